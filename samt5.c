@@ -1,6 +1,20 @@
+#define _POSIX_C_SOURCE 200809L    // for sysconf(), mmap() and the pthreads API
+
 #include "CSet.h"
 
+#include "stddef.h"
 #include "stdlib.h"
+#include "string.h"
+#include "pthread.h"
+#include "sched.h"
+#include "time.h"
+#include "unistd.h"
+#include "fcntl.h"
+#include "sys/mman.h"
+#include "sys/stat.h"
+#if defined(__SSE2__)
+#include "emmintrin.h"
+#endif
 
 // CSet provides an implementation of a set type for storing a collection of
 // signed 32-bit integer values (int32_t).
@@ -33,6 +47,18 @@
 //
 // This is here for demo purposes
 
+// Kinds of change recorded by a change feed; see CSetFeed below.
+enum _CSetFeedOp {
+
+	CSETFEED_INSERT,       // Value was inserted
+	CSETFEED_REMOVE,       // Value was removed
+	CSETFEED_RESET         // the set was replaced as a whole
+};
+
+typedef enum _CSetFeedOp CSetFeedOp;
+
+static void CSet_Notify(const CSet* const pSet, CSetFeedOp Op, int32_t Value);
+
 /**
  * Initializes a raw pSet object, with capacity Sz.
  *
@@ -97,9 +123,6 @@ bool CSet_Init(CSet* const pSet, uint32_t Sz) {
  * Complexity:  O( pSet->Usage )
  */
 bool CSet_Insert(CSet* const pSet, int32_t Value) {
-	if (pSet->Data == NULL) {
-		return false;
-	}
 	//Determine if we have enough space to insert a value
 	if (pSet->Usage + 1 < pSet->Capacity) {
 		uint32_t i = 0;
@@ -125,6 +148,9 @@ bool CSet_Insert(CSet* const pSet, int32_t Value) {
 	}
 	//If we don't have space, make a new array and move everything there
 	else {
+		if (CSet_Contains(pSet, Value)) {
+			return false;
+		}
 		uint32_t capacity = pSet->Capacity;
 		if (capacity <= 0) {
 			capacity = 1;
@@ -134,13 +160,15 @@ bool CSet_Insert(CSet* const pSet, int32_t Value) {
 		pSet->Capacity = capacity * 2;
 		uint32_t i = 0;
 		uint32_t j = 0;
+		bool placed = false;
 		while (i < pSet->Usage + 1) {
-			if (j < pSet->Usage && pSet->Data[j] < Value) {
+			if (j < pSet->Usage && (placed || pSet->Data[j] < Value)) {
 				NewData[i] = pSet->Data[j];
 				j++;
 			}
 			else {
 				NewData[i] = Value;
+				placed = true;
 			}
 			i++;
 		}
@@ -152,6 +180,7 @@ bool CSet_Insert(CSet* const pSet, int32_t Value) {
 		pSet->Data = NewData;
 	}
 	pSet->Usage++;
+	CSet_Notify(pSet, CSETFEED_INSERT, Value);
 	return true;
 }
 
@@ -201,9 +230,48 @@ bool CSet_Insert(CSet* const pSet, int32_t Value) {
 		CSet_Remove(pSet, Value);
 		pSet->Data[pSet->Usage] = INT32_MIN;
 	}
+	if (found) {
+		CSet_Notify(pSet, CSETFEED_REMOVE, Value);
+	}
 	return found;
 }
 
+// Sets of at most CSet_ScanMax values are searched by a linear scan, and
+// intersections and subset tests where the sets have at most
+// CSet_PairsMax values compare all pairs, since for small sets both beat
+// binary search and branchy merging.  CSet_Calibrate() measures the
+// crossover points on the running CPU.
+static uint32_t CSet_ScanMax = 32;
+static uint32_t CSet_PairsMax = 16;
+
+/**
+ * Returns true if Value is among Data[0 : n-1], by a linear scan that
+ * compares four values at a time where SSE2 is available.
+ */
+static bool CSet_ScanFind(const int32_t* Data, uint32_t n, int32_t Value) {
+	uint32_t i = 0;
+#if defined(__SSE2__)
+	__m128i key = _mm_set1_epi32(Value);
+	while (i + 8 <= n) {
+		__m128i lo = _mm_cmpeq_epi32(_mm_loadu_si128((const __m128i*)(Data + i)), key);
+		__m128i hi = _mm_cmpeq_epi32(_mm_loadu_si128((const __m128i*)(Data + i + 4)), key);
+		if (_mm_movemask_epi8(_mm_or_si128(lo, hi)) != 0) return true;
+		i += 8;
+	}
+	if (i + 4 <= n) {
+		if (_mm_movemask_epi8(_mm_cmpeq_epi32(_mm_loadu_si128((const __m128i*)(Data + i)), key)) != 0) {
+			return true;
+		}
+		i += 4;
+	}
+#endif
+	while (i < n) {
+		if (Data[i] == Value) return true;
+		i++;
+	}
+	return false;
+}
+
 /**
  * Determines if Value belongs to the given pSet object.
  *
@@ -218,7 +286,7 @@ bool CSet_Insert(CSet* const pSet, int32_t Value) {
  * Complexity:  O( log(pSet->Usage) )
  */
 bool CSet_Contains(const CSet* const pSet, int32_t Value) {
-	if (pSet->Usage == 0) return false;
+	if (pSet->Usage <= CSet_ScanMax) return CSet_ScanFind(pSet->Data, pSet->Usage, Value);
 	int32_t max = pSet->Usage - 1;
 	int32_t min = 0;
 	//Binary search for the max value
@@ -281,7 +349,7 @@ bool CSet_Equals(const CSet* const pA, const CSet* const pB) {
  *    *pB is unchanged
  * Returns:
  *    true if *pB contains every element of *pA, false otherwise
- * Complexity:  O( pA->Usage )
+ * Complexity:  O( pA->Usage + pB->Usage )
  */
 bool CSet_isSubsetOf(const CSet* const pA, const CSet* const pB) {
 	if (pA->Usage > pB->Usage) {
@@ -290,10 +358,18 @@ bool CSet_isSubsetOf(const CSet* const pA, const CSet* const pB) {
 	}
 	uint32_t a = 0;
 	uint32_t b = a;
+	if (pB->Usage <= CSet_PairsMax) {
+		//Small: look for each element of pA in all of pB
+		while (a < pA->Usage) {
+			if (!CSet_ScanFind(pB->Data, pB->Usage, pA->Data[a])) return false;
+			a++;
+		}
+		return true;
+	}
 	while (a < pA->Usage && b < pB->Usage) {
 		if (pA->Data[a] > pB->Data[b]) {
-			a++;
-			if (b == pB->Usage - 1) return false;
+			//pB->Data[b] is not in pA; move past it
+			b++;
 		}
 		else if (pA->Data[a] == pB->Data[b]) {
 			b++;
@@ -331,9 +407,23 @@ bool CSet_Intersection(CSet* const pIntersection, const CSet* const pA, const CS
 	uint32_t a = 0;
 	uint32_t b = 0;
 	uint32_t capacity = (pA->Capacity > pB->Capacity) ? pB->Capacity : pA->Capacity;
-	int32_t* data = (int32_t*)malloc(capacity * sizeof(int32_t));
-	if (data == NULL) {
-		return false;
+	int32_t* data = NULL;
+	if (capacity > 0) {
+		data = (int32_t*)malloc(capacity * sizeof(int32_t));
+		if (data == NULL) {
+			return false;
+		}
+	}
+	if (pA->Usage <= CSet_PairsMax && pB->Usage <= CSet_PairsMax) {
+		//Small: look for each element of pA in all of pB; the merge below
+		//then has nothing left to do
+		while (a < pA->Usage) {
+			if (CSet_ScanFind(pB->Data, pB->Usage, pA->Data[a])) {
+				data[i] = pA->Data[a];
+				i++;
+			}
+			a++;
+		}
 	}
 	while (a < pA->Usage && b < pB->Usage) {
 		if (pA->Data[a] < pB->Data[b]) {
@@ -356,9 +446,143 @@ bool CSet_Intersection(CSet* const pIntersection, const CSet* const pA, const CS
 	free(pIntersection->Data);
 	pIntersection->Data = data;
 	pIntersection->Capacity = capacity;
+	CSet_Notify(pIntersection, CSETFEED_RESET, 0);
 	return true;
 }
  
+// Blocks of at least this many elements are written with non-temporal
+// (cache-bypassing) stores where SSE2 is available, so that copying a huge
+// set does not evict the working set of everything else.
+#define CSET_STREAM_MIN (1u << 18)
+
+/**
+ * Copies n values from Src to Dst with non-temporal stores where
+ * available.  The caller issues the closing fence (CSet_StreamEnd()).
+ */
+static void CSet_StreamBlock(int32_t* Dst, const int32_t* Src, size_t n) {
+#if defined(__SSE2__)
+	//Plain stores up to the first 16-byte boundary of Dst
+	while (n > 0 && ((uintptr_t)Dst & 15) != 0) {
+		*Dst++ = *Src++;
+		n--;
+	}
+	while (n >= 4) {
+		_mm_stream_si128((__m128i*)Dst, _mm_loadu_si128((const __m128i*)Src));
+		Dst += 4;
+		Src += 4;
+		n -= 4;
+	}
+#endif
+	if (n > 0) {
+		memcpy(Dst, Src, n * sizeof(int32_t));
+	}
+}
+
+/**
+ * Orders non-temporal stores before any later store.
+ */
+static void CSet_StreamEnd(void) {
+#if defined(__SSE2__)
+	_mm_sfence();
+#endif
+}
+
+/**
+ * Copies n values from Src to Dst, streaming them past the cache when n is
+ * at least CSET_STREAM_MIN.
+ */
+static void CSet_StreamCopy(int32_t* Dst, const int32_t* Src, size_t n) {
+	if (n >= CSET_STREAM_MIN) {
+		CSet_StreamBlock(Dst, Src, n);
+		CSet_StreamEnd();
+	}
+	else if (n > 0) {
+		memcpy(Dst, Src, n * sizeof(int32_t));
+	}
+}
+
+/**
+ * Sets n cells of Dst to Value, streaming them past the cache when n is at
+ * least CSET_STREAM_MIN.
+ */
+static void CSet_StreamFill(int32_t* Dst, int32_t Value, size_t n) {
+#if defined(__SSE2__)
+	if (n >= CSET_STREAM_MIN) {
+		__m128i fill = _mm_set1_epi32(Value);
+		while (n > 0 && ((uintptr_t)Dst & 15) != 0) {
+			*Dst++ = Value;
+			n--;
+		}
+		while (n >= 4) {
+			_mm_stream_si128((__m128i*)Dst, fill);
+			Dst += 4;
+			n -= 4;
+		}
+		_mm_sfence();
+	}
+#endif
+	while (n > 0) {
+		*Dst++ = Value;
+		n--;
+	}
+}
+
+// Values a CSetWriter gathers before writing them out in one block.
+#define CSET_STAGE 64
+
+// Output cursor for merges.  Small outputs are written directly; large
+// ones are gathered in a cache-resident stage and streamed out a block at
+// a time, so that the output does not displace the inputs from the cache.
+struct _CSetWriter {
+
+	int32_t* Out;
+	uint32_t n;                  // values written to Out
+	uint32_t Staged;
+	bool     Stream;
+	int32_t  Stage[CSET_STAGE];
+};
+
+static void CSet_WriterInit(struct _CSetWriter* pWriter, int32_t* Out, uint32_t Capacity) {
+	pWriter->Out = Out;
+	pWriter->n = 0;
+	pWriter->Staged = 0;
+	pWriter->Stream = (Capacity >= CSET_STREAM_MIN);
+}
+
+static void CSet_WriterPut(struct _CSetWriter* pWriter, int32_t Value) {
+	if (!pWriter->Stream) {
+		pWriter->Out[pWriter->n++] = Value;
+		return;
+	}
+	pWriter->Stage[pWriter->Staged++] = Value;
+	if (pWriter->Staged == CSET_STAGE) {
+		CSet_StreamBlock(pWriter->Out + pWriter->n, pWriter->Stage, CSET_STAGE);
+		pWriter->n += CSET_STAGE;
+		pWriter->Staged = 0;
+	}
+}
+
+/**
+ * Writes out whatever is staged; returns the number of values written.
+ */
+static uint32_t CSet_WriterEnd(struct _CSetWriter* pWriter) {
+	if (pWriter->Stream) {
+		CSet_StreamBlock(pWriter->Out + pWriter->n, pWriter->Stage, pWriter->Staged);
+		pWriter->n += pWriter->Staged;
+		pWriter->Staged = 0;
+		CSet_StreamEnd();
+	}
+	return pWriter->n;
+}
+
+/**
+ * Returns true if every value of *pA is less than every value of *pB,
+ * which holds trivially if either is empty.
+ */
+static bool CSet_Precedes(const CSet* const pA, const CSet* const pB) {
+	return pA->Usage == 0 || pB->Usage == 0 || pA->Data[pA->Usage - 1] < pB->Data[0];
+}
+
 /**
  * Sets *pSym to be the symmetric difference of the sets *pA and *pB.
  *
@@ -379,40 +603,57 @@ bool CSet_Intersection(CSet* const pIntersection, const CSet* const pA, const CS
  */
 bool CSet_SymDifference(CSet* const pSym, const CSet* const pA, const CSet* const pB) {
 	uint32_t capacity = pA->Capacity + pB->Capacity;
-	int32_t* data = (int32_t*)malloc(capacity * sizeof(int32_t));
-	if (data == NULL) return false;
+	int32_t* data = NULL;
+	if (capacity > 0) {
+		data = (int32_t*)malloc(capacity * sizeof(int32_t));
+		if (data == NULL) return false;
+	}
 	uint32_t i = 0;
-	uint32_t a = 0;
-	uint32_t b = 0;
-	while (a < pA->Usage || b < pB->Usage) {
-		if (a < pA->Usage && b < pB->Usage) {
-			if (pA->Data[a] == pB->Data[b]) {
-				a++;
-				b++;
+	//Range-disjoint inputs need no merge: copy one after the other
+	const CSet* pFirst = CSet_Precedes(pA, pB) ? pA : CSet_Precedes(pB, pA) ? pB : NULL;
+	if (pFirst != NULL) {
+		const CSet* pSecond = (pFirst == pA) ? pB : pA;
+		if (pFirst->Usage > 0) {
+			CSet_StreamCopy(data, pFirst->Data, pFirst->Usage);
+		}
+		if (pSecond->Usage > 0) {
+			CSet_StreamCopy(data + pFirst->Usage, pSecond->Data, pSecond->Usage);
+		}
+		i = pFirst->Usage + pSecond->Usage;
+	}
+	else {
+		uint32_t a = 0;
+		uint32_t b = 0;
+		while (a < pA->Usage || b < pB->Usage) {
+			if (a < pA->Usage && b < pB->Usage) {
+				if (pA->Data[a] == pB->Data[b]) {
+					a++;
+					b++;
+				}
+				else if (pA->Data[a] < pB->Data[b]) {
+					data[i] = pA->Data[a];
+					i++;
+					a++;
+				}
+				else {
+					data[i] = pB->Data[b];
+					i++;
+					b++;
+				}
 			}
-			else if (pA->Data[a] < pB->Data[b]) {
+			//If b is at its usage then all in a should be added
+			else if (a < pA->Usage) {
 				data[i] = pA->Data[a];
 				i++;
 				a++;
 			}
+			//Inverse of previous conditional statement.
 			else {
 				data[i] = pB->Data[b];
 				i++;
 				b++;
 			}
 		}
-		//If b is at its usage then all in a should be added
-		else if (a < pA->Usage) {
-			data[i] = pA->Data[a];
-			i++;
-			a++;
-		}
-		//Inverse of previous conditional statement.
-		else {
-			data[i] = pB->Data[b];
-			i++;
-			b++;
-		}
 	}
 	pSym->Usage = i;
 	while (i < capacity) {
@@ -424,6 +665,7 @@ bool CSet_SymDifference(CSet* const pSym, const CSet* const pA, const CSet* cons
 	}
 	pSym->Data = data;
 	pSym->Capacity = capacity;
+	CSet_Notify(pSym, CSETFEED_RESET, 0);
 	return true;
 }
 
@@ -445,25 +687,23 @@ bool CSet_SymDifference(CSet* const pSym, const CSet* const pA, const CSet* cons
  * Returns:
  *    true if successful, false otherwise
  * 
- * Complexity:  O( max(pSource->Usage) )
+ * Complexity:  O( pSource->Capacity ), reading only pSource->Usage cells
  */
 bool CSet_Copy(CSet* const pTarget, const CSet* const pSource) {
 	if (pTarget == pSource) return true;
-	int32_t* initialData = NULL;
-	if (pTarget->Data != NULL) {
-		initialData = pTarget->Data;
+	int32_t* data = NULL;
+	if (pSource->Capacity > 0) {
+		data = (int32_t*)malloc(pSource->Capacity * sizeof(int32_t));
+		if (data == NULL) return false;
 	}
-	pTarget->Data = malloc(pSource->Capacity * sizeof(int32_t));
-	if (pTarget->Data == NULL) {
-		pTarget->Data = initialData;
-		return false;
-	}
-	for (uint32_t i = 0; i < pSource->Capacity; i++) {
-		pTarget->Data[i] = pSource->Data[i];
-	}
-	free(initialData);
+	//Only the live values are read; the tail is known to be FILLER
+	CSet_StreamCopy(data, pSource->Data, pSource->Usage);
+	CSet_StreamFill(data + pSource->Usage, FILLER, pSource->Capacity - pSource->Usage);
+	free(pTarget->Data);
+	pTarget->Data = data;
 	pTarget->Usage = pSource->Usage;
 	pTarget->Capacity = pSource->Capacity;
+	CSet_Notify(pTarget, CSETFEED_RESET, 0);
 	return true;
 }
 
@@ -512,3 +752,7263 @@ bool CSet_isEmpty(const CSet* const pSet) {
 	return (pSet->Usage == 0);
 }
 
+/**
+ * Finds the first position in Data[Lo : Hi-1] whose value is not less
+ * than Value.
+ *
+ * Pre:
+ *    Data[Lo : Hi-1] is in ascending order
+ * Returns:
+ *    the smallest i in [Lo, Hi] such that i == Hi or Data[i] >= Value
+ *
+ * Complexity:  O( log(Hi - Lo) )
+ */
+static uint32_t CSet_LowerBound(const int32_t* Data, uint32_t Lo, uint32_t Hi, int32_t Value) {
+	while (Lo < Hi) {
+		uint32_t mid = Lo + (Hi - Lo) / 2;
+		if (Data[mid] < Value) {
+			Lo = mid + 1;
+		}
+		else {
+			Hi = mid;
+		}
+	}
+	return Lo;
+}
+
+// CMultiSet provides a counting variant of CSet, in which each value may
+// occur more than once.  Rather than storing duplicates, each distinct value
+// is stored once together with the number of times it occurs.
+//
+// Storage is a pair of parallel arrays: Data holds the distinct values in
+// ascending order, exactly as a CSet does, and Count holds the matching
+// multiplicities, so Count[i] is the number of occurrences of Data[i].
+// Multiplicities saturate at UINT32_MAX.
+//
+// We say a CMultiSet object M is proper if and only if it satisfies each of
+// the following conditions:
+//
+//  1.  If M.Capacity == 0 then M.Usage == 0, and M.Data and M.Count are NULL.
+//  2.  If M.Capacity > 0 then M.Data and M.Count point to arrays of
+//      dimension M.Capacity.
+//  3.  M.Data[0 : M.Usage-1] are the distinct values in the multiset, in
+//      ascending order, and M.Count[0 : M.Usage-1] are all nonzero.
+//  4.  M.Data[M.Usage : M.Capacity-1] equal INT32_MIN (FILLER) and
+//      M.Count[M.Usage : M.Capacity-1] equal 0.
+//
+struct _CMultiSet {
+
+	uint32_t  Capacity;    // dimension of the Data and Count arrays
+	uint32_t  Usage;       // number of distinct values in the multiset
+	int32_t*  Data;        // distinct values, ascending
+	uint32_t* Count;       // multiplicity of each value in Data
+};
+
+typedef struct _CMultiSet CMultiSet;
+
+// How CMultiSet_Union() combines the counts of values found in both inputs.
+enum _CMultiSetMode {
+
+	CMULTISET_MAX,         // count is max(a, b)
+	CMULTISET_SUM          // count is a + b, saturating at UINT32_MAX
+};
+
+typedef enum _CMultiSetMode CMultiSetMode;
+
+/**
+ * Allocates the Data and Count arrays for a CMultiSet of capacity Sz,
+ * with every cell set to FILLER and 0 respectively.
+ *
+ * Returns:
+ *    true if successful (or Sz == 0, in which case both are NULL),
+ *    false otherwise; on failure nothing is allocated
+ */
+static bool CMultiSet_Alloc(uint32_t Sz, int32_t** pData, uint32_t** pCount) {
+	*pData = NULL;
+	*pCount = NULL;
+	if (Sz == 0) return true;
+	*pData = (int32_t*)malloc(Sz * sizeof(int32_t));
+	*pCount = (uint32_t*)calloc(Sz, sizeof(uint32_t));
+	if (*pData == NULL || *pCount == NULL) {
+		free(*pData);
+		free(*pCount);
+		*pData = NULL;
+		*pCount = NULL;
+		return false;
+	}
+	uint32_t i = 0;
+	while (i < Sz) {
+		(*pData)[i] = INT32_MIN;
+		i++;
+	}
+	return true;
+}
+
+/**
+ * Replaces the storage of pSet with the given arrays, releasing the old
+ * storage and restoring the FILLER / 0 tail above Usage.
+ */
+static void CMultiSet_Adopt(CMultiSet* const pSet, int32_t* Data, uint32_t* Count,
+                            uint32_t Usage, uint32_t Capacity) {
+	uint32_t i = Usage;
+	while (i < Capacity) {
+		Data[i] = INT32_MIN;
+		Count[i] = 0;
+		i++;
+	}
+	free(pSet->Data);
+	free(pSet->Count);
+	pSet->Data = Data;
+	pSet->Count = Count;
+	pSet->Usage = Usage;
+	pSet->Capacity = Capacity;
+}
+
+/**
+ * Initializes a raw pSet object, with capacity Sz.
+ *
+ * Pre:
+ *    pSet points to a CMultiSet object, but *pSet may be proper or raw
+ *    Sz   has been initialized
+ * Post:
+ *    If successful:
+ *       pSet->Capacity == Sz
+ *       pSet->Usage == 0
+ *       *pSet is proper
+ *    else:
+ *       pSet->Capacity == 0, pSet->Usage == 0
+ *       pSet->Data == NULL, pSet->Count == NULL
+ * Returns:
+ *    true if successful, false otherwise
+ *
+ * Complexity:  O( Sz )
+ */
+bool CMultiSet_Init(CMultiSet* const pSet, uint32_t Sz) {
+	if (pSet == NULL) return false;
+	pSet->Usage = 0;
+	if (!CMultiSet_Alloc(Sz, &pSet->Data, &pSet->Count)) {
+		pSet->Capacity = 0;
+		return false;
+	}
+	pSet->Capacity = Sz;
+	return true;
+}
+
+/**
+ * Releases the storage held by a pSet object.
+ *
+ * Pre:
+ *    *pSet is proper
+ * Post:
+ *    *pSet is proper and empty, with capacity 0
+ *
+ * Complexity:  O( 1 )
+ */
+void CMultiSet_Free(CMultiSet* const pSet) {
+	free(pSet->Data);
+	free(pSet->Count);
+	pSet->Data = NULL;
+	pSet->Count = NULL;
+	pSet->Usage = 0;
+	pSet->Capacity = 0;
+}
+
+/**
+ * Reports the number of occurrences of Value in a pSet object.
+ *
+ * Pre:
+ *    *pSet is proper
+ * Post:
+ *    *pSet is unchanged
+ * Returns:
+ *    the multiplicity of Value, which is 0 if Value is not a member
+ *
+ * Complexity:  O( log(pSet->Usage) )
+ */
+uint32_t CMultiSet_Count(const CMultiSet* const pSet, int32_t Value) {
+	uint32_t i = CSet_LowerBound(pSet->Data, 0, pSet->Usage, Value);
+	if (i < pSet->Usage && pSet->Data[i] == Value) {
+		return pSet->Count[i];
+	}
+	return 0;
+}
+
+/**
+ * Adds By occurrences of Value to a pSet object.
+ *
+ * Pre:
+ *    *pSet is proper
+ *    By > 0
+ * Post:
+ *    If successful:
+ *       the multiplicity of Value has grown by By (saturating at UINT32_MAX)
+ *       pSet->Capacity has been doubled, if a new value had no room
+ *       *pSet is proper
+ *    else:
+ *       *pSet is unchanged
+ * Returns:
+ *    true if successful, false otherwise
+ *
+ * Complexity:  O( log(pSet->Usage) ) if Value is already a member,
+ *              O( pSet->Usage ) otherwise
+ */
+bool CMultiSet_Increment(CMultiSet* const pSet, int32_t Value, uint32_t By) {
+	if (By == 0) return false;
+	uint32_t i = CSet_LowerBound(pSet->Data, 0, pSet->Usage, Value);
+	//Existing value, bump its count in place
+	if (i < pSet->Usage && pSet->Data[i] == Value) {
+		uint32_t sum = pSet->Count[i] + By;
+		pSet->Count[i] = (sum < By) ? UINT32_MAX : sum;
+		return true;
+	}
+	//New value, grow if there is no free cell
+	if (pSet->Usage == pSet->Capacity) {
+		uint32_t capacity = (pSet->Capacity == 0) ? 1 : pSet->Capacity * 2;
+		int32_t* data;
+		uint32_t* count;
+		if (!CMultiSet_Alloc(capacity, &data, &count)) return false;
+		if (pSet->Usage > 0) {
+			memcpy(data, pSet->Data, i * sizeof(int32_t));
+			memcpy(count, pSet->Count, i * sizeof(uint32_t));
+			memcpy(data + i + 1, pSet->Data + i, (pSet->Usage - i) * sizeof(int32_t));
+			memcpy(count + i + 1, pSet->Count + i, (pSet->Usage - i) * sizeof(uint32_t));
+		}
+		data[i] = Value;
+		count[i] = By;
+		CMultiSet_Adopt(pSet, data, count, pSet->Usage + 1, capacity);
+		return true;
+	}
+	memmove(pSet->Data + i + 1, pSet->Data + i, (pSet->Usage - i) * sizeof(int32_t));
+	memmove(pSet->Count + i + 1, pSet->Count + i, (pSet->Usage - i) * sizeof(uint32_t));
+	pSet->Data[i] = Value;
+	pSet->Count[i] = By;
+	pSet->Usage++;
+	return true;
+}
+
+/**
+ * Removes up to By occurrences of Value from a pSet object.
+ *
+ * Pre:
+ *    *pSet is proper
+ * Post:
+ *    If Value was a member of *pSet:
+ *       the multiplicity of Value has dropped by min(By, old multiplicity)
+ *       if it dropped to 0, Value is no longer a member and
+ *          pSet->Usage is decremented
+ *       pSet->Capacity is unchanged
+ *       *pSet is proper
+ *    else:
+ *       *pSet is unchanged
+ * Returns:
+ *    the remaining multiplicity of Value
+ *
+ * Complexity:  O( log(pSet->Usage) ) if Value keeps a nonzero count,
+ *              O( pSet->Usage ) otherwise
+ */
+uint32_t CMultiSet_Decrement(CMultiSet* const pSet, int32_t Value, uint32_t By) {
+	uint32_t i = CSet_LowerBound(pSet->Data, 0, pSet->Usage, Value);
+	if (i == pSet->Usage || pSet->Data[i] != Value) {
+		return 0;
+	}
+	if (pSet->Count[i] > By) {
+		pSet->Count[i] -= By;
+		return pSet->Count[i];
+	}
+	//Count dropped to zero, close the gap
+	memmove(pSet->Data + i, pSet->Data + i + 1, (pSet->Usage - i - 1) * sizeof(int32_t));
+	memmove(pSet->Count + i, pSet->Count + i + 1, (pSet->Usage - i - 1) * sizeof(uint32_t));
+	pSet->Usage--;
+	pSet->Data[pSet->Usage] = INT32_MIN;
+	pSet->Count[pSet->Usage] = 0;
+	return 0;
+}
+
+/**
+ * Determines whether two CMultiSet objects store the same distinct values
+ * in the same positions, i.e. whether their Data arrays can be combined
+ * lane by lane without a merge.
+ */
+static bool CMultiSet_SameKeys(const CMultiSet* const pA, const CMultiSet* const pB) {
+	return pA->Usage == pB->Usage &&
+	       (pA->Usage == 0 || memcmp(pA->Data, pB->Data, pA->Usage * sizeof(int32_t)) == 0);
+}
+
+/**
+ * Sets *pUnion to be the multiset union of *pA and *pB.
+ *
+ * Pre:
+ *    *pUnion, *pA and *pB are proper
+ * Post:
+ *    *pA and *pB are unchanged, unless *pUnion aliases *pA or *pB
+ *    For every integer x, the multiplicity of x in *pUnion is
+ *       max(a, b) if Mode == CMULTISET_MAX, or
+ *       a + b     if Mode == CMULTISET_SUM (saturating at UINT32_MAX),
+ *       where a and b are the multiplicities of x in *pA and *pB
+ *    pUnion->Capacity == pA->Usage + pB->Usage
+ *    *pUnion is proper
+ * Returns:
+ *    true if the union is successfully created; false otherwise, in which
+ *    case *pUnion is unchanged
+ *
+ * Complexity:  O( pA->Usage + pB->Usage )
+ */
+bool CMultiSet_Union(CMultiSet* const pUnion, const CMultiSet* const pA,
+                     const CMultiSet* const pB, CMultiSetMode Mode) {
+	uint32_t capacity = pA->Usage + pB->Usage;
+	int32_t* data;
+	uint32_t* count;
+	if (!CMultiSet_Alloc(capacity, &data, &count)) return false;
+	const uint32_t* ca = pA->Count;
+	const uint32_t* cb = pB->Count;
+	uint32_t i = 0;
+	//Identical key arrays: no merge needed, the count arrays are combined
+	//lane by lane in a branch-free loop the compiler can vectorize
+	if (CMultiSet_SameKeys(pA, pB)) {
+		if (pA->Usage > 0) {
+			memcpy(data, pA->Data, pA->Usage * sizeof(int32_t));
+		}
+		if (Mode == CMULTISET_MAX) {
+			while (i < pA->Usage) {
+				count[i] = (ca[i] > cb[i]) ? ca[i] : cb[i];
+				i++;
+			}
+		}
+		else {
+			while (i < pA->Usage) {
+				uint32_t sum = ca[i] + cb[i];
+				count[i] = (sum < ca[i]) ? UINT32_MAX : sum;
+				i++;
+			}
+		}
+		CMultiSet_Adopt(pUnion, data, count, i, capacity);
+		return true;
+	}
+	uint32_t a = 0;
+	uint32_t b = 0;
+	while (a < pA->Usage && b < pB->Usage) {
+		if (pA->Data[a] < pB->Data[b]) {
+			data[i] = pA->Data[a];
+			count[i] = ca[a];
+			a++;
+		}
+		else if (pA->Data[a] > pB->Data[b]) {
+			data[i] = pB->Data[b];
+			count[i] = cb[b];
+			b++;
+		}
+		else {
+			data[i] = pA->Data[a];
+			if (Mode == CMULTISET_MAX) {
+				count[i] = (ca[a] > cb[b]) ? ca[a] : cb[b];
+			}
+			else {
+				uint32_t sum = ca[a] + cb[b];
+				count[i] = (sum < ca[a]) ? UINT32_MAX : sum;
+			}
+			a++;
+			b++;
+		}
+		i++;
+	}
+	//At most one of these tails is non-empty
+	if (a < pA->Usage) {
+		memcpy(data + i, pA->Data + a, (pA->Usage - a) * sizeof(int32_t));
+		memcpy(count + i, ca + a, (pA->Usage - a) * sizeof(uint32_t));
+		i += pA->Usage - a;
+	}
+	if (b < pB->Usage) {
+		memcpy(data + i, pB->Data + b, (pB->Usage - b) * sizeof(int32_t));
+		memcpy(count + i, cb + b, (pB->Usage - b) * sizeof(uint32_t));
+		i += pB->Usage - b;
+	}
+	CMultiSet_Adopt(pUnion, data, count, i, capacity);
+	return true;
+}
+
+/**
+ * Sets *pIntersection to be the multiset intersection of *pA and *pB.
+ *
+ * Pre:
+ *    *pIntersection, *pA and *pB are proper
+ * Post:
+ *    *pA and *pB are unchanged, unless *pIntersection aliases *pA or *pB
+ *    For every integer x, the multiplicity of x in *pIntersection is
+ *       min(a, b), where a and b are the multiplicities of x in *pA and *pB
+ *    pIntersection->Capacity == min(pA->Usage, pB->Usage)
+ *    *pIntersection is proper
+ * Returns:
+ *    true if the intersection is successfully created; false otherwise,
+ *    in which case *pIntersection is unchanged
+ *
+ * Complexity:  O( pA->Usage + pB->Usage )
+ */
+bool CMultiSet_Intersection(CMultiSet* const pIntersection, const CMultiSet* const pA,
+                            const CMultiSet* const pB) {
+	uint32_t capacity = (pA->Usage < pB->Usage) ? pA->Usage : pB->Usage;
+	int32_t* data;
+	uint32_t* count;
+	if (!CMultiSet_Alloc(capacity, &data, &count)) return false;
+	const uint32_t* ca = pA->Count;
+	const uint32_t* cb = pB->Count;
+	uint32_t i = 0;
+	if (CMultiSet_SameKeys(pA, pB)) {
+		if (pA->Usage > 0) {
+			memcpy(data, pA->Data, pA->Usage * sizeof(int32_t));
+		}
+		while (i < pA->Usage) {
+			count[i] = (ca[i] < cb[i]) ? ca[i] : cb[i];
+			i++;
+		}
+		CMultiSet_Adopt(pIntersection, data, count, i, capacity);
+		return true;
+	}
+	uint32_t a = 0;
+	uint32_t b = 0;
+	while (a < pA->Usage && b < pB->Usage) {
+		if (pA->Data[a] < pB->Data[b]) {
+			a++;
+		}
+		else if (pA->Data[a] > pB->Data[b]) {
+			b++;
+		}
+		else {
+			data[i] = pA->Data[a];
+			count[i] = (ca[a] < cb[b]) ? ca[a] : cb[b];
+			a++;
+			b++;
+			i++;
+		}
+	}
+	CMultiSet_Adopt(pIntersection, data, count, i, capacity);
+	return true;
+}
+
+/**
+ * Sets *pDiff to be the multiset difference *pA - *pB.
+ *
+ * Pre:
+ *    *pDiff, *pA and *pB are proper
+ * Post:
+ *    *pA and *pB are unchanged, unless *pDiff aliases *pA or *pB
+ *    For every integer x, the multiplicity of x in *pDiff is a - b if
+ *       a > b and 0 otherwise, where a and b are the multiplicities of x
+ *       in *pA and *pB
+ *    pDiff->Capacity == pA->Usage
+ *    *pDiff is proper
+ * Returns:
+ *    true if the difference is successfully created; false otherwise,
+ *    in which case *pDiff is unchanged
+ *
+ * Complexity:  O( pA->Usage + pB->Usage )
+ */
+bool CMultiSet_Difference(CMultiSet* const pDiff, const CMultiSet* const pA,
+                          const CMultiSet* const pB) {
+	uint32_t capacity = pA->Usage;
+	int32_t* data;
+	uint32_t* count;
+	if (!CMultiSet_Alloc(capacity, &data, &count)) return false;
+	const uint32_t* ca = pA->Count;
+	const uint32_t* cb = pB->Count;
+	uint32_t i = 0;
+	uint32_t a = 0;
+	uint32_t b = 0;
+	while (a < pA->Usage) {
+		//Skip over values of B that cannot match
+		while (b < pB->Usage && pB->Data[b] < pA->Data[a]) {
+			b++;
+		}
+		uint32_t left = ca[a];
+		if (b < pB->Usage && pB->Data[b] == pA->Data[a]) {
+			left = (ca[a] > cb[b]) ? ca[a] - cb[b] : 0;
+			b++;
+		}
+		//Written unconditionally; only kept when the count survives
+		data[i] = pA->Data[a];
+		count[i] = left;
+		i += (left != 0);
+		a++;
+	}
+	CMultiSet_Adopt(pDiff, data, count, i, capacity);
+	return true;
+}
+
+/**
+ * Sets *pSet to hold the distinct values of *pMulti, ignoring counts.
+ *
+ * Pre:
+ *    *pSet and *pMulti are proper
+ * Post:
+ *    *pMulti is unchanged
+ *    If successful:
+ *       x is contained in *pSet iff x has a nonzero count in *pMulti
+ *       pSet->Capacity == pMulti->Capacity
+ *       *pSet is proper
+ *    else:
+ *       *pSet is unchanged
+ * Returns:
+ *    true if successful, false otherwise
+ *
+ * Complexity:  O( pMulti->Capacity )
+ */
+bool CMultiSet_Support(CSet* const pSet, const CMultiSet* const pMulti) {
+	CSet view = { pMulti->Capacity, pMulti->Usage, pMulti->Data };
+	return CSet_Copy(pSet, &view);
+}
+
+/**
+ * Finds the first position in Data[Lo : Hi-1] whose value is not less
+ * than Value, probing forward from Lo in doubling steps before bisecting.
+ * This is cheaper than CSet_LowerBound() when the answer is near Lo, as
+ * it is when a merge cursor advances by small amounts.
+ *
+ * Pre:
+ *    Data[Lo : Hi-1] is in ascending order
+ * Returns:
+ *    the smallest i in [Lo, Hi] such that i == Hi or Data[i] >= Value
+ *
+ * Complexity:  O( log(d) ), where d is the distance from Lo to the answer
+ */
+static uint32_t CSet_Gallop(const int32_t* Data, uint32_t Lo, uint32_t Hi, int32_t Value) {
+	uint32_t step = 1;
+	uint32_t probe = Lo;
+	while (probe < Hi && Data[probe] < Value) {
+		Lo = probe + 1;
+		probe = (Hi - probe > step) ? probe + step : Hi;
+		step *= 2;
+	}
+	return CSet_LowerBound(Data, Lo, probe, Value);
+}
+
+// Number of consecutive elements summarized by one block-max entry of a
+// CWSet.
+#define CWSET_BLOCK 64
+
+// CWSet is a weighted CSet: every member value carries a nonnegative
+// weight.  Data holds the values in ascending order exactly as a CSet does,
+// and Weight[i] is the weight of Data[i].
+//
+// For top-k retrieval each set may also carry block-max bounds: BlockMax[b]
+// is the largest weight among Data[b*CWSET_BLOCK : (b+1)*CWSET_BLOCK - 1]
+// and MaxWeight is the largest weight in the set.  The bounds are built by
+// CWSet_Seal() and are discarded by any update to the set.
+//
+// We say a CWSet object W is proper if and only if it satisfies each of the
+// following conditions:
+//
+//  1.  If W.Capacity == 0 then W.Usage == 0, and W.Data and W.Weight are NULL.
+//  2.  If W.Capacity > 0 then W.Data and W.Weight point to arrays of
+//      dimension W.Capacity.
+//  3.  W.Data[0 : W.Usage-1] are the values in the set, in ascending order,
+//      and W.Weight[0 : W.Usage-1] are their weights, all >= 0.
+//  4.  W.Data[W.Usage : W.Capacity-1] equal INT32_MIN (FILLER) and
+//      W.Weight[W.Usage : W.Capacity-1] equal 0.
+//  5.  If W.BlockMax != NULL then it holds the block-max bounds described
+//      above, for the current contents of the set.
+//
+struct _CWSet {
+
+	uint32_t Capacity;     // dimension of the Data and Weight arrays
+	uint32_t Usage;        // number of elements in the set
+	int32_t* Data;         // values, ascending
+	double*  Weight;       // weight of each value in Data
+	double*  BlockMax;     // per-block maximum weight, or NULL if unsealed
+	double   MaxWeight;    // maximum weight in the set, valid if sealed
+};
+
+typedef struct _CWSet CWSet;
+
+// How weights are combined for values found in more than one set.
+enum _CWSetAggregate {
+
+	CWSET_SUM,             // combined weight is the sum of the weights
+	CWSET_MAX              // combined weight is the largest of the weights
+};
+
+typedef enum _CWSetAggregate CWSetAggregate;
+
+/**
+ * Allocates the Data and Weight arrays for a CWSet of capacity Sz, with
+ * every cell set to FILLER and 0 respectively.
+ *
+ * Returns:
+ *    true if successful (or Sz == 0, in which case both are NULL),
+ *    false otherwise; on failure nothing is allocated
+ */
+static bool CWSet_Alloc(uint32_t Sz, int32_t** pData, double** pWeight) {
+	*pData = NULL;
+	*pWeight = NULL;
+	if (Sz == 0) return true;
+	*pData = (int32_t*)malloc(Sz * sizeof(int32_t));
+	*pWeight = (double*)malloc(Sz * sizeof(double));
+	if (*pData == NULL || *pWeight == NULL) {
+		free(*pData);
+		free(*pWeight);
+		*pData = NULL;
+		*pWeight = NULL;
+		return false;
+	}
+	uint32_t i = 0;
+	while (i < Sz) {
+		(*pData)[i] = INT32_MIN;
+		(*pWeight)[i] = 0.0;
+		i++;
+	}
+	return true;
+}
+
+/**
+ * Drops the block-max bounds of pSet, which is about to change.
+ */
+static void CWSet_Unseal(CWSet* const pSet) {
+	free(pSet->BlockMax);
+	pSet->BlockMax = NULL;
+	pSet->MaxWeight = 0.0;
+}
+
+/**
+ * Initializes a raw pSet object, with capacity Sz.
+ *
+ * Pre:
+ *    pSet points to a CWSet object, but *pSet may be proper or raw
+ *    Sz   has been initialized
+ * Post:
+ *    If successful:
+ *       pSet->Capacity == Sz
+ *       pSet->Usage == 0
+ *       *pSet is proper and unsealed
+ *    else:
+ *       pSet->Capacity == 0, pSet->Usage == 0
+ *       pSet->Data == NULL, pSet->Weight == NULL
+ * Returns:
+ *    true if successful, false otherwise
+ *
+ * Complexity:  O( Sz )
+ */
+bool CWSet_Init(CWSet* const pSet, uint32_t Sz) {
+	if (pSet == NULL) return false;
+	pSet->Usage = 0;
+	pSet->BlockMax = NULL;
+	pSet->MaxWeight = 0.0;
+	if (!CWSet_Alloc(Sz, &pSet->Data, &pSet->Weight)) {
+		pSet->Capacity = 0;
+		return false;
+	}
+	pSet->Capacity = Sz;
+	return true;
+}
+
+/**
+ * Releases the storage held by a pSet object.
+ *
+ * Pre:
+ *    *pSet is proper
+ * Post:
+ *    *pSet is proper and empty, with capacity 0
+ *
+ * Complexity:  O( 1 )
+ */
+void CWSet_Free(CWSet* const pSet) {
+	CWSet_Unseal(pSet);
+	free(pSet->Data);
+	free(pSet->Weight);
+	pSet->Data = NULL;
+	pSet->Weight = NULL;
+	pSet->Usage = 0;
+	pSet->Capacity = 0;
+}
+
+/**
+ * Adds Value, with weight Weight, to a pSet object.  If Value is already a
+ * member its weight is replaced.
+ *
+ * Pre:
+ *    *pSet is proper
+ *    Weight >= 0
+ * Post:
+ *    If successful:
+ *       Value is a member of *pSet, with weight Weight
+ *       pSet->Capacity has been doubled, if necessary
+ *       *pSet is proper and unsealed
+ *    else:
+ *       *pSet is unchanged
+ * Returns:
+ *    true if successful, false otherwise
+ *
+ * Complexity:  O( pSet->Usage )
+ */
+bool CWSet_Insert(CWSet* const pSet, int32_t Value, double Weight) {
+	if (!(Weight >= 0.0)) return false;
+	uint32_t i = CSet_LowerBound(pSet->Data, 0, pSet->Usage, Value);
+	if (i < pSet->Usage && pSet->Data[i] == Value) {
+		CWSet_Unseal(pSet);
+		pSet->Weight[i] = Weight;
+		return true;
+	}
+	if (pSet->Usage == pSet->Capacity) {
+		uint32_t capacity = (pSet->Capacity == 0) ? 1 : pSet->Capacity * 2;
+		int32_t* data;
+		double* weight;
+		if (!CWSet_Alloc(capacity, &data, &weight)) return false;
+		if (pSet->Usage > 0) {
+			memcpy(data, pSet->Data, pSet->Usage * sizeof(int32_t));
+			memcpy(weight, pSet->Weight, pSet->Usage * sizeof(double));
+		}
+		free(pSet->Data);
+		free(pSet->Weight);
+		pSet->Data = data;
+		pSet->Weight = weight;
+		pSet->Capacity = capacity;
+	}
+	CWSet_Unseal(pSet);
+	memmove(pSet->Data + i + 1, pSet->Data + i, (pSet->Usage - i) * sizeof(int32_t));
+	memmove(pSet->Weight + i + 1, pSet->Weight + i, (pSet->Usage - i) * sizeof(double));
+	pSet->Data[i] = Value;
+	pSet->Weight[i] = Weight;
+	pSet->Usage++;
+	return true;
+}
+
+/**
+ * Looks up the weight of Value in a pSet object.
+ *
+ * Pre:
+ *    *pSet is proper
+ *    pWeight points to a double
+ * Post:
+ *    *pSet is unchanged
+ *    if Value is a member, *pWeight is its weight
+ * Returns:
+ *    true if Value belongs to *pSet, false otherwise
+ *
+ * Complexity:  O( log(pSet->Usage) )
+ */
+bool CWSet_Weight(const CWSet* const pSet, int32_t Value, double* pWeight) {
+	uint32_t i = CSet_LowerBound(pSet->Data, 0, pSet->Usage, Value);
+	if (i < pSet->Usage && pSet->Data[i] == Value) {
+		*pWeight = pSet->Weight[i];
+		return true;
+	}
+	return false;
+}
+
+/**
+ * Computes the block-max bounds of *pSet into BlockMax, which has room
+ * for one entry per CWSET_BLOCK elements, and returns the overall maximum.
+ */
+static double CWSet_Bounds(const CWSet* const pSet, double* BlockMax) {
+	double max = 0.0;
+	uint32_t i = 0;
+	while (i < pSet->Usage) {
+		double w = pSet->Weight[i];
+		if (i % CWSET_BLOCK == 0) {
+			BlockMax[i / CWSET_BLOCK] = w;
+		}
+		else if (w > BlockMax[i / CWSET_BLOCK]) {
+			BlockMax[i / CWSET_BLOCK] = w;
+		}
+		if (w > max) max = w;
+		i++;
+	}
+	return max;
+}
+
+/**
+ * Builds the block-max bounds used by CWSet_TopK() for a pSet object.
+ * Sealing is optional; CWSet_TopK() computes bounds on the fly for sets
+ * that are not sealed, at O( Usage ) cost per query.
+ *
+ * Pre:
+ *    *pSet is proper
+ * Post:
+ *    If successful, *pSet is sealed; its contents are unchanged
+ * Returns:
+ *    true if successful, false otherwise
+ *
+ * Complexity:  O( pSet->Usage )
+ */
+bool CWSet_Seal(CWSet* const pSet) {
+	CWSet_Unseal(pSet);
+	uint32_t blocks = (pSet->Usage + CWSET_BLOCK - 1) / CWSET_BLOCK;
+	pSet->BlockMax = (double*)malloc((blocks > 0 ? blocks : 1) * sizeof(double));
+	if (pSet->BlockMax == NULL) return false;
+	pSet->MaxWeight = CWSet_Bounds(pSet, pSet->BlockMax);
+	return true;
+}
+
+/**
+ * Sets *pIntersection to be the intersection of *pA and *pB, aggregating
+ * the weights of each common value during the merge.
+ *
+ * Pre:
+ *    *pIntersection, *pA and *pB are proper
+ * Post:
+ *    *pA and *pB are unchanged, unless *pIntersection aliases *pA or *pB
+ *    For every integer x, x is contained in *pIntersection iff x is
+ *       contained in both *pA and *pB; its weight is the sum of its two
+ *       weights if Mode == CWSET_SUM, or the larger if Mode == CWSET_MAX
+ *    pIntersection->Capacity == min(pA->Usage, pB->Usage)
+ *    *pIntersection is proper and unsealed
+ * Returns:
+ *    true if the intersection is successfully created; false otherwise,
+ *    in which case *pIntersection is unchanged
+ *
+ * Complexity:  O( pA->Usage + pB->Usage )
+ */
+bool CWSet_Intersection(CWSet* const pIntersection, const CWSet* const pA,
+                        const CWSet* const pB, CWSetAggregate Mode) {
+	uint32_t capacity = (pA->Usage < pB->Usage) ? pA->Usage : pB->Usage;
+	int32_t* data;
+	double* weight;
+	if (!CWSet_Alloc(capacity, &data, &weight)) return false;
+	uint32_t i = 0;
+	uint32_t a = 0;
+	uint32_t b = 0;
+	while (a < pA->Usage && b < pB->Usage) {
+		if (pA->Data[a] < pB->Data[b]) {
+			a++;
+		}
+		else if (pA->Data[a] > pB->Data[b]) {
+			b++;
+		}
+		else {
+			double wa = pA->Weight[a];
+			double wb = pB->Weight[b];
+			data[i] = pA->Data[a];
+			if (Mode == CWSET_SUM) {
+				weight[i] = wa + wb;
+			}
+			else {
+				weight[i] = (wa > wb) ? wa : wb;
+			}
+			a++;
+			b++;
+			i++;
+		}
+	}
+	CWSet_Unseal(pIntersection);
+	free(pIntersection->Data);
+	free(pIntersection->Weight);
+	pIntersection->Data = data;
+	pIntersection->Weight = weight;
+	pIntersection->Usage = i;
+	pIntersection->Capacity = capacity;
+	return true;
+}
+
+// Position of one input set during CWSet_TopK().
+struct _CWSetCursor {
+
+	const CWSet*  Set;
+	uint32_t      Pos;        // index of the current element in Set->Data
+	const double* BlockMax;   // block-max bounds of Set
+	double        Bound;      // largest weight in Set
+};
+
+// Candidate held in the CWSet_TopK() result heap.
+struct _CWSetHit {
+
+	double  Score;
+	int32_t Value;
+};
+
+// Sentinel id of a cursor that has run off the end of its set.
+#define CWSET_END INT64_MAX
+
+static int64_t CWSet_CursorId(const struct _CWSetCursor* pCur) {
+	if (pCur->Pos < pCur->Set->Usage) {
+		return pCur->Set->Data[pCur->Pos];
+	}
+	return CWSET_END;
+}
+
+/**
+ * Restores the min-heap order of Heap[0 : Size-1] after Heap[0] changed.
+ */
+static void CWSet_SiftDown(struct _CWSetHit* Heap, uint32_t Size) {
+	uint32_t i = 0;
+	while (2 * i + 1 < Size) {
+		uint32_t c = 2 * i + 1;
+		if (c + 1 < Size && Heap[c + 1].Score < Heap[c].Score) {
+			c++;
+		}
+		if (Heap[i].Score <= Heap[c].Score) break;
+		struct _CWSetHit t = Heap[i];
+		Heap[i] = Heap[c];
+		Heap[c] = t;
+		i = c;
+	}
+}
+
+/**
+ * Finds the K values with the highest total weight across a collection of
+ * weighted sets, where the total weight of x is the sum of its weights in
+ * the sets that contain it.
+ *
+ * The search is a block-max WAND: cursors are kept ordered by their current
+ * value, and a value is only fully scored if the per-set maximum weights,
+ * and then the block-max bounds of the blocks it falls in, show that it
+ * could beat the current K-th best score.  Whole blocks that cannot are
+ * skipped without being examined.
+ *
+ * Pre:
+ *    Sets[0 : N-1] point to proper CWSet objects
+ *    Values and Scores have room for K entries
+ * Post:
+ *    the sets are unchanged
+ *    Values[0 : r-1] are the r top-scoring values and Scores[0 : r-1] their
+ *       total weights, in descending order of score, where r is the
+ *       return value
+ * Returns:
+ *    min(K, number of distinct values in the union of the sets); 0 if
+ *    memory for the search could not be allocated
+ *
+ * Complexity:  O( T * N ), where T is the number of candidate values that
+ *              survive the bound checks; O( sum of Usage ) worst case,
+ *              plus O( Usage ) for each set that is not sealed
+ */
+uint32_t CWSet_TopK(const CWSet* const* Sets, uint32_t N, uint32_t K,
+                    int32_t* Values, double* Scores) {
+	if (N == 0 || K == 0) return 0;
+	struct _CWSetCursor* cur = (struct _CWSetCursor*)malloc(N * sizeof(struct _CWSetCursor));
+	double** owned = (double**)calloc(N, sizeof(double*));
+	struct _CWSetHit* heap = (struct _CWSetHit*)malloc(K * sizeof(struct _CWSetHit));
+	uint32_t found = 0;
+	uint32_t n = 0;
+	if (cur == NULL || owned == NULL || heap == NULL) goto done;
+
+	//Set up one cursor per non-empty set, building bounds for unsealed sets
+	while (n < N) {
+		const CWSet* pSet = Sets[n];
+		cur[n].Set = pSet;
+		cur[n].Pos = 0;
+		cur[n].BlockMax = pSet->BlockMax;
+		cur[n].Bound = pSet->MaxWeight;
+		if (pSet->BlockMax == NULL && pSet->Usage > 0) {
+			owned[n] = (double*)malloc(((pSet->Usage + CWSET_BLOCK - 1) / CWSET_BLOCK) * sizeof(double));
+			if (owned[n] == NULL) goto done;
+			cur[n].Bound = CWSet_Bounds(pSet, owned[n]);
+			cur[n].BlockMax = owned[n];
+		}
+		n++;
+	}
+
+	while (true) {
+		//Keep the cursors ordered by current value; between rounds only a
+		//few cursors move, so insertion sort is close to linear
+		uint32_t i = 1;
+		while (i < N) {
+			struct _CWSetCursor t = cur[i];
+			int64_t id = CWSet_CursorId(&t);
+			uint32_t j = i;
+			while (j > 0 && CWSet_CursorId(&cur[j - 1]) > id) {
+				cur[j] = cur[j - 1];
+				j--;
+			}
+			cur[j] = t;
+			i++;
+		}
+		double threshold = (found == K) ? heap[0].Score : -1.0;
+
+		//Pivot: first cursor at which the accumulated maximum weights could
+		//beat the threshold; every value before it is provably too small
+		double acc = 0.0;
+		uint32_t p = 0;
+		while (p < N && CWSet_CursorId(&cur[p]) != CWSET_END) {
+			acc += cur[p].Bound;
+			if (acc > threshold) break;
+			p++;
+		}
+		if (p == N || CWSet_CursorId(&cur[p]) == CWSET_END) break;
+		int64_t pivot = CWSet_CursorId(&cur[p]);
+		while (p + 1 < N && CWSet_CursorId(&cur[p + 1]) == pivot) {
+			p++;
+		}
+
+		//Refine with the bounds of the blocks the pivot falls in
+		double blockSum = 0.0;
+		int64_t next = (p + 1 < N) ? CWSet_CursorId(&cur[p + 1]) : CWSET_END;
+		i = 0;
+		while (i <= p) {
+			const CWSet* pSet = cur[i].Set;
+			uint32_t at = CSet_Gallop(pSet->Data, cur[i].Pos, pSet->Usage, (int32_t)pivot);
+			if (at < pSet->Usage) {
+				uint32_t block = at / CWSET_BLOCK;
+				uint32_t last = (block + 1) * CWSET_BLOCK;
+				if (last > pSet->Usage) last = pSet->Usage;
+				blockSum += cur[i].BlockMax[block];
+				if ((int64_t)pSet->Data[last - 1] + 1 < next) {
+					next = (int64_t)pSet->Data[last - 1] + 1;
+				}
+			}
+			i++;
+		}
+
+		if (blockSum <= threshold) {
+			//No value before next can qualify; jump every pivot cursor there.
+			//A block ending at INT32_MAX gives next == 2^31, which no member
+			//can reach, so those cursors are simply exhausted
+			i = 0;
+			while (i <= p) {
+				const CWSet* pSet = cur[i].Set;
+				cur[i].Pos = (next > INT32_MAX) ? pSet->Usage
+				             : CSet_Gallop(pSet->Data, cur[i].Pos, pSet->Usage, (int32_t)next);
+				i++;
+			}
+		}
+		else if (CWSet_CursorId(&cur[0]) == pivot) {
+			//Every cursor up to p sits on the pivot: score it fully
+			double score = 0.0;
+			i = 0;
+			while (i <= p) {
+				score += cur[i].Set->Weight[cur[i].Pos];
+				cur[i].Pos++;
+				i++;
+			}
+			if (found < K) {
+				//Still filling: insert and sift up
+				uint32_t c = found++;
+				heap[c].Score = score;
+				heap[c].Value = (int32_t)pivot;
+				while (c > 0 && heap[(c - 1) / 2].Score > heap[c].Score) {
+					struct _CWSetHit t = heap[c];
+					heap[c] = heap[(c - 1) / 2];
+					heap[(c - 1) / 2] = t;
+					c = (c - 1) / 2;
+				}
+			}
+			else if (score > threshold) {
+				heap[0].Score = score;
+				heap[0].Value = (int32_t)pivot;
+				CWSet_SiftDown(heap, K);
+			}
+		}
+		else {
+			//Bring the lagging cursors up to the pivot
+			i = 0;
+			while (i <= p && CWSet_CursorId(&cur[i]) < pivot) {
+				const CWSet* pSet = cur[i].Set;
+				cur[i].Pos = CSet_Gallop(pSet->Data, cur[i].Pos, pSet->Usage, (int32_t)pivot);
+				i++;
+			}
+		}
+	}
+
+	//Drain the heap, smallest first, into descending order
+	n = found;
+	while (n > 0) {
+		n--;
+		Values[n] = heap[0].Value;
+		Scores[n] = heap[0].Score;
+		heap[0] = heap[n];
+		CWSet_SiftDown(heap, n);
+	}
+	n = N;
+
+done:
+	if (owned != NULL) {
+		uint32_t i = 0;
+		while (i < N) {
+			free(owned[i]);
+			i++;
+		}
+	}
+	free(owned);
+	free(cur);
+	free(heap);
+	return (n == N) ? found : 0;
+}
+
+/**
+ * Replaces the storage of pSet with Data, an array of dimension Capacity
+ * whose first Usage cells hold the set's values in ascending order.  The
+ * remaining cells are set to FILLER and the old storage is released.
+ * This replaces the set as a whole, so any change feed on it records a
+ * reset.
+ */
+static void CSet_Install(CSet* const pSet, int32_t* Data, uint32_t Usage, uint32_t Capacity) {
+	if (Capacity > Usage) {
+		CSet_StreamFill(Data + Usage, FILLER, Capacity - Usage);
+	}
+	free(pSet->Data);
+	pSet->Data = (Capacity > 0) ? Data : NULL;
+	if (Capacity == 0) free(Data);
+	pSet->Usage = Usage;
+	pSet->Capacity = Capacity;
+	CSet_Notify(pSet, CSETFEED_RESET, 0);
+}
+
+// Upper limit on the number of threads used by the parallel operations.
+#define CSET_MAX_THREADS 64
+
+/**
+ * Chooses the number of worker threads for a parallel operation.
+ *
+ * Returns:
+ *    Wanted, or the number of online processors if Wanted == 0, clamped
+ *    to [1, CSET_MAX_THREADS]
+ */
+static uint32_t CSet_ThreadCount(uint32_t Wanted) {
+	if (Wanted == 0) {
+		long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+		Wanted = (cpus > 0) ? (uint32_t)cpus : 1;
+	}
+	if (Wanted > CSET_MAX_THREADS) Wanted = CSET_MAX_THREADS;
+	return Wanted;
+}
+
+/**
+ * Runs Fn on each of nTasks task records, Tasks[0 : nTasks-1], where each
+ * record is Size bytes long.  Task 0 runs on the calling thread and the
+ * others on threads of their own; a task whose thread cannot be created
+ * runs on the calling thread instead, so every task always runs.
+ *
+ * Post:
+ *    Fn has returned for every task
+ */
+static void CSet_RunParallel(void* (*Fn)(void*), void* Tasks, size_t Size, uint32_t nTasks) {
+	pthread_t threads[CSET_MAX_THREADS];
+	bool started[CSET_MAX_THREADS];
+	char* base = (char*)Tasks;
+	uint32_t i = 1;
+	while (i < nTasks) {
+		started[i] = (pthread_create(&threads[i], NULL, Fn, base + i * Size) == 0);
+		i++;
+	}
+	if (nTasks > 0) {
+		Fn(base);
+	}
+	i = 1;
+	while (i < nTasks) {
+		if (started[i]) {
+			pthread_join(threads[i], NULL);
+		}
+		else {
+			Fn(base + i * Size);
+		}
+		i++;
+	}
+}
+
+// Outcome of an operation that can be cancelled.
+enum _CSetStatus {
+
+	CSET_OK,          // completed
+	CSET_CANCELLED,   // stopped by CSetCancel_Cancel()
+	CSET_EXPIRED,     // stopped by the token's deadline
+	CSET_FAILED       // memory could not be allocated
+};
+
+typedef enum _CSetStatus CSetStatus;
+
+// CSetCancel lets a caller stop long-running operations: it can be
+// cancelled from any thread, and may carry a deadline.  Operations that
+// take a token poll it once every CSET_CANCEL_BLOCK elements, and when it
+// has fired they stop, leave their destination proper (and, unless stated
+// otherwise, unchanged) and report why.
+struct _CSetCancel {
+
+	uint32_t Cancelled;   // set by CSetCancel_Cancel(); read atomically
+	uint64_t Deadline;    // CSet_Micros() time to stop at, or 0 for none
+};
+
+typedef struct _CSetCancel CSetCancel;
+
+// Long loops poll for cancellation once per this many elements.
+#define CSET_CANCEL_BLOCK 4096
+
+/**
+ * Returns microseconds on a monotonic clock.
+ */
+static uint64_t CSet_Micros(void) {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t)now.tv_sec * 1000000u + (uint64_t)now.tv_nsec / 1000u;
+}
+
+/**
+ * Initializes a raw pCancel token, with a deadline TimeoutMicros
+ * microseconds from now, or none if TimeoutMicros is 0.
+ *
+ * Complexity:  O( 1 )
+ */
+void CSetCancel_Init(CSetCancel* const pCancel, uint64_t TimeoutMicros) {
+	pCancel->Cancelled = 0;
+	pCancel->Deadline = (TimeoutMicros > 0) ? CSet_Micros() + TimeoutMicros : 0;
+}
+
+/**
+ * Fires a token; operations polling it stop at their next check.  May be
+ * called from any thread.
+ *
+ * Complexity:  O( 1 )
+ */
+void CSetCancel_Cancel(CSetCancel* const pCancel) {
+	__atomic_store_n(&pCancel->Cancelled, 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * Reports whether a token has fired.
+ *
+ * Returns:
+ *    CSET_CANCELLED or CSET_EXPIRED if it has, CSET_OK if not or if
+ *    pCancel is NULL
+ *
+ * Complexity:  O( 1 )
+ */
+CSetStatus CSetCancel_Status(const CSetCancel* const pCancel) {
+	if (pCancel == NULL) return CSET_OK;
+	if (__atomic_load_n(&pCancel->Cancelled, __ATOMIC_ACQUIRE)) return CSET_CANCELLED;
+	if (pCancel->Deadline > 0 && CSet_Micros() >= pCancel->Deadline) return CSET_EXPIRED;
+	return CSET_OK;
+}
+
+/**
+ * Returns true if a token (possibly NULL) has fired.
+ */
+static bool CSetCancel_Stopped(const CSetCancel* const pCancel) {
+	return CSetCancel_Status(pCancel) != CSET_OK;
+}
+
+// One slice of a T-occurrence query: the values in [Lo, Hi) of every input
+// set.  Each parallel worker owns one slice; a serial query is one slice
+// covering every int32_t value.
+struct _CSetTOccTask {
+
+	const CSet* const* Sets;
+	uint32_t N;
+	uint32_t T;
+	int64_t  Lo;           // smallest value in the slice
+	int64_t  Hi;           // one past the largest value in the slice
+	int32_t* Out;          // values that occur in >= T sets, ascending
+	uint32_t Count;        // number of values in Out
+	bool     Ok;           // false if the slice ran out of memory or stopped
+	const CSetCancel* Cancel;  // polled every CSET_CANCEL_BLOCK steps
+};
+
+// Use ScanCount when the counter array is at most this many times larger
+// than the number of input elements.
+#define CSET_SCANCOUNT_RATIO 4
+
+/**
+ * Restores the min-heap order, keyed by the current value of each cursor,
+ * of Heap[0 : Size-1] after Heap[0] changed.
+ */
+static void CSet_CursorSiftDown(uint32_t* Heap, uint32_t Size, const CSet* const* Sets,
+                                const uint32_t* Pos) {
+	uint32_t i = 0;
+	while (2 * i + 1 < Size) {
+		uint32_t c = 2 * i + 1;
+		if (c + 1 < Size &&
+		    Sets[Heap[c + 1]]->Data[Pos[Heap[c + 1]]] < Sets[Heap[c]]->Data[Pos[Heap[c]]]) {
+			c++;
+		}
+		if (Sets[Heap[i]]->Data[Pos[Heap[i]]] <= Sets[Heap[c]]->Data[Pos[Heap[c]]]) break;
+		uint32_t t = Heap[i];
+		Heap[i] = Heap[c];
+		Heap[c] = t;
+		i = c;
+	}
+}
+
+/**
+ * Adds cursor s to the min-heap Heap[0 : Size-1].
+ */
+static void CSet_CursorPush(uint32_t* Heap, uint32_t Size, uint32_t s, const CSet* const* Sets,
+                            const uint32_t* Pos) {
+	uint32_t c = Size;
+	Heap[c] = s;
+	while (c > 0) {
+		uint32_t parent = (c - 1) / 2;
+		if (Sets[Heap[parent]]->Data[Pos[Heap[parent]]] <= Sets[s]->Data[Pos[s]]) break;
+		Heap[c] = Heap[parent];
+		c = parent;
+	}
+	Heap[c] = s;
+}
+
+/**
+ * Answers one T-occurrence slice.  When the slice's value range is small
+ * relative to its size, every value is counted in an array (ScanCount);
+ * otherwise the sets are merged through a heap of cursors, and whenever
+ * the smallest value is seen fewer than T times the T-1 smallest cursors
+ * jump straight past it (MergeSkip).
+ */
+static void* CSet_TOccRun(void* Arg) {
+	struct _CSetTOccTask* pTask = (struct _CSetTOccTask*)Arg;
+	const CSet* const* sets = pTask->Sets;
+	uint32_t N = pTask->N;
+	uint32_t T = pTask->T;
+	uint32_t* pos = (uint32_t*)malloc(N * sizeof(uint32_t));
+	uint32_t* end = (uint32_t*)malloc(N * sizeof(uint32_t));
+	uint32_t* heap = (uint32_t*)malloc(N * sizeof(uint32_t));
+	pTask->Out = NULL;
+	pTask->Count = 0;
+	pTask->Ok = false;
+	if (pos == NULL || end == NULL || heap == NULL) goto done;
+
+	//Bound each set to the slice, and find the slice's actual value range
+	uint64_t total = 0;
+	int64_t min = INT64_MAX;
+	int64_t max = INT64_MIN;
+	uint32_t s = 0;
+	while (s < N) {
+		const CSet* pSet = sets[s];
+		pos[s] = (pTask->Lo <= INT32_MIN) ? 0
+		         : CSet_LowerBound(pSet->Data, 0, pSet->Usage, (int32_t)pTask->Lo);
+		end[s] = (pTask->Hi > INT32_MAX) ? pSet->Usage
+		         : CSet_LowerBound(pSet->Data, pos[s], pSet->Usage, (int32_t)pTask->Hi);
+		if (pos[s] < end[s]) {
+			total += end[s] - pos[s];
+			if (pSet->Data[pos[s]] < min) min = pSet->Data[pos[s]];
+			if (pSet->Data[end[s] - 1] > max) max = pSet->Data[end[s] - 1];
+		}
+		s++;
+	}
+	if (total / T + 1 > UINT32_MAX) goto done;
+	//Each result value accounts for at least T input elements
+	pTask->Out = (int32_t*)malloc((size_t)(total / T + 1) * sizeof(int32_t));
+	if (pTask->Out == NULL) goto done;
+	if (total == 0) {
+		pTask->Ok = true;
+		goto done;
+	}
+
+	uint64_t range = (uint64_t)(max - min) + 1;
+	if (range <= CSET_SCANCOUNT_RATIO * total && range <= ((uint64_t)1 << 28)) {
+		uint32_t* counts = (uint32_t*)calloc((size_t)range, sizeof(uint32_t));
+		if (counts != NULL) {
+			s = 0;
+			while (s < N) {
+				const int32_t* data = sets[s]->Data;
+				uint32_t i = pos[s];
+				while (i < end[s]) {
+					if ((i & (CSET_CANCEL_BLOCK - 1)) == 0 && CSetCancel_Stopped(pTask->Cancel)) {
+						free(counts);
+						goto done;
+					}
+					counts[(int64_t)data[i] - min]++;
+					i++;
+				}
+				s++;
+			}
+			uint64_t v = 0;
+			while (v < range) {
+				if (counts[v] >= T) {
+					pTask->Out[pTask->Count++] = (int32_t)(min + (int64_t)v);
+				}
+				v++;
+			}
+			free(counts);
+			pTask->Ok = true;
+			goto done;
+		}
+		//Counter array too large to allocate; fall back to merging
+	}
+
+	uint32_t size = 0;
+	s = 0;
+	while (s < N) {
+		if (pos[s] < end[s]) {
+			CSet_CursorPush(heap, size, s, sets, pos);
+			size++;
+		}
+		s++;
+	}
+	uint32_t rounds = 0;
+	while (size >= T) {
+		rounds++;
+		if ((rounds & (CSET_CANCEL_BLOCK - 1)) == 0 && CSetCancel_Stopped(pTask->Cancel)) goto done;
+		//Pop every cursor sitting on the smallest value
+		int32_t top = sets[heap[0]]->Data[pos[heap[0]]];
+		uint32_t popped = 0;
+		while (size > 0 && sets[heap[0]]->Data[pos[heap[0]]] == top) {
+			//Popped cursors are parked past the end of the heap
+			uint32_t t = heap[0];
+			size--;
+			heap[0] = heap[size];
+			heap[size] = t;
+			CSet_CursorSiftDown(heap, size, sets, pos);
+			popped++;
+		}
+		if (popped >= T) {
+			pTask->Out[pTask->Count++] = top;
+			uint32_t k = 0;
+			while (k < popped) {
+				uint32_t c = heap[size + popped - 1 - k];
+				pos[c]++;
+				k++;
+			}
+		}
+		else {
+			//top is short of T; so is everything below the T-th cursor's
+			//value, so pull T-1 cursors in total and skip them ahead
+			while (popped < T - 1 && size > 0) {
+				uint32_t t = heap[0];
+				size--;
+				heap[0] = heap[size];
+				heap[size] = t;
+				CSet_CursorSiftDown(heap, size, sets, pos);
+				popped++;
+			}
+			if (size == 0) break;
+			int32_t target = sets[heap[0]]->Data[pos[heap[0]]];
+			uint32_t k = 0;
+			while (k < popped) {
+				uint32_t c = heap[size + k];
+				pos[c] = CSet_Gallop(sets[c]->Data, pos[c], end[c], target);
+				k++;
+			}
+		}
+		//Return the surviving popped cursors to the heap
+		uint32_t k = 0;
+		uint32_t first = size;
+		while (k < popped) {
+			uint32_t c = heap[first + k];
+			if (pos[c] < end[c]) {
+				CSet_CursorPush(heap, size, c, sets, pos);
+				size++;
+			}
+			k++;
+		}
+	}
+	pTask->Ok = true;
+
+done:
+	free(pos);
+	free(end);
+	free(heap);
+	return NULL;
+}
+
+// Total input size below which a T-occurrence query stays on one thread.
+#define CSET_TOCC_PARALLEL_MIN (1u << 16)
+
+/**
+ * Sets *pResult to the values that occur in at least T of the sets
+ * Sets[0 : N-1].
+ *
+ * Small value ranges are answered by counting (ScanCount); otherwise the
+ * sets are merged with skipping (MergeSkip).  Large queries are split
+ * into disjoint value ranges, one per thread.  Every thread polls
+ * *pCancel, if given, once per CSET_CANCEL_BLOCK elements.
+ *
+ * Pre:
+ *    *pResult is proper, and is not one of the input sets
+ *    Sets[0 : N-1] point to proper CSet objects
+ *    T > 0
+ *    nThreads is the number of threads to use, or 0 for one per processor
+ *    pCancel is NULL, or points to an initialized token
+ * Post:
+ *    the input sets are unchanged
+ *    If successful:
+ *       For every integer x, x is contained in *pResult iff x is contained
+ *          in at least T of the input sets
+ *       pResult->Capacity >= pResult->Usage
+ *       *pResult is proper
+ *    else:
+ *       *pResult is unchanged
+ * Returns:
+ *    CSET_OK if the result is successfully created, CSET_FAILED if memory
+ *    could not be allocated, otherwise the status of the token that
+ *    stopped it
+ *
+ * Complexity:  O( S * log N ) for S = total elements, and usually much
+ *              less since skipped runs are crossed by galloping
+ */
+CSetStatus CSet_TOccurrenceCancellable(CSet* const pResult, const CSet* const* Sets, uint32_t N,
+                                       uint32_t T, uint32_t nThreads, const CSetCancel* const pCancel) {
+	if (T == 0) return CSET_FAILED;
+	struct _CSetTOccTask tasks[CSET_MAX_THREADS];
+	uint64_t total = 0;
+	uint32_t largest = 0;
+	uint32_t s = 0;
+	while (s < N) {
+		total += Sets[s]->Usage;
+		if (Sets[s]->Usage > Sets[largest]->Usage) largest = s;
+		s++;
+	}
+	uint32_t nTasks = CSet_ThreadCount(nThreads);
+	if (T > N || total < CSET_TOCC_PARALLEL_MIN) nTasks = 1;
+	if (nTasks > 1 && Sets[largest]->Usage < nTasks) nTasks = 1;
+
+	//Split the value space at evenly spaced values of the largest set
+	uint32_t t = 0;
+	while (t < nTasks) {
+		tasks[t].Sets = Sets;
+		tasks[t].N = N;
+		tasks[t].T = T;
+		tasks[t].Cancel = pCancel;
+		tasks[t].Lo = (t == 0) ? INT64_MIN
+		              : Sets[largest]->Data[(uint64_t)Sets[largest]->Usage * t / nTasks];
+		tasks[t].Hi = INT64_MAX;
+		if (t > 0) tasks[t - 1].Hi = tasks[t].Lo;
+		t++;
+	}
+	if (T > N) {
+		//Nothing can occur T times
+		tasks[0].Out = NULL;
+		tasks[0].Count = 0;
+		tasks[0].Ok = true;
+	}
+	else {
+		CSet_RunParallel(CSet_TOccRun, tasks, sizeof(tasks[0]), nTasks);
+	}
+
+	bool ok = true;
+	uint64_t count = 0;
+	t = 0;
+	while (t < nTasks) {
+		ok = ok && tasks[t].Ok;
+		count += tasks[t].Count;
+		t++;
+	}
+	int32_t* data = NULL;
+	if (ok && nTasks == 1 && tasks[0].Out != NULL) {
+		//Single slice: its buffer already has room for the result
+		data = tasks[0].Out;
+		tasks[0].Out = NULL;
+		CSet_Install(pResult, data, tasks[0].Count, (uint32_t)(total / T + 1));
+	}
+	else if (ok) {
+		data = (int32_t*)malloc((size_t)(count + 1) * sizeof(int32_t));
+		ok = (data != NULL);
+		if (ok) {
+			uint32_t i = 0;
+			t = 0;
+			while (t < nTasks) {
+				if (tasks[t].Count > 0) {
+					memcpy(data + i, tasks[t].Out, tasks[t].Count * sizeof(int32_t));
+				}
+				i += tasks[t].Count;
+				t++;
+			}
+			CSet_Install(pResult, data, i, i + 1);
+		}
+	}
+	t = 0;
+	while (t < nTasks) {
+		free(tasks[t].Out);
+		t++;
+	}
+	if (ok) return CSET_OK;
+	return CSetCancel_Stopped(pCancel) ? CSetCancel_Status(pCancel) : CSET_FAILED;
+}
+
+/**
+ * Sets *pResult to the values that occur in at least T of the sets
+ * Sets[0 : N-1]; CSet_TOccurrenceCancellable() without a token.
+ *
+ * Returns:
+ *    true if the result is successfully created; false otherwise
+ */
+bool CSet_TOccurrence(CSet* const pResult, const CSet* const* Sets, uint32_t N, uint32_t T,
+                      uint32_t nThreads) {
+	return T > 0 && CSet_TOccurrenceCancellable(pResult, Sets, N, T, nThreads, NULL) == CSET_OK;
+}
+
+/**
+ * Sorts Keys[0 : n-1] into ascending order, with an LSD radix sort on
+ * 16-bit digits, polling *pCancel, if given, once per CSET_CANCEL_BLOCK
+ * keys.
+ *
+ * Returns:
+ *    true if successful, false if scratch memory could not be allocated,
+ *    in which case Keys is unchanged, or if the token fired, in which case
+ *    Keys holds the same keys in some order
+ *
+ * Complexity:  O( n )
+ */
+static bool CSet_SortKeysCancellable(uint64_t* Keys, size_t n, const CSetCancel* const pCancel) {
+	if (n < 2) return true;
+	uint64_t* tmp = (uint64_t*)malloc(n * sizeof(uint64_t));
+	size_t* count = (size_t*)malloc(65536 * sizeof(size_t));
+	if (tmp == NULL || count == NULL) {
+		free(tmp);
+		free(count);
+		return false;
+	}
+	uint64_t* src = Keys;
+	uint64_t* dst = tmp;
+	uint32_t shift = 0;
+	while (shift < 64) {
+		memset(count, 0, 65536 * sizeof(size_t));
+		size_t i = 0;
+		while (i < n) {
+			if ((i & (CSET_CANCEL_BLOCK - 1)) == 0 && CSetCancel_Stopped(pCancel)) {
+				if (src != Keys) {
+					memcpy(Keys, src, n * sizeof(uint64_t));
+				}
+				free(tmp);
+				free(count);
+				return false;
+			}
+			count[(src[i] >> shift) & 0xFFFF]++;
+			i++;
+		}
+		//Skip digits on which every key agrees
+		if (count[(src[0] >> shift) & 0xFFFF] != n) {
+			size_t sum = 0;
+			i = 0;
+			while (i < 65536) {
+				size_t c = count[i];
+				count[i] = sum;
+				sum += c;
+				i++;
+			}
+			i = 0;
+			while (i < n) {
+				dst[count[(src[i] >> shift) & 0xFFFF]++] = src[i];
+				i++;
+			}
+			uint64_t* t = src;
+			src = dst;
+			dst = t;
+		}
+		shift += 16;
+	}
+	if (src != Keys) {
+		memcpy(Keys, src, n * sizeof(uint64_t));
+	}
+	free(tmp);
+	free(count);
+	return true;
+}
+
+/**
+ * Sorts Keys[0 : n-1] into ascending order; CSet_SortKeysCancellable()
+ * without a token.
+ */
+static bool CSet_SortKeys(uint64_t* Keys, size_t n) {
+	return CSet_SortKeysCancellable(Keys, n, NULL);
+}
+
+// An inverted index over a collection of CSets: for each distinct value,
+// the ascending list of the indices of the sets that contain it.  The
+// lists are stored back to back, so the sets containing Values[v] are
+// Ids[Offsets[v] : Offsets[v+1]-1].
+struct _CSetPostings {
+
+	uint32_t  nValues;     // number of distinct values
+	int32_t*  Values;      // distinct values, ascending
+	uint64_t* Offsets;     // start of each value's list; nValues+1 entries
+	uint32_t* Ids;         // set indices, grouped by value
+};
+
+/**
+ * Builds the inverted index of Sets[0 : N-1] into *pPost, polling *pCancel,
+ * if given, once per CSET_CANCEL_BLOCK elements.
+ *
+ * Returns:
+ *    true if successful, false if memory could not be allocated or the
+ *    token fired, in which case *pPost owns no memory
+ *
+ * Complexity:  O( S ), where S is the total number of elements
+ */
+static bool CSet_BuildPostingsCancellable(struct _CSetPostings* pPost, const CSet* const* Sets,
+                                          uint32_t N, const CSetCancel* const pCancel) {
+	size_t total = 0;
+	uint32_t s = 0;
+	while (s < N) {
+		total += Sets[s]->Usage;
+		s++;
+	}
+	pPost->nValues = 0;
+	pPost->Values = NULL;
+	pPost->Ids = NULL;
+	pPost->Offsets = NULL;
+	//Each key is (value, set index), with the sign bit of the value flipped
+	//so that unsigned order matches signed order
+	uint64_t* keys = (uint64_t*)malloc((total > 0 ? total : 1) * sizeof(uint64_t));
+	if (keys == NULL) return false;
+	size_t k = 0;
+	s = 0;
+	while (s < N) {
+		if ((s & (CSET_CANCEL_BLOCK - 1)) == 0 && CSetCancel_Stopped(pCancel)) {
+			free(keys);
+			return false;
+		}
+		uint32_t i = 0;
+		while (i < Sets[s]->Usage) {
+			keys[k++] = ((uint64_t)((uint32_t)Sets[s]->Data[i] ^ 0x80000000u) << 32) | s;
+			i++;
+		}
+		s++;
+	}
+	pPost->Values = (int32_t*)malloc((total > 0 ? total : 1) * sizeof(int32_t));
+	pPost->Ids = (uint32_t*)malloc((total > 0 ? total : 1) * sizeof(uint32_t));
+	pPost->Offsets = (uint64_t*)malloc((total + 1) * sizeof(uint64_t));
+	if (pPost->Values == NULL || pPost->Ids == NULL || pPost->Offsets == NULL ||
+	    !CSet_SortKeysCancellable(keys, total, pCancel)) {
+		free(keys);
+		free(pPost->Values);
+		free(pPost->Ids);
+		free(pPost->Offsets);
+		return false;
+	}
+	uint32_t v = 0;
+	k = 0;
+	while (k < total) {
+		int32_t value = (int32_t)((uint32_t)(keys[k] >> 32) ^ 0x80000000u);
+		if (k == 0 || value != pPost->Values[v - 1]) {
+			pPost->Values[v] = value;
+			pPost->Offsets[v] = k;
+			v++;
+		}
+		pPost->Ids[k] = (uint32_t)keys[k];
+		k++;
+	}
+	pPost->Offsets[v] = total;
+	pPost->nValues = v;
+	free(keys);
+	return true;
+}
+
+/**
+ * Builds the inverted index of Sets[0 : N-1] into *pPost;
+ * CSet_BuildPostingsCancellable() without a token.
+ */
+static bool CSet_BuildPostings(struct _CSetPostings* pPost, const CSet* const* Sets, uint32_t N) {
+	return CSet_BuildPostingsCancellable(pPost, Sets, N, NULL);
+}
+
+/**
+ * Releases the memory owned by *pPost.
+ */
+static void CSet_FreePostings(struct _CSetPostings* pPost) {
+	free(pPost->Values);
+	free(pPost->Offsets);
+	free(pPost->Ids);
+	pPost->Values = NULL;
+	pPost->Offsets = NULL;
+	pPost->Ids = NULL;
+	pPost->nValues = 0;
+}
+
+// A pair of collection indices reported by a join: set A[A] and set B[B].
+struct _CSetPair {
+
+	uint32_t A;
+	uint32_t B;
+};
+
+typedef struct _CSetPair CSetPair;
+
+// One contiguous range of the A collection in a containment join.
+struct _CSetJoinTask {
+
+	const CSet* const*          As;
+	uint32_t                    First;    // first A index of the range
+	uint32_t                    Last;     // one past the last A index
+	uint32_t                    nB;
+	const struct _CSetPostings* Post;     // inverted index of the B sets
+	CSetPair*                   Pairs;    // pairs found, ordered by A then B
+	uint64_t                    Count;
+	uint64_t                    Room;     // dimension of Pairs
+	bool                        Ok;       // false if out of memory or stopped
+	const CSetCancel*           Cancel;   // polled every CSET_CANCEL_BLOCK sets or pairs
+};
+
+/**
+ * Appends (a, b) to the task's pair list, doubling it when full.
+ *
+ * Returns:
+ *    true if successful, false if memory could not be allocated or the
+ *    task's token fired
+ */
+static bool CSet_JoinEmit(struct _CSetJoinTask* pTask, uint32_t a, uint32_t b) {
+	if ((pTask->Count & (CSET_CANCEL_BLOCK - 1)) == 0 && CSetCancel_Stopped(pTask->Cancel)) {
+		return false;
+	}
+	if (pTask->Count == pTask->Room) {
+		uint64_t room = (pTask->Room == 0) ? 64 : pTask->Room * 2;
+		CSetPair* pairs = (CSetPair*)realloc(pTask->Pairs, (size_t)room * sizeof(CSetPair));
+		if (pairs == NULL) return false;
+		pTask->Pairs = pairs;
+		pTask->Room = room;
+	}
+	pTask->Pairs[pTask->Count].A = a;
+	pTask->Pairs[pTask->Count].B = b;
+	pTask->Count++;
+	return true;
+}
+
+static int CSet_CompareU64(const void* pX, const void* pY) {
+	uint64_t x = *(const uint64_t*)pX;
+	uint64_t y = *(const uint64_t*)pY;
+	return (x > y) - (x < y);
+}
+
+/**
+ * Finds the first position in Ids[Lo : Hi-1] whose id is not less than Id;
+ * the posting-list counterpart of CSet_Gallop().
+ *
+ * Pre:
+ *    Ids[Lo : Hi-1] is in ascending order
+ * Returns:
+ *    the smallest i in [Lo, Hi] such that i == Hi or Ids[i] >= Id
+ *
+ * Complexity:  O( log(d) ), where d is the distance from Lo to the answer
+ */
+static uint32_t CSet_GallopIds(const uint32_t* Ids, uint32_t Lo, uint32_t Hi, uint32_t Id) {
+	uint32_t step = 1;
+	uint32_t probe = Lo;
+	while (probe < Hi && Ids[probe] < Id) {
+		Lo = probe + 1;
+		probe = (Hi - probe > step) ? probe + step : Hi;
+		step *= 2;
+	}
+	//Bisect the last stride, (previous probe, probe]
+	while (Lo < probe) {
+		uint32_t mid = Lo + (probe - Lo) / 2;
+		if (Ids[mid] < Id) {
+			Lo = mid + 1;
+		}
+		else {
+			probe = mid;
+		}
+	}
+	return Lo;
+}
+
+/**
+ * Finds the supersets of every A set in the task's range.  The candidates
+ * for A start as the posting list of A's rarest value and are narrowed by
+ * intersecting with the lists of A's other values, rarest first, so the
+ * work is bounded by the shortest lists rather than by the number of B sets.
+ */
+static void* CSet_JoinRun(void* Arg) {
+	struct _CSetJoinTask* pTask = (struct _CSetJoinTask*)Arg;
+	const struct _CSetPostings* post = pTask->Post;
+	uint32_t most = 0;
+	uint32_t a = pTask->First;
+	while (a < pTask->Last) {
+		if (pTask->As[a]->Usage > most) most = pTask->As[a]->Usage;
+		a++;
+	}
+	//Each entry is (list length, value slot) for one value of A
+	uint64_t* order = (uint64_t*)malloc((most > 0 ? most : 1) * sizeof(uint64_t));
+	uint32_t* cand = (uint32_t*)malloc((pTask->nB > 0 ? pTask->nB : 1) * sizeof(uint32_t));
+	pTask->Ok = (order != NULL && cand != NULL);
+	a = pTask->First;
+	while (pTask->Ok && a < pTask->Last) {
+		if (((a - pTask->First) & (CSET_CANCEL_BLOCK - 1)) == 0 && CSetCancel_Stopped(pTask->Cancel)) {
+			pTask->Ok = false;
+			break;
+		}
+		const CSet* pA = pTask->As[a];
+		uint32_t n = 0;
+		//The empty set is a subset of every B
+		if (pA->Usage == 0) {
+			while (n < pTask->nB && pTask->Ok) {
+				pTask->Ok = CSet_JoinEmit(pTask, a, n);
+				n++;
+			}
+			a++;
+			continue;
+		}
+		bool possible = true;
+		uint32_t i = 0;
+		while (i < pA->Usage) {
+			uint32_t v = CSet_LowerBound(post->Values, 0, post->nValues, pA->Data[i]);
+			if (v == post->nValues || post->Values[v] != pA->Data[i]) {
+				possible = false;
+				break;
+			}
+			order[i] = ((post->Offsets[v + 1] - post->Offsets[v]) << 32) | v;
+			i++;
+		}
+		if (!possible) {
+			a++;
+			continue;
+		}
+		qsort(order, pA->Usage, sizeof(uint64_t), CSet_CompareU64);
+		uint32_t v = (uint32_t)order[0];
+		uint64_t first = post->Offsets[v];
+		n = (uint32_t)(post->Offsets[v + 1] - first);
+		memcpy(cand, post->Ids + first, n * sizeof(uint32_t));
+		i = 1;
+		while (i < pA->Usage && n > 0) {
+			v = (uint32_t)order[i];
+			const uint32_t* list = post->Ids + post->Offsets[v];
+			uint32_t len = (uint32_t)(post->Offsets[v + 1] - post->Offsets[v]);
+			uint32_t at = 0;
+			uint32_t kept = 0;
+			uint32_t c = 0;
+			//Candidates are few; gallop through the longer list
+			while (c < n && at < len) {
+				at = CSet_GallopIds(list, at, len, cand[c]);
+				if (at < len && list[at] == cand[c]) {
+					cand[kept++] = cand[c];
+				}
+				c++;
+			}
+			n = kept;
+			i++;
+		}
+		i = 0;
+		while (i < n && pTask->Ok) {
+			pTask->Ok = CSet_JoinEmit(pTask, a, cand[i]);
+			i++;
+		}
+		a++;
+	}
+	free(order);
+	free(cand);
+	return NULL;
+}
+
+/**
+ * Finds every pair (a, b) such that As[a] is a subset of Bs[b].
+ *
+ * An inverted index is built over the B sets; each A set then only looks
+ * at the B sets listed under its rarest value, narrowed by its other
+ * values, so the cost tracks the size of those lists and of the output
+ * rather than nA * nB.  Building the index and every thread poll *pCancel,
+ * if given, once per CSET_CANCEL_BLOCK elements, sets or pairs.
+ *
+ * Pre:
+ *    As[0 : nA-1] and Bs[0 : nB-1] point to proper CSet objects
+ *    pPairs and pCount point to variables that receive the result
+ *    nThreads is the number of threads to use, or 0 for one per processor
+ *    pCancel is NULL, or points to an initialized token
+ * Post:
+ *    the input sets are unchanged
+ *    If successful:
+ *       *pPairs points to a malloc'd array of *pCount pairs, ordered by A
+ *          then by B, holding exactly the pairs (a, b) with As[a] a subset
+ *          of Bs[b]; *pPairs is NULL if *pCount == 0
+ *    else:
+ *       *pPairs == NULL and *pCount == 0
+ * Returns:
+ *    CSET_OK if the pairs are successfully found, CSET_FAILED if memory
+ *    could not be allocated, otherwise the status of the token that
+ *    stopped it
+ *
+ * Complexity:  O( S + P + sum over A of |A| * L(A) ), where S is the total
+ *              number of elements, P the number of pairs reported and L(A)
+ *              the length of A's rarest posting list
+ */
+CSetStatus CSet_ContainmentJoinCancellable(const CSet* const* As, uint32_t nA, const CSet* const* Bs,
+                                           uint32_t nB, CSetPair** pPairs, uint64_t* pCount,
+                                           uint32_t nThreads, const CSetCancel* const pCancel) {
+	*pPairs = NULL;
+	*pCount = 0;
+	struct _CSetPostings post;
+	if (!CSet_BuildPostingsCancellable(&post, Bs, nB, pCancel)) {
+		return CSetCancel_Stopped(pCancel) ? CSetCancel_Status(pCancel) : CSET_FAILED;
+	}
+
+	//Split the A sets into contiguous ranges of roughly equal total size
+	struct _CSetJoinTask tasks[CSET_MAX_THREADS];
+	uint32_t nTasks = CSet_ThreadCount(nThreads);
+	if (nTasks > nA) nTasks = (nA > 0) ? nA : 1;
+	uint64_t total = 0;
+	uint32_t a = 0;
+	while (a < nA) {
+		total += As[a]->Usage + 1;
+		a++;
+	}
+	uint64_t seen = 0;
+	uint32_t t = 0;
+	a = 0;
+	while (t < nTasks) {
+		tasks[t].As = As;
+		tasks[t].nB = nB;
+		tasks[t].Post = &post;
+		tasks[t].Pairs = NULL;
+		tasks[t].Count = 0;
+		tasks[t].Room = 0;
+		tasks[t].Cancel = pCancel;
+		tasks[t].First = a;
+		while (a < nA && (t == nTasks - 1 || seen < total * (t + 1) / nTasks)) {
+			seen += As[a]->Usage + 1;
+			a++;
+		}
+		tasks[t].Last = a;
+		t++;
+	}
+	CSet_RunParallel(CSet_JoinRun, tasks, sizeof(tasks[0]), nTasks);
+	CSet_FreePostings(&post);
+
+	bool ok = true;
+	uint64_t count = 0;
+	t = 0;
+	while (t < nTasks) {
+		ok = ok && tasks[t].Ok;
+		count += tasks[t].Count;
+		t++;
+	}
+	CSetPair* pairs = NULL;
+	if (ok && nTasks == 1) {
+		pairs = tasks[0].Pairs;
+		tasks[0].Pairs = NULL;
+	}
+	else if (ok && count > 0) {
+		pairs = (CSetPair*)malloc((size_t)count * sizeof(CSetPair));
+		ok = (pairs != NULL);
+		uint64_t i = 0;
+		t = 0;
+		while (ok && t < nTasks) {
+			if (tasks[t].Count > 0) {
+				memcpy(pairs + i, tasks[t].Pairs, (size_t)tasks[t].Count * sizeof(CSetPair));
+			}
+			i += tasks[t].Count;
+			t++;
+		}
+	}
+	t = 0;
+	while (t < nTasks) {
+		free(tasks[t].Pairs);
+		t++;
+	}
+	if (!ok) {
+		return CSetCancel_Stopped(pCancel) ? CSetCancel_Status(pCancel) : CSET_FAILED;
+	}
+	*pPairs = pairs;
+	*pCount = count;
+	return CSET_OK;
+}
+
+/**
+ * Finds every pair (a, b) such that As[a] is a subset of Bs[b];
+ * CSet_ContainmentJoinCancellable() without a token.
+ *
+ * Returns:
+ *    true if successful, false otherwise
+ */
+bool CSet_ContainmentJoin(const CSet* const* As, uint32_t nA, const CSet* const* Bs, uint32_t nB,
+                          CSetPair** pPairs, uint64_t* pCount, uint32_t nThreads) {
+	return CSet_ContainmentJoinCancellable(As, nA, Bs, nB, pPairs, pCount, nThreads, NULL) == CSET_OK;
+}
+
+/**
+ * Advances the generator state *pRng and returns the next 64 random bits
+ * (SplitMix64).  Any value, including 0, is a valid initial state.
+ */
+static uint64_t CSet_Random(uint64_t* pRng) {
+	uint64_t z = (*pRng += 0x9E3779B97F4A7C15ull);
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+	return z ^ (z >> 31);
+}
+
+/**
+ * Returns a uniformly distributed integer in [0, Bound), Bound > 0, without
+ * modulo bias.
+ */
+static uint32_t CSet_RandomBelow(uint64_t* pRng, uint32_t Bound) {
+	uint64_t m = (CSet_Random(pRng) >> 32) * Bound;
+	if ((uint32_t)m < Bound) {
+		uint32_t floor = (uint32_t)(-Bound) % Bound;
+		while ((uint32_t)m < floor) {
+			m = (CSet_Random(pRng) >> 32) * Bound;
+		}
+	}
+	return (uint32_t)(m >> 32);
+}
+
+/**
+ * Draws one member of a pSet object uniformly at random.
+ *
+ * Pre:
+ *    *pSet is proper
+ *    pRng points to the caller's generator state
+ * Post:
+ *    *pSet is unchanged
+ *    if *pSet is not empty, *pValue is the chosen member
+ * Returns:
+ *    true if a member was drawn, false if *pSet is empty
+ *
+ * Complexity:  O( 1 )
+ */
+bool CSet_RandomElement(const CSet* const pSet, uint64_t* pRng, int32_t* pValue) {
+	if (pSet->Usage == 0) return false;
+	*pValue = pSet->Data[CSet_RandomBelow(pRng, pSet->Usage)];
+	return true;
+}
+
+/**
+ * Sets *pSample to K members of *pSet chosen uniformly at random, without
+ * replacement.  Positions are chosen directly with Floyd's algorithm, so
+ * the cost does not depend on the size of *pSet.
+ *
+ * Pre:
+ *    *pSample and *pSet are proper, and pSample != pSet
+ *    pRng points to the caller's generator state
+ * Post:
+ *    *pSet is unchanged
+ *    If successful:
+ *       *pSample holds min(K, pSet->Usage) members of *pSet, every such
+ *          subset being equally likely
+ *       pSample->Capacity == min(K, pSet->Usage)
+ *       *pSample is proper
+ *    else:
+ *       *pSample is unchanged
+ * Returns:
+ *    true if successful, false otherwise
+ *
+ * Complexity:  O( K )
+ */
+bool CSet_Sample(CSet* const pSample, const CSet* const pSet, uint32_t K, uint64_t* pRng) {
+	uint32_t n = pSet->Usage;
+	if (K > n) K = n;
+	int32_t* data = (int32_t*)malloc((K > 0 ? K : 1) * sizeof(int32_t));
+	if (data == NULL) return false;
+	if (K == n) {
+		if (n > 0) memcpy(data, pSet->Data, n * sizeof(int32_t));
+		CSet_Install(pSample, data, n, n);
+		return true;
+	}
+	//Open-addressed table of the chosen positions, at most half full;
+	//slots hold position + 1 so that 0 marks an empty slot.  K may exceed
+	//2^31, so the table is sized in 64 bits and hashed on the top bits
+	size_t slots = 2;
+	uint32_t shift = 63;
+	while (slots < 2 * (uint64_t)K) {
+		slots *= 2;
+		shift--;
+	}
+	uint64_t* table = (uint64_t*)calloc(slots, sizeof(uint64_t));
+	uint64_t* chosen = (uint64_t*)malloc((K > 0 ? K : 1) * sizeof(uint64_t));
+	if (table == NULL || chosen == NULL) {
+		free(table);
+		free(chosen);
+		free(data);
+		return false;
+	}
+	//Floyd: for j = n-K .. n-1 pick t in [0, j]; take t unless already
+	//taken, in which case take j, which cannot have been taken yet
+	uint32_t i = 0;
+	uint32_t j = n - K;
+	while (i < K) {
+		uint64_t pick = CSet_RandomBelow(pRng, j + 1);
+		size_t h = (size_t)((pick * 0x9E3779B97F4A7C15ull) >> shift);
+		while (table[h] != 0 && table[h] != pick + 1) {
+			h = (h + 1) & (slots - 1);
+		}
+		if (table[h] != 0) {
+			pick = j;
+			h = (size_t)((pick * 0x9E3779B97F4A7C15ull) >> shift);
+			while (table[h] != 0) {
+				h = (h + 1) & (slots - 1);
+			}
+		}
+		table[h] = pick + 1;
+		chosen[i] = pick;
+		i++;
+		j++;
+	}
+	free(table);
+	//Gather in position order so the sample comes out ascending
+	if (!CSet_SortKeys(chosen, K)) {
+		free(chosen);
+		free(data);
+		return false;
+	}
+	i = 0;
+	while (i < K) {
+		data[i] = pSet->Data[chosen[i]];
+		i++;
+	}
+	free(chosen);
+	CSet_Install(pSample, data, K, K);
+	return true;
+}
+
+// A prepared sampler over a collection of CSets.  Each draw first picks a
+// set, with probability proportional to its weight, and then a member of
+// that set uniformly at random.  Sets are picked with Vose's alias method,
+// so a draw costs O( 1 ) however many sets there are.
+struct _CSetSampler {
+
+	const CSet* const* Sets;
+	uint32_t N;
+	double*   Prob;        // chance of keeping slot i rather than Alias[i]
+	uint32_t* Alias;       // alternative set for each slot
+};
+
+typedef struct _CSetSampler CSetSampler;
+
+/**
+ * Prepares a sampler over Sets[0 : N-1].
+ *
+ * Pre:
+ *    pSampler points to a raw CSetSampler object
+ *    Sets[0 : N-1] point to proper CSet objects, which must stay unchanged
+ *       while the sampler is in use
+ *    Weights is NULL, or points to N nonnegative weights; if NULL, each set
+ *       is weighted by its Usage, so every element of the collection is
+ *       equally likely
+ * Post:
+ *    If successful, *pSampler is ready for CSetSampler_Draw()
+ * Returns:
+ *    true if successful; false if memory could not be allocated or no set
+ *    with positive weight is non-empty
+ *
+ * Complexity:  O( N )
+ */
+bool CSetSampler_Init(CSetSampler* const pSampler, const CSet* const* Sets, uint32_t N,
+                      const double* Weights) {
+	pSampler->Sets = Sets;
+	pSampler->N = N;
+	pSampler->Prob = (double*)malloc((N > 0 ? N : 1) * sizeof(double));
+	pSampler->Alias = (uint32_t*)malloc((N > 0 ? N : 1) * sizeof(uint32_t));
+	uint32_t* work = (uint32_t*)malloc((N > 0 ? N : 1) * sizeof(uint32_t));
+	bool ok = (pSampler->Prob != NULL && pSampler->Alias != NULL && work != NULL);
+	double total = 0.0;
+	uint32_t i = 0;
+	while (ok && i < N) {
+		//Empty sets can never be drawn from
+		double w = (Sets[i]->Usage == 0) ? 0.0 : (Weights != NULL) ? Weights[i] : Sets[i]->Usage;
+		pSampler->Prob[i] = (w > 0.0) ? w : 0.0;
+		total += pSampler->Prob[i];
+		i++;
+	}
+	ok = ok && total > 0.0;
+	if (ok) {
+		//Scale to mean 1, then pair each light slot with a heavy one;
+		//work holds the light slots from the front, heavy from the back
+		uint32_t light = 0;
+		uint32_t heavy = N;
+		i = 0;
+		while (i < N) {
+			pSampler->Prob[i] = pSampler->Prob[i] * N / total;
+			pSampler->Alias[i] = i;
+			if (pSampler->Prob[i] < 1.0) {
+				work[light++] = i;
+			}
+			else {
+				work[--heavy] = i;
+			}
+			i++;
+		}
+		uint32_t l = 0;
+		while (l < light && heavy < N) {
+			uint32_t s = work[l++];
+			uint32_t g = work[heavy];
+			pSampler->Alias[s] = g;
+			pSampler->Prob[g] -= 1.0 - pSampler->Prob[s];
+			if (pSampler->Prob[g] < 1.0) {
+				//g turned light; it is handled next in place of s
+				heavy++;
+				work[--l] = g;
+			}
+		}
+		//Rounding leftovers are certain picks
+		while (l < light) {
+			pSampler->Prob[work[l++]] = 1.0;
+		}
+		while (heavy < N) {
+			pSampler->Prob[work[heavy++]] = 1.0;
+		}
+	}
+	free(work);
+	if (!ok) {
+		free(pSampler->Prob);
+		free(pSampler->Alias);
+		pSampler->Prob = NULL;
+		pSampler->Alias = NULL;
+	}
+	return ok;
+}
+
+/**
+ * Draws one (set, member) pair from a prepared sampler.
+ *
+ * Pre:
+ *    *pSampler was prepared by CSetSampler_Init()
+ *    pRng points to the caller's generator state
+ * Post:
+ *    *pSet is the index of the chosen set and *pValue the chosen member
+ *
+ * Complexity:  O( 1 )
+ */
+void CSetSampler_Draw(const CSetSampler* const pSampler, uint64_t* pRng, uint32_t* pSet,
+                      int32_t* pValue) {
+	uint32_t slot = CSet_RandomBelow(pRng, pSampler->N);
+	double coin = (double)(CSet_Random(pRng) >> 11) * (1.0 / 9007199254740992.0);
+	uint32_t s = (coin < pSampler->Prob[slot]) ? slot : pSampler->Alias[slot];
+	*pSet = s;
+	CSet_RandomElement(pSampler->Sets[s], pRng, pValue);
+}
+
+/**
+ * Releases the memory held by a sampler.
+ *
+ * Complexity:  O( 1 )
+ */
+void CSetSampler_Free(CSetSampler* const pSampler) {
+	free(pSampler->Prob);
+	free(pSampler->Alias);
+	pSampler->Prob = NULL;
+	pSampler->Alias = NULL;
+	pSampler->N = 0;
+}
+
+// Failed rejection draws tolerated by CSet_RandomIntersectionElement()
+// before it falls back to a counting pass.
+#define CSET_REJECTION_TRIES 32
+
+/**
+ * Draws one member of the intersection of *pA and *pB uniformly at random,
+ * without building the intersection.  Members of the smaller set are drawn
+ * until one is found in the larger; if the overlap is too small for that
+ * to succeed quickly, one merge pass picks a common value by reservoir
+ * sampling instead.
+ *
+ * Pre:
+ *    *pA and *pB are proper
+ *    pRng points to the caller's generator state
+ * Post:
+ *    *pA and *pB are unchanged
+ *    if the intersection is not empty, *pValue is the chosen member
+ * Returns:
+ *    true if a member was drawn, false if the intersection is empty
+ *
+ * Complexity:  O( log(max Usage) ) expected when the overlap is a fair
+ *              fraction of the smaller set, O( pA->Usage + pB->Usage )
+ *              otherwise
+ */
+bool CSet_RandomIntersectionElement(const CSet* const pA, const CSet* const pB, uint64_t* pRng,
+                                    int32_t* pValue) {
+	const CSet* small = (pA->Usage <= pB->Usage) ? pA : pB;
+	const CSet* large = (small == pA) ? pB : pA;
+	if (small->Usage == 0) return false;
+	uint32_t tries = 0;
+	while (tries < CSET_REJECTION_TRIES) {
+		int32_t v = small->Data[CSet_RandomBelow(pRng, small->Usage)];
+		if (CSet_Contains(large, v)) {
+			*pValue = v;
+			return true;
+		}
+		tries++;
+	}
+	uint32_t seen = 0;
+	uint32_t s = 0;
+	uint32_t l = 0;
+	while (s < small->Usage && l < large->Usage) {
+		l = CSet_Gallop(large->Data, l, large->Usage, small->Data[s]);
+		if (l < large->Usage && large->Data[l] == small->Data[s]) {
+			//Keep the i-th common value with probability 1/i
+			seen++;
+			if (CSet_RandomBelow(pRng, seen) == 0) {
+				*pValue = small->Data[s];
+			}
+		}
+		s++;
+	}
+	return seen > 0;
+}
+
+/**
+ * Sets *pSample to K members of the intersection of *pA and *pB chosen
+ * uniformly at random without replacement, in one merge pass that keeps
+ * a reservoir of K values instead of building the intersection.
+ *
+ * Pre:
+ *    *pSample, *pA and *pB are proper, and *pSample aliases neither input
+ *    pRng points to the caller's generator state
+ * Post:
+ *    *pA and *pB are unchanged
+ *    If successful:
+ *       *pSample holds min(K, |A n B|) members of the intersection, every
+ *          such subset being equally likely
+ *       pSample->Capacity == K
+ *       *pSample is proper
+ *    else:
+ *       *pSample is unchanged
+ * Returns:
+ *    true if successful, false otherwise
+ *
+ * Complexity:  O( min(Usage) * log(max Usage) + K log K )
+ */
+bool CSet_SampleIntersection(CSet* const pSample, const CSet* const pA, const CSet* const pB,
+                             uint32_t K, uint64_t* pRng) {
+	const CSet* small = (pA->Usage <= pB->Usage) ? pA : pB;
+	const CSet* large = (small == pA) ? pB : pA;
+	uint64_t* reservoir = (uint64_t*)malloc((K > 0 ? K : 1) * sizeof(uint64_t));
+	int32_t* data = (int32_t*)malloc((K > 0 ? K : 1) * sizeof(int32_t));
+	if (reservoir == NULL || data == NULL) {
+		free(reservoir);
+		free(data);
+		return false;
+	}
+	uint32_t seen = 0;
+	uint32_t s = 0;
+	uint32_t l = 0;
+	while (K > 0 && s < small->Usage && l < large->Usage) {
+		l = CSet_Gallop(large->Data, l, large->Usage, small->Data[s]);
+		if (l < large->Usage && large->Data[l] == small->Data[s]) {
+			//Reservoir entries are positions in small, so sorting them
+			//restores value order
+			if (seen < K) {
+				reservoir[seen] = s;
+			}
+			else {
+				uint32_t r = CSet_RandomBelow(pRng, seen + 1);
+				if (r < K) reservoir[r] = s;
+			}
+			seen++;
+		}
+		s++;
+	}
+	uint32_t n = (seen < K) ? seen : K;
+	if (!CSet_SortKeys(reservoir, n)) {
+		free(reservoir);
+		free(data);
+		return false;
+	}
+	uint32_t i = 0;
+	while (i < n) {
+		data[i] = small->Data[reservoir[i]];
+		i++;
+	}
+	free(reservoir);
+	CSet_Install(pSample, data, n, K);
+	return true;
+}
+
+// CSetRIndex is a reverse-membership index over a collection of CSets,
+// each identified by a caller-chosen id in [0, INT32_MAX].  For each value
+// it keeps the ids of the member sets that contain it, as a CSet, so the
+// question "which sets contain x" costs one search plus the size of the
+// answer, and the answers can be combined with the ordinary CSet
+// operations.
+//
+// Values[0 : Usage-1] are the indexed values in ascending order, and
+// Lists[i] is the set of ids of the member sets containing Values[i];
+// no list is empty.
+struct _CSetRIndex {
+
+	uint32_t Capacity;     // dimension of the Values and Lists arrays
+	uint32_t Usage;        // number of distinct values indexed
+	int32_t* Values;       // indexed values, ascending
+	CSet*    Lists;        // ids of the sets containing each value
+};
+
+typedef struct _CSetRIndex CSetRIndex;
+
+/**
+ * Initializes a raw pIndex object as an empty index.
+ *
+ * Pre:
+ *    pIndex points to a CSetRIndex object
+ * Post:
+ *    *pIndex is empty
+ *
+ * Complexity:  O( 1 )
+ */
+void CSetRIndex_Init(CSetRIndex* const pIndex) {
+	pIndex->Capacity = 0;
+	pIndex->Usage = 0;
+	pIndex->Values = NULL;
+	pIndex->Lists = NULL;
+}
+
+/**
+ * Releases all memory held by a pIndex object.
+ *
+ * Post:
+ *    *pIndex is empty
+ *
+ * Complexity:  O( pIndex->Usage )
+ */
+void CSetRIndex_Free(CSetRIndex* const pIndex) {
+	uint32_t i = 0;
+	while (i < pIndex->Usage) {
+		free(pIndex->Lists[i].Data);
+		i++;
+	}
+	free(pIndex->Values);
+	free(pIndex->Lists);
+	CSetRIndex_Init(pIndex);
+}
+
+/**
+ * Builds a pIndex object over Sets[0 : N-1], where Sets[i] has id i.
+ *
+ * Pre:
+ *    pIndex points to a raw or empty CSetRIndex object
+ *    Sets[0 : N-1] point to proper CSet objects, N <= INT32_MAX
+ * Post:
+ *    If successful, *pIndex indexes the sets; otherwise it is empty
+ * Returns:
+ *    true if successful, false otherwise
+ *
+ * Complexity:  O( S ), where S is the total number of elements
+ */
+bool CSetRIndex_Build(CSetRIndex* const pIndex, const CSet* const* Sets, uint32_t N) {
+	CSetRIndex_Init(pIndex);
+	struct _CSetPostings post;
+	if (!CSet_BuildPostings(&post, Sets, N)) return false;
+	uint32_t n = post.nValues;
+	pIndex->Lists = (CSet*)malloc((n > 0 ? n : 1) * sizeof(CSet));
+	if (pIndex->Lists == NULL) {
+		CSet_FreePostings(&post);
+		return false;
+	}
+	//The distinct values carry over as they are
+	pIndex->Values = post.Values;
+	post.Values = NULL;
+	pIndex->Capacity = n;
+	while (pIndex->Usage < n) {
+		uint32_t v = pIndex->Usage;
+		uint32_t len = (uint32_t)(post.Offsets[v + 1] - post.Offsets[v]);
+		//One spare cell so the next CSet_Insert can shift in place
+		if (!CSet_Init(&pIndex->Lists[v], len + 1)) {
+			CSet_FreePostings(&post);
+			CSetRIndex_Free(pIndex);
+			return false;
+		}
+		memcpy(pIndex->Lists[v].Data, post.Ids + post.Offsets[v], len * sizeof(int32_t));
+		pIndex->Lists[v].Usage = len;
+		pIndex->Usage++;
+	}
+	CSet_FreePostings(&post);
+	return true;
+}
+
+/**
+ * Reports which member sets contain Value.
+ *
+ * Pre:
+ *    *pIndex has been initialized
+ * Post:
+ *    *pIndex is unchanged
+ * Returns:
+ *    the set of ids of the member sets that contain Value, or NULL if
+ *    there are none; the result stays valid until the index is next
+ *    changed, and must not be modified
+ *
+ * Complexity:  O( log(pIndex->Usage) )
+ */
+const CSet* CSetRIndex_Lookup(const CSetRIndex* const pIndex, int32_t Value) {
+	uint32_t i = CSet_LowerBound(pIndex->Values, 0, pIndex->Usage, Value);
+	if (i < pIndex->Usage && pIndex->Values[i] == Value) {
+		return &pIndex->Lists[i];
+	}
+	return NULL;
+}
+
+/**
+ * Records that the member set with id Id changed from *pOld to *pNew.
+ * Only the values in which the two differ are touched.  Adding a set is
+ * an update from the empty set, and removing one an update to it.
+ *
+ * Pre:
+ *    *pIndex has been initialized
+ *    *pOld is the set the index currently holds for Id, and *pNew is
+ *       its new contents; both are proper
+ *    Id <= INT32_MAX
+ * Post:
+ *    If successful, *pIndex reflects *pNew for Id
+ *    else, *pIndex is consistent but may reflect only part of the change
+ * Returns:
+ *    true if successful, false otherwise
+ *
+ * Complexity:  O( |Old| + |New| + D * L + V ), where D is the number of
+ *              values that changed, L the length of their id lists, and
+ *              the O( V ) term is only paid when a value enters or
+ *              leaves the index
+ */
+bool CSetRIndex_Update(CSetRIndex* const pIndex, int32_t Id, const CSet* const pOld,
+                       const CSet* const pNew) {
+	//Values new to the index, collected in ascending order
+	uint32_t room = pNew->Usage;
+	int32_t* fresh = (int32_t*)malloc((room > 0 ? room : 1) * sizeof(int32_t));
+	if (fresh == NULL) return false;
+	uint32_t nFresh = 0;
+	bool emptied = false;
+	bool ok = true;
+	uint32_t a = 0;
+	uint32_t b = 0;
+	while (ok && (a < pOld->Usage || b < pNew->Usage)) {
+		bool gone = (b == pNew->Usage) || (a < pOld->Usage && pOld->Data[a] < pNew->Data[b]);
+		bool added = !gone && ((a == pOld->Usage) || pNew->Data[b] < pOld->Data[a]);
+		if (gone) {
+			int32_t v = pOld->Data[a];
+			uint32_t i = CSet_LowerBound(pIndex->Values, 0, pIndex->Usage, v);
+			if (i < pIndex->Usage && pIndex->Values[i] == v) {
+				CSet_Remove(&pIndex->Lists[i], Id);
+				emptied = emptied || pIndex->Lists[i].Usage == 0;
+			}
+			a++;
+		}
+		else if (added) {
+			int32_t v = pNew->Data[b];
+			uint32_t i = CSet_LowerBound(pIndex->Values, 0, pIndex->Usage, v);
+			if (i < pIndex->Usage && pIndex->Values[i] == v) {
+				ok = CSet_Insert(&pIndex->Lists[i], Id) || CSet_Contains(&pIndex->Lists[i], Id);
+			}
+			else {
+				fresh[nFresh++] = v;
+			}
+			b++;
+		}
+		else {
+			//In both; nothing changes
+			a++;
+			b++;
+		}
+	}
+
+	//Make the fresh lists first, so the merge below cannot fail midway
+	CSet* made = NULL;
+	if (ok && nFresh > 0) {
+		made = (CSet*)malloc(nFresh * sizeof(CSet));
+		ok = (made != NULL);
+		uint32_t f = 0;
+		while (ok && f < nFresh) {
+			ok = CSet_Init(&made[f], 2) && CSet_Insert(&made[f], Id);
+			f++;
+		}
+		uint32_t usage = pIndex->Usage + nFresh;
+		if (ok && usage > pIndex->Capacity) {
+			uint32_t capacity = (pIndex->Capacity * 2 > usage) ? pIndex->Capacity * 2 : usage;
+			int32_t* values = (int32_t*)realloc(pIndex->Values, capacity * sizeof(int32_t));
+			if (values != NULL) pIndex->Values = values;
+			CSet* lists = (values == NULL) ? NULL : (CSet*)realloc(pIndex->Lists, capacity * sizeof(CSet));
+			if (lists != NULL) {
+				pIndex->Lists = lists;
+				pIndex->Capacity = capacity;
+			}
+			ok = (lists != NULL);
+		}
+		if (!ok) {
+			while (made != NULL && f > 0) {
+				f--;
+				free(made[f].Data);
+			}
+		}
+		//Merge the fresh values in from the back, in one pass
+		uint32_t r = pIndex->Usage;
+		uint32_t w = usage;
+		while (ok && f > 0) {
+			w--;
+			if (r > 0 && pIndex->Values[r - 1] > fresh[f - 1]) {
+				r--;
+				pIndex->Values[w] = pIndex->Values[r];
+				pIndex->Lists[w] = pIndex->Lists[r];
+			}
+			else {
+				f--;
+				pIndex->Values[w] = fresh[f];
+				pIndex->Lists[w] = made[f];
+			}
+		}
+		if (ok) pIndex->Usage = usage;
+	}
+	free(made);
+	free(fresh);
+
+	//Drop values no set contains any more
+	if (emptied) {
+		uint32_t w = 0;
+		uint32_t i = 0;
+		while (i < pIndex->Usage) {
+			if (pIndex->Lists[i].Usage == 0) {
+				free(pIndex->Lists[i].Data);
+			}
+			else {
+				pIndex->Values[w] = pIndex->Values[i];
+				pIndex->Lists[w] = pIndex->Lists[i];
+				w++;
+			}
+			i++;
+		}
+		pIndex->Usage = w;
+	}
+	return ok;
+}
+
+// CSetSubIndex is a subscription matching index: it holds a changing
+// collection of subscription sets and, for a query set E, reports every
+// subscription S with S a subset of E.
+//
+// Matching counts, for each subscription sharing a value with E, how many
+// of its values E contains; a subscription matches when the count reaches
+// its size.  The counters live in a hash table sized from the id lists of
+// E's values, so a match costs time and memory in proportion to the ids it
+// reads, however many subscriptions the index holds.
+//
+// Subscription ids are slot numbers, reused after removal.  Subs[id] is a
+// private copy of subscription id and Live[id] tells whether the slot is
+// in use.  Empty subscriptions, which match every query, are kept aside
+// in Empty.
+struct _CSetSubIndex {
+
+	CSetRIndex Index;      // value -> ids of the subscriptions containing it
+	uint32_t   Capacity;   // dimension of Subs and Live
+	uint32_t   Slots;      // number of slots ever used
+	CSet*      Subs;       // copy of each subscription
+	bool*      Live;       // whether each slot holds a subscription
+	CSet       Empty;      // ids of the live empty subscriptions
+	CSet       Unused;     // ids of the free slots below Slots
+};
+
+typedef struct _CSetSubIndex CSetSubIndex;
+
+/**
+ * Initializes a raw pIndex object as an empty subscription index.
+ *
+ * Pre:
+ *    pIndex points to a CSetSubIndex object
+ * Post:
+ *    *pIndex holds no subscriptions
+ * Returns:
+ *    true if successful, false otherwise
+ *
+ * Complexity:  O( 1 )
+ */
+bool CSetSubIndex_Init(CSetSubIndex* const pIndex) {
+	CSetRIndex_Init(&pIndex->Index);
+	pIndex->Capacity = 0;
+	pIndex->Slots = 0;
+	pIndex->Subs = NULL;
+	pIndex->Live = NULL;
+	bool ok = CSet_Init(&pIndex->Empty, 2);
+	if (!CSet_Init(&pIndex->Unused, 2)) ok = false;
+	return ok;
+}
+
+/**
+ * Releases all memory held by a pIndex object.
+ *
+ * Complexity:  O( number of slots + indexed values )
+ */
+void CSetSubIndex_Free(CSetSubIndex* const pIndex) {
+	uint32_t i = 0;
+	while (i < pIndex->Slots) {
+		if (pIndex->Live[i]) {
+			free(pIndex->Subs[i].Data);
+		}
+		i++;
+	}
+	CSetRIndex_Free(&pIndex->Index);
+	free(pIndex->Subs);
+	free(pIndex->Live);
+	free(pIndex->Empty.Data);
+	free(pIndex->Unused.Data);
+	pIndex->Subs = NULL;
+	pIndex->Live = NULL;
+	pIndex->Empty.Data = NULL;
+	pIndex->Unused.Data = NULL;
+	pIndex->Capacity = 0;
+	pIndex->Slots = 0;
+}
+
+/**
+ * Adds a copy of *pSub to a pIndex object as a new subscription.
+ *
+ * Pre:
+ *    *pIndex has been initialized
+ *    *pSub is proper
+ * Post:
+ *    If successful, the subscription is live and *pId is its id
+ *    else, *pIndex is unchanged
+ * Returns:
+ *    true if successful, false otherwise
+ *
+ * Complexity:  O( |Sub| * L + V ), as for CSetRIndex_Update()
+ */
+bool CSetSubIndex_Add(CSetSubIndex* const pIndex, const CSet* const pSub, uint32_t* pId) {
+	uint32_t id;
+	if (pIndex->Unused.Usage > 0) {
+		id = (uint32_t)pIndex->Unused.Data[0];
+	}
+	else {
+		if (pIndex->Slots == (uint32_t)INT32_MAX) return false;
+		id = pIndex->Slots;
+		if (id == pIndex->Capacity) {
+			uint32_t capacity = (pIndex->Capacity == 0) ? 8 : pIndex->Capacity * 2;
+			CSet* subs = (CSet*)realloc(pIndex->Subs, capacity * sizeof(CSet));
+			if (subs != NULL) pIndex->Subs = subs;
+			bool* live = (bool*)realloc(pIndex->Live, capacity * sizeof(bool));
+			if (live != NULL) pIndex->Live = live;
+			if (subs == NULL || live == NULL) return false;
+			pIndex->Capacity = capacity;
+		}
+	}
+	CSet* pCopy = &pIndex->Subs[id];
+	if (!CSet_Init(pCopy, pSub->Usage)) return false;
+	if (pSub->Usage > 0) {
+		memcpy(pCopy->Data, pSub->Data, pSub->Usage * sizeof(int32_t));
+	}
+	pCopy->Usage = pSub->Usage;
+	CSet none = { 0, 0, NULL };
+	bool ok = (pSub->Usage > 0) ? CSetRIndex_Update(&pIndex->Index, (int32_t)id, &none, pCopy)
+	                            : CSet_Insert(&pIndex->Empty, (int32_t)id);
+	if (!ok) {
+		//Take back whatever part of the update was applied
+		CSetRIndex_Update(&pIndex->Index, (int32_t)id, pCopy, &none);
+		free(pCopy->Data);
+		return false;
+	}
+	if (id == pIndex->Slots) {
+		pIndex->Slots++;
+	}
+	else {
+		CSet_Remove(&pIndex->Unused, (int32_t)id);
+	}
+	pIndex->Live[id] = true;
+	*pId = id;
+	return true;
+}
+
+/**
+ * Removes the subscription with id Id from a pIndex object.
+ *
+ * Pre:
+ *    *pIndex has been initialized
+ * Post:
+ *    If Id was live, it no longer is, and its id may be reused
+ * Returns:
+ *    true if Id was removed, false if it was not live or the index could
+ *    not be updated
+ *
+ * Complexity:  O( |Sub| * L ), plus O( V ) if values leave the index
+ */
+bool CSetSubIndex_Remove(CSetSubIndex* const pIndex, uint32_t Id) {
+	if (Id >= pIndex->Slots || !pIndex->Live[Id]) return false;
+	//The free list must have room before anything is undone
+	if (!CSet_Insert(&pIndex->Unused, (int32_t)Id)) return false;
+	CSet* pSub = &pIndex->Subs[Id];
+	CSet none = { 0, 0, NULL };
+	if (pSub->Usage == 0) {
+		CSet_Remove(&pIndex->Empty, (int32_t)Id);
+	}
+	else {
+		CSetRIndex_Update(&pIndex->Index, (int32_t)Id, pSub, &none);
+	}
+	free(pSub->Data);
+	pSub->Data = NULL;
+	pIndex->Live[Id] = false;
+	return true;
+}
+
+/**
+ * Sets *pMatches to the ids of every subscription that is a subset of
+ * *pEvent.
+ *
+ * The hit counters belong to the call and are sized from the id lists of
+ * E's values, so any number of threads may match against the same index at
+ * once, and subscriptions sharing no value with E cost nothing.
+ *
+ * Pre:
+ *    *pIndex has been initialized; it is not being changed by another
+ *       thread
+ *    *pMatches and *pEvent are proper
+ * Post:
+ *    *pIndex and *pEvent are unchanged
+ *    If successful:
+ *       For every id, id is contained in *pMatches iff subscription id is
+ *          live and is a subset of *pEvent
+ *       *pMatches is proper
+ *    else:
+ *       *pMatches is unchanged
+ * Returns:
+ *    true if successful, false otherwise
+ *
+ * Complexity:  O( |E| log V + H + M ), where H is the total length of the
+ *              id lists of E's values and M the number of matches
+ */
+bool CSetSubIndex_Match(const CSetSubIndex* const pIndex, const CSet* const pEvent,
+                        CSet* const pMatches) {
+	//Walk the id lists of E's values with a cursor into the index, since
+	//both are ascending; the first walk only sums their lengths
+	const CSetRIndex* pRev = &pIndex->Index;
+	uint64_t nHits = 0;
+	uint32_t v = 0;
+	uint32_t e = 0;
+	while (e < pEvent->Usage && v < pRev->Usage) {
+		v = CSet_Gallop(pRev->Values, v, pRev->Usage, pEvent->Data[e]);
+		if (v < pRev->Usage && pRev->Values[v] == pEvent->Data[e]) {
+			nHits += pRev->Lists[v].Usage;
+		}
+		e++;
+	}
+	//Open-addressed hit counters, at most half full; a slot holds id + 1 in
+	//its upper half and the id's count in its lower half, so that 0 marks
+	//an empty slot
+	size_t slots = 2;
+	uint32_t shift = 63;
+	while (slots < 2 * nHits) {
+		slots *= 2;
+		shift--;
+	}
+	uint64_t* table = (uint64_t*)calloc(slots, sizeof(uint64_t));
+	uint64_t* found = (uint64_t*)malloc((size_t)(nHits + 1) * sizeof(uint64_t));
+	if (table == NULL || found == NULL) {
+		free(table);
+		free(found);
+		return false;
+	}
+	uint32_t nFound = 0;
+	v = 0;
+	e = 0;
+	while (e < pEvent->Usage && v < pRev->Usage) {
+		v = CSet_Gallop(pRev->Values, v, pRev->Usage, pEvent->Data[e]);
+		if (v < pRev->Usage && pRev->Values[v] == pEvent->Data[e]) {
+			const CSet* pList = &pRev->Lists[v];
+			uint32_t i = 0;
+			while (i < pList->Usage) {
+				uint64_t key = ((uint64_t)pList->Data[i] + 1) << 32;
+				size_t h = (size_t)((key * 0x9E3779B97F4A7C15ull) >> shift);
+				while (table[h] != 0 && (table[h] >> 32) != (key >> 32)) {
+					h = (h + 1) & (slots - 1);
+				}
+				if (table[h] == 0) table[h] = key;
+				table[h]++;
+				uint32_t id = (uint32_t)pList->Data[i];
+				if ((uint32_t)table[h] == pIndex->Subs[id].Usage) {
+					found[nFound++] = id;
+				}
+				i++;
+			}
+		}
+		e++;
+	}
+	free(table);
+	//Merge in the empty subscriptions, which match every event and are
+	//already ascending
+	const CSet* pEmpty = &pIndex->Empty;
+	int32_t* data = (int32_t*)malloc((nFound + pEmpty->Usage + 1) * sizeof(int32_t));
+	if (data == NULL || !CSet_SortKeys(found, nFound)) {
+		free(data);
+		free(found);
+		return false;
+	}
+	uint32_t n = 0;
+	uint32_t i = 0;
+	uint32_t j = 0;
+	while (i < nFound || j < pEmpty->Usage) {
+		if (j == pEmpty->Usage || (i < nFound && found[i] < (uint64_t)pEmpty->Data[j])) {
+			data[n++] = (int32_t)found[i++];
+		}
+		else {
+			data[n++] = pEmpty->Data[j++];
+		}
+	}
+	free(found);
+	CSet_Install(pMatches, data, n, n + 1);
+	return true;
+}
+
+// Similarity measures supported by CSetSimIndex_TopK().
+enum _CSetSimilarity {
+
+	CSET_OVERLAP,          // |Q n S|
+	CSET_JACCARD           // |Q n S| / |Q u S|
+};
+
+typedef enum _CSetSimilarity CSetSimilarity;
+
+// One partition of a CSetSimIndex: an inverted index over the sets
+// Sets[First : First+Count-1], with set indices relative to First.
+struct _CSetSimPart {
+
+	uint32_t             First;
+	uint32_t             Count;
+	struct _CSetPostings Post;
+};
+
+// CSetSimIndex answers top-k similarity queries over a fixed collection of
+// CSets.  The collection is split into partitions, each with its own
+// inverted index, which are searched in parallel.
+//
+// Within a partition, the query's values are taken rarest first and their
+// lists are scanned to gather candidates, while a bounded heap tracks the
+// current k best.  As soon as the best score an unseen set could still
+// reach drops below the k-th best, scanning stops; the remaining values are
+// then checked only against the surviving candidates, by binary search in
+// the candidate sets, and candidates whose upper bound falls below the
+// k-th best are dropped along the way.
+struct _CSetSimIndex {
+
+	const CSet* const*   Sets;     // the indexed collection
+	uint32_t             N;
+	uint32_t             nParts;
+	struct _CSetSimPart* Parts;
+};
+
+typedef struct _CSetSimIndex CSetSimIndex;
+
+/**
+ * Builds a pIndex object over Sets[0 : N-1], split into nParts partitions.
+ *
+ * Pre:
+ *    pIndex points to a raw CSetSimIndex object
+ *    Sets[0 : N-1] point to proper CSet objects, which must stay unchanged
+ *       while the index is in use
+ *    nParts is the number of partitions, or 0 for one per processor
+ * Post:
+ *    If successful, *pIndex is ready for CSetSimIndex_TopK()
+ * Returns:
+ *    true if successful, false otherwise
+ *
+ * Complexity:  O( S ), where S is the total number of elements
+ */
+bool CSetSimIndex_Build(CSetSimIndex* const pIndex, const CSet* const* Sets, uint32_t N,
+                        uint32_t nParts) {
+	nParts = CSet_ThreadCount(nParts);
+	if (nParts > N) nParts = (N > 0) ? N : 1;
+	pIndex->Sets = Sets;
+	pIndex->N = N;
+	pIndex->nParts = 0;
+	pIndex->Parts = (struct _CSetSimPart*)malloc(nParts * sizeof(struct _CSetSimPart));
+	if (pIndex->Parts == NULL) return false;
+	while (pIndex->nParts < nParts) {
+		uint32_t p = pIndex->nParts;
+		struct _CSetSimPart* pPart = &pIndex->Parts[p];
+		pPart->First = (uint32_t)((uint64_t)N * p / nParts);
+		pPart->Count = (uint32_t)((uint64_t)N * (p + 1) / nParts) - pPart->First;
+		if (!CSet_BuildPostings(&pPart->Post, Sets + pPart->First, pPart->Count)) {
+			while (p > 0) {
+				p--;
+				CSet_FreePostings(&pIndex->Parts[p].Post);
+			}
+			free(pIndex->Parts);
+			pIndex->Parts = NULL;
+			return false;
+		}
+		pIndex->nParts++;
+	}
+	return true;
+}
+
+/**
+ * Releases the memory held by a pIndex object.
+ *
+ * Complexity:  O( number of partitions )
+ */
+void CSetSimIndex_Free(CSetSimIndex* const pIndex) {
+	uint32_t p = 0;
+	while (p < pIndex->nParts) {
+		CSet_FreePostings(&pIndex->Parts[p].Post);
+		p++;
+	}
+	free(pIndex->Parts);
+	pIndex->Parts = NULL;
+	pIndex->nParts = 0;
+}
+
+/**
+ * Scores a candidate that shares Common values with a query of QSize
+ * values, given the candidate's size SSize.
+ */
+static double CSet_SimScore(CSetSimilarity Measure, uint32_t Common, uint32_t QSize, uint32_t SSize) {
+	if (Measure == CSET_OVERLAP) return (double)Common;
+	return (double)Common / (double)(QSize + SSize - Common);
+}
+
+// One partition's share of a top-k similarity query.
+struct _CSetSimTask {
+
+	const CSetSimIndex*     Index;
+	const struct _CSetSimPart* Part;
+	const CSet*             Query;
+	CSetSimilarity          Measure;
+	uint32_t                K;
+	struct _CWSetHit*       Hits;     // local top K, Value holds global set ids
+	uint32_t                nHits;
+	bool                    Ok;
+};
+
+// Bounded heap of the K best candidates seen so far in one partition, kept
+// up to date as candidate scores grow.  The worst of them sits at the root,
+// so its score is the K-th best.  Heap holds candidate indices, and Pos[c]
+// is the position of candidate c in Heap, or CSET_SIM_OUT if it is not
+// there.  A candidate is worse than another if its score is lower, or equal
+// and its index higher.
+struct _CSetSimTop {
+
+	uint32_t* Heap;
+	uint32_t* Pos;
+	uint32_t  Size;
+	uint32_t  K;
+};
+
+#define CSET_SIM_OUT UINT32_MAX
+
+static bool CSet_SimWorse(const double* Score, uint32_t x, uint32_t y) {
+	return Score[x] < Score[y] || (Score[x] == Score[y] && x > y);
+}
+
+static void CSet_SimSwap(struct _CSetSimTop* pTop, uint32_t i, uint32_t j) {
+	uint32_t t = pTop->Heap[i];
+	pTop->Heap[i] = pTop->Heap[j];
+	pTop->Heap[j] = t;
+	pTop->Pos[pTop->Heap[i]] = i;
+	pTop->Pos[pTop->Heap[j]] = j;
+}
+
+static void CSet_SimSiftDown(struct _CSetSimTop* pTop, const double* Score, uint32_t i) {
+	while (2 * i + 1 < pTop->Size) {
+		uint32_t c = 2 * i + 1;
+		if (c + 1 < pTop->Size && CSet_SimWorse(Score, pTop->Heap[c + 1], pTop->Heap[c])) {
+			c++;
+		}
+		if (!CSet_SimWorse(Score, pTop->Heap[c], pTop->Heap[i])) break;
+		CSet_SimSwap(pTop, i, c);
+		i = c;
+	}
+}
+
+/**
+ * Takes note that the score of candidate c has risen: c moves within the
+ * heap, joins it while it has room, or displaces the root if it is now
+ * better than the root.
+ *
+ * Complexity:  O( log K )
+ */
+static void CSet_SimOffer(struct _CSetSimTop* pTop, const double* Score, uint32_t c) {
+	if (pTop->Pos[c] != CSET_SIM_OUT) {
+		CSet_SimSiftDown(pTop, Score, pTop->Pos[c]);
+	}
+	else if (pTop->Size < pTop->K) {
+		uint32_t i = pTop->Size++;
+		pTop->Heap[i] = c;
+		pTop->Pos[c] = i;
+		while (i > 0 && CSet_SimWorse(Score, pTop->Heap[i], pTop->Heap[(i - 1) / 2])) {
+			CSet_SimSwap(pTop, i, (i - 1) / 2);
+			i = (i - 1) / 2;
+		}
+	}
+	else if (CSet_SimWorse(Score, pTop->Heap[0], c)) {
+		pTop->Pos[pTop->Heap[0]] = CSET_SIM_OUT;
+		pTop->Heap[0] = c;
+		pTop->Pos[c] = 0;
+		CSet_SimSiftDown(pTop, Score, 0);
+	}
+}
+
+/**
+ * Returns the K-th best score seen so far, or -1 if there are fewer than
+ * K candidates.
+ */
+static double CSet_SimThreshold(const struct _CSetSimTop* pTop, const double* Score) {
+	return (pTop->Size == pTop->K) ? Score[pTop->Heap[0]] : -1.0;
+}
+
+static void* CSet_SimRun(void* Arg) {
+	struct _CSetSimTask* pTask = (struct _CSetSimTask*)Arg;
+	const struct _CSetSimPart* pPart = pTask->Part;
+	const struct _CSetPostings* post = &pPart->Post;
+	const CSet* const* sets = pTask->Index->Sets + pPart->First;
+	const CSet* pQuery = pTask->Query;
+	uint32_t K = pTask->K;
+	uint32_t q = pQuery->Usage;
+	uint32_t room = (pPart->Count > 0) ? pPart->Count : 1;
+	uint64_t* order = (uint64_t*)malloc((q > 0 ? q : 1) * sizeof(uint64_t));
+	uint32_t* common = (uint32_t*)calloc(room, sizeof(uint32_t));
+	double* score = (double*)malloc(room * sizeof(double));
+	uint32_t* cand = (uint32_t*)malloc(room * sizeof(uint32_t));
+	struct _CSetSimTop top;
+	top.Heap = (uint32_t*)malloc(K * sizeof(uint32_t));
+	top.Pos = (uint32_t*)malloc(room * sizeof(uint32_t));
+	top.Size = 0;
+	top.K = K;
+	struct _CWSetHit* hits = (struct _CWSetHit*)malloc(K * sizeof(struct _CWSetHit));
+	pTask->Hits = hits;
+	pTask->nHits = 0;
+	pTask->Ok = (order != NULL && common != NULL && score != NULL && cand != NULL &&
+	             top.Heap != NULL && top.Pos != NULL && hits != NULL);
+	if (!pTask->Ok) goto done;
+	memset(top.Pos, 0xFF, room * sizeof(uint32_t));
+
+	//Order the query's indexed values by list length, rarest first
+	uint32_t m = 0;
+	uint32_t v = 0;
+	uint32_t i = 0;
+	while (i < q && v < post->nValues) {
+		v = CSet_Gallop(post->Values, v, post->nValues, pQuery->Data[i]);
+		if (v < post->nValues && post->Values[v] == pQuery->Data[i]) {
+			order[m++] = ((post->Offsets[v + 1] - post->Offsets[v]) << 32) | v;
+		}
+		i++;
+	}
+	qsort(order, m, sizeof(uint64_t), CSet_CompareU64);
+
+	//Gather candidates until no unseen set can reach the K-th best; one
+	//that could tie it must still be seen, since it might have the lower
+	//index
+	uint32_t nCand = 0;
+	uint32_t t = 0;
+	while (t < m) {
+		double unseen = CSet_SimScore(pTask->Measure, m - t, q, m - t);
+		if (unseen < CSet_SimThreshold(&top, score)) break;
+		v = (uint32_t)order[t];
+		uint64_t k = post->Offsets[v];
+		while (k < post->Offsets[v + 1]) {
+			uint32_t c = post->Ids[k];
+			if (common[c] == 0) {
+				cand[nCand++] = c;
+			}
+			common[c]++;
+			score[c] = CSet_SimScore(pTask->Measure, common[c], q, sets[c]->Usage);
+			CSet_SimOffer(&top, score, c);
+			k++;
+		}
+		t++;
+	}
+
+	//Finish the survivors on the remaining values by binary search,
+	//dropping any whose best possible score cannot reach the K-th best;
+	//members of the heap always can
+	while (t < m && nCand > 0) {
+		int32_t value = post->Values[(uint32_t)order[t]];
+		uint32_t left = m - t;
+		uint32_t kept = 0;
+		i = 0;
+		while (i < nCand) {
+			uint32_t c = cand[i];
+			uint32_t best = common[c] + left;
+			if (best > sets[c]->Usage) best = sets[c]->Usage;
+			if (top.Pos[c] != CSET_SIM_OUT ||
+			    CSet_SimScore(pTask->Measure, best, q, sets[c]->Usage) >= CSet_SimThreshold(&top, score)) {
+				if (CSet_Contains(sets[c], value)) {
+					common[c]++;
+					score[c] = CSet_SimScore(pTask->Measure, common[c], q, sets[c]->Usage);
+					CSet_SimOffer(&top, score, c);
+				}
+				cand[kept++] = c;
+			}
+			i++;
+		}
+		nCand = kept;
+		t++;
+	}
+
+	//The heap now holds the K best survivors, ties going to the lower index
+	i = 0;
+	while (i < top.Size) {
+		hits[i].Score = score[top.Heap[i]];
+		hits[i].Value = (int32_t)(pPart->First + top.Heap[i]);
+		i++;
+	}
+	pTask->nHits = top.Size;
+
+done:
+	free(order);
+	free(common);
+	free(score);
+	free(cand);
+	free(top.Heap);
+	free(top.Pos);
+	return NULL;
+}
+
+static int CSet_CompareHits(const void* pX, const void* pY) {
+	const struct _CWSetHit* x = (const struct _CWSetHit*)pX;
+	const struct _CWSetHit* y = (const struct _CWSetHit*)pY;
+	if (x->Score != y->Score) return (x->Score < y->Score) ? 1 : -1;
+	return (x->Value > y->Value) - (x->Value < y->Value);
+}
+
+/**
+ * Finds the K indexed sets most similar to *pQuery.
+ *
+ * Pre:
+ *    *pIndex was built by CSetSimIndex_Build()
+ *    *pQuery is proper
+ *    Ids and Scores have room for K entries
+ * Post:
+ *    *pIndex and *pQuery are unchanged
+ *    Ids[0 : r-1] are the indices of the r most similar sets that share at
+ *       least one value with *pQuery, and Scores[0 : r-1] their similarity
+ *       under Measure, in descending order of score and then ascending
+ *       index, where r is the return value; the scores are exact, and of
+ *       sets with equal scores the lower indices are reported
+ * Returns:
+ *    the number of sets reported, at most K; 0 if memory could not be
+ *    allocated
+ *
+ * Complexity:  O( |Q| log |Q| + H log K + C * R * log(max Usage * K) ) per
+ *              partition, where H is the length of the lists scanned, C the
+ *              number of surviving candidates and R the number of values
+ *              left
+ */
+uint32_t CSetSimIndex_TopK(const CSetSimIndex* const pIndex, const CSet* const pQuery, uint32_t K,
+                           CSetSimilarity Measure, uint32_t* Ids, double* Scores) {
+	if (K == 0 || pIndex->nParts == 0) return 0;
+	struct _CSetSimTask tasks[CSET_MAX_THREADS];
+	uint32_t p = 0;
+	while (p < pIndex->nParts) {
+		tasks[p].Index = pIndex;
+		tasks[p].Part = &pIndex->Parts[p];
+		tasks[p].Query = pQuery;
+		tasks[p].Measure = Measure;
+		tasks[p].K = K;
+		p++;
+	}
+	CSet_RunParallel(CSet_SimRun, tasks, sizeof(tasks[0]), pIndex->nParts);
+
+	uint64_t total = 0;
+	bool ok = true;
+	p = 0;
+	while (p < pIndex->nParts) {
+		ok = ok && tasks[p].Ok;
+		total += tasks[p].nHits;
+		p++;
+	}
+	struct _CWSetHit* all = ok ? (struct _CWSetHit*)malloc((size_t)(total + 1) * sizeof(struct _CWSetHit)) : NULL;
+	uint32_t n = 0;
+	if (all != NULL) {
+		p = 0;
+		while (p < pIndex->nParts) {
+			if (tasks[p].nHits > 0) {
+				memcpy(all + n, tasks[p].Hits, tasks[p].nHits * sizeof(struct _CWSetHit));
+			}
+			n += tasks[p].nHits;
+			p++;
+		}
+		qsort(all, n, sizeof(struct _CWSetHit), CSet_CompareHits);
+		if (n > K) n = K;
+		uint32_t i = 0;
+		while (i < n) {
+			Ids[i] = (uint32_t)all[i].Value;
+			Scores[i] = all[i].Score;
+			i++;
+		}
+		free(all);
+	}
+	p = 0;
+	while (p < pIndex->nParts) {
+		free(tasks[p].Hits);
+		p++;
+	}
+	return n;
+}
+
+// One interned set: the shared copy and the number of handles to it.
+struct _CSetInternEntry {
+
+	struct _CSetInternEntry* Next;    // next entry in the same bucket
+	uint64_t                 Hash;    // CSet_Hash() of Set
+	uint32_t                 Refs;    // handles given out and not released
+	CSet                     Set;     // the shared, immutable copy
+};
+
+// CSetInternTable deduplicates identical CSets.  Interning a set returns a
+// handle to a single shared, immutable copy of its contents; every set
+// with the same elements gets the same handle, so two interned sets are
+// equal exactly when their handles are equal, and the elements are stored
+// once however many holders there are.
+//
+// The table is a chained hash table keyed by a hash of the elements, with
+// CSet_Equals() confirming every match.  Copies are reference counted and
+// freed when the last handle is released.  All operations are serialized
+// by a mutex, so a table may be shared between threads.
+struct _CSetInternTable {
+
+	pthread_mutex_t           Lock;
+	uint32_t                  nBuckets;   // a power of 2
+	uint32_t                  Count;      // number of distinct sets held
+	struct _CSetInternEntry** Buckets;
+};
+
+typedef struct _CSetInternTable CSetInternTable;
+
+/**
+ * Computes a 64-bit hash of the elements of a pSet object; sets with the
+ * same elements have the same hash, whatever their capacity.
+ *
+ * Pre:
+ *    *pSet is proper
+ * Returns:
+ *    the hash
+ *
+ * Complexity:  O( pSet->Usage )
+ */
+uint64_t CSet_Hash(const CSet* const pSet) {
+	uint64_t h = 0x9E3779B97F4A7C15ull ^ pSet->Usage;
+	uint32_t i = 0;
+	while (i < pSet->Usage) {
+		h ^= (uint32_t)pSet->Data[i];
+		h *= 0xFF51AFD7ED558CCDull;
+		h ^= h >> 32;
+		i++;
+	}
+	h ^= h >> 29;
+	h *= 0xC4CEB9FE1A85EC53ull;
+	return h ^ (h >> 32);
+}
+
+/**
+ * Initializes a raw pTable object as an empty table.
+ *
+ * Pre:
+ *    pTable points to a CSetInternTable object
+ * Returns:
+ *    true if successful, false otherwise
+ *
+ * Complexity:  O( 1 )
+ */
+bool CSetInternTable_Init(CSetInternTable* const pTable) {
+	pTable->nBuckets = 64;
+	pTable->Count = 0;
+	pTable->Buckets = (struct _CSetInternEntry**)calloc(pTable->nBuckets, sizeof(struct _CSetInternEntry*));
+	if (pTable->Buckets == NULL) return false;
+	if (pthread_mutex_init(&pTable->Lock, NULL) != 0) {
+		free(pTable->Buckets);
+		pTable->Buckets = NULL;
+		return false;
+	}
+	return true;
+}
+
+/**
+ * Releases a pTable object and every set it holds.  Outstanding handles
+ * become invalid.
+ *
+ * Complexity:  O( number of buckets + sets held )
+ */
+void CSetInternTable_Free(CSetInternTable* const pTable) {
+	uint32_t b = 0;
+	while (b < pTable->nBuckets) {
+		struct _CSetInternEntry* pEntry = pTable->Buckets[b];
+		while (pEntry != NULL) {
+			struct _CSetInternEntry* pNext = pEntry->Next;
+			free(pEntry->Set.Data);
+			free(pEntry);
+			pEntry = pNext;
+		}
+		b++;
+	}
+	free(pTable->Buckets);
+	pTable->Buckets = NULL;
+	pTable->nBuckets = 0;
+	pTable->Count = 0;
+	pthread_mutex_destroy(&pTable->Lock);
+}
+
+/**
+ * Returns the shared copy of *pSet's contents, creating it if this is the
+ * first set with those contents.
+ *
+ * Pre:
+ *    *pTable has been initialized
+ *    *pSet is proper
+ * Post:
+ *    *pSet is unchanged
+ *    If successful, the shared copy holds one more reference; it has
+ *       Capacity == Usage, and must not be modified
+ * Returns:
+ *    the handle of the shared copy, or NULL if memory could not be
+ *    allocated
+ *
+ * Complexity:  O( pSet->Usage ) expected
+ */
+const CSet* CSet_Intern(CSetInternTable* const pTable, const CSet* const pSet) {
+	uint64_t hash = CSet_Hash(pSet);
+	const CSet* pShared = NULL;
+	pthread_mutex_lock(&pTable->Lock);
+	struct _CSetInternEntry* pEntry = pTable->Buckets[hash & (pTable->nBuckets - 1)];
+	while (pEntry != NULL) {
+		if (pEntry->Hash == hash && CSet_Equals(&pEntry->Set, pSet)) {
+			pEntry->Refs++;
+			pShared = &pEntry->Set;
+			break;
+		}
+		pEntry = pEntry->Next;
+	}
+	if (pShared == NULL) {
+		pEntry = (struct _CSetInternEntry*)malloc(sizeof(struct _CSetInternEntry));
+		if (pEntry != NULL && CSet_Init(&pEntry->Set, pSet->Usage)) {
+			if (pSet->Usage > 0) {
+				memcpy(pEntry->Set.Data, pSet->Data, pSet->Usage * sizeof(int32_t));
+			}
+			pEntry->Set.Usage = pSet->Usage;
+			pEntry->Hash = hash;
+			pEntry->Refs = 1;
+			//Grow at a load factor of 2; a failed grow just leaves longer chains
+			if (pTable->Count >= 2 * pTable->nBuckets) {
+				uint32_t n = pTable->nBuckets * 2;
+				struct _CSetInternEntry** buckets = (struct _CSetInternEntry**)calloc(n, sizeof(struct _CSetInternEntry*));
+				if (buckets != NULL) {
+					uint32_t b = 0;
+					while (b < pTable->nBuckets) {
+						struct _CSetInternEntry* p = pTable->Buckets[b];
+						while (p != NULL) {
+							struct _CSetInternEntry* pNext = p->Next;
+							p->Next = buckets[p->Hash & (n - 1)];
+							buckets[p->Hash & (n - 1)] = p;
+							p = pNext;
+						}
+						b++;
+					}
+					free(pTable->Buckets);
+					pTable->Buckets = buckets;
+					pTable->nBuckets = n;
+				}
+			}
+			uint32_t b = (uint32_t)(hash & (pTable->nBuckets - 1));
+			pEntry->Next = pTable->Buckets[b];
+			pTable->Buckets[b] = pEntry;
+			pTable->Count++;
+			pShared = &pEntry->Set;
+		}
+		else {
+			free(pEntry);
+		}
+	}
+	pthread_mutex_unlock(&pTable->Lock);
+	return pShared;
+}
+
+/**
+ * Gives up one reference to a shared copy, freeing it when none remain.
+ *
+ * Pre:
+ *    pShared was returned by CSet_Intern() on this table and still holds
+ *       the reference being released
+ * Post:
+ *    if this was the last reference, pShared is no longer valid
+ *
+ * Complexity:  O( 1 ) expected
+ */
+void CSet_Release(CSetInternTable* const pTable, const CSet* const pShared) {
+	struct _CSetInternEntry* pEntry = (struct _CSetInternEntry*)
+		((const char*)pShared - offsetof(struct _CSetInternEntry, Set));
+	pthread_mutex_lock(&pTable->Lock);
+	pEntry->Refs--;
+	if (pEntry->Refs == 0) {
+		struct _CSetInternEntry** pLink = &pTable->Buckets[pEntry->Hash & (pTable->nBuckets - 1)];
+		while (*pLink != pEntry) {
+			pLink = &(*pLink)->Next;
+		}
+		*pLink = pEntry->Next;
+		pTable->Count--;
+		free(pEntry->Set.Data);
+		free(pEntry);
+	}
+	pthread_mutex_unlock(&pTable->Lock);
+}
+
+// CDeltaSet stores a set as the changes made to a base CSet: the set's
+// members are the values of *Base that are not in Removed, together with
+// the values in Added.  A version that differs little from its base costs
+// only the size of the difference.
+//
+// Added and Removed are kept minimal: Added holds no value of *Base, and
+// Removed only values of *Base.  When they grow past 1/CDELTA_REBASE_RATIO
+// of the base, the set is rebased: it is materialized into a new base,
+// owned by the CDeltaSet, and the differences are cleared.
+struct _CDeltaSet {
+
+	const CSet* Base;      // the base set
+	bool        OwnsBase;  // whether Base was created by a rebase
+	CSet        Added;     // members not in *Base
+	CSet        Removed;   // values of *Base that are not members
+};
+
+typedef struct _CDeltaSet CDeltaSet;
+
+// Rebase once the differences exceed this fraction of the base ...
+#define CDELTA_REBASE_RATIO 8
+// ... and hold at least this many values.
+#define CDELTA_REBASE_MIN 64
+
+// A position in a CDeltaSet, for visiting its members in ascending order.
+struct _CDeltaCursor {
+
+	const CDeltaSet* Delta;
+	uint32_t         B;    // next index into Base->Data
+	uint32_t         A;    // next index into Added.Data
+	uint32_t         R;    // next index into Removed.Data
+};
+
+typedef struct _CDeltaCursor CDeltaCursor;
+
+/**
+ * Initializes a raw pDelta object to hold the same members as *pBase.
+ *
+ * Pre:
+ *    pDelta points to a CDeltaSet object
+ *    *pBase is proper, and must stay unchanged while *pDelta refers to it
+ * Post:
+ *    If successful, *pDelta has no differences from *pBase
+ * Returns:
+ *    true if successful, false otherwise
+ *
+ * Complexity:  O( 1 )
+ */
+bool CDeltaSet_Init(CDeltaSet* const pDelta, const CSet* const pBase) {
+	pDelta->Base = pBase;
+	pDelta->OwnsBase = false;
+	bool ok = CSet_Init(&pDelta->Added, 2);
+	if (!CSet_Init(&pDelta->Removed, 2)) ok = false;
+	return ok;
+}
+
+/**
+ * Releases the memory held by a pDelta object, including its base if it
+ * owns it.
+ *
+ * Complexity:  O( 1 )
+ */
+void CDeltaSet_Free(CDeltaSet* const pDelta) {
+	if (pDelta->OwnsBase) {
+		free(pDelta->Base->Data);
+		free((CSet*)pDelta->Base);
+	}
+	pDelta->Base = NULL;
+	pDelta->OwnsBase = false;
+	free(pDelta->Added.Data);
+	free(pDelta->Removed.Data);
+	pDelta->Added.Data = NULL;
+	pDelta->Removed.Data = NULL;
+	pDelta->Added.Usage = pDelta->Added.Capacity = 0;
+	pDelta->Removed.Usage = pDelta->Removed.Capacity = 0;
+}
+
+/**
+ * Reports the number of members of a pDelta object.
+ *
+ * Complexity:  O( 1 )
+ */
+uint32_t CDeltaSet_Usage(const CDeltaSet* const pDelta) {
+	return pDelta->Base->Usage - pDelta->Removed.Usage + pDelta->Added.Usage;
+}
+
+/**
+ * Determines if Value belongs to a pDelta object.
+ *
+ * Complexity:  O( log N ), for N the size of the base
+ */
+bool CDeltaSet_Contains(const CDeltaSet* const pDelta, int32_t Value) {
+	if (CSet_Contains(&pDelta->Added, Value)) return true;
+	return CSet_Contains(pDelta->Base, Value) && !CSet_Contains(&pDelta->Removed, Value);
+}
+
+/**
+ * Positions a cursor before the smallest member of a pDelta object.
+ *
+ * Pre:
+ *    *pDelta must not change while the cursor is in use
+ *
+ * Complexity:  O( 1 )
+ */
+void CDeltaCursor_Init(CDeltaCursor* const pCursor, const CDeltaSet* const pDelta) {
+	pCursor->Delta = pDelta;
+	pCursor->B = 0;
+	pCursor->A = 0;
+	pCursor->R = 0;
+}
+
+/**
+ * Moves a cursor to the next member of its CDeltaSet, in ascending order.
+ *
+ * Post:
+ *    if there is a next member, *pValue is that member
+ * Returns:
+ *    true if a member was produced, false if the cursor is at the end
+ *
+ * Complexity:  O( 1 ) amortized
+ */
+bool CDeltaCursor_Next(CDeltaCursor* const pCursor, int32_t* pValue) {
+	const CSet* pBase = pCursor->Delta->Base;
+	const CSet* pAdded = &pCursor->Delta->Added;
+	const CSet* pRemoved = &pCursor->Delta->Removed;
+	//Step over base values that have been removed
+	while (pCursor->B < pBase->Usage && pCursor->R < pRemoved->Usage &&
+	       pBase->Data[pCursor->B] >= pRemoved->Data[pCursor->R]) {
+		if (pBase->Data[pCursor->B] == pRemoved->Data[pCursor->R]) {
+			pCursor->B++;
+		}
+		pCursor->R++;
+	}
+	bool haveBase = pCursor->B < pBase->Usage;
+	bool haveAdded = pCursor->A < pAdded->Usage;
+	if (haveBase && (!haveAdded || pBase->Data[pCursor->B] < pAdded->Data[pCursor->A])) {
+		*pValue = pBase->Data[pCursor->B++];
+		return true;
+	}
+	if (haveAdded) {
+		*pValue = pAdded->Data[pCursor->A++];
+		return true;
+	}
+	return false;
+}
+
+/**
+ * Sets *pOut to hold the members of a pDelta object, in one three-way
+ * merge of the base, Added and Removed.
+ *
+ * Pre:
+ *    *pOut is proper, and is not the base of *pDelta
+ * Post:
+ *    If successful:
+ *       *pOut holds exactly the members of *pDelta
+ *       pOut->Capacity == CDeltaSet_Usage(pDelta) + 1
+ *       *pOut is proper
+ *    else:
+ *       *pOut is unchanged
+ * Returns:
+ *    true if successful, false otherwise
+ *
+ * Complexity:  O( N + |Added| + |Removed| )
+ */
+bool CDeltaSet_Materialize(const CDeltaSet* const pDelta, CSet* const pOut) {
+	uint32_t usage = CDeltaSet_Usage(pDelta);
+	int32_t* data = (int32_t*)malloc((usage + 1) * sizeof(int32_t));
+	if (data == NULL) return false;
+	CDeltaCursor cur;
+	CDeltaCursor_Init(&cur, pDelta);
+	uint32_t i = 0;
+	while (CDeltaCursor_Next(&cur, &data[i])) {
+		i++;
+	}
+	CSet_Install(pOut, data, i, usage + 1);
+	return true;
+}
+
+/**
+ * Makes the current members of a pDelta object its new base, owned by the
+ * CDeltaSet, and clears the differences.  This is done automatically by
+ * CDeltaSet_Insert() and CDeltaSet_Remove() as the differences grow.
+ *
+ * Post:
+ *    If successful, the members are unchanged and there are no differences
+ *    else, *pDelta is unchanged
+ * Returns:
+ *    true if successful, false otherwise
+ *
+ * Complexity:  O( N + |Added| + |Removed| )
+ */
+bool CDeltaSet_Rebase(CDeltaSet* const pDelta) {
+	CSet* pBase = (CSet*)malloc(sizeof(CSet));
+	if (pBase == NULL) return false;
+	CSet_Init(pBase, 0);
+	if (!CDeltaSet_Materialize(pDelta, pBase)) {
+		free(pBase);
+		return false;
+	}
+	if (pDelta->OwnsBase) {
+		free(pDelta->Base->Data);
+		free((CSet*)pDelta->Base);
+	}
+	pDelta->Base = pBase;
+	pDelta->OwnsBase = true;
+	//Clearing never fails: only the FILLER tail is rewritten
+	while (pDelta->Added.Usage > 0) {
+		pDelta->Added.Usage--;
+		pDelta->Added.Data[pDelta->Added.Usage] = INT32_MIN;
+	}
+	while (pDelta->Removed.Usage > 0) {
+		pDelta->Removed.Usage--;
+		pDelta->Removed.Data[pDelta->Removed.Usage] = INT32_MIN;
+	}
+	return true;
+}
+
+/**
+ * Rebases pDelta if its differences have grown too large.  A failed
+ * rebase is not an error; the differences are simply kept.
+ */
+static void CDeltaSet_MaybeRebase(CDeltaSet* const pDelta) {
+	uint64_t diff = (uint64_t)pDelta->Added.Usage + pDelta->Removed.Usage;
+	if (diff >= CDELTA_REBASE_MIN && diff * CDELTA_REBASE_RATIO > pDelta->Base->Usage) {
+		CDeltaSet_Rebase(pDelta);
+	}
+}
+
+/**
+ * Adds Value to a pDelta object.
+ *
+ * Post:
+ *    If successful, Value is a member of *pDelta; else *pDelta is unchanged
+ * Returns:
+ *    true if Value was added, false if it was already a member or memory
+ *    could not be allocated
+ *
+ * Complexity:  O( log N + |Added| + |Removed| ), plus the cost of a
+ *              rebase when one is due
+ */
+bool CDeltaSet_Insert(CDeltaSet* const pDelta, int32_t Value) {
+	bool done;
+	if (CSet_Contains(pDelta->Base, Value)) {
+		//Members of the base can only come back after a removal
+		done = CSet_Remove(&pDelta->Removed, Value);
+	}
+	else {
+		done = CSet_Insert(&pDelta->Added, Value);
+	}
+	if (done) CDeltaSet_MaybeRebase(pDelta);
+	return done;
+}
+
+/**
+ * Removes Value from a pDelta object.
+ *
+ * Post:
+ *    If successful, Value is not a member of *pDelta; else *pDelta is
+ *    unchanged
+ * Returns:
+ *    true if Value was removed, false if it was not a member or memory
+ *    could not be allocated
+ *
+ * Complexity:  O( log N + |Added| + |Removed| ), plus the cost of a
+ *              rebase when one is due
+ */
+bool CDeltaSet_Remove(CDeltaSet* const pDelta, int32_t Value) {
+	bool done;
+	if (CSet_Contains(pDelta->Base, Value)) {
+		done = CSet_Insert(&pDelta->Removed, Value);
+	}
+	else {
+		done = CSet_Remove(&pDelta->Added, Value);
+	}
+	if (done) CDeltaSet_MaybeRebase(pDelta);
+	return done;
+}
+
+/**
+ * Initializes a raw pDelta object to hold the members of *pNew, stored as
+ * differences from *pBase.
+ *
+ * Pre:
+ *    pDelta points to a CDeltaSet object
+ *    *pBase and *pNew are proper; *pBase must stay unchanged while *pDelta
+ *       refers to it
+ * Post:
+ *    If successful, *pDelta has the same members as *pNew
+ * Returns:
+ *    true if successful, false otherwise
+ *
+ * Complexity:  O( pBase->Usage + pNew->Usage )
+ */
+bool CDeltaSet_Encode(CDeltaSet* const pDelta, const CSet* const pBase, const CSet* const pNew) {
+	if (!CDeltaSet_Init(pDelta, pBase)) {
+		CDeltaSet_Free(pDelta);
+		return false;
+	}
+	//Count both sides first, so each difference is allocated once
+	uint32_t nAdded = 0;
+	uint32_t nRemoved = 0;
+	uint32_t b = 0;
+	uint32_t n = 0;
+	while (b < pBase->Usage || n < pNew->Usage) {
+		if (n == pNew->Usage || (b < pBase->Usage && pBase->Data[b] < pNew->Data[n])) {
+			nRemoved++;
+			b++;
+		}
+		else if (b == pBase->Usage || pNew->Data[n] < pBase->Data[b]) {
+			nAdded++;
+			n++;
+		}
+		else {
+			b++;
+			n++;
+		}
+	}
+	int32_t* added = (int32_t*)malloc((nAdded + 1) * sizeof(int32_t));
+	int32_t* removed = (int32_t*)malloc((nRemoved + 1) * sizeof(int32_t));
+	if (added == NULL || removed == NULL) {
+		free(added);
+		free(removed);
+		CDeltaSet_Free(pDelta);
+		return false;
+	}
+	uint32_t a = 0;
+	uint32_t r = 0;
+	b = 0;
+	n = 0;
+	while (b < pBase->Usage || n < pNew->Usage) {
+		if (n == pNew->Usage || (b < pBase->Usage && pBase->Data[b] < pNew->Data[n])) {
+			removed[r++] = pBase->Data[b++];
+		}
+		else if (b == pBase->Usage || pNew->Data[n] < pBase->Data[b]) {
+			added[a++] = pNew->Data[n++];
+		}
+		else {
+			b++;
+			n++;
+		}
+	}
+	CSet_Install(&pDelta->Added, added, a, a + 1);
+	CSet_Install(&pDelta->Removed, removed, r, r + 1);
+	CDeltaSet_MaybeRebase(pDelta);
+	return true;
+}
+
+// CSetArena stores a large collection of sets in compressed sparse row
+// form: the sets' values are laid end to end in one array, and set i is
+// Values[Offsets[i] : Offsets[i+1]-1], in ascending order.  Compared with
+// one CSet per set, this saves the per-set struct and allocation, which
+// dominate when the sets are small.
+//
+// CSetArena_View() presents any set of the arena as a read-only CSet,
+// so CSet_Contains(), CSet_Intersection(), CSet_isSubsetOf() and the
+// other operations that do not modify their inputs work on it directly.
+//
+// An arena may be saved to a file and later mapped back into memory with
+// CSetArena_Map(), without copying.
+struct _CSetArena {
+
+	uint32_t  Count;       // number of sets
+	uint64_t  nValues;     // total number of values
+	uint64_t* Offsets;     // start of each set in Values; Count+1 entries
+	int32_t*  Values;      // every set's values, end to end
+	void*     Map;         // the mapped file, or NULL if built in memory
+	size_t    MapSize;     // size of the mapping
+};
+
+typedef struct _CSetArena CSetArena;
+
+// Layout of a saved arena: this header, then Offsets, then Values, all in
+// the byte order of the machine that wrote it.
+struct _CSetArenaHeader {
+
+	char     Magic[8];     // CSET_ARENA_MAGIC
+	uint32_t Count;
+	uint32_t Reserved;
+	uint64_t nValues;
+};
+
+#define CSET_ARENA_MAGIC "CSetCSR1"
+
+/**
+ * Allocates the arrays of a pArena object for Count sets and nValues
+ * values in total, leaving their contents undefined.
+ */
+static bool CSetArena_Alloc(CSetArena* const pArena, uint32_t Count, uint64_t nValues) {
+	pArena->Count = Count;
+	pArena->nValues = nValues;
+	pArena->Map = NULL;
+	pArena->MapSize = 0;
+	pArena->Offsets = (uint64_t*)malloc(((size_t)Count + 1) * sizeof(uint64_t));
+	pArena->Values = (int32_t*)malloc((size_t)(nValues > 0 ? nValues : 1) * sizeof(int32_t));
+	if (pArena->Offsets == NULL || pArena->Values == NULL) {
+		free(pArena->Offsets);
+		free(pArena->Values);
+		pArena->Offsets = NULL;
+		pArena->Values = NULL;
+		pArena->Count = 0;
+		pArena->nValues = 0;
+		return false;
+	}
+	return true;
+}
+
+/**
+ * Releases the memory held by a pArena object, or unmaps its file.
+ * Views of the arena become invalid.
+ *
+ * Complexity:  O( 1 )
+ */
+void CSetArena_Free(CSetArena* const pArena) {
+	if (pArena->Map != NULL) {
+		munmap(pArena->Map, pArena->MapSize);
+	}
+	else {
+		free(pArena->Offsets);
+		free(pArena->Values);
+	}
+	pArena->Map = NULL;
+	pArena->MapSize = 0;
+	pArena->Offsets = NULL;
+	pArena->Values = NULL;
+	pArena->Count = 0;
+	pArena->nValues = 0;
+}
+
+/**
+ * Returns a read-only CSet view of set i of a pArena object.
+ *
+ * Pre:
+ *    i < pArena->Count
+ * Returns:
+ *    a proper CSet, with Capacity == Usage, whose Data points into the
+ *    arena; it stays valid until the arena is freed, and must never be
+ *    passed to an operation that modifies or frees its argument
+ *
+ * Complexity:  O( 1 )
+ */
+CSet CSetArena_View(const CSetArena* const pArena, uint32_t i) {
+	uint64_t first = pArena->Offsets[i];
+	uint32_t len = (uint32_t)(pArena->Offsets[i + 1] - first);
+	CSet view = { len, len, (len > 0) ? pArena->Values + first : NULL };
+	return view;
+}
+
+/**
+ * Leaves a built pArena object holding no sets, as a cancelled build does.
+ */
+static void CSetArena_Clear(CSetArena* const pArena) {
+	CSetArena_Free(pArena);
+	if (CSetArena_Alloc(pArena, 0, 0)) {
+		pArena->Offsets[0] = 0;
+	}
+}
+
+// One range of sets for the parallel arena builders.
+struct _CSetArenaTask {
+
+	CSetArena*         Arena;
+	const CSet* const* Sets;       // CSetArena_Build() input
+	uint32_t           First;
+	uint32_t           Last;
+	uint64_t*          Kept;       // CSetArena_BuildFromPairs(): row sizes
+	const CSetCancel*  Cancel;     // polled every CSET_CANCEL_BLOCK sets
+	bool               Stopped;    // true if the token fired
+};
+
+static void* CSetArena_CopyRun(void* Arg) {
+	struct _CSetArenaTask* pTask = (struct _CSetArenaTask*)Arg;
+	CSetArena* pArena = pTask->Arena;
+	pTask->Stopped = false;
+	uint32_t i = pTask->First;
+	while (i < pTask->Last) {
+		if (((i - pTask->First) & (CSET_CANCEL_BLOCK - 1)) == 0 && CSetCancel_Stopped(pTask->Cancel)) {
+			pTask->Stopped = true;
+			break;
+		}
+		if (pTask->Sets[i]->Usage > 0) {
+			memcpy(pArena->Values + pArena->Offsets[i], pTask->Sets[i]->Data,
+			       pTask->Sets[i]->Usage * sizeof(int32_t));
+		}
+		i++;
+	}
+	return NULL;
+}
+
+/**
+ * Splits [0, Count) into nTasks ranges holding about the same number of
+ * values, given the arena's offsets.
+ */
+static void CSetArena_Split(struct _CSetArenaTask* Tasks, uint32_t nTasks, CSetArena* const pArena,
+                            const uint64_t* Offsets, uint32_t Count) {
+	uint32_t t = 0;
+	uint32_t i = 0;
+	while (t < nTasks) {
+		Tasks[t].Arena = pArena;
+		Tasks[t].First = i;
+		//Sets are weighted by size plus one, so runs of empty sets split too
+		uint64_t goal = (Offsets[Count] + Count) * (t + 1) / nTasks;
+		while (i < Count && (t == nTasks - 1 || Offsets[i + 1] + i + 1 <= goal)) {
+			i++;
+		}
+		Tasks[t].Last = i;
+		t++;
+	}
+}
+
+/**
+ * Builds a pArena object holding copies of Sets[0 : N-1], copying ranges
+ * of sets on separate threads.  Every thread polls *pCancel, if given,
+ * once per CSET_CANCEL_BLOCK sets.
+ *
+ * Pre:
+ *    pArena points to a raw CSetArena object
+ *    Sets[0 : N-1] point to proper CSet objects
+ *    nThreads is the number of threads to use, or 0 for one per processor
+ *    pCancel is NULL, or points to an initialized token
+ * Post:
+ *    If successful, set i of *pArena holds the elements of Sets[i]
+ *    If stopped, *pArena holds no sets
+ * Returns:
+ *    CSET_OK if the arena is successfully built, CSET_FAILED if memory
+ *    could not be allocated, otherwise the status of the token that
+ *    stopped it
+ *
+ * Complexity:  O( N + S ), for S the total number of elements
+ */
+CSetStatus CSetArena_BuildCancellable(CSetArena* const pArena, const CSet* const* Sets, uint32_t N,
+                                      uint32_t nThreads, const CSetCancel* const pCancel) {
+	uint64_t total = 0;
+	uint32_t i = 0;
+	while (i < N) {
+		total += Sets[i]->Usage;
+		i++;
+	}
+	if (!CSetArena_Alloc(pArena, N, total)) return CSET_FAILED;
+	total = 0;
+	i = 0;
+	while (i < N) {
+		pArena->Offsets[i] = total;
+		total += Sets[i]->Usage;
+		i++;
+	}
+	pArena->Offsets[N] = total;
+	struct _CSetArenaTask tasks[CSET_MAX_THREADS];
+	uint32_t nTasks = CSet_ThreadCount(nThreads);
+	if (total < CSET_TOCC_PARALLEL_MIN) nTasks = 1;
+	CSetArena_Split(tasks, nTasks, pArena, pArena->Offsets, N);
+	i = 0;
+	while (i < nTasks) {
+		tasks[i].Sets = Sets;
+		tasks[i].Cancel = pCancel;
+		i++;
+	}
+	CSet_RunParallel(CSetArena_CopyRun, tasks, sizeof(tasks[0]), nTasks);
+	bool stopped = false;
+	i = 0;
+	while (i < nTasks) {
+		stopped = stopped || tasks[i].Stopped;
+		i++;
+	}
+	if (stopped) {
+		CSetArena_Clear(pArena);
+		return CSetCancel_Status(pCancel);
+	}
+	return CSET_OK;
+}
+
+/**
+ * Builds a pArena object holding copies of Sets[0 : N-1];
+ * CSetArena_BuildCancellable() without a token.
+ *
+ * Returns:
+ *    true if successful, false otherwise
+ */
+bool CSetArena_Build(CSetArena* const pArena, const CSet* const* Sets, uint32_t N, uint32_t nThreads) {
+	return CSetArena_BuildCancellable(pArena, Sets, N, nThreads, NULL) == CSET_OK;
+}
+
+static int CSet_CompareValues(const void* pX, const void* pY) {
+	int32_t x = *(const int32_t*)pX;
+	int32_t y = *(const int32_t*)pY;
+	return (x > y) - (x < y);
+}
+
+static void* CSetArena_SortRun(void* Arg) {
+	struct _CSetArenaTask* pTask = (struct _CSetArenaTask*)Arg;
+	CSetArena* pArena = pTask->Arena;
+	pTask->Stopped = false;
+	uint32_t i = pTask->First;
+	while (i < pTask->Last) {
+		if (((i - pTask->First) & (CSET_CANCEL_BLOCK - 1)) == 0 && CSetCancel_Stopped(pTask->Cancel)) {
+			pTask->Stopped = true;
+			break;
+		}
+		int32_t* row = pArena->Values + pArena->Offsets[i];
+		uint64_t len = pArena->Offsets[i + 1] - pArena->Offsets[i];
+		qsort(row, (size_t)len, sizeof(int32_t), CSet_CompareValues);
+		//Drop duplicates; the row is compacted into place later
+		uint64_t kept = 0;
+		uint64_t j = 0;
+		while (j < len) {
+			if (kept == 0 || row[j] != row[kept - 1]) {
+				row[kept++] = row[j];
+			}
+			j++;
+		}
+		pTask->Kept[i] = kept;
+		i++;
+	}
+	return NULL;
+}
+
+/**
+ * Builds a pArena object of N sets from M (row, value) pairs, such as the
+ * edge list of a graph: set r holds every value paired with r.  Pairs may
+ * come in any order and may repeat.  Rows are bucketed with a counting
+ * sort, then sorted and deduplicated on separate threads.  Each pass polls
+ * *pCancel, if given, once per CSET_CANCEL_BLOCK pairs or rows.
+ *
+ * Pre:
+ *    pArena points to a raw CSetArena object
+ *    Rows[0 : M-1] are all < N, and Cols[0 : M-1] are their values
+ *    nThreads is the number of threads to use, or 0 for one per processor
+ *    pCancel is NULL, or points to an initialized token
+ * Post:
+ *    If successful, set r of *pArena holds the distinct values paired
+ *    with r
+ *    If stopped, *pArena holds no sets
+ * Returns:
+ *    CSET_OK if the arena is successfully built, CSET_FAILED if memory
+ *    could not be allocated, otherwise the status of the token that
+ *    stopped it
+ *
+ * Complexity:  O( N + M log D ), for D the largest number of pairs of a row
+ */
+CSetStatus CSetArena_BuildFromPairsCancellable(CSetArena* const pArena, uint32_t N, const uint32_t* Rows,
+                                               const int32_t* Cols, uint64_t M, uint32_t nThreads,
+                                               const CSetCancel* const pCancel) {
+	if (!CSetArena_Alloc(pArena, N, M)) return CSET_FAILED;
+	uint64_t* next = (uint64_t*)calloc((size_t)N + 1, sizeof(uint64_t));
+	if (next == NULL) {
+		CSetArena_Free(pArena);
+		return CSET_FAILED;
+	}
+	uint64_t k = 0;
+	while (k < M) {
+		if ((k & (CSET_CANCEL_BLOCK - 1)) == 0 && CSetCancel_Stopped(pCancel)) goto stopped;
+		next[Rows[k] + 1]++;
+		k++;
+	}
+	uint32_t i = 0;
+	while (i < N) {
+		next[i + 1] += next[i];
+		i++;
+	}
+	memcpy(pArena->Offsets, next, ((size_t)N + 1) * sizeof(uint64_t));
+	k = 0;
+	while (k < M) {
+		if ((k & (CSET_CANCEL_BLOCK - 1)) == 0 && CSetCancel_Stopped(pCancel)) goto stopped;
+		pArena->Values[next[Rows[k]]++] = Cols[k];
+		k++;
+	}
+
+	//Sort and deduplicate the rows in parallel; next is reused for sizes
+	struct _CSetArenaTask tasks[CSET_MAX_THREADS];
+	uint32_t nTasks = CSet_ThreadCount(nThreads);
+	if (M < CSET_TOCC_PARALLEL_MIN) nTasks = 1;
+	CSetArena_Split(tasks, nTasks, pArena, pArena->Offsets, N);
+	i = 0;
+	while (i < nTasks) {
+		tasks[i].Kept = next;
+		tasks[i].Cancel = pCancel;
+		i++;
+	}
+	CSet_RunParallel(CSetArena_SortRun, tasks, sizeof(tasks[0]), nTasks);
+	i = 0;
+	while (i < nTasks) {
+		if (tasks[i].Stopped) goto stopped;
+		i++;
+	}
+
+	//Close the gaps left by duplicates
+	uint64_t w = 0;
+	i = 0;
+	while (i < N) {
+		if ((i & (CSET_CANCEL_BLOCK - 1)) == 0 && CSetCancel_Stopped(pCancel)) goto stopped;
+		uint64_t first = pArena->Offsets[i];
+		pArena->Offsets[i] = w;
+		if (w != first) {
+			memmove(pArena->Values + w, pArena->Values + first, (size_t)next[i] * sizeof(int32_t));
+		}
+		w += next[i];
+		i++;
+	}
+	pArena->Offsets[N] = w;
+	pArena->nValues = w;
+	free(next);
+	return CSET_OK;
+
+stopped:
+	free(next);
+	CSetArena_Clear(pArena);
+	return CSetCancel_Status(pCancel);
+}
+
+/**
+ * Builds a pArena object of N sets from M (row, value) pairs;
+ * CSetArena_BuildFromPairsCancellable() without a token.
+ *
+ * Returns:
+ *    true if successful, false otherwise
+ */
+bool CSetArena_BuildFromPairs(CSetArena* const pArena, uint32_t N, const uint32_t* Rows,
+                              const int32_t* Cols, uint64_t M, uint32_t nThreads) {
+	return CSetArena_BuildFromPairsCancellable(pArena, N, Rows, Cols, M, nThreads, NULL) == CSET_OK;
+}
+
+/**
+ * Writes a pArena object to the file at Path, in the form read by
+ * CSetArena_Map().
+ *
+ * Returns:
+ *    true if successful, false otherwise
+ *
+ * Complexity:  O( Count + nValues )
+ */
+bool CSetArena_Save(const CSetArena* const pArena, const char* Path) {
+	struct _CSetArenaHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.Magic, CSET_ARENA_MAGIC, sizeof(header.Magic));
+	header.Count = pArena->Count;
+	header.nValues = pArena->nValues;
+	FILE* fp = fopen(Path, "wb");
+	if (fp == NULL) return false;
+	bool ok = fwrite(&header, sizeof(header), 1, fp) == 1 &&
+	          fwrite(pArena->Offsets, sizeof(uint64_t), (size_t)pArena->Count + 1, fp) == (size_t)pArena->Count + 1 &&
+	          fwrite(pArena->Values, sizeof(int32_t), (size_t)pArena->nValues, fp) == (size_t)pArena->nValues;
+	if (fclose(fp) != 0) ok = false;
+	return ok;
+}
+
+/**
+ * Maps an arena saved by CSetArena_Save() into memory, read-only.  Pages
+ * of values are loaded on demand, so opening a large arena costs one pass
+ * over the offsets only.
+ *
+ * The header sizes and the offsets are validated, so every view of the
+ * mapped arena lies within the file; the order of the values within each
+ * set is not checked, and is only guaranteed for files written by
+ * CSetArena_Save().
+ *
+ * Pre:
+ *    pArena points to a raw CSetArena object
+ * Post:
+ *    If successful, *pArena holds the saved sets; it must be released
+ *    with CSetArena_Free(), and never modified
+ * Returns:
+ *    true if successful; false if the file cannot be mapped, or its size,
+ *    header or offsets are inconsistent
+ *
+ * Complexity:  O( Count )
+ */
+bool CSetArena_Map(CSetArena* const pArena, const char* Path) {
+	int fd = open(Path, O_RDONLY);
+	if (fd < 0) return false;
+	struct stat info;
+	void* map = MAP_FAILED;
+	if (fstat(fd, &info) == 0 && (size_t)info.st_size >= sizeof(struct _CSetArenaHeader)) {
+		map = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	}
+	close(fd);
+	if (map == MAP_FAILED) return false;
+	const struct _CSetArenaHeader* pHeader = (const struct _CSetArenaHeader*)map;
+	const uint64_t* offsets = (const uint64_t*)(pHeader + 1);
+	uint64_t fileSize = (uint64_t)info.st_size;
+	//Bound nValues by the file size first, so the total cannot overflow
+	bool ok = memcmp(pHeader->Magic, CSET_ARENA_MAGIC, sizeof(pHeader->Magic)) == 0 &&
+	          pHeader->nValues <= fileSize / sizeof(int32_t);
+	if (ok) {
+		uint64_t size = (uint64_t)sizeof(*pHeader) + ((uint64_t)pHeader->Count + 1) * sizeof(uint64_t) +
+		                pHeader->nValues * sizeof(int32_t);
+		ok = (size == fileSize);
+	}
+	//Offsets must start at 0, never decrease, end at nValues, and give
+	//every set a length that fits a CSet
+	if (ok) ok = (offsets[0] == 0 && offsets[pHeader->Count] == pHeader->nValues);
+	uint32_t i = 0;
+	while (ok && i < pHeader->Count) {
+		ok = offsets[i] <= offsets[i + 1] && offsets[i + 1] - offsets[i] <= UINT32_MAX;
+		i++;
+	}
+	if (!ok) {
+		munmap(map, (size_t)info.st_size);
+		return false;
+	}
+	pArena->Count = pHeader->Count;
+	pArena->nValues = pHeader->nValues;
+	pArena->Offsets = (uint64_t*)offsets;
+	pArena->Values = (int32_t*)(offsets + pHeader->Count + 1);
+	pArena->Map = map;
+	pArena->MapSize = (size_t)info.st_size;
+	return true;
+}
+
+/**
+ * Copies Values[0 : n-1] into a new array, sorted ascending and without
+ * duplicates.
+ *
+ * Returns:
+ *    the new array, which holds *pCount values and has room for at least
+ *    one, or NULL if memory could not be allocated
+ *
+ * Complexity:  O( n )
+ */
+static int32_t* CSet_SortedCopy(const int32_t* Values, uint32_t n, uint32_t* pCount) {
+	uint64_t* keys = (uint64_t*)malloc((n > 0 ? n : 1) * sizeof(uint64_t));
+	int32_t* out = (int32_t*)malloc((n > 0 ? n : 1) * sizeof(int32_t));
+	if (keys == NULL || out == NULL) {
+		free(keys);
+		free(out);
+		return NULL;
+	}
+	uint32_t i = 0;
+	while (i < n) {
+		keys[i] = (uint32_t)Values[i] ^ 0x80000000u;
+		i++;
+	}
+	if (!CSet_SortKeys(keys, n)) {
+		free(keys);
+		free(out);
+		return NULL;
+	}
+	uint32_t k = 0;
+	i = 0;
+	while (i < n) {
+		int32_t v = (int32_t)((uint32_t)keys[i] ^ 0x80000000u);
+		if (k == 0 || out[k - 1] != v) {
+			out[k++] = v;
+		}
+		i++;
+	}
+	free(keys);
+	*pCount = k;
+	return out;
+}
+
+/**
+ * Inserts and removes batches of values in a pSet object, in a single
+ * merge pass over its elements.  A value listed in both batches ends up
+ * absent, as if it were inserted and then removed.
+ *
+ * Pre:
+ *    *pSet is proper
+ *    Inserts[0 : nInserts-1] and Removes[0 : nRemoves-1] are the values to
+ *       insert and remove, in any order and possibly repeated
+ *    pInserted and pRemoved are NULL, or point to variables for the counts
+ * Post:
+ *    If successful:
+ *       *pSet holds its old elements plus the inserted values, less the
+ *          removed values
+ *       pSet->Capacity is unchanged if the result fits, and otherwise has
+ *          been doubled (as many times as needed) in a single reallocation
+ *       *pSet is proper
+ *       *pInserted and *pRemoved are the numbers of values actually added
+ *          and actually removed
+ *    else:
+ *       *pSet is unchanged
+ * Returns:
+ *    true if successful, false otherwise
+ *
+ * Complexity:  O( pSet->Usage + nInserts + nRemoves )
+ */
+bool CSet_ApplyDelta(CSet* const pSet, const int32_t* Inserts, uint32_t nInserts,
+                     const int32_t* Removes, uint32_t nRemoves, uint32_t* pInserted, uint32_t* pRemoved) {
+	uint32_t nIns = 0;
+	uint32_t nRem = 0;
+	int32_t* ins = CSet_SortedCopy(Inserts, nInserts, &nIns);
+	int32_t* rem = CSet_SortedCopy(Removes, nRemoves, &nRem);
+	if (ins == NULL || rem == NULL) {
+		free(ins);
+		free(rem);
+		return false;
+	}
+	int32_t* data = pSet->Data;
+	uint32_t usage = pSet->Usage;
+
+	//Narrow both lists to the changes that take effect
+	uint32_t k = 0;
+	uint32_t r = 0;
+	uint32_t d = 0;
+	uint32_t i = 0;
+	while (i < nIns) {
+		r = CSet_Gallop(rem, r, nRem, ins[i]);
+		d = CSet_Gallop(data, d, usage, ins[i]);
+		bool removed = (r < nRem && rem[r] == ins[i]);
+		bool present = (d < usage && data[d] == ins[i]);
+		if (!removed && !present) {
+			ins[k++] = ins[i];
+		}
+		i++;
+	}
+	nIns = k;
+	k = 0;
+	d = 0;
+	i = 0;
+	while (i < nRem) {
+		d = CSet_Gallop(data, d, usage, rem[i]);
+		if (d < usage && data[d] == rem[i]) {
+			rem[k++] = rem[i];
+		}
+		i++;
+	}
+	nRem = k;
+	uint32_t newUsage = usage - nRem + nIns;
+
+	if (newUsage <= pSet->Capacity) {
+		//In place: squeeze out the removals front to back, then open
+		//gaps for the insertions back to front
+		uint32_t w = 0;
+		r = 0;
+		i = 0;
+		while (i < usage) {
+			if (r < nRem && data[i] == rem[r]) {
+				r++;
+			}
+			else {
+				data[w++] = data[i];
+			}
+			i++;
+		}
+		uint32_t from = w;
+		w = newUsage;
+		k = nIns;
+		while (k > 0) {
+			w--;
+			if (from > 0 && data[from - 1] > ins[k - 1]) {
+				data[w] = data[--from];
+			}
+			else {
+				data[w] = ins[--k];
+			}
+		}
+		i = newUsage;
+		while (i < usage) {
+			data[i] = INT32_MIN;
+			i++;
+		}
+		pSet->Usage = newUsage;
+	}
+	else {
+		uint32_t capacity = (pSet->Capacity > 0) ? pSet->Capacity : 1;
+		while (capacity <= newUsage && capacity <= UINT32_MAX / 2) {
+			capacity *= 2;
+		}
+		if (capacity < newUsage) capacity = newUsage;
+		int32_t* grown = (int32_t*)malloc((size_t)capacity * sizeof(int32_t));
+		if (grown == NULL) {
+			free(ins);
+			free(rem);
+			return false;
+		}
+		uint32_t w = 0;
+		r = 0;
+		k = 0;
+		i = 0;
+		while (i < usage || k < nIns) {
+			if (i < usage && r < nRem && data[i] == rem[r]) {
+				i++;
+				r++;
+			}
+			else if (k == nIns || (i < usage && data[i] < ins[k])) {
+				grown[w++] = data[i++];
+			}
+			else {
+				grown[w++] = ins[k++];
+			}
+		}
+		//Installed by hand: this is an update, not a replacement
+		i = w;
+		while (i < capacity) {
+			grown[i] = INT32_MIN;
+			i++;
+		}
+		free(pSet->Data);
+		pSet->Data = grown;
+		pSet->Usage = w;
+		pSet->Capacity = capacity;
+	}
+	i = 0;
+	while (i < nIns) {
+		CSet_Notify(pSet, CSETFEED_INSERT, ins[i]);
+		i++;
+	}
+	i = 0;
+	while (i < nRem) {
+		CSet_Notify(pSet, CSETFEED_REMOVE, rem[i]);
+		i++;
+	}
+	free(ins);
+	free(rem);
+	if (pInserted != NULL) *pInserted = nIns;
+	if (pRemoved != NULL) *pRemoved = nRem;
+	return true;
+}
+
+/**
+ * Splits the difference between two versions of a set by side: *pAdded
+ * receives the values of *pNew missing from *pOld, and *pRemoved the values
+ * of *pOld missing from *pNew, in one merge pass.
+ *
+ * Pre:
+ *    *pOld, *pNew, *pAdded and *pRemoved are proper, and pAdded != pRemoved
+ * Post:
+ *    *pOld and *pNew are unchanged, unless aliased by an output
+ *    If successful:
+ *       x is contained in *pAdded iff x is in *pNew but not in *pOld
+ *       x is contained in *pRemoved iff x is in *pOld but not in *pNew
+ *       pAdded->Capacity == pNew->Usage + 1
+ *       pRemoved->Capacity == pOld->Usage + 1
+ *       *pAdded and *pRemoved are proper
+ *    else:
+ *       *pAdded and *pRemoved are unchanged
+ * Returns:
+ *    true if successful, false otherwise
+ *
+ * Complexity:  O( pOld->Usage + pNew->Usage )
+ */
+bool CSet_Diff(const CSet* const pOld, const CSet* const pNew, CSet* const pAdded,
+               CSet* const pRemoved) {
+	uint32_t addedCap = pNew->Usage + 1;
+	uint32_t removedCap = pOld->Usage + 1;
+	int32_t* added = (int32_t*)malloc(addedCap * sizeof(int32_t));
+	int32_t* removed = (int32_t*)malloc(removedCap * sizeof(int32_t));
+	if (added == NULL || removed == NULL) {
+		free(added);
+		free(removed);
+		return false;
+	}
+	uint32_t a = 0;
+	uint32_t r = 0;
+	uint32_t o = 0;
+	uint32_t n = 0;
+	while (o < pOld->Usage && n < pNew->Usage) {
+		if (pOld->Data[o] < pNew->Data[n]) {
+			removed[r++] = pOld->Data[o++];
+		}
+		else if (pOld->Data[o] > pNew->Data[n]) {
+			added[a++] = pNew->Data[n++];
+		}
+		else {
+			o++;
+			n++;
+		}
+	}
+	//Whatever is left on either side is wholly on that side
+	if (o < pOld->Usage) {
+		memcpy(removed + r, pOld->Data + o, (pOld->Usage - o) * sizeof(int32_t));
+		r += pOld->Usage - o;
+	}
+	if (n < pNew->Usage) {
+		memcpy(added + a, pNew->Data + n, (pNew->Usage - n) * sizeof(int32_t));
+		a += pNew->Usage - n;
+	}
+	CSet_Install(pAdded, added, a, addedCap);
+	CSet_Install(pRemoved, removed, r, removedCap);
+	return true;
+}
+
+// A streaming form of CSet_Diff(): each call to CSetDiffCursor_Next()
+// produces the next differing value, in ascending order, and which side
+// it came from, without building either output set.
+struct _CSetDiffCursor {
+
+	const CSet* Old;
+	const CSet* New;
+	uint32_t    O;         // next index into Old->Data
+	uint32_t    N;         // next index into New->Data
+};
+
+typedef struct _CSetDiffCursor CSetDiffCursor;
+
+/**
+ * Positions a cursor at the start of the difference between *pOld and
+ * *pNew.
+ *
+ * Pre:
+ *    *pOld and *pNew are proper, and must not change while the cursor is
+ *    in use
+ *
+ * Complexity:  O( 1 )
+ */
+void CSetDiffCursor_Init(CSetDiffCursor* const pCursor, const CSet* const pOld, const CSet* const pNew) {
+	pCursor->Old = pOld;
+	pCursor->New = pNew;
+	pCursor->O = 0;
+	pCursor->N = 0;
+}
+
+/**
+ * Moves a cursor to the next value that is in exactly one of its sets.
+ *
+ * Post:
+ *    if there is such a value, *pValue is that value, and *pAdded is true
+ *    if it is only in the new set and false if it is only in the old one
+ * Returns:
+ *    true if a value was produced, false if the cursor is at the end
+ *
+ * Complexity:  O( 1 ) amortized
+ */
+bool CSetDiffCursor_Next(CSetDiffCursor* const pCursor, int32_t* pValue, bool* pAdded) {
+	const CSet* pOld = pCursor->Old;
+	const CSet* pNew = pCursor->New;
+	while (pCursor->O < pOld->Usage && pCursor->N < pNew->Usage) {
+		int32_t o = pOld->Data[pCursor->O];
+		int32_t n = pNew->Data[pCursor->N];
+		if (o < n) {
+			pCursor->O++;
+			*pValue = o;
+			*pAdded = false;
+			return true;
+		}
+		if (o > n) {
+			pCursor->N++;
+			*pValue = n;
+			*pAdded = true;
+			return true;
+		}
+		pCursor->O++;
+		pCursor->N++;
+	}
+	if (pCursor->O < pOld->Usage) {
+		*pValue = pOld->Data[pCursor->O++];
+		*pAdded = false;
+		return true;
+	}
+	if (pCursor->N < pNew->Usage) {
+		*pValue = pNew->Data[pCursor->N++];
+		*pAdded = true;
+		return true;
+	}
+	return false;
+}
+
+// One change recorded by a change feed.
+struct _CSetFeedRecord {
+
+	uint64_t   Generation; // position of the change in the set's history
+	int32_t    Value;      // the value inserted or removed
+	CSetFeedOp Op;
+};
+
+typedef struct _CSetFeedRecord CSetFeedRecord;
+
+// CSetFeed is a change feed for one CSet: once attached with
+// CSet_AttachFeed(), every change made to the set is recorded, so that a
+// replica elsewhere can be kept in step by replaying the changes rather
+// than by copying the whole set.
+//
+// CSet_Insert(), CSet_Remove() and CSet_ApplyDelta() record one
+// CSETFEED_INSERT or CSETFEED_REMOVE per value actually changed.
+// Operations that replace the set as a whole, such as CSet_Copy(),
+// CSet_Intersection() and CSet_SymDifference() into it, record a
+// CSETFEED_RESET, after which replicas must be resynchronized by copying.
+//
+// Records go into a lock-free ring buffer with one producer (the thread
+// changing the set) and one consumer.  The producer never waits: if the
+// ring is full the record is dropped, and the consumer detects the gap in
+// generation numbers and reports that a resync is needed.
+struct _CSetFeed {
+
+	CSetFeedRecord* Ring;
+	uint32_t        Size;        // dimension of Ring, a power of 2
+	uint64_t        Head;        // records written; advanced by the producer
+	uint64_t        Tail;        // records read; advanced by the consumer
+	uint64_t        Generation;  // changes recorded or dropped; producer writes
+	uint64_t        Expected;    // next generation due; consumer only
+};
+
+typedef struct _CSetFeed CSetFeed;
+
+// Most feeds that may be attached at once, across all sets.
+#define CSET_MAX_FEEDS 64
+
+// Attached feeds, and the sets they track.  Slots are claimed under the
+// lock but read without it by CSet_Notify(), which only compares set
+// pointers until it finds its own set.
+static pthread_mutex_t CSet_FeedLock = PTHREAD_MUTEX_INITIALIZER;
+static const CSet*     CSet_FeedSets[CSET_MAX_FEEDS];
+static CSetFeed*       CSet_Feeds[CSET_MAX_FEEDS];
+static uint32_t        CSet_FeedSlots;   // one past the highest slot used
+
+/**
+ * Records a change to *pSet in its change feed, if it has one.  When no
+ * feed is attached to any set this is a single load.
+ */
+static void CSet_Notify(const CSet* const pSet, CSetFeedOp Op, int32_t Value) {
+	uint32_t slots = __atomic_load_n(&CSet_FeedSlots, __ATOMIC_ACQUIRE);
+	uint32_t i = 0;
+	while (i < slots) {
+		if (__atomic_load_n(&CSet_FeedSets[i], __ATOMIC_ACQUIRE) == pSet) {
+			CSetFeed* pFeed = CSet_Feeds[i];
+			uint64_t head = pFeed->Head;
+			uint64_t tail = __atomic_load_n(&pFeed->Tail, __ATOMIC_ACQUIRE);
+			//A full ring drops the record; the gap is seen by the consumer
+			if (head - tail < pFeed->Size) {
+				CSetFeedRecord* pRec = &pFeed->Ring[head & (pFeed->Size - 1)];
+				pRec->Generation = pFeed->Generation;
+				pRec->Value = Value;
+				pRec->Op = Op;
+				__atomic_store_n(&pFeed->Head, head + 1, __ATOMIC_RELEASE);
+			}
+			//Published after Head, so a consumer that sees a generation
+			//also sees every record written before it
+			__atomic_store_n(&pFeed->Generation, pFeed->Generation + 1, __ATOMIC_RELEASE);
+			return;
+		}
+		i++;
+	}
+}
+
+/**
+ * Initializes a raw pFeed object with room for at least Size records.
+ *
+ * Pre:
+ *    pFeed points to a CSetFeed object
+ * Returns:
+ *    true if successful, false otherwise
+ *
+ * Complexity:  O( 1 )
+ */
+bool CSetFeed_Init(CSetFeed* const pFeed, uint32_t Size) {
+	uint32_t size = 16;
+	while (size < Size && size < (1u << 31)) {
+		size *= 2;
+	}
+	pFeed->Ring = (CSetFeedRecord*)malloc(size * sizeof(CSetFeedRecord));
+	if (pFeed->Ring == NULL) return false;
+	pFeed->Size = size;
+	pFeed->Head = 0;
+	pFeed->Tail = 0;
+	pFeed->Generation = 0;
+	pFeed->Expected = 0;
+	return true;
+}
+
+/**
+ * Releases the memory held by a pFeed object.
+ *
+ * Pre:
+ *    the feed is not attached
+ *
+ * Complexity:  O( 1 )
+ */
+void CSetFeed_Free(CSetFeed* const pFeed) {
+	free(pFeed->Ring);
+	pFeed->Ring = NULL;
+	pFeed->Size = 0;
+}
+
+/**
+ * Starts recording the changes made to *pSet in *pFeed.
+ *
+ * Pre:
+ *    *pSet is proper and has no feed attached
+ *    *pFeed is initialized and not attached
+ *    *pSet is not being changed while this runs
+ * Returns:
+ *    true if successful, false if CSET_MAX_FEEDS feeds are attached
+ *
+ * Complexity:  O( CSET_MAX_FEEDS )
+ */
+bool CSet_AttachFeed(const CSet* const pSet, CSetFeed* const pFeed) {
+	bool ok = false;
+	pthread_mutex_lock(&CSet_FeedLock);
+	uint32_t i = 0;
+	while (i < CSET_MAX_FEEDS) {
+		if (CSet_FeedSets[i] == NULL) {
+			CSet_Feeds[i] = pFeed;
+			__atomic_store_n(&CSet_FeedSets[i], pSet, __ATOMIC_RELEASE);
+			if (i >= CSet_FeedSlots) {
+				__atomic_store_n(&CSet_FeedSlots, i + 1, __ATOMIC_RELEASE);
+			}
+			ok = true;
+			break;
+		}
+		i++;
+	}
+	pthread_mutex_unlock(&CSet_FeedLock);
+	return ok;
+}
+
+/**
+ * Stops recording the changes made to *pSet.
+ *
+ * Pre:
+ *    *pSet is not being changed while this runs
+ * Returns:
+ *    true if a feed was detached, false if *pSet had none
+ *
+ * Complexity:  O( CSET_MAX_FEEDS )
+ */
+bool CSet_DetachFeed(const CSet* const pSet) {
+	bool ok = false;
+	pthread_mutex_lock(&CSet_FeedLock);
+	uint32_t i = 0;
+	while (i < CSet_FeedSlots) {
+		if (CSet_FeedSets[i] == pSet) {
+			__atomic_store_n(&CSet_FeedSets[i], NULL, __ATOMIC_RELEASE);
+			CSet_Feeds[i] = NULL;
+			ok = true;
+			break;
+		}
+		i++;
+	}
+	while (CSet_FeedSlots > 0 && CSet_FeedSets[CSet_FeedSlots - 1] == NULL) {
+		__atomic_store_n(&CSet_FeedSlots, CSet_FeedSlots - 1, __ATOMIC_RELEASE);
+	}
+	pthread_mutex_unlock(&CSet_FeedLock);
+	return ok;
+}
+
+/**
+ * Takes up to Max of the oldest unread records from a feed.  Only one
+ * thread may consume from a feed.
+ *
+ * Post:
+ *    Records[0 : r-1] are the records taken, oldest first, where r is the
+ *    return value
+ * Returns:
+ *    the number of records taken
+ *
+ * Complexity:  O( r )
+ */
+uint32_t CSetFeed_Poll(CSetFeed* const pFeed, CSetFeedRecord* Records, uint32_t Max) {
+	uint64_t tail = pFeed->Tail;
+	uint64_t head = __atomic_load_n(&pFeed->Head, __ATOMIC_ACQUIRE);
+	uint32_t n = (head - tail < Max) ? (uint32_t)(head - tail) : Max;
+	uint32_t i = 0;
+	while (i < n) {
+		Records[i] = pFeed->Ring[(tail + i) & (pFeed->Size - 1)];
+		i++;
+	}
+	__atomic_store_n(&pFeed->Tail, tail + n, __ATOMIC_RELEASE);
+	return n;
+}
+
+/**
+ * Drains a feed into a replica: the pending records are coalesced, so that
+ * only the last change to each value counts, and applied in one
+ * CSet_ApplyDelta().  Only one thread may consume from a feed.
+ *
+ * Pre:
+ *    *pReplica is proper, and matched the tracked set as of the first
+ *       pending record
+ *    pResync points to a bool
+ * Post:
+ *    If the records since the replica was last in step were all still
+ *       available, they have been applied and *pResync is false
+ *    Otherwise (records were dropped, or the set was replaced), the
+ *       records have been discarded, *pReplica is unchanged and *pResync
+ *       is true; the caller must copy the tracked set into the replica,
+ *       then call CSetFeed_Resynced(), while the set is not being changed
+ * Returns:
+ *    true if successful, false if memory could not be allocated, in which
+ *    case *pReplica may hold only some of the changes
+ *
+ * Complexity:  O( R + pReplica->Usage ), for R the number of records
+ */
+bool CSetFeed_Apply(CSetFeed* const pFeed, CSet* const pReplica, bool* pResync) {
+	*pResync = false;
+	uint64_t generation = __atomic_load_n(&pFeed->Generation, __ATOMIC_ACQUIRE);
+	uint64_t head = __atomic_load_n(&pFeed->Head, __ATOMIC_ACQUIRE);
+	uint32_t n = (uint32_t)(head - pFeed->Tail);
+	CSetFeedRecord* recs = (CSetFeedRecord*)malloc((n > 0 ? n : 1) * sizeof(CSetFeedRecord));
+	uint64_t* keys = (uint64_t*)malloc((n > 0 ? n : 1) * sizeof(uint64_t));
+	int32_t* ins = (int32_t*)malloc((n > 0 ? n : 1) * sizeof(int32_t));
+	int32_t* rem = (int32_t*)malloc((n > 0 ? n : 1) * sizeof(int32_t));
+	bool ok = (recs != NULL && keys != NULL && ins != NULL && rem != NULL);
+	if (ok) {
+		n = CSetFeed_Poll(pFeed, recs, n);
+		uint32_t i = 0;
+		while (i < n && !*pResync) {
+			*pResync = (recs[i].Generation != pFeed->Expected || recs[i].Op == CSETFEED_RESET);
+			pFeed->Expected = recs[i].Generation + 1;
+			//Key by value, then by position, so each value's last record
+			//sorts last among its own
+			keys[i] = ((uint64_t)((uint32_t)recs[i].Value ^ 0x80000000u) << 32) | i;
+			i++;
+		}
+		//Records dropped after the last one written leave no gap to see
+		*pResync = *pResync || pFeed->Expected < generation;
+		ok = *pResync || CSet_SortKeys(keys, n);
+	}
+	if (ok && !*pResync) {
+		uint32_t nIns = 0;
+		uint32_t nRem = 0;
+		uint32_t i = 0;
+		while (i < n) {
+			if (i + 1 == n || (keys[i] >> 32) != (keys[i + 1] >> 32)) {
+				const CSetFeedRecord* pRec = &recs[(uint32_t)keys[i]];
+				if (pRec->Op == CSETFEED_INSERT) {
+					ins[nIns++] = pRec->Value;
+				}
+				else {
+					rem[nRem++] = pRec->Value;
+				}
+			}
+			i++;
+		}
+		ok = CSet_ApplyDelta(pReplica, ins, nIns, rem, nRem, NULL, NULL);
+	}
+	free(recs);
+	free(keys);
+	free(ins);
+	free(rem);
+	return ok;
+}
+
+/**
+ * Tells a feed that its consumer has just copied the tracked set, so the
+ * records up to now are no longer needed.
+ *
+ * Pre:
+ *    the tracked set has not been changed since it was copied
+ *
+ * Complexity:  O( 1 )
+ */
+void CSetFeed_Resynced(CSetFeed* const pFeed) {
+	uint64_t head = __atomic_load_n(&pFeed->Head, __ATOMIC_ACQUIRE);
+	__atomic_store_n(&pFeed->Tail, head, __ATOMIC_RELEASE);
+	pFeed->Expected = pFeed->Generation;
+}
+
+
+// One published state of every set in a CSetStore.  Versions are never
+// changed once published; a commit publishes a new one, sharing the sets
+// it did not touch with the version before.
+struct _CSetVersion {
+
+	uint64_t Number;   // 1 for the initial version, then one per commit
+	CSet**   Sets;     // Sets[i] is set i as of this version
+};
+
+typedef struct _CSetVersion CSetVersion;
+
+// CSetStore holds Count sets that are updated together by transactions
+// (CSetTxn).  A transaction stages inserts, removes and moves against any
+// of the sets, and CSetTxn_Commit() makes all of them visible at once by
+// switching a single version pointer, so a reader sees either every change
+// of a transaction or none of them.
+//
+// Readers take no lock: CSetStore_ReadBegin() enters the current epoch and
+// picks up the current version, which stays valid until CSetStore_ReadEnd().
+// Commits are serialized by a mutex, and after publishing wait until no
+// reader can still hold the version they replaced before freeing it.
+//
+// A CSetStore is proper if Count > 0, Current points to a version whose
+// Count sets are proper, and Active[] counts the readers in each epoch.
+struct _CSetStore {
+
+	uint32_t        Count;
+	CSetVersion*    Current;
+	uint64_t        Epoch;      // parity selects the Active[] counter
+	uint32_t        Active[2];  // readers that entered in each parity of Epoch
+	pthread_mutex_t Lock;       // serializes commits
+};
+
+typedef struct _CSetStore CSetStore;
+
+// A reader's hold on one version of a CSetStore.
+struct _CSetReader {
+
+	const CSetVersion* Version;
+	uint64_t           Epoch;
+};
+
+typedef struct _CSetReader CSetReader;
+
+enum _CSetTxnOp { CSETTXN_INSERT, CSETTXN_REMOVE };
+
+typedef enum _CSetTxnOp CSetTxnOp;
+
+// One change staged in a transaction.
+struct _CSetTxnEntry {
+
+	uint32_t  Index;   // the set changed
+	int32_t   Value;
+	CSetTxnOp Op;
+	uint32_t  Order;   // position among the transaction's changes
+};
+
+// CSetTxn stages changes to the sets of a CSetStore.  Nothing is visible to
+// readers until CSetTxn_Commit(); changes are applied in the order staged,
+// so the last change to a given value in a given set wins.
+struct _CSetTxn {
+
+	CSetStore*            Store;
+	uint32_t              Capacity;
+	uint32_t              Usage;
+	struct _CSetTxnEntry* Entries;
+};
+
+typedef struct _CSetTxn CSetTxn;
+
+/**
+ * Releases a version and the sets in it for which Keep is NULL or holds a
+ * different set at the same index.
+ */
+static void CSetVersion_Free(CSetVersion* pVersion, const CSetVersion* Keep, uint32_t Count) {
+	uint32_t i = 0;
+	while (i < Count) {
+		if (Keep == NULL || Keep->Sets[i] != pVersion->Sets[i]) {
+			free(pVersion->Sets[i]->Data);
+			free(pVersion->Sets[i]);
+		}
+		i++;
+	}
+	free(pVersion->Sets);
+	free(pVersion);
+}
+
+/**
+ * Initializes a raw pStore object holding Count empty sets.
+ *
+ * Pre:
+ *    pStore points to a CSetStore object
+ *    Count > 0
+ * Post:
+ *    *pStore is proper, at version 1
+ * Returns:
+ *    true if successful, false otherwise
+ *
+ * Complexity:  O( Count )
+ */
+bool CSetStore_Init(CSetStore* const pStore, uint32_t Count) {
+	CSetVersion* pVersion = (CSetVersion*)malloc(sizeof(CSetVersion));
+	if (pVersion == NULL) return false;
+	pVersion->Number = 1;
+	pVersion->Sets = (CSet**)calloc(Count, sizeof(CSet*));
+	bool ok = (pVersion->Sets != NULL);
+	uint32_t i = 0;
+	while (ok && i < Count) {
+		pVersion->Sets[i] = (CSet*)malloc(sizeof(CSet));
+		ok = (pVersion->Sets[i] != NULL && CSet_Init(pVersion->Sets[i], 4));
+		if (!ok && pVersion->Sets[i] != NULL) {
+			free(pVersion->Sets[i]);
+		}
+		i++;
+	}
+	if (!ok) {
+		//Release the sets made so far
+		uint32_t j = 0;
+		while (pVersion->Sets != NULL && j + 1 < i) {
+			free(pVersion->Sets[j]->Data);
+			free(pVersion->Sets[j]);
+			j++;
+		}
+		free(pVersion->Sets);
+		free(pVersion);
+		return false;
+	}
+	if (pthread_mutex_init(&pStore->Lock, NULL) != 0) {
+		CSetVersion_Free(pVersion, NULL, Count);
+		return false;
+	}
+	pStore->Count = Count;
+	pStore->Current = pVersion;
+	pStore->Epoch = 0;
+	pStore->Active[0] = 0;
+	pStore->Active[1] = 0;
+	return true;
+}
+
+/**
+ * Releases the memory held by a pStore object.
+ *
+ * Pre:
+ *    *pStore is proper, with no readers and no commit in progress
+ *
+ * Complexity:  O( Count )
+ */
+void CSetStore_Free(CSetStore* const pStore) {
+	CSetVersion_Free(pStore->Current, NULL, pStore->Count);
+	pStore->Current = NULL;
+	pthread_mutex_destroy(&pStore->Lock);
+}
+
+/**
+ * Takes a hold on the current version of *pStore.  The hold must be
+ * released with CSetStore_ReadEnd(), and should be short: commits wait for
+ * older holds before completing.
+ *
+ * Pre:
+ *    *pStore is proper
+ *    pReader points to a CSetReader object
+ * Post:
+ *    *pReader holds the current version; the sets it sees do not change
+ *       until CSetStore_ReadEnd()
+ *
+ * Complexity:  O( 1 ) expected
+ */
+void CSetStore_ReadBegin(CSetStore* const pStore, CSetReader* const pReader) {
+	uint64_t epoch = __atomic_load_n(&pStore->Epoch, __ATOMIC_SEQ_CST);
+	while (true) {
+		__atomic_add_fetch(&pStore->Active[epoch & 1], 1, __ATOMIC_SEQ_CST);
+		//A commit that moved on meanwhile may not have seen this reader
+		uint64_t now = __atomic_load_n(&pStore->Epoch, __ATOMIC_SEQ_CST);
+		if (now == epoch) break;
+		__atomic_sub_fetch(&pStore->Active[epoch & 1], 1, __ATOMIC_SEQ_CST);
+		epoch = now;
+	}
+	pReader->Epoch = epoch;
+	pReader->Version = __atomic_load_n(&pStore->Current, __ATOMIC_ACQUIRE);
+}
+
+/**
+ * Returns set Index of the version held by *pReader.
+ *
+ * Pre:
+ *    *pReader holds a version, and Index < the store's Count
+ *
+ * Complexity:  O( 1 )
+ */
+const CSet* CSetStore_Get(const CSetReader* const pReader, uint32_t Index) {
+	return pReader->Version->Sets[Index];
+}
+
+/**
+ * Returns the number of the version held by *pReader.
+ *
+ * Complexity:  O( 1 )
+ */
+uint64_t CSetStore_Version(const CSetReader* const pReader) {
+	return pReader->Version->Number;
+}
+
+/**
+ * Releases the hold taken by CSetStore_ReadBegin().
+ *
+ * Post:
+ *    the sets obtained through *pReader must no longer be used
+ *
+ * Complexity:  O( 1 )
+ */
+void CSetStore_ReadEnd(CSetStore* const pStore, CSetReader* const pReader) {
+	__atomic_sub_fetch(&pStore->Active[pReader->Epoch & 1], 1, __ATOMIC_RELEASE);
+	pReader->Version = NULL;
+}
+
+/**
+ * Begins a transaction against *pStore.
+ *
+ * Pre:
+ *    *pStore is proper
+ *    pTxn points to a CSetTxn object
+ * Returns:
+ *    true if successful, false otherwise
+ *
+ * Complexity:  O( 1 )
+ */
+bool CSetTxn_Begin(CSetStore* const pStore, CSetTxn* const pTxn) {
+	pTxn->Entries = (struct _CSetTxnEntry*)malloc(16 * sizeof(struct _CSetTxnEntry));
+	if (pTxn->Entries == NULL) return false;
+	pTxn->Store = pStore;
+	pTxn->Capacity = 16;
+	pTxn->Usage = 0;
+	return true;
+}
+
+/**
+ * Stages one change, growing the entry list as needed.
+ */
+static bool CSetTxn_Stage(CSetTxn* const pTxn, uint32_t Index, int32_t Value, CSetTxnOp Op) {
+	if (pTxn->Usage == pTxn->Capacity) {
+		if (pTxn->Capacity > UINT32_MAX / 2) return false;
+		struct _CSetTxnEntry* entries = (struct _CSetTxnEntry*)realloc(pTxn->Entries,
+		        2 * (size_t)pTxn->Capacity * sizeof(struct _CSetTxnEntry));
+		if (entries == NULL) return false;
+		pTxn->Entries = entries;
+		pTxn->Capacity *= 2;
+	}
+	struct _CSetTxnEntry* pEntry = &pTxn->Entries[pTxn->Usage];
+	pEntry->Index = Index;
+	pEntry->Value = Value;
+	pEntry->Op = Op;
+	pEntry->Order = pTxn->Usage;
+	pTxn->Usage++;
+	return true;
+}
+
+/**
+ * Stages the insertion of Value into set Index.
+ *
+ * Pre:
+ *    *pTxn has begun, and Index < the store's Count
+ * Returns:
+ *    true if successful, false if memory could not be allocated, in which
+ *    case nothing was staged
+ *
+ * Complexity:  O( 1 ) amortized
+ */
+bool CSetTxn_Insert(CSetTxn* const pTxn, uint32_t Index, int32_t Value) {
+	return CSetTxn_Stage(pTxn, Index, Value, CSETTXN_INSERT);
+}
+
+/**
+ * Stages the removal of Value from set Index.
+ *
+ * Pre:
+ *    *pTxn has begun, and Index < the store's Count
+ * Returns:
+ *    true if successful, false if memory could not be allocated, in which
+ *    case nothing was staged
+ *
+ * Complexity:  O( 1 ) amortized
+ */
+bool CSetTxn_Remove(CSetTxn* const pTxn, uint32_t Index, int32_t Value) {
+	return CSetTxn_Stage(pTxn, Index, Value, CSETTXN_REMOVE);
+}
+
+/**
+ * Stages moving Value from set From to set To.  Once committed, readers see
+ * Value in To and not in From; never in both or in neither.
+ *
+ * Pre:
+ *    *pTxn has begun, and From, To < the store's Count
+ * Returns:
+ *    true if successful, false if memory could not be allocated, in which
+ *    case nothing was staged
+ *
+ * Complexity:  O( 1 ) amortized
+ */
+bool CSetTxn_Move(CSetTxn* const pTxn, uint32_t From, uint32_t To, int32_t Value) {
+	uint32_t usage = pTxn->Usage;
+	if (!CSetTxn_Stage(pTxn, From, Value, CSETTXN_REMOVE)) return false;
+	if (!CSetTxn_Stage(pTxn, To, Value, CSETTXN_INSERT)) {
+		pTxn->Usage = usage;
+		return false;
+	}
+	return true;
+}
+
+/**
+ * Discards a transaction without applying any of its changes.
+ *
+ * Complexity:  O( 1 )
+ */
+void CSetTxn_Abort(CSetTxn* const pTxn) {
+	free(pTxn->Entries);
+	pTxn->Entries = NULL;
+	pTxn->Capacity = 0;
+	pTxn->Usage = 0;
+}
+
+/**
+ * Orders staged changes by set, then value, then the order staged.
+ */
+static int CSetTxn_CompareEntries(const void* pX, const void* pY) {
+	const struct _CSetTxnEntry* x = (const struct _CSetTxnEntry*)pX;
+	const struct _CSetTxnEntry* y = (const struct _CSetTxnEntry*)pY;
+	if (x->Index != y->Index) return (x->Index > y->Index) - (x->Index < y->Index);
+	if (x->Value != y->Value) return (x->Value > y->Value) - (x->Value < y->Value);
+	return (x->Order > y->Order) - (x->Order < y->Order);
+}
+
+/**
+ * Waits until no reader can hold a version older than the current one.
+ * Called with the store's lock held, after publishing a new version.
+ */
+static void CSetStore_Synchronize(CSetStore* const pStore) {
+	uint64_t epoch = __atomic_load_n(&pStore->Epoch, __ATOMIC_SEQ_CST);
+	__atomic_store_n(&pStore->Epoch, epoch + 1, __ATOMIC_SEQ_CST);
+	//Readers that entered the old epoch may hold the old version; readers
+	//entering the new one pick up the new version
+	while (__atomic_load_n(&pStore->Active[epoch & 1], __ATOMIC_SEQ_CST) != 0) {
+		sched_yield();
+	}
+}
+
+/**
+ * Applies every change staged in *pTxn to its store as one atomic step and
+ * ends the transaction.
+ *
+ * Pre:
+ *    *pTxn has begun
+ *    the calling thread holds no CSetReader on the store
+ * Post:
+ *    If successful, a new version holding the sets with every staged change
+ *       applied, in the order staged, has been published
+ *    Otherwise the store is unchanged
+ *    In either case the transaction has ended
+ * Returns:
+ *    true if successful, false if memory could not be allocated
+ *
+ * Complexity:  O( M log M + S ), for M staged changes and S the total
+ *    Usage of the sets they touch, plus the wait for current readers
+ */
+bool CSetTxn_Commit(CSetTxn* const pTxn) {
+	CSetStore* pStore = pTxn->Store;
+	uint32_t m = pTxn->Usage;
+	struct _CSetTxnEntry* entries = pTxn->Entries;
+	qsort(entries, m, sizeof(struct _CSetTxnEntry), CSetTxn_CompareEntries);
+	int32_t* ins = (int32_t*)malloc((m > 0 ? m : 1) * sizeof(int32_t));
+	int32_t* rem = (int32_t*)malloc((m > 0 ? m : 1) * sizeof(int32_t));
+	bool ok = (ins != NULL && rem != NULL);
+
+	pthread_mutex_lock(&pStore->Lock);
+	CSetVersion* pOld = pStore->Current;
+	CSetVersion* pNew = ok ? (CSetVersion*)malloc(sizeof(CSetVersion)) : NULL;
+	ok = (pNew != NULL);
+	if (ok) {
+		pNew->Sets = (CSet**)malloc(pStore->Count * sizeof(CSet*));
+		ok = (pNew->Sets != NULL);
+		if (!ok) free(pNew);
+	}
+	if (ok) {
+		pNew->Number = pOld->Number + 1;
+		memcpy(pNew->Sets, pOld->Sets, pStore->Count * sizeof(CSet*));
+		//Build a fresh copy of each set touched, applying its last change
+		//per value
+		uint32_t i = 0;
+		while (ok && i < m) {
+			uint32_t index = entries[i].Index;
+			uint32_t nIns = 0;
+			uint32_t nRem = 0;
+			while (i < m && entries[i].Index == index) {
+				if (i + 1 == m || entries[i + 1].Index != index || entries[i + 1].Value != entries[i].Value) {
+					if (entries[i].Op == CSETTXN_INSERT) {
+						ins[nIns++] = entries[i].Value;
+					}
+					else {
+						rem[nRem++] = entries[i].Value;
+					}
+				}
+				i++;
+			}
+			const CSet* pFrom = pOld->Sets[index];
+			CSet* pSet = (CSet*)malloc(sizeof(CSet));
+			ok = (pSet != NULL && CSet_Init(pSet, pFrom->Usage + nIns + 1));
+			if (ok) {
+				if (pFrom->Usage > 0) {
+					memcpy(pSet->Data, pFrom->Data, pFrom->Usage * sizeof(int32_t));
+				}
+				pSet->Usage = pFrom->Usage;
+				ok = CSet_ApplyDelta(pSet, ins, nIns, rem, nRem, NULL, NULL);
+				if (!ok) free(pSet->Data);
+			}
+			if (ok) {
+				pNew->Sets[index] = pSet;
+			}
+			else {
+				free(pSet);
+			}
+		}
+		if (ok) {
+			__atomic_store_n(&pStore->Current, pNew, __ATOMIC_RELEASE);
+			CSetStore_Synchronize(pStore);
+			CSetVersion_Free(pOld, pNew, pStore->Count);
+		}
+		else {
+			CSetVersion_Free(pNew, pOld, pStore->Count);
+		}
+	}
+	pthread_mutex_unlock(&pStore->Lock);
+
+	free(ins);
+	free(rem);
+	CSetTxn_Abort(pTxn);
+	return ok;
+}
+
+// CSeqSet is a CSet shared between exactly one writer thread and any
+// number of reader threads, guarded by a sequence lock.  The writer changes
+// Set in place, making Seq odd while it does; readers take no lock, and
+// retry if Seq was odd or changed while they read.
+//
+// Readers may see elements mid-shift, so every read they make is bounded
+// by a capacity known to be valid for the buffer it reads: a torn read can
+// give a wrong answer, which the sequence check discards, but never an
+// access out of bounds.  When the set grows, the new buffer is published
+// and the old one is kept on Retired until CSeqSet_Free(), since readers
+// may still be scanning it and take no hold the writer could wait on.
+// Capacity doubles on growth, so the retired buffers together are smaller
+// than the current one: a CSeqSet holds less than twice the memory of a
+// CSet of the same capacity.
+//
+// A CSeqSet is proper if Set is proper, Seq is even whenever no writer call
+// is running, and Retired[0 : nRetired-1] are buffers Set no longer uses.
+struct _CSeqSet {
+
+	CSet      Set;
+	uint32_t  Seq;
+	int32_t** Retired;
+	uint32_t  nRetired;
+	uint32_t  RetiredCap;
+};
+
+typedef struct _CSeqSet CSeqSet;
+
+/**
+ * Initializes a raw pSeq object, with room for Sz - 1 values before it
+ * first grows.
+ *
+ * Pre:
+ *    pSeq points to a CSeqSet object
+ * Post:
+ *    *pSeq is proper and empty
+ * Returns:
+ *    true if successful, false otherwise
+ *
+ * Complexity:  O( Sz )
+ */
+bool CSeqSet_Init(CSeqSet* const pSeq, uint32_t Sz) {
+	if (!CSet_Init(&pSeq->Set, Sz < 2 ? 2 : Sz)) return false;
+	pSeq->Seq = 0;
+	pSeq->Retired = NULL;
+	pSeq->nRetired = 0;
+	pSeq->RetiredCap = 0;
+	return true;
+}
+
+/**
+ * Releases the memory held by a pSeq object.
+ *
+ * Pre:
+ *    no reader or writer is using *pSeq
+ *
+ * Complexity:  O( nRetired )
+ */
+void CSeqSet_Free(CSeqSet* const pSeq) {
+	uint32_t i = 0;
+	while (i < pSeq->nRetired) {
+		free(pSeq->Retired[i]);
+		i++;
+	}
+	pSeq->nRetired = 0;
+	free(pSeq->Retired);
+	pSeq->Retired = NULL;
+	pSeq->RetiredCap = 0;
+	free(pSeq->Set.Data);
+	pSeq->Set.Data = NULL;
+	pSeq->Set.Capacity = 0;
+	pSeq->Set.Usage = 0;
+}
+
+/**
+ * Opens and closes a writer's critical section.
+ */
+static void CSeqSet_WriteBegin(CSeqSet* const pSeq) {
+	__atomic_store_n(&pSeq->Seq, pSeq->Seq + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+static void CSeqSet_WriteEnd(CSeqSet* const pSeq) {
+	__atomic_store_n(&pSeq->Seq, pSeq->Seq + 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * Inserts Value into a pSeq object.  Only the writer thread may call this.
+ *
+ * Pre:
+ *    *pSeq is proper
+ * Post:
+ *    If Value was not a member, it is now, and readers see it once this
+ *       returns; growth, if needed, retires the old buffer
+ *    *pSeq is proper
+ * Returns:
+ *    true if Value was inserted, false if it was already a member or memory
+ *    could not be allocated
+ *
+ * Complexity:  O( pSeq->Set.Usage )
+ */
+bool CSeqSet_Insert(CSeqSet* const pSeq, int32_t Value) {
+	CSet* pSet = &pSeq->Set;
+	uint32_t i = CSet_LowerBound(pSet->Data, 0, pSet->Usage, Value);
+	if (i < pSet->Usage && pSet->Data[i] == Value) return false;
+
+	if (pSet->Usage + 1 < pSet->Capacity) {
+		CSeqSet_WriteBegin(pSeq);
+		uint32_t j = pSet->Usage;
+		while (j > i) {
+			__atomic_store_n(&pSet->Data[j], pSet->Data[j - 1], __ATOMIC_RELAXED);
+			j--;
+		}
+		__atomic_store_n(&pSet->Data[i], Value, __ATOMIC_RELAXED);
+		__atomic_store_n(&pSet->Usage, pSet->Usage + 1, __ATOMIC_RELAXED);
+		CSeqSet_WriteEnd(pSeq);
+		return true;
+	}
+
+	//Build the grown buffer privately, then publish it
+	if (pSeq->nRetired == pSeq->RetiredCap) {
+		uint32_t cap = pSeq->RetiredCap == 0 ? 4 : 2 * pSeq->RetiredCap;
+		int32_t** retired = (int32_t**)realloc(pSeq->Retired, cap * sizeof(int32_t*));
+		if (retired == NULL) return false;
+		pSeq->Retired = retired;
+		pSeq->RetiredCap = cap;
+	}
+	if (pSet->Capacity > UINT32_MAX / 2) return false;
+	uint32_t capacity = 2 * pSet->Capacity;
+	int32_t* data = (int32_t*)malloc(capacity * sizeof(int32_t));
+	if (data == NULL) return false;
+	memcpy(data, pSet->Data, i * sizeof(int32_t));
+	data[i] = Value;
+	memcpy(data + i + 1, pSet->Data + i, (pSet->Usage - i) * sizeof(int32_t));
+	uint32_t j = pSet->Usage + 1;
+	while (j < capacity) {
+		data[j] = FILLER;
+		j++;
+	}
+	pSeq->Retired[pSeq->nRetired++] = pSet->Data;
+	CSeqSet_WriteBegin(pSeq);
+	//Data before Capacity: a reader that sees the larger capacity also
+	//sees the buffer it belongs to
+	__atomic_store_n(&pSet->Data, data, __ATOMIC_RELEASE);
+	__atomic_store_n(&pSet->Capacity, capacity, __ATOMIC_RELEASE);
+	__atomic_store_n(&pSet->Usage, pSet->Usage + 1, __ATOMIC_RELAXED);
+	CSeqSet_WriteEnd(pSeq);
+	return true;
+}
+
+/**
+ * Removes Value from a pSeq object.  Only the writer thread may call this.
+ *
+ * Pre:
+ *    *pSeq is proper
+ * Post:
+ *    Value is not a member, and readers see that once this returns
+ *    pSeq->Set.Capacity is unchanged
+ *    *pSeq is proper
+ * Returns:
+ *    true if Value was removed, false otherwise
+ *
+ * Complexity:  O( pSeq->Set.Usage )
+ */
+bool CSeqSet_Remove(CSeqSet* const pSeq, int32_t Value) {
+	CSet* pSet = &pSeq->Set;
+	uint32_t i = CSet_LowerBound(pSet->Data, 0, pSet->Usage, Value);
+	if (i == pSet->Usage || pSet->Data[i] != Value) return false;
+	CSeqSet_WriteBegin(pSeq);
+	while (i + 1 < pSet->Usage) {
+		__atomic_store_n(&pSet->Data[i], pSet->Data[i + 1], __ATOMIC_RELAXED);
+		i++;
+	}
+	__atomic_store_n(&pSet->Data[i], FILLER, __ATOMIC_RELAXED);
+	__atomic_store_n(&pSet->Usage, pSet->Usage - 1, __ATOMIC_RELAXED);
+	CSeqSet_WriteEnd(pSeq);
+	return true;
+}
+
+/**
+ * Starts a read, waiting out any write in progress, and returns the
+ * sequence number to validate against.  *pData and *pUsage receive the
+ * buffer and a number of readable cells that is in bounds for it.
+ */
+static uint32_t CSeqSet_ReadBegin(const CSeqSet* const pSeq, const int32_t** pData, uint32_t* pUsage) {
+	uint32_t seq = __atomic_load_n(&pSeq->Seq, __ATOMIC_ACQUIRE);
+	while (seq & 1) {
+		sched_yield();
+		seq = __atomic_load_n(&pSeq->Seq, __ATOMIC_ACQUIRE);
+	}
+	uint32_t capacity = __atomic_load_n(&pSeq->Set.Capacity, __ATOMIC_ACQUIRE);
+	*pData = __atomic_load_n(&pSeq->Set.Data, __ATOMIC_ACQUIRE);
+	uint32_t usage = __atomic_load_n(&pSeq->Set.Usage, __ATOMIC_RELAXED);
+	*pUsage = (usage < capacity) ? usage : capacity;
+	return seq;
+}
+
+/**
+ * Returns true if nothing was written since ReadBegin() returned Seq.
+ */
+static bool CSeqSet_ReadValid(const CSeqSet* const pSeq, uint32_t Seq) {
+	__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	return __atomic_load_n(&pSeq->Seq, __ATOMIC_RELAXED) == Seq;
+}
+
+/**
+ * Determines if Value belongs to a pSeq object.  Any thread may call this,
+ * concurrently with the writer.
+ *
+ * Pre:
+ *    *pSeq is proper
+ * Returns:
+ *    true if Value was a member at some moment during the call, false
+ *    otherwise
+ *
+ * Complexity:  O( log pSeq->Set.Usage ) per attempt
+ */
+bool CSeqSet_Contains(const CSeqSet* const pSeq, int32_t Value) {
+	while (true) {
+		const int32_t* data;
+		uint32_t usage;
+		uint32_t seq = CSeqSet_ReadBegin(pSeq, &data, &usage);
+		//Bounds come from usage alone, so torn values cannot lead out of range
+		uint32_t lo = 0;
+		uint32_t hi = usage;
+		while (lo < hi) {
+			uint32_t mid = lo + (hi - lo) / 2;
+			if (__atomic_load_n(&data[mid], __ATOMIC_RELAXED) < Value) {
+				lo = mid + 1;
+			}
+			else {
+				hi = mid;
+			}
+		}
+		bool found = (lo < usage && __atomic_load_n(&data[lo], __ATOMIC_RELAXED) == Value);
+		if (CSeqSet_ReadValid(pSeq, seq)) return found;
+	}
+}
+
+/**
+ * Copies the members of a pSeq object in [Lo, Hi] to Values, up to Max of
+ * them.  Any thread may call this, concurrently with the writer; it is
+ * meant for small scans, since a write during the scan restarts it.
+ *
+ * Pre:
+ *    *pSeq is proper
+ *    Values has room for Max values
+ * Post:
+ *    Values[0 : r-1] are the smallest r members in [Lo, Hi] as of one
+ *       moment during the call, in ascending order, where r is the return
+ *       value
+ * Returns:
+ *    the number of values copied
+ *
+ * Complexity:  O( log pSeq->Set.Usage + Max ) per attempt
+ */
+uint32_t CSeqSet_Range(const CSeqSet* const pSeq, int32_t Lo, int32_t Hi, int32_t* Values, uint32_t Max) {
+	while (true) {
+		const int32_t* data;
+		uint32_t usage;
+		uint32_t seq = CSeqSet_ReadBegin(pSeq, &data, &usage);
+		uint32_t lo = 0;
+		uint32_t hi = usage;
+		while (lo < hi) {
+			uint32_t mid = lo + (hi - lo) / 2;
+			if (__atomic_load_n(&data[mid], __ATOMIC_RELAXED) < Lo) {
+				lo = mid + 1;
+			}
+			else {
+				hi = mid;
+			}
+		}
+		uint32_t n = 0;
+		while (n < Max && lo < usage) {
+			int32_t value = __atomic_load_n(&data[lo], __ATOMIC_RELAXED);
+			if (value > Hi) break;
+			Values[n++] = value;
+			lo++;
+		}
+		if (CSeqSet_ReadValid(pSeq, seq)) return n;
+	}
+}
+
+// Most levels in a CSkipSet; each level holds about a quarter of the
+// nodes of the one below it.
+#define CSKIP_LEVELS 16
+
+// Bytes carved at a time from the allocator for skip list nodes.
+#define CSKIP_CHUNK (1u << 16)
+
+// A skip list node.  Next[] holds one link per level the node is on; the
+// low bit of a link marks the node as logically removed from that level.
+// A node takes 8 bytes plus 8 per level, and nodes are carved from large
+// chunks in allocation order, so most nodes are small and packed densely.
+struct _CSkipNode {
+
+	int32_t   Value;
+	uint32_t  Height;
+	uintptr_t Next[];
+};
+
+// A block of memory that nodes are carved from.
+struct _CSkipChunk {
+
+	struct _CSkipChunk* Next;
+	size_t              Used;
+	size_t              Size;
+	unsigned char       Bytes[];
+};
+
+// CSkipSet is a lock-free set of int32_t values, for workloads in which many
+// threads insert, remove and look up at once.  It is a skip list in the
+// style of Harris and Fraser: a node is removed by first marking its links,
+// top level down, then unlinking it with compare-and-swap; any thread that
+// meets a marked node helps unlink it.
+//
+// Removed nodes are never freed while the set is in use, so a thread can
+// never follow a link into released memory; their memory is returned by
+// CSkipSet_Free().  Memory therefore grows with the number of successful
+// inserts over the life of the set, not with the number of members: about
+// 19 bytes per insert on average, so 100 million inserts hold roughly 2 GB
+// however many values were removed again.  A set with heavy churn should
+// be rebuilt from a CSkipSet_Snapshot() at a quiet moment.
+// CSkipSet_Snapshot() also copies the members into a CSet for the
+// merge-based operations.
+//
+// A CSkipSet is proper if Head is a node of CSKIP_LEVELS levels whose
+// level-0 chain, skipping marked nodes, is in strictly ascending order.
+struct _CSkipSet {
+
+	struct _CSkipNode*  Head;
+	struct _CSkipChunk* Chunks;
+	uint64_t            Seed;    // advanced by each insert to pick heights
+};
+
+typedef struct _CSkipSet CSkipSet;
+
+#define CSKIP_MARKED(link) ((link) & 1)
+#define CSKIP_NODE(link)   ((struct _CSkipNode*)((link) & ~(uintptr_t)1))
+
+/**
+ * Initializes a raw pSkip object to the empty set.
+ *
+ * Pre:
+ *    pSkip points to a CSkipSet object
+ * Post:
+ *    *pSkip is proper and empty
+ * Returns:
+ *    true if successful, false otherwise
+ *
+ * Complexity:  O( 1 )
+ */
+bool CSkipSet_Init(CSkipSet* const pSkip) {
+	pSkip->Head = (struct _CSkipNode*)calloc(1, sizeof(struct _CSkipNode) + CSKIP_LEVELS * sizeof(uintptr_t));
+	if (pSkip->Head == NULL) return false;
+	pSkip->Head->Value = FILLER;
+	pSkip->Head->Height = CSKIP_LEVELS;
+	pSkip->Chunks = NULL;
+	pSkip->Seed = (uint64_t)(uintptr_t)pSkip;
+	return true;
+}
+
+/**
+ * Releases the memory held by a pSkip object, including removed nodes.
+ *
+ * Pre:
+ *    no other thread is using *pSkip
+ *
+ * Complexity:  O( number of chunks )
+ */
+void CSkipSet_Free(CSkipSet* const pSkip) {
+	struct _CSkipChunk* pChunk = pSkip->Chunks;
+	while (pChunk != NULL) {
+		struct _CSkipChunk* pNext = pChunk->Next;
+		free(pChunk);
+		pChunk = pNext;
+	}
+	pSkip->Chunks = NULL;
+	free(pSkip->Head);
+	pSkip->Head = NULL;
+}
+
+/**
+ * Carves Bytes (a multiple of 8) from the current chunk, starting a new one
+ * when it is full.  Lock-free: a thread that loses the race to install a
+ * new chunk releases its own and retries.
+ */
+static void* CSkipSet_Alloc(CSkipSet* const pSkip, size_t Bytes) {
+	while (true) {
+		struct _CSkipChunk* pChunk = __atomic_load_n(&pSkip->Chunks, __ATOMIC_ACQUIRE);
+		if (pChunk != NULL) {
+			size_t at = __atomic_fetch_add(&pChunk->Used, Bytes, __ATOMIC_RELAXED);
+			if (at + Bytes <= pChunk->Size) return pChunk->Bytes + at;
+		}
+		struct _CSkipChunk* pNew = (struct _CSkipChunk*)malloc(sizeof(struct _CSkipChunk) + CSKIP_CHUNK);
+		if (pNew == NULL) return NULL;
+		pNew->Next = pChunk;
+		pNew->Used = Bytes;
+		pNew->Size = CSKIP_CHUNK;
+		if (__atomic_compare_exchange_n(&pSkip->Chunks, &pChunk, pNew, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+			return pNew->Bytes;
+		}
+		free(pNew);
+	}
+}
+
+/**
+ * Locates Value, unlinking any marked nodes met on the way.  Preds[l] is
+ * the last node before Value on level l and Succs[l] the node after it.
+ * Returns true if Succs[0] holds Value.
+ */
+static bool CSkipSet_Find(CSkipSet* const pSkip, int32_t Value, struct _CSkipNode** Preds,
+                          struct _CSkipNode** Succs) {
+	bool restart = true;
+	while (restart) {
+		restart = false;
+		struct _CSkipNode* pPred = pSkip->Head;
+		int level = CSKIP_LEVELS - 1;
+		while (!restart && level >= 0) {
+			struct _CSkipNode* pCurr = CSKIP_NODE(__atomic_load_n(&pPred->Next[level], __ATOMIC_ACQUIRE));
+			while (pCurr != NULL) {
+				uintptr_t succ = __atomic_load_n(&pCurr->Next[level], __ATOMIC_ACQUIRE);
+				if (CSKIP_MARKED(succ)) {
+					//Help unlink pCurr; start over if pPred changed meanwhile
+					uintptr_t expected = (uintptr_t)pCurr;
+					if (!__atomic_compare_exchange_n(&pPred->Next[level], &expected, succ & ~(uintptr_t)1,
+					                                 false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+						restart = true;
+						break;
+					}
+					pCurr = CSKIP_NODE(succ);
+				}
+				else if (pCurr->Value < Value) {
+					pPred = pCurr;
+					pCurr = CSKIP_NODE(succ);
+				}
+				else {
+					break;
+				}
+			}
+			Preds[level] = pPred;
+			Succs[level] = pCurr;
+			level--;
+		}
+	}
+	return Succs[0] != NULL && Succs[0]->Value == Value;
+}
+
+/**
+ * Inserts Value into a pSkip object.  Safe to call from any number of
+ * threads at once.
+ *
+ * Pre:
+ *    *pSkip is proper
+ * Post:
+ *    Value is a member of *pSkip, unless allocation failed
+ *    *pSkip is proper
+ * Returns:
+ *    true if Value was inserted, false if it was already a member or memory
+ *    could not be allocated
+ *
+ * Complexity:  O( log N ) expected, for N members
+ */
+bool CSkipSet_Insert(CSkipSet* const pSkip, int32_t Value) {
+	struct _CSkipNode* preds[CSKIP_LEVELS];
+	struct _CSkipNode* succs[CSKIP_LEVELS];
+	//Each level above the first is kept with probability 1/4
+	uint64_t seed = __atomic_add_fetch(&pSkip->Seed, 0x9E3779B97F4A7C15ull, __ATOMIC_RELAXED);
+	uint64_t bits = CSet_Random(&seed);
+	uint32_t height = 1;
+	while (height < CSKIP_LEVELS && (bits & 3) == 0) {
+		height++;
+		bits >>= 2;
+	}
+	struct _CSkipNode* pNode = NULL;
+	while (true) {
+		if (CSkipSet_Find(pSkip, Value, preds, succs)) return false;
+		if (pNode == NULL) {
+			pNode = (struct _CSkipNode*)CSkipSet_Alloc(pSkip, sizeof(struct _CSkipNode) + height * sizeof(uintptr_t));
+			if (pNode == NULL) return false;
+			pNode->Value = Value;
+			pNode->Height = height;
+		}
+		uint32_t level = 0;
+		while (level < height) {
+			__atomic_store_n(&pNode->Next[level], (uintptr_t)succs[level], __ATOMIC_RELAXED);
+			level++;
+		}
+		//Linking level 0 is what makes Value a member
+		uintptr_t expected = (uintptr_t)succs[0];
+		if (__atomic_compare_exchange_n(&preds[0]->Next[0], &expected, (uintptr_t)pNode,
+		                                false, __ATOMIC_RELEASE, __ATOMIC_RELAXED)) {
+			break;
+		}
+	}
+	//The upper levels only speed up searches, so give up on them if the
+	//node is removed meanwhile
+	uint32_t level = 1;
+	while (level < height) {
+		while (true) {
+			uintptr_t link = __atomic_load_n(&pNode->Next[level], __ATOMIC_ACQUIRE);
+			if (CSKIP_MARKED(link)) return true;
+			if (CSKIP_NODE(link) != succs[level] &&
+			    !__atomic_compare_exchange_n(&pNode->Next[level], &link, (uintptr_t)succs[level],
+			                                 false, __ATOMIC_RELEASE, __ATOMIC_RELAXED)) {
+				return true;
+			}
+			uintptr_t expected = (uintptr_t)succs[level];
+			if (__atomic_compare_exchange_n(&preds[level]->Next[level], &expected, (uintptr_t)pNode,
+			                                false, __ATOMIC_RELEASE, __ATOMIC_RELAXED)) {
+				break;
+			}
+			if (!CSkipSet_Find(pSkip, Value, preds, succs) || succs[0] != pNode) return true;
+		}
+		level++;
+	}
+	return true;
+}
+
+/**
+ * Removes Value from a pSkip object.  Safe to call from any number of
+ * threads at once.
+ *
+ * Pre:
+ *    *pSkip is proper
+ * Post:
+ *    Value is not a member of *pSkip
+ *    *pSkip is proper
+ * Returns:
+ *    true if this call removed Value, false otherwise
+ *
+ * Complexity:  O( log N ) expected, for N members
+ */
+bool CSkipSet_Remove(CSkipSet* const pSkip, int32_t Value) {
+	struct _CSkipNode* preds[CSKIP_LEVELS];
+	struct _CSkipNode* succs[CSKIP_LEVELS];
+	if (!CSkipSet_Find(pSkip, Value, preds, succs)) return false;
+	struct _CSkipNode* pNode = succs[0];
+	//Mark the upper levels first, so the node stops being found from above
+	int level = (int)pNode->Height - 1;
+	while (level >= 1) {
+		uintptr_t link = __atomic_load_n(&pNode->Next[level], __ATOMIC_ACQUIRE);
+		while (!CSKIP_MARKED(link) &&
+		       !__atomic_compare_exchange_n(&pNode->Next[level], &link, link | 1,
+		                                    false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+		}
+		level--;
+	}
+	//Whoever marks level 0 is the one that removed Value
+	uintptr_t link = __atomic_load_n(&pNode->Next[0], __ATOMIC_ACQUIRE);
+	while (true) {
+		if (CSKIP_MARKED(link)) return false;
+		if (__atomic_compare_exchange_n(&pNode->Next[0], &link, link | 1,
+		                                false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+			CSkipSet_Find(pSkip, Value, preds, succs);
+			return true;
+		}
+	}
+}
+
+/**
+ * Determines if Value belongs to a pSkip object.  Wait-free apart from
+ * the length of the search, and never writes to the list.
+ *
+ * Pre:
+ *    *pSkip is proper
+ * Returns:
+ *    true if Value is a member, false otherwise
+ *
+ * Complexity:  O( log N ) expected, for N members
+ */
+bool CSkipSet_Contains(const CSkipSet* const pSkip, int32_t Value) {
+	const struct _CSkipNode* pPred = pSkip->Head;
+	const struct _CSkipNode* pCurr = NULL;
+	int level = CSKIP_LEVELS - 1;
+	while (level >= 0) {
+		pCurr = CSKIP_NODE(__atomic_load_n(&pPred->Next[level], __ATOMIC_ACQUIRE));
+		while (pCurr != NULL) {
+			uintptr_t succ = __atomic_load_n(&pCurr->Next[level], __ATOMIC_ACQUIRE);
+			if (!CSKIP_MARKED(succ) && pCurr->Value >= Value) break;
+			if (!CSKIP_MARKED(succ)) pPred = pCurr;
+			pCurr = CSKIP_NODE(succ);
+		}
+		level--;
+	}
+	return pCurr != NULL && pCurr->Value == Value;
+}
+
+/**
+ * Copies the members of a pSkip object into *pSet.  Safe to call while
+ * other threads change *pSkip: values that are members throughout the call
+ * are copied, values that are members at no point are not, and values
+ * inserted or removed meanwhile may go either way.
+ *
+ * Pre:
+ *    *pSkip is proper
+ *    *pSet is proper
+ * Post:
+ *    If successful, *pSet holds the members copied and is proper
+ *    Otherwise *pSet is unchanged
+ * Returns:
+ *    true if successful, false otherwise
+ *
+ * Complexity:  O( N ), for N members
+ */
+bool CSkipSet_Snapshot(const CSkipSet* const pSkip, CSet* const pSet) {
+	uint32_t capacity = 16;
+	uint32_t usage = 0;
+	int32_t* data = (int32_t*)malloc(capacity * sizeof(int32_t));
+	if (data == NULL) return false;
+	const struct _CSkipNode* pNode = CSKIP_NODE(__atomic_load_n(&pSkip->Head->Next[0], __ATOMIC_ACQUIRE));
+	while (pNode != NULL) {
+		uintptr_t succ = __atomic_load_n(&pNode->Next[0], __ATOMIC_ACQUIRE);
+		if (!CSKIP_MARKED(succ)) {
+			//Leave room for the FILLER cell a proper set needs
+			if (usage + 1 == capacity) {
+				int32_t* grown = (capacity <= UINT32_MAX / 2) ?
+				                 (int32_t*)realloc(data, 2 * (size_t)capacity * sizeof(int32_t)) : NULL;
+				if (grown == NULL) {
+					free(data);
+					return false;
+				}
+				data = grown;
+				capacity *= 2;
+			}
+			data[usage++] = pNode->Value;
+		}
+		pNode = CSKIP_NODE(succ);
+	}
+	CSet_Install(pSet, data, usage, capacity);
+	return true;
+}
+
+// Operations a CSetEngine can run.
+enum _CSetAsyncOp {
+
+	CSETASYNC_INTERSECTION,    // CSet_Intersection(Result, A, B)
+	CSETASYNC_SYMDIFFERENCE,   // CSet_SymDifference(Result, A, B)
+	CSETASYNC_CONTAINS,        // Found[i] = CSet_Contains(A, Values[i])
+	CSETASYNC_COPY             // CSet_Copy(Result, A)
+};
+
+typedef enum _CSetAsyncOp CSetAsyncOp;
+
+// A request to a CSetEngine.  The caller owns it, fills in Op and the
+// operands the operation uses, and must leave it, its operands and its
+// destination alone from submission until the engine hands it back.
+struct _CSetRequest {
+
+	CSetAsyncOp          Op;
+	CSet*                Result;   // destination, unless Op is CONTAINS
+	const CSet*          A;
+	const CSet*          B;        // for INTERSECTION and SYMDIFFERENCE
+	const int32_t*       Values;   // for CONTAINS
+	uint32_t             nValues;
+	bool*                Found;    // for CONTAINS; room for nValues
+	void*                Tag;      // for the caller; never touched
+	bool                 Ok;       // the operation's result, once complete
+	struct _CSetRequest* Next;     // used by the engine
+};
+
+typedef struct _CSetRequest CSetRequest;
+
+// Work, in elements touched, that a worker takes at once when requests
+// are small, and the most requests it takes at once.
+#define CSET_ASYNC_BATCH     (1u << 14)
+#define CSET_ASYNC_BATCH_OPS 64
+
+// CSetEngine runs set operations on a pool of worker threads, so that a
+// thread which cannot block (an event loop, say) can submit a request and
+// collect it later by polling or waiting on the completion queue.
+//
+// A worker takes the oldest request, plus the requests after it for as long
+// as their combined size stays within CSET_ASYNC_BATCH, so that small
+// requests are handled in batches rather than one wake-up each.  A batch is
+// run grouped by first operand, so requests on the same set run back to
+// back while it is in cache.
+struct _CSetEngine {
+
+	pthread_mutex_t Lock;
+	pthread_cond_t  Work;       // signalled when requests are submitted
+	pthread_cond_t  Done;       // signalled when requests complete
+	CSetRequest*    Queue;      // submitted, oldest first
+	CSetRequest*    QueueTail;
+	CSetRequest*    Complete;   // completed, oldest first
+	CSetRequest*    CompleteTail;
+	uint32_t        Pending;    // submitted but not yet complete
+	bool            Stopping;
+	uint32_t        nThreads;
+	pthread_t       Threads[CSET_MAX_THREADS];
+};
+
+typedef struct _CSetEngine CSetEngine;
+
+/**
+ * Returns the number of elements a request will touch.
+ */
+static uint64_t CSetRequest_Cost(const CSetRequest* const pReq) {
+	uint64_t cost = 1 + pReq->A->Usage;
+	if (pReq->Op == CSETASYNC_INTERSECTION || pReq->Op == CSETASYNC_SYMDIFFERENCE) {
+		cost += pReq->B->Usage;
+	}
+	else if (pReq->Op == CSETASYNC_CONTAINS) {
+		cost += pReq->nValues;
+	}
+	return cost;
+}
+
+/**
+ * Runs one request.
+ */
+static void CSetRequest_Run(CSetRequest* const pReq) {
+	if (pReq->Op == CSETASYNC_INTERSECTION) {
+		pReq->Ok = CSet_Intersection(pReq->Result, pReq->A, pReq->B);
+	}
+	else if (pReq->Op == CSETASYNC_SYMDIFFERENCE) {
+		pReq->Ok = CSet_SymDifference(pReq->Result, pReq->A, pReq->B);
+	}
+	else if (pReq->Op == CSETASYNC_CONTAINS) {
+		uint32_t i = 0;
+		while (i < pReq->nValues) {
+			pReq->Found[i] = CSet_Contains(pReq->A, pReq->Values[i]);
+			i++;
+		}
+		pReq->Ok = true;
+	}
+	else if (pReq->Op == CSETASYNC_COPY) {
+		pReq->Ok = CSet_Copy(pReq->Result, pReq->A);
+	}
+	else {
+		pReq->Ok = false;
+	}
+}
+
+/**
+ * Worker loop: takes a batch, runs it outside the lock, then posts all of
+ * its completions at once.
+ */
+static void* CSetEngine_Worker(void* pArg) {
+	CSetEngine* pEngine = (CSetEngine*)pArg;
+	CSetRequest* batch[CSET_ASYNC_BATCH_OPS];
+	pthread_mutex_lock(&pEngine->Lock);
+	while (true) {
+		while (pEngine->Queue == NULL && !pEngine->Stopping) {
+			pthread_cond_wait(&pEngine->Work, &pEngine->Lock);
+		}
+		if (pEngine->Queue == NULL) break;
+		uint32_t n = 0;
+		uint64_t cost = 0;
+		do {
+			cost += CSetRequest_Cost(pEngine->Queue);
+			batch[n++] = pEngine->Queue;
+			pEngine->Queue = pEngine->Queue->Next;
+		} while (pEngine->Queue != NULL && n < CSET_ASYNC_BATCH_OPS &&
+		         cost + CSetRequest_Cost(pEngine->Queue) <= CSET_ASYNC_BATCH);
+		if (pEngine->Queue == NULL) {
+			pEngine->QueueTail = NULL;
+		}
+		pthread_mutex_unlock(&pEngine->Lock);
+
+		//Group by first operand, keeping submission order within a group
+		uint32_t i = 1;
+		while (i < n) {
+			CSetRequest* pReq = batch[i];
+			uint32_t j = i;
+			while (j > 0 && (uintptr_t)batch[j - 1]->A > (uintptr_t)pReq->A) {
+				batch[j] = batch[j - 1];
+				j--;
+			}
+			batch[j] = pReq;
+			i++;
+		}
+		i = 0;
+		while (i < n) {
+			CSetRequest_Run(batch[i]);
+			batch[i]->Next = (i + 1 < n) ? batch[i + 1] : NULL;
+			i++;
+		}
+
+		pthread_mutex_lock(&pEngine->Lock);
+		if (pEngine->CompleteTail == NULL) {
+			pEngine->Complete = batch[0];
+		}
+		else {
+			pEngine->CompleteTail->Next = batch[0];
+		}
+		pEngine->CompleteTail = batch[n - 1];
+		pEngine->Pending -= n;
+		pthread_cond_broadcast(&pEngine->Done);
+	}
+	pthread_mutex_unlock(&pEngine->Lock);
+	return NULL;
+}
+
+/**
+ * Initializes a raw pEngine object and starts its workers.
+ *
+ * Pre:
+ *    pEngine points to a CSetEngine object
+ *    nThreads is the number of workers, or 0 for one per online processor
+ * Returns:
+ *    true if successful (at least one worker started), false otherwise
+ *
+ * Complexity:  O( nThreads )
+ */
+bool CSetEngine_Init(CSetEngine* const pEngine, uint32_t nThreads) {
+	if (pthread_mutex_init(&pEngine->Lock, NULL) != 0) return false;
+	if (pthread_cond_init(&pEngine->Work, NULL) != 0) {
+		pthread_mutex_destroy(&pEngine->Lock);
+		return false;
+	}
+	if (pthread_cond_init(&pEngine->Done, NULL) != 0) {
+		pthread_cond_destroy(&pEngine->Work);
+		pthread_mutex_destroy(&pEngine->Lock);
+		return false;
+	}
+	pEngine->Queue = NULL;
+	pEngine->QueueTail = NULL;
+	pEngine->Complete = NULL;
+	pEngine->CompleteTail = NULL;
+	pEngine->Pending = 0;
+	pEngine->Stopping = false;
+	pEngine->nThreads = 0;
+	uint32_t wanted = CSet_ThreadCount(nThreads);
+	while (pEngine->nThreads < wanted &&
+	       pthread_create(&pEngine->Threads[pEngine->nThreads], NULL, CSetEngine_Worker, pEngine) == 0) {
+		pEngine->nThreads++;
+	}
+	if (pEngine->nThreads == 0) {
+		pthread_cond_destroy(&pEngine->Done);
+		pthread_cond_destroy(&pEngine->Work);
+		pthread_mutex_destroy(&pEngine->Lock);
+		return false;
+	}
+	return true;
+}
+
+/**
+ * Finishes every submitted request, stops the workers and releases the
+ * engine.  Requests still on the completion queue are simply dropped from
+ * it; they remain the caller's.
+ *
+ * Pre:
+ *    no other thread is using *pEngine
+ *
+ * Complexity:  O( pending work )
+ */
+void CSetEngine_Free(CSetEngine* const pEngine) {
+	pthread_mutex_lock(&pEngine->Lock);
+	pEngine->Stopping = true;
+	pthread_cond_broadcast(&pEngine->Work);
+	pthread_mutex_unlock(&pEngine->Lock);
+	uint32_t i = 0;
+	while (i < pEngine->nThreads) {
+		pthread_join(pEngine->Threads[i], NULL);
+		i++;
+	}
+	pEngine->nThreads = 0;
+	pthread_cond_destroy(&pEngine->Done);
+	pthread_cond_destroy(&pEngine->Work);
+	pthread_mutex_destroy(&pEngine->Lock);
+}
+
+/**
+ * Queues a request to run on the engine's workers; never blocks on the
+ * work itself.
+ *
+ * Pre:
+ *    *pReq is filled in for its Op, and not queued already
+ * Post:
+ *    *pReq will be handed back by CSetEngine_Poll() or CSetEngine_Wait()
+ *       once complete, with Ok set
+ * Returns:
+ *    true if queued, false if the engine is stopping
+ *
+ * Complexity:  O( 1 )
+ */
+bool CSetEngine_Submit(CSetEngine* const pEngine, CSetRequest* const pReq) {
+	pReq->Next = NULL;
+	pthread_mutex_lock(&pEngine->Lock);
+	bool ok = !pEngine->Stopping;
+	if (ok) {
+		if (pEngine->QueueTail == NULL) {
+			pEngine->Queue = pReq;
+		}
+		else {
+			pEngine->QueueTail->Next = pReq;
+		}
+		pEngine->QueueTail = pReq;
+		pEngine->Pending++;
+		pthread_cond_signal(&pEngine->Work);
+	}
+	pthread_mutex_unlock(&pEngine->Lock);
+	return ok;
+}
+
+/**
+ * Takes the oldest completed request off the completion queue.
+ */
+static CSetRequest* CSetEngine_Take(CSetEngine* const pEngine) {
+	CSetRequest* pReq = pEngine->Complete;
+	if (pReq != NULL) {
+		pEngine->Complete = pReq->Next;
+		if (pEngine->Complete == NULL) {
+			pEngine->CompleteTail = NULL;
+		}
+		pReq->Next = NULL;
+	}
+	return pReq;
+}
+
+/**
+ * Returns a completed request without waiting.
+ *
+ * Returns:
+ *    the oldest completed request not yet handed back, or NULL if there is
+ *    none
+ *
+ * Complexity:  O( 1 )
+ */
+CSetRequest* CSetEngine_Poll(CSetEngine* const pEngine) {
+	pthread_mutex_lock(&pEngine->Lock);
+	CSetRequest* pReq = CSetEngine_Take(pEngine);
+	pthread_mutex_unlock(&pEngine->Lock);
+	return pReq;
+}
+
+/**
+ * Returns a completed request, waiting for one if need be.
+ *
+ * Returns:
+ *    the oldest completed request not yet handed back, or NULL if there is
+ *    none and no request is pending
+ *
+ * Complexity:  O( 1 ), plus the wait
+ */
+CSetRequest* CSetEngine_Wait(CSetEngine* const pEngine) {
+	pthread_mutex_lock(&pEngine->Lock);
+	while (pEngine->Complete == NULL && pEngine->Pending > 0) {
+		pthread_cond_wait(&pEngine->Done, &pEngine->Lock);
+	}
+	CSetRequest* pReq = CSetEngine_Take(pEngine);
+	pthread_mutex_unlock(&pEngine->Lock);
+	return pReq;
+}
+
+// Operations a CSetJob can run.
+enum _CSetJobOp {
+
+	CSETJOB_INTERSECTION,    // as CSet_Intersection(Result, A, B)
+	CSETJOB_SYMDIFFERENCE,   // as CSet_SymDifference(Result, A, B)
+	CSETJOB_COPY             // as CSet_Copy(Result, A)
+};
+
+typedef enum _CSetJobOp CSetJobOp;
+
+// Elements a job processes between checks of the clock.
+#define CSETJOB_CHUNK 1024
+
+// CSetJob runs a set operation a slice at a time, so that a loop with a
+// fixed time budget per iteration can spread a large operation over many
+// iterations.  The merge cursors and the partly built output live in the
+// job between calls to CSetJob_Step(); the output replaces *Result only
+// once the job completes, so Result is untouched until then.
+//
+// Between creation and completion, *A and *B must not change, and *Result
+// must not be changed or used by anything but the job.
+struct _CSetJob {
+
+	CSetJobOp   Op;
+	CSet*       Result;
+	const CSet* A;
+	const CSet* B;
+	int32_t*    Data;       // the output being built
+	uint32_t    Capacity;
+	uint32_t    Usage;
+	uint32_t    a;          // cursor into A->Data
+	uint32_t    b;          // cursor into B->Data
+	uint32_t    Filled;     // cells after Usage set to FILLER so far
+	uint64_t    Processed;  // elements processed so far, for progress
+	bool        Merged;     // merge finished; FILLER padding under way
+	bool        Done;       // output installed in *Result
+};
+
+typedef struct _CSetJob CSetJob;
+
+/**
+ * Prepares a raw pJob object to compute Op into *pResult.  No elements are
+ * processed until CSetJob_Step().
+ *
+ * Pre:
+ *    pJob points to a CSetJob object
+ *    *pResult and *pA are proper, and *pB is proper unless Op is
+ *       CSETJOB_COPY, in which case pB is ignored
+ * Returns:
+ *    true if successful, false if memory could not be allocated
+ *
+ * Complexity:  O( 1 )
+ */
+bool CSetJob_Init(CSetJob* const pJob, CSetJobOp Op, CSet* const pResult, const CSet* const pA,
+                  const CSet* const pB) {
+	uint32_t capacity = pA->Capacity;
+	if (Op == CSETJOB_INTERSECTION) {
+		capacity = (pA->Capacity > pB->Capacity) ? pB->Capacity : pA->Capacity;
+	}
+	else if (Op == CSETJOB_SYMDIFFERENCE) {
+		capacity = pA->Capacity + pB->Capacity;
+	}
+	pJob->Data = NULL;
+	if (capacity > 0) {
+		pJob->Data = (int32_t*)malloc(capacity * sizeof(int32_t));
+		if (pJob->Data == NULL) return false;
+	}
+	pJob->Op = Op;
+	pJob->Result = pResult;
+	pJob->A = pA;
+	pJob->B = (Op == CSETJOB_COPY) ? pA : pB;
+	pJob->Capacity = capacity;
+	pJob->Usage = 0;
+	pJob->a = 0;
+	pJob->b = 0;
+	pJob->Filled = 0;
+	pJob->Processed = 0;
+	pJob->Merged = false;
+	pJob->Done = false;
+	return true;
+}
+
+/**
+ * Discards a job that has not completed, leaving *Result unchanged.
+ *
+ * Complexity:  O( 1 )
+ */
+void CSetJob_Abort(CSetJob* const pJob) {
+	if (!pJob->Done) {
+		free(pJob->Data);
+	}
+	pJob->Data = NULL;
+}
+
+/**
+ * Advances the merge by at most Steps elements; returns the number taken.
+ * Fewer than Steps means the merge has finished.
+ */
+static uint32_t CSetJob_Merge(CSetJob* const pJob, uint32_t Steps) {
+	const int32_t* A = pJob->A->Data;
+	const int32_t* B = pJob->B->Data;
+	uint32_t nA = pJob->A->Usage;
+	uint32_t nB = pJob->B->Usage;
+	uint32_t a = pJob->a;
+	uint32_t b = pJob->b;
+	uint32_t i = pJob->Usage;
+	uint32_t steps = 0;
+	if (pJob->Op == CSETJOB_COPY) {
+		steps = (nA - a < Steps) ? nA - a : Steps;
+		if (steps > 0) {
+			memcpy(pJob->Data + i, A + a, steps * sizeof(int32_t));
+		}
+		a += steps;
+		i += steps;
+	}
+	else if (pJob->Op == CSETJOB_INTERSECTION) {
+		while (steps < Steps && a < nA && b < nB) {
+			if (A[a] < B[b]) {
+				a++;
+			}
+			else if (A[a] > B[b]) {
+				b++;
+			}
+			else {
+				pJob->Data[i++] = A[a];
+				a++;
+				b++;
+			}
+			steps++;
+		}
+	}
+	else {
+		while (steps < Steps && (a < nA || b < nB)) {
+			if (b == nB || (a < nA && A[a] < B[b])) {
+				pJob->Data[i++] = A[a++];
+			}
+			else if (a == nA || B[b] < A[a]) {
+				pJob->Data[i++] = B[b++];
+			}
+			else {
+				a++;
+				b++;
+			}
+			steps++;
+		}
+	}
+	pJob->a = a;
+	pJob->b = b;
+	pJob->Usage = i;
+	return steps;
+}
+
+/**
+ * Runs a job for one slice: at most MaxElements elements (merge steps or
+ * FILLER cells), and no longer than about MaxMicros microseconds.  A limit
+ * of 0 means no limit of that kind.  When the job completes, its output
+ * replaces *Result.
+ *
+ * Pre:
+ *    *pJob was initialized and has not been aborted
+ * Post:
+ *    If the job completed, *Result holds the operation's result and is
+ *       proper, as after the operation itself; otherwise *Result is
+ *       unchanged
+ * Returns:
+ *    true if the job has completed, false if it needs more steps
+ *
+ * Complexity:  O( MaxElements ), and time over MaxMicros is bounded by
+ *    CSETJOB_CHUNK elements
+ */
+bool CSetJob_Step(CSetJob* const pJob, uint32_t MaxElements, uint32_t MaxMicros) {
+	uint64_t start = (MaxMicros > 0) ? CSet_Micros() : 0;
+	uint32_t budget = (MaxElements > 0) ? MaxElements : UINT32_MAX;
+	while (!pJob->Done && budget > 0) {
+		uint32_t chunk = (budget < CSETJOB_CHUNK) ? budget : CSETJOB_CHUNK;
+		uint32_t used = 0;
+		if (!pJob->Merged) {
+			used = CSetJob_Merge(pJob, chunk);
+			pJob->Merged = (used < chunk);
+		}
+		else {
+			//Pad a slice at a time; Usage is fixed once the merge is done
+			uint32_t left = pJob->Capacity - pJob->Usage - pJob->Filled;
+			used = (left < chunk) ? left : chunk;
+			uint32_t at = pJob->Usage + pJob->Filled;
+			uint32_t end = at + used;
+			while (at < end) {
+				pJob->Data[at] = FILLER;
+				at++;
+			}
+			pJob->Filled += used;
+			if (pJob->Usage + pJob->Filled == pJob->Capacity) {
+				CSet* pResult = pJob->Result;
+				free(pResult->Data);
+				pResult->Data = pJob->Data;
+				pResult->Capacity = pJob->Capacity;
+				pResult->Usage = pJob->Usage;
+				pJob->Done = true;
+				CSet_Notify(pResult, CSETFEED_RESET, 0);
+			}
+		}
+		budget -= used;
+		pJob->Processed += used;
+		if (MaxMicros > 0 && CSet_Micros() - start >= MaxMicros) break;
+	}
+	return pJob->Done;
+}
+
+/**
+ * Runs a job until it completes or *pCancel fires, polling the token once
+ * per CSET_CANCEL_BLOCK elements.  A stopped job keeps its progress
+ * (pJob->Processed elements) and can be resumed by CSetJob_Run() or
+ * CSetJob_Step(), or discarded by CSetJob_Abort().
+ *
+ * Pre:
+ *    *pJob was initialized and has not been aborted
+ *    pCancel is NULL, or points to an initialized token
+ * Post:
+ *    If the job completed, *Result holds the operation's result; otherwise
+ *       *Result is unchanged
+ * Returns:
+ *    CSET_OK if the job completed, otherwise the status of the token
+ *
+ * Complexity:  O( remaining elements )
+ */
+CSetStatus CSetJob_Run(CSetJob* const pJob, const CSetCancel* const pCancel) {
+	while (!pJob->Done) {
+		CSetStatus status = CSetCancel_Status(pCancel);
+		if (status != CSET_OK) return status;
+		CSetJob_Step(pJob, CSET_CANCEL_BLOCK, 0);
+	}
+	return CSET_OK;
+}
+
+/**
+ * Runs Op into *pResult as CSet_Intersection(), CSet_SymDifference() or
+ * CSet_Copy() would, but gives up if *pCancel fires.
+ *
+ * Pre:
+ *    as for CSetJob_Init()
+ *    pCancel is NULL, or points to an initialized token
+ * Post:
+ *    If the operation completed, *pResult holds its result and is proper
+ *    Otherwise *pResult is unchanged
+ * Returns:
+ *    CSET_OK if the operation completed, CSET_FAILED if memory could not be
+ *    allocated, otherwise the status of the token that stopped it
+ *
+ * Complexity:  O( elements processed )
+ */
+CSetStatus CSet_RunCancellable(CSetJobOp Op, CSet* const pResult, const CSet* const pA,
+                               const CSet* const pB, const CSetCancel* const pCancel) {
+	CSetJob job;
+	if (!CSetJob_Init(&job, Op, pResult, pA, pB)) return CSET_FAILED;
+	CSetStatus status = CSetJob_Run(&job, pCancel);
+	if (status != CSET_OK) {
+		CSetJob_Abort(&job);
+	}
+	return status;
+}
+
+// The two operands of one intersection in CSet_IntersectionBatch().
+struct _CSetOperands {
+
+	const CSet* A;
+	const CSet* B;
+};
+
+typedef struct _CSetOperands CSetOperands;
+
+// Pairs a batch worker merges at once, taking turns, and the merge steps
+// each takes per turn.
+#define CSET_BATCH_GROUP  4
+#define CSET_BATCH_STRIDE 64
+
+// Shared state of a batch of intersections; workers claim groups of pairs
+// from Next, cheapest last.
+struct _CSetBatchTask {
+
+	const CSetOperands* Pairs;
+	const uint64_t*     Order;    // (cost << 32 | pair) ascending by cost
+	uint32_t            n;
+	uint32_t*           Next;     // groups claimed so far; shared
+	uint32_t*           Counts;
+	CSet*               Results;
+	bool                Ok;
+};
+
+/**
+ * Intersects up to CSET_BATCH_GROUP pairs, advancing their merges in turns
+ * so that one pair's cache misses overlap with another's work.  The merges
+ * are branch-free, and each turn prefetches the data the next will read.
+ * Returns false if an output buffer could not be allocated.
+ */
+static bool CSet_IntersectGroup(const CSetOperands* Pairs, const uint32_t* Ids, uint32_t g,
+                                uint32_t* Counts, CSet* Results) {
+	uint32_t a[CSET_BATCH_GROUP];
+	uint32_t b[CSET_BATCH_GROUP];
+	uint32_t count[CSET_BATCH_GROUP];
+	int32_t* out[CSET_BATCH_GROUP];
+	uint32_t capacity[CSET_BATCH_GROUP];
+	bool ok = true;
+	uint32_t k = 0;
+	while (k < g) {
+		const CSet* pA = Pairs[Ids[k]].A;
+		const CSet* pB = Pairs[Ids[k]].B;
+		a[k] = 0;
+		b[k] = 0;
+		count[k] = 0;
+		out[k] = NULL;
+		capacity[k] = (pA->Capacity > pB->Capacity) ? pB->Capacity : pA->Capacity;
+		if (Results != NULL && capacity[k] > 0) {
+			out[k] = (int32_t*)malloc(capacity[k] * sizeof(int32_t));
+			ok = ok && (out[k] != NULL);
+		}
+		k++;
+	}
+	uint32_t active = ok ? g : 0;
+	while (active > 0) {
+		active = 0;
+		k = 0;
+		while (k < g) {
+			const int32_t* A = Pairs[Ids[k]].A->Data;
+			const int32_t* B = Pairs[Ids[k]].B->Data;
+			uint32_t nA = Pairs[Ids[k]].A->Usage;
+			uint32_t nB = Pairs[Ids[k]].B->Usage;
+			uint32_t x = a[k];
+			uint32_t y = b[k];
+			if (x < nA && y < nB) {
+				__builtin_prefetch(A + ((x + CSET_BATCH_STRIDE < nA) ? x + CSET_BATCH_STRIDE : nA - 1));
+				__builtin_prefetch(B + ((y + CSET_BATCH_STRIDE < nB) ? y + CSET_BATCH_STRIDE : nB - 1));
+				uint32_t c = count[k];
+				uint32_t steps = 0;
+				if (out[k] != NULL) {
+					while (steps < CSET_BATCH_STRIDE && x < nA && y < nB) {
+						int32_t u = A[x];
+						int32_t v = B[y];
+						//c never passes min(x, y), so the write stays in bounds
+						out[k][c] = u;
+						c += (u == v);
+						x += (u <= v);
+						y += (v <= u);
+						steps++;
+					}
+				}
+				else {
+					while (steps < CSET_BATCH_STRIDE && x < nA && y < nB) {
+						int32_t u = A[x];
+						int32_t v = B[y];
+						c += (u == v);
+						x += (u <= v);
+						y += (v <= u);
+						steps++;
+					}
+				}
+				a[k] = x;
+				b[k] = y;
+				count[k] = c;
+				if (x < nA && y < nB) active++;
+			}
+			k++;
+		}
+	}
+	k = 0;
+	while (k < g) {
+		if (ok) {
+			if (Counts != NULL) Counts[Ids[k]] = count[k];
+			if (Results != NULL) {
+				CSet_Install(&Results[Ids[k]], out[k], count[k], capacity[k]);
+			}
+		}
+		else {
+			free(out[k]);
+		}
+		k++;
+	}
+	return ok;
+}
+
+/**
+ * Batch worker: claims groups of pairs, costliest first, until none are
+ * left.
+ */
+static void* CSet_BatchRun(void* Arg) {
+	struct _CSetBatchTask* pTask = (struct _CSetBatchTask*)Arg;
+	uint32_t ids[CSET_BATCH_GROUP];
+	pTask->Ok = true;
+	while (true) {
+		uint32_t start = __atomic_fetch_add(pTask->Next, CSET_BATCH_GROUP, __ATOMIC_RELAXED);
+		if (start >= pTask->n) break;
+		uint32_t g = (pTask->n - start < CSET_BATCH_GROUP) ? pTask->n - start : CSET_BATCH_GROUP;
+		uint32_t k = 0;
+		while (k < g) {
+			ids[k] = (uint32_t)pTask->Order[pTask->n - 1 - start - k];
+			k++;
+		}
+		if (!CSet_IntersectGroup(pTask->Pairs, ids, g, pTask->Counts, pTask->Results)) {
+			pTask->Ok = false;
+		}
+	}
+	return NULL;
+}
+
+/**
+ * Intersects each of n independent pairs of sets, giving the size of each
+ * intersection, the intersection itself, or both.
+ *
+ * Pairs are handed out costliest first, in small groups, to threads that
+ * claim them as they finish, which keeps the threads evenly loaded; each
+ * group's merges are interleaved to hide memory latency.
+ *
+ * Pre:
+ *    Pairs[0 : n-1] hold pointers to proper CSet objects
+ *    Counts is NULL or has room for n counts
+ *    Results is NULL or points to n proper CSet objects, none of them an
+ *       operand in Pairs
+ *    nThreads is the number of threads to use, or 0 for one per processor
+ * Post:
+ *    the operands are unchanged
+ *    If successful, for each i:
+ *       Counts[i] is the number of values in both Pairs[i].A and Pairs[i].B
+ *       Results[i] is their intersection, as set by CSet_Intersection()
+ *    Otherwise some of the counts and results may not have been set
+ * Returns:
+ *    true if successful, false if memory could not be allocated
+ *
+ * Complexity:  O( sum of Pairs[i].A->Usage + Pairs[i].B->Usage + n )
+ */
+bool CSet_IntersectionBatch(const CSetOperands* Pairs, uint32_t n, uint32_t* Counts, CSet* Results,
+                            uint32_t nThreads) {
+	uint64_t* order = (uint64_t*)malloc((n > 0 ? n : 1) * sizeof(uint64_t));
+	if (order == NULL) return false;
+	uint64_t total = 0;
+	uint32_t i = 0;
+	while (i < n) {
+		uint64_t cost = (uint64_t)Pairs[i].A->Usage + Pairs[i].B->Usage;
+		total += cost;
+		//Costs beyond 32 bits only need to sort last
+		order[i] = ((cost > UINT32_MAX) ? UINT32_MAX : cost) << 32 | i;
+		i++;
+	}
+	if (!CSet_SortKeys(order, n)) {
+		free(order);
+		return false;
+	}
+	uint32_t next = 0;
+	struct _CSetBatchTask tasks[CSET_MAX_THREADS];
+	uint32_t nTasks = CSet_ThreadCount(nThreads);
+	if (total < CSET_TOCC_PARALLEL_MIN) nTasks = 1;
+	if (nTasks > (n + CSET_BATCH_GROUP - 1) / CSET_BATCH_GROUP) {
+		nTasks = (n + CSET_BATCH_GROUP - 1) / CSET_BATCH_GROUP;
+	}
+	if (nTasks == 0) nTasks = 1;
+	uint32_t t = 0;
+	while (t < nTasks) {
+		tasks[t].Pairs = Pairs;
+		tasks[t].Order = order;
+		tasks[t].n = n;
+		tasks[t].Next = &next;
+		tasks[t].Counts = Counts;
+		tasks[t].Results = Results;
+		t++;
+	}
+	CSet_RunParallel(CSet_BatchRun, tasks, sizeof(tasks[0]), nTasks);
+	bool ok = true;
+	t = 0;
+	while (t < nTasks) {
+		ok = ok && tasks[t].Ok;
+		t++;
+	}
+	free(order);
+	return ok;
+}
+
+/**
+ * Sets *pUnion to be the union of the sets *pA and *pB.  When the inputs
+ * occupy disjoint value ranges, as time-partitioned sets usually do, the
+ * result is built by copying them one after the other, without merging.
+ *
+ * Pre:
+ *    *pUnion, *pA and *pB are proper
+ * Post:
+ *    *pA and *pB are unchanged, unless *pUnion aliases *pA or *pB
+ *    For every integer x, x is contained in *pUnion iff x is contained in
+ *       *pA or in *pB
+ *    pUnion->Capacity == pA->Capacity + pB->Capacity
+ *    *pUnion is proper
+ * Returns:
+ *    true if the union is successfully created; false otherwise, in which
+ *    case *pUnion is unchanged
+ *
+ * Complexity:  O( pA->Usage + pB->Usage )
+ */
+bool CSet_Union(CSet* const pUnion, const CSet* const pA, const CSet* const pB) {
+	uint32_t capacity = pA->Capacity + pB->Capacity;
+	int32_t* data = NULL;
+	if (capacity > 0) {
+		data = (int32_t*)malloc(capacity * sizeof(int32_t));
+		if (data == NULL) return false;
+	}
+	uint32_t i = 0;
+	const CSet* pFirst = CSet_Precedes(pA, pB) ? pA : CSet_Precedes(pB, pA) ? pB : NULL;
+	if (pFirst != NULL) {
+		const CSet* pSecond = (pFirst == pA) ? pB : pA;
+		if (pFirst->Usage > 0) {
+			CSet_StreamCopy(data, pFirst->Data, pFirst->Usage);
+		}
+		if (pSecond->Usage > 0) {
+			CSet_StreamCopy(data + pFirst->Usage, pSecond->Data, pSecond->Usage);
+		}
+		i = pFirst->Usage + pSecond->Usage;
+	}
+	else {
+		uint32_t a = 0;
+		uint32_t b = 0;
+		struct _CSetWriter writer;
+		CSet_WriterInit(&writer, data, capacity);
+		while (a < pA->Usage && b < pB->Usage) {
+			int32_t x = pA->Data[a];
+			int32_t y = pB->Data[b];
+			CSet_WriterPut(&writer, (x < y) ? x : y);
+			a += (x <= y);
+			b += (y <= x);
+		}
+		i = CSet_WriterEnd(&writer);
+		if (a < pA->Usage) {
+			CSet_StreamCopy(data + i, pA->Data + a, pA->Usage - a);
+			i += pA->Usage - a;
+		}
+		if (b < pB->Usage) {
+			CSet_StreamCopy(data + i, pB->Data + b, pB->Usage - b);
+			i += pB->Usage - b;
+		}
+	}
+	CSet_Install(pUnion, data, i, capacity);
+	return true;
+}
+
+/**
+ * Splits *pSet at Pivot: *pLow receives its values below Pivot and *pHigh
+ * the rest.  The split point is found by binary search and each half is
+ * copied in one block.
+ *
+ * Pre:
+ *    *pSet, *pLow and *pHigh are proper, and pLow != pHigh
+ * Post:
+ *    *pSet is unchanged, unless it is *pLow or *pHigh
+ *    If successful:
+ *       *pLow holds the values of *pSet less than Pivot, and
+ *          pLow->Capacity == pLow->Usage + 1
+ *       *pHigh holds the values of *pSet not less than Pivot, and
+ *          pHigh->Capacity == pHigh->Usage + 1
+ *       *pLow and *pHigh are proper
+ *    else:
+ *       *pLow and *pHigh are unchanged
+ * Returns:
+ *    true if successful, false otherwise
+ *
+ * Complexity:  O( pSet->Usage )
+ */
+bool CSet_Split(const CSet* const pSet, int32_t Pivot, CSet* const pLow, CSet* const pHigh) {
+	uint32_t cut = CSet_LowerBound(pSet->Data, 0, pSet->Usage, Pivot);
+	uint32_t nHigh = pSet->Usage - cut;
+	int32_t* low = (int32_t*)malloc((cut + 1) * sizeof(int32_t));
+	int32_t* high = (int32_t*)malloc((nHigh + 1) * sizeof(int32_t));
+	if (low == NULL || high == NULL) {
+		free(low);
+		free(high);
+		return false;
+	}
+	if (cut > 0) {
+		CSet_StreamCopy(low, pSet->Data, cut);
+	}
+	if (nHigh > 0) {
+		CSet_StreamCopy(high, pSet->Data + cut, nHigh);
+	}
+	//Both halves are built before either is installed, since pSet may be
+	//one of the destinations
+	CSet_Install(pLow, low, cut, cut + 1);
+	CSet_Install(pHigh, high, nHigh, nHigh + 1);
+	return true;
+}
+
+/**
+ * Sets *pResult to the values of *pA followed by those of *pB, which must
+ * lie entirely above them; the union of range-disjoint sets, built by
+ * copying.
+ *
+ * Pre:
+ *    *pResult, *pA and *pB are proper
+ * Post:
+ *    *pA and *pB are unchanged, unless *pResult aliases *pA or *pB
+ *    If every value of *pA is less than every value of *pB:
+ *       *pResult holds the values of both
+ *       pResult->Capacity == pA->Usage + pB->Usage + 1
+ *       *pResult is proper
+ *    else:
+ *       *pResult is unchanged
+ * Returns:
+ *    true if successful, false if the ranges overlap or memory could not
+ *    be allocated
+ *
+ * Complexity:  O( pA->Usage + pB->Usage )
+ */
+bool CSet_Concat(CSet* const pResult, const CSet* const pA, const CSet* const pB) {
+	if (!CSet_Precedes(pA, pB)) return false;
+	uint32_t usage = pA->Usage + pB->Usage;
+	int32_t* data = (int32_t*)malloc((usage + 1) * sizeof(int32_t));
+	if (data == NULL) return false;
+	if (pA->Usage > 0) {
+		CSet_StreamCopy(data, pA->Data, pA->Usage);
+	}
+	if (pB->Usage > 0) {
+		CSet_StreamCopy(data + pA->Usage, pB->Data, pB->Usage);
+	}
+	CSet_Install(pResult, data, usage, usage + 1);
+	return true;
+}
+
+// One thread's slice of a parallel copy: cells [Lo, Hi) of the target.
+struct _CSetCopyTask {
+
+	int32_t*       Dst;
+	const int32_t* Src;
+	size_t         Usage;   // cells below this are copied, the rest filled
+	size_t         Lo;
+	size_t         Hi;
+};
+
+/**
+ * Copies or fills one slice of a parallel copy.
+ */
+static void* CSet_CopyRun(void* Arg) {
+	struct _CSetCopyTask* pTask = (struct _CSetCopyTask*)Arg;
+	size_t split = (pTask->Usage < pTask->Lo) ? pTask->Lo : (pTask->Usage > pTask->Hi) ? pTask->Hi : pTask->Usage;
+	CSet_StreamCopy(pTask->Dst + pTask->Lo, pTask->Src + pTask->Lo, split - pTask->Lo);
+	CSet_StreamFill(pTask->Dst + split, FILLER, pTask->Hi - split);
+	return NULL;
+}
+
+/**
+ * Makes a deep copy of a CSet object as CSet_Copy() does, splitting the
+ * work across threads; for sets large enough that one core cannot reach
+ * full memory bandwidth.
+ *
+ * Pre:
+ *    *pTarget and *pSource are proper
+ *    nThreads is the number of threads to use, or 0 for one per processor
+ * Post:
+ *    as for CSet_Copy()
+ * Returns:
+ *    true if successful, false otherwise
+ *
+ * Complexity:  O( pSource->Capacity / nThreads )
+ */
+bool CSet_CopyParallel(CSet* const pTarget, const CSet* const pSource, uint32_t nThreads) {
+	if (pTarget == pSource) return true;
+	uint32_t nTasks = CSet_ThreadCount(nThreads);
+	//Below a few streaming blocks per thread, threads cost more than they save
+	if (pSource->Capacity < (uint64_t)nTasks * CSET_STREAM_MIN) {
+		return CSet_Copy(pTarget, pSource);
+	}
+	int32_t* data = (int32_t*)malloc(pSource->Capacity * sizeof(int32_t));
+	if (data == NULL) return false;
+	struct _CSetCopyTask tasks[CSET_MAX_THREADS];
+	uint32_t t = 0;
+	while (t < nTasks) {
+		tasks[t].Dst = data;
+		tasks[t].Src = pSource->Data;
+		tasks[t].Usage = pSource->Usage;
+		//Slice edges on multiples of 16 values, so each slice starts aligned
+		//as the buffer does and streams without a scalar head
+		tasks[t].Lo = ((uint64_t)pSource->Capacity * t / nTasks) & ~(size_t)15;
+		tasks[t].Hi = (t + 1 == nTasks) ? pSource->Capacity
+		              : ((uint64_t)pSource->Capacity * (t + 1) / nTasks) & ~(size_t)15;
+		t++;
+	}
+	CSet_RunParallel(CSet_CopyRun, tasks, sizeof(tasks[0]), nTasks);
+	free(pTarget->Data);
+	pTarget->Data = data;
+	pTarget->Usage = pSource->Usage;
+	pTarget->Capacity = pSource->Capacity;
+	CSet_Notify(pTarget, CSETFEED_RESET, 0);
+	return true;
+}
+
+/**
+ * Sets the size limits for the small-set paths: sets of at most ScanMax
+ * values are searched by linear scan, and intersections and subset tests
+ * on sets of at most PairsMax values compare all pairs.  0 disables a
+ * path.  For a benchmark suite or configuration to apply measured limits.
+ *
+ * Pre:
+ *    no other thread is using CSet functions
+ *
+ * Complexity:  O( 1 )
+ */
+void CSet_SetSmallThresholds(uint32_t ScanMax, uint32_t PairsMax) {
+	CSet_ScanMax = ScanMax;
+	CSet_PairsMax = PairsMax;
+}
+
+// Sizes tried by CSet_Calibrate(), and lookups timed at each size.
+#define CSET_CALIBRATE_MAX     256
+#define CSET_CALIBRATE_LOOKUPS 20000
+
+/**
+ * Measures where the small-set paths stop paying off on the running CPU,
+ * and sets their limits accordingly.  Sizes 4, 8, ..., 256 are tried, and
+ * each limit is the largest size at which the small path was still at
+ * least as fast.  Takes a few milliseconds.
+ *
+ * Pre:
+ *    no other thread is using CSet functions
+ *
+ * Complexity:  O( 1 )
+ */
+void CSet_Calibrate(void) {
+	int32_t a[CSET_CALIBRATE_MAX];
+	int32_t b[CSET_CALIBRATE_MAX];
+	uint64_t rng = 0x5EED;
+	volatile uint64_t sink = 0;
+	uint32_t scanMax = 0;
+	uint32_t pairsMax = 0;
+	bool scanWins = true;
+	bool pairsWins = true;
+	uint32_t n = 4;
+	while (n <= CSET_CALIBRATE_MAX && (scanWins || pairsWins)) {
+		uint32_t i = 0;
+		while (i < n) {
+			a[i] = (int32_t)(2 * i);
+			b[i] = (int32_t)(3 * i);
+			i++;
+		}
+		if (scanWins) {
+			uint64_t hits = 0;
+			uint64_t start = CSet_Micros();
+			uint32_t q = 0;
+			while (q < CSET_CALIBRATE_LOOKUPS) {
+				hits += CSet_ScanFind(a, n, (int32_t)CSet_RandomBelow(&rng, 2 * n));
+				q++;
+			}
+			uint64_t scan = CSet_Micros() - start;
+			start = CSet_Micros();
+			q = 0;
+			while (q < CSET_CALIBRATE_LOOKUPS) {
+				int32_t value = (int32_t)CSet_RandomBelow(&rng, 2 * n);
+				uint32_t at = CSet_LowerBound(a, 0, n, value);
+				hits += (at < n && a[at] == value);
+				q++;
+			}
+			uint64_t bisect = CSet_Micros() - start;
+			sink += hits;
+			scanWins = (scan <= bisect);
+			if (scanWins) scanMax = n;
+		}
+		if (pairsWins) {
+			uint64_t hits = 0;
+			uint32_t rounds = CSET_CALIBRATE_LOOKUPS / n;
+			uint64_t start = CSet_Micros();
+			uint32_t r = 0;
+			while (r < rounds) {
+				i = 0;
+				while (i < n) {
+					hits += CSet_ScanFind(b, n, a[i] + (int32_t)(r & 1));
+					i++;
+				}
+				r++;
+			}
+			uint64_t pairs = CSet_Micros() - start;
+			start = CSet_Micros();
+			r = 0;
+			while (r < rounds) {
+				int32_t shift = (int32_t)(r & 1);
+				uint32_t x = 0;
+				uint32_t y = 0;
+				while (x < n && y < n) {
+					if (a[x] + shift < b[y]) {
+						x++;
+					}
+					else if (a[x] + shift > b[y]) {
+						y++;
+					}
+					else {
+						hits++;
+						x++;
+						y++;
+					}
+				}
+				r++;
+			}
+			uint64_t merge = CSet_Micros() - start;
+			sink += hits;
+			pairsWins = (pairs <= merge);
+			if (pairsWins) pairsMax = n;
+		}
+		n *= 2;
+	}
+	(void)sink;
+	CSet_SetSmallThresholds(scanMax, pairsMax);
+}
+
+// How CSet_ContainsWith() searches a set.
+enum _CSetSearchMode {
+
+	CSET_SEARCH_BINARY,   // as CSet_Contains()
+	CSET_SEARCH_HYBRID    // interpolation alternated with bisection
+};
+
+typedef enum _CSetSearchMode CSetSearchMode;
+
+// Ranges at most this long are finished by bisection alone.
+#define CSET_HYBRID_MIN 16
+
+// Values CSet_ChooseSearchMode() samples, and the worst interpolation
+// error, as a fraction 1/CSET_HYBRID_SKEW of the set, it accepts.
+#define CSET_HYBRID_SAMPLES 64
+#define CSET_HYBRID_SKEW    64
+
+/**
+ * Returns the first index in [Lo, Hi) whose value is not less than Value,
+ * or Hi.  Each round probes where linear interpolation between the ends of
+ * the range puts Value, then bisects what is left; the bisection at least
+ * halves the range every round, so the search takes O( log n ) rounds
+ * whatever the data, and O( log log n ) on uniformly spread values.
+ */
+static uint32_t CSet_HybridBound(const int32_t* Data, uint32_t Lo, uint32_t Hi, int32_t Value) {
+	while (Hi - Lo > CSET_HYBRID_MIN) {
+		int64_t low = Data[Lo];
+		int64_t high = Data[Hi - 1];
+		if (Value <= low) return Lo;
+		if (Value > high) return Hi;
+		//low < Value <= high, so the probe lands inside the range
+		uint32_t probe = Lo + (uint32_t)((double)((int64_t)Value - low) / (double)(high - low) * (Hi - 1 - Lo));
+		if (probe >= Hi) probe = Hi - 1;
+		if (Data[probe] < Value) {
+			Lo = probe + 1;
+		}
+		else {
+			Hi = probe;
+		}
+		if (Lo < Hi) {
+			uint32_t mid = Lo + (Hi - Lo) / 2;
+			if (Data[mid] < Value) {
+				Lo = mid + 1;
+			}
+			else {
+				Hi = mid;
+			}
+		}
+	}
+	return CSet_LowerBound(Data, Lo, Hi, Value);
+}
+
+/**
+ * Determines if Value belongs to the given pSet object, searching it as
+ * Mode says.  CSET_SEARCH_HYBRID suits sets whose values are spread about
+ * evenly, and is never worse than O( log n ); CSet_ChooseSearchMode()
+ * picks the mode for a given set.
+ *
+ * Pre:
+ *    *pSet is proper
+ * Returns:
+ *    true if Value belongs to *pSet, false otherwise
+ *
+ * Complexity:  O( log(pSet->Usage) ), and O( log log(pSet->Usage) )
+ *              expected for CSET_SEARCH_HYBRID on uniform data
+ */
+bool CSet_ContainsWith(const CSet* const pSet, int32_t Value, CSetSearchMode Mode) {
+	if (Mode != CSET_SEARCH_HYBRID || pSet->Usage <= CSet_ScanMax) {
+		return CSet_Contains(pSet, Value);
+	}
+	uint32_t at = CSet_HybridBound(pSet->Data, 0, pSet->Usage, Value);
+	return at < pSet->Usage && pSet->Data[at] == Value;
+}
+
+/**
+ * Picks the search mode for a set from a sample of its values: if linear
+ * interpolation between its smallest and largest values predicts the
+ * position of every sampled value to within 1/CSET_HYBRID_SKEW of the set,
+ * the hybrid search will converge quickly.  Meant to be called once the
+ * set is built, with the result kept alongside it.
+ *
+ * Pre:
+ *    *pSet is proper
+ * Returns:
+ *    the mode to pass to CSet_ContainsWith() for *pSet
+ *
+ * Complexity:  O( CSET_HYBRID_SAMPLES )
+ */
+CSetSearchMode CSet_ChooseSearchMode(const CSet* const pSet) {
+	uint32_t n = pSet->Usage;
+	if (n <= CSet_ScanMax || n <= CSET_HYBRID_MIN) return CSET_SEARCH_BINARY;
+	double low = pSet->Data[0];
+	double span = (double)pSet->Data[n - 1] - low;
+	double tolerance = (double)n / CSET_HYBRID_SKEW;
+	uint32_t k = 1;
+	while (k < CSET_HYBRID_SAMPLES) {
+		uint32_t at = (uint32_t)((uint64_t)(n - 1) * k / CSET_HYBRID_SAMPLES);
+		double predicted = ((double)pSet->Data[at] - low) / span * (n - 1);
+		double error = predicted - at;
+		if (error > tolerance || -error > tolerance) return CSET_SEARCH_BINARY;
+		k++;
+	}
+	return CSET_SEARCH_HYBRID;
+}
@@ -0,0 +1,104 @@
+// Throughput of CSkipSet against a CSet guarded by one mutex, at 1 to 64
+// threads.  Each thread runs the same mix of operations on values drawn
+// from a shared range: mostly lookups, with inserts and removes balanced so
+// the set stays about half full.  Not part of the default test run:
+//
+//    CFLAGS=-O2 tests/runTests.sh bench_skipset
+//
+// Threads beyond the number of cores only measure how each design copes
+// with preemption, which is where a lock holder being descheduled hurts.
+
+#include "CSet.c"
+#include "testing.h"
+
+#define RANGE     (1 << 12)
+#define OPS       100000      // per thread
+#define LOOKUPS   8           // of every 10 operations
+
+static CSkipSet        Skip;
+static CSet            Locked;
+static pthread_mutex_t Lock = PTHREAD_MUTEX_INITIALIZER;
+static bool            UseSkip;
+
+static void* Worker(void* Arg) {
+	uint32_t seed = 101 + 7919 * (uint32_t)(uintptr_t)Arg;
+	uint32_t hits = 0;
+	uint32_t k = 0;
+	while (k < OPS) {
+		seed ^= seed << 13;
+		seed ^= seed >> 17;
+		seed ^= seed << 5;
+		int32_t v = (int32_t)(seed % RANGE);
+		uint32_t pick = (seed >> 20) % 10;
+		if (UseSkip) {
+			if (pick < LOOKUPS) {
+				hits += CSkipSet_Contains(&Skip, v);
+			}
+			else if (pick == LOOKUPS) {
+				CSkipSet_Insert(&Skip, v);
+			}
+			else {
+				CSkipSet_Remove(&Skip, v);
+			}
+		}
+		else {
+			pthread_mutex_lock(&Lock);
+			if (pick < LOOKUPS) {
+				hits += CSet_Contains(&Locked, v);
+			}
+			else if (pick == LOOKUPS) {
+				CSet_Insert(&Locked, v);
+			}
+			else {
+				CSet_Remove(&Locked, v);
+			}
+			pthread_mutex_unlock(&Lock);
+		}
+		k++;
+	}
+	return (void*)(uintptr_t)hits;
+}
+
+// Fills both sets with every other value, then times nThreads workers on
+// the chosen one.  Returns millions of operations per second.
+static double Run(bool Skiplist, uint32_t nThreads) {
+	CSkipSet_Init(&Skip);
+	CSet_Init(&Locked, RANGE + 1);
+	int32_t v = 0;
+	while (v < RANGE) {
+		CSkipSet_Insert(&Skip, v);
+		CSet_Insert(&Locked, v);
+		v += 2;
+	}
+	UseSkip = Skiplist;
+	pthread_t threads[64];
+	struct timespec start, end;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	uintptr_t i = 0;
+	while (i < nThreads) {
+		pthread_create(&threads[i], NULL, Worker, (void*)i);
+		i++;
+	}
+	i = 0;
+	while (i < nThreads) {
+		pthread_join(threads[i], NULL);
+		i++;
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	double seconds = (double)(end.tv_sec - start.tv_sec) + 1e-9 * (double)(end.tv_nsec - start.tv_nsec);
+	CSkipSet_Free(&Skip);
+	free(Locked.Data);
+	return (double)nThreads * OPS / seconds / 1e6;
+}
+
+int main(void) {
+	printf("%8s %14s %14s\n", "threads", "CSkipSet Mops", "mutex Mops");
+	uint32_t n = 1;
+	while (n <= 64) {
+		double skip = Run(true, n);
+		double locked = Run(false, n);
+		printf("%8u %14.2f %14.2f\n", n, skip, locked);
+		n *= 2;
+	}
+	return 0;
+}
@@ -0,0 +1,65 @@
+#! /bin/bash
+#
+#  Builds and runs the behavior tests for samt5.c.
+#
+#  Each tests/test_*.c program is compiled against the CSet.h shipped in the
+#  grading package, using the same compiler line as gradeC01.sh (plus
+#  -pthread, which the concurrent types need).
+#
+#  Invocation:  tests/runTests.sh [test name ...]
+#               e.g., tests/runTests.sh test_multiset
+#
+#  The tests/bench_*.c programs are left out of the default run; name one
+#  to build and run it the same way, e.g., tests/runTests.sh bench_skipset
+#
+#  Extra compiler switches may be passed in CFLAGS, e.g.
+#               CFLAGS="-O2 -fsanitize=address,undefined" tests/runTests.sh
+#
+#  Exit status is the number of tests that failed to build or run cleanly.
+
+testDir=$(cd "$(dirname "$0")" && pwd)
+repoDir=$(dirname "$testDir")
+buildDir="$testDir/build"
+
+############################################################ Prepare build directory
+
+   rm -Rf "$buildDir"
+   mkdir -p "$buildDir"
+   tar xOf "$repoDir/C01Files.tar" CSetGrader.tar | tar xf - -C "$buildDir" CSet.h
+   if [[ ! -e "$buildDir/CSet.h" ]]; then
+      echo "Could not extract CSet.h from C01Files.tar"
+      exit 1
+   fi
+   cp "$repoDir/samt5.c" "$buildDir/CSet.c"
+
+############################################################ Select tests
+
+   if [[ $# -gt 0 ]]; then
+      tests=("$@")
+   else
+      tests=()
+      for src in "$testDir"/test_*.c; do
+         name=${src##*/}
+         tests+=("${name%.c}")
+      done
+   fi
+
+############################################################ Build and run
+
+   failed=0
+   for name in "${tests[@]}"; do
+      exe="$buildDir/$name"
+      if ! gcc -o "$exe" -std=c99 -Wall -ggdb3 $CFLAGS -I "$buildDir" -I "$testDir" \
+               "$testDir/$name.c" -pthread; then
+         echo "$name: build failed"
+         failed=$((failed + 1))
+         continue
+      fi
+      if ! timeout 600 "$exe"; then
+         echo "$name: FAILED"
+         failed=$((failed + 1))
+      fi
+   done
+
+   echo "$((${#tests[@]} - failed)) of ${#tests[@]} test programs passed"
+   exit $failed
@@ -0,0 +1,109 @@
+// Behavior tests for CSet_ApplyDelta().
+
+#include "CSet.c"
+#include "testing.h"
+
+// Values are -400, -397, ..., 797 and the two extremes, one per slot.
+#define RANGE  400
+#define SCALE  3
+#define OFFSET (-RANGE)
+#define SLOTS  (RANGE + 2)
+
+static void TestRandom(void) {
+	uint32_t round = 0;
+	while (round < 2000) {
+		bool member[SLOTS] = { false };
+		int32_t values[SLOTS];
+		uint32_t n = 0;
+		uint32_t slot = 0;
+		uint32_t density = Test_Random() % 4;
+		while (slot < SLOTS) {
+			if (Test_Random() % 4 < density) {
+				values[n++] = Test_EdgeValue(slot, RANGE, SCALE, OFFSET);
+				member[slot] = true;
+			}
+			slot++;
+		}
+		CSet set;
+		Test_MakeSet(&set, values, n, Test_Random() % 50);
+		uint32_t capacity = set.Capacity;
+
+		int32_t ins[300], rem[300];
+		uint32_t nIns = Test_Random() % 300;
+		uint32_t nRem = Test_Random() % 300;
+		bool inserted[SLOTS] = { false }, removed[SLOTS] = { false };
+		uint32_t i = 0;
+		while (i < nIns) {
+			slot = Test_Random() % SLOTS;
+			ins[i] = Test_EdgeValue(slot, RANGE, SCALE, OFFSET);
+			inserted[slot] = true;
+			i++;
+		}
+		i = 0;
+		while (i < nRem) {
+			slot = Test_Random() % SLOTS;
+			rem[i] = Test_EdgeValue(slot, RANGE, SCALE, OFFSET);
+			removed[slot] = true;
+			i++;
+		}
+		uint32_t added = 0, dropped = 0, usage = 0;
+		slot = 0;
+		while (slot < SLOTS) {
+			bool after = (member[slot] || inserted[slot]) && !removed[slot];
+			added += !member[slot] && after;
+			dropped += member[slot] && !after;
+			usage += after;
+			slot++;
+		}
+		uint32_t gotAdded = UINT32_MAX, gotDropped = UINT32_MAX;
+		CHECK(CSet_ApplyDelta(&set, ins, nIns, rem, nRem, &gotAdded, &gotDropped));
+		CHECK(Test_IsProper(&set) && set.Usage == usage);
+		CHECK(gotAdded == added && gotDropped == dropped);
+		bool same = true;
+		slot = 0;
+		while (slot < SLOTS) {
+			bool after = (member[slot] || inserted[slot]) && !removed[slot];
+			same = same && CSet_Contains(&set, Test_EdgeValue(slot, RANGE, SCALE, OFFSET)) == after;
+			slot++;
+		}
+		CHECK(same);
+		//Capacity is kept when the result fits, else doubled until it has
+		//room to spare
+		if (usage <= capacity) {
+			CHECK(set.Capacity == capacity);
+		}
+		else {
+			uint32_t expect = (capacity == 0) ? 1 : capacity;
+			while (expect <= usage) expect *= 2;
+			CHECK(set.Capacity == expect);
+		}
+		free(set.Data);
+		round++;
+	}
+}
+
+static void TestEdges(void) {
+	CSet set;
+	CSet_Init(&set, 0);
+	CHECK(CSet_ApplyDelta(&set, NULL, 0, NULL, 0, NULL, NULL));
+	CHECK(set.Usage == 0 && Test_IsProper(&set));
+	int32_t ends[3] = { INT32_MAX, INT32_MIN, INT32_MIN };
+	CHECK(CSet_ApplyDelta(&set, ends, 3, NULL, 0, NULL, NULL));
+	CHECK(set.Usage == 2 && set.Data[0] == INT32_MIN && set.Data[1] == INT32_MAX && Test_IsProper(&set));
+
+	//Batches that alias the set's own storage
+	uint32_t added = 9, dropped = 9;
+	CHECK(CSet_ApplyDelta(&set, set.Data, set.Usage, NULL, 0, &added, &dropped));
+	CHECK(set.Usage == 2 && added == 0 && dropped == 0);
+	CHECK(CSet_ApplyDelta(&set, set.Data, set.Usage, set.Data, 1, &added, &dropped));
+	CHECK(set.Usage == 1 && set.Data[0] == INT32_MAX && added == 0 && dropped == 1);
+	CHECK(CSet_ApplyDelta(&set, NULL, 0, set.Data, set.Usage, &added, &dropped));
+	CHECK(set.Usage == 0 && dropped == 1 && Test_IsProper(&set));
+	free(set.Data);
+}
+
+int main(void) {
+	TestEdges();
+	TestRandom();
+	return Test_Report("test_applydelta");
+}
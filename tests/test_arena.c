@@ -0,0 +1,183 @@
+// Behavior tests for CSetArena, including mapping corrupt files.
+
+#include "CSet.c"
+#include "testing.h"
+
+#define NSETS 3000
+
+static char Path[] = "/tmp/csetArenaXXXXXX";
+
+static void CheckArena(const CSetArena* const pArena, const CSet* Sets, uint32_t N) {
+	CHECK(pArena->Count == N);
+	bool same = true;
+	uint32_t i = 0;
+	while (i < N) {
+		CSet view = CSetArena_View(pArena, i);
+		same = same && Test_IsProper(&view) && CSet_Equals(&view, &Sets[i]);
+		i++;
+	}
+	CHECK(same);
+}
+
+// Writes Size bytes of Bytes to Path.
+static void WriteFile(const void* Bytes, size_t Size) {
+	FILE* fp = fopen(Path, "wb");
+	fwrite(Bytes, 1, Size, fp);
+	fclose(fp);
+}
+
+static void TestCorrupt(const CSetArena* const pGood) {
+	//A small valid image to damage: header, 3 offsets, 2 values
+	struct _CSetArenaHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.Magic, CSET_ARENA_MAGIC, sizeof(header.Magic));
+	header.Count = 2;
+	header.nValues = 2;
+	unsigned char image[sizeof(header) + 3 * sizeof(uint64_t) + 2 * sizeof(int32_t)];
+	uint64_t offsets[3] = { 0, 1, 2 };
+	int32_t values[2] = { INT32_MIN, INT32_MAX };
+	memcpy(image, &header, sizeof(header));
+	memcpy(image + sizeof(header), offsets, sizeof(offsets));
+	memcpy(image + sizeof(header) + sizeof(offsets), values, sizeof(values));
+	CSetArena arena;
+	WriteFile(image, sizeof(image));
+	CHECK(CSetArena_Map(&arena, Path));
+	CSet view = CSetArena_View(&arena, 1);
+	CHECK(view.Usage == 1 && view.Data[0] == INT32_MAX);
+	CSetArena_Free(&arena);
+
+	unsigned char bad[sizeof(image)];
+	struct _CSetArenaHeader* pHeader = (struct _CSetArenaHeader*)bad;
+	uint64_t* pOffsets = (uint64_t*)(bad + sizeof(header));
+
+	memcpy(bad, image, sizeof(image));
+	bad[0] = 'X';
+	WriteFile(bad, sizeof(bad));
+	CHECK(!CSetArena_Map(&arena, Path));
+
+	WriteFile(image, sizeof(image) - 1);
+	CHECK(!CSetArena_Map(&arena, Path));
+	WriteFile(image, sizeof(header) - 1);
+	CHECK(!CSetArena_Map(&arena, Path));
+
+	//(Count+1)*8 + nValues*4 wraps around to the file size
+	memcpy(bad, image, sizeof(image));
+	pHeader->nValues = 2 + (UINT64_MAX / 4 + 1);
+	pOffsets[2] = pHeader->nValues;
+	WriteFile(bad, sizeof(bad));
+	CHECK(!CSetArena_Map(&arena, Path));
+
+	//Decreasing offsets would give a set of length 2^64 - 1
+	memcpy(bad, image, sizeof(image));
+	pOffsets[1] = 2;
+	pOffsets[2] = 2;
+	WriteFile(bad, sizeof(bad));
+	CHECK(CSetArena_Map(&arena, Path));
+	CSetArena_Free(&arena);
+	pOffsets[1] = 3;
+	WriteFile(bad, sizeof(bad));
+	CHECK(!CSetArena_Map(&arena, Path));
+
+	memcpy(bad, image, sizeof(image));
+	pOffsets[0] = 1;
+	WriteFile(bad, sizeof(bad));
+	CHECK(!CSetArena_Map(&arena, Path));
+
+	memcpy(bad, image, sizeof(image));
+	pOffsets[2] = 1;
+	WriteFile(bad, sizeof(bad));
+	CHECK(!CSetArena_Map(&arena, Path));
+
+	//Count too large for the file
+	memcpy(bad, image, sizeof(image));
+	pHeader->Count = UINT32_MAX;
+	WriteFile(bad, sizeof(bad));
+	CHECK(!CSetArena_Map(&arena, Path));
+
+	CHECK(!CSetArena_Map(&arena, "/nonexistent/arena"));
+	CHECK(CSetArena_Save(pGood, Path));
+}
+
+int main(void) {
+	int fd = mkstemp(Path);
+	CHECK(fd >= 0);
+	close(fd);
+
+	static CSet sets[NSETS];
+	static const CSet* ptrs[NSETS];
+	uint32_t i = 0;
+	while (i < NSETS) {
+		//Mostly small sets, some empty, a few large ones
+		uint32_t n = (i % 100 == 0) ? 5000 : Test_Random() % 12;
+		Test_RandomSet(&sets[i], n, UINT32_MAX, INT32_MIN);
+		ptrs[i] = &sets[i];
+		i++;
+	}
+	CSetArena arena;
+	CHECK(CSetArena_Build(&arena, ptrs, 0, 1));
+	CHECK(arena.Count == 0 && arena.nValues == 0);
+	CHECK(CSetArena_Save(&arena, Path));
+	CSetArena_Free(&arena);
+	CHECK(CSetArena_Map(&arena, Path));
+	CHECK(arena.Count == 0);
+	CSetArena_Free(&arena);
+
+	CHECK(CSetArena_Build(&arena, ptrs, NSETS, 4));
+	CheckArena(&arena, sets, NSETS);
+	CHECK(CSetArena_Save(&arena, Path));
+	CSetArena mapped;
+	CHECK(CSetArena_Map(&mapped, Path));
+	CheckArena(&mapped, sets, NSETS);
+	CSetArena_Free(&mapped);
+	TestCorrupt(&arena);
+	CSetArena_Free(&arena);
+
+	//From pairs: every set member once, plus repeats, shuffled
+	uint64_t m = 0;
+	i = 0;
+	while (i < NSETS) {
+		m += 2 * sets[i].Usage;
+		i++;
+	}
+	uint32_t* rows = (uint32_t*)malloc(m * sizeof(uint32_t));
+	int32_t* cols = (int32_t*)malloc(m * sizeof(int32_t));
+	uint64_t k = 0;
+	i = 0;
+	while (i < NSETS) {
+		uint32_t j = 0;
+		while (j < 2 * sets[i].Usage) {
+			rows[k] = i;
+			cols[k] = sets[i].Data[j % sets[i].Usage];
+			k++;
+			j++;
+		}
+		i++;
+	}
+	k = m;
+	while (k > 1) {
+		uint64_t r = Test_Random() % k;
+		k--;
+		uint32_t tr = rows[k];
+		int32_t tc = cols[k];
+		rows[k] = rows[r];
+		cols[k] = cols[r];
+		rows[r] = tr;
+		cols[r] = tc;
+	}
+	CHECK(CSetArena_BuildFromPairs(&arena, NSETS, rows, cols, m, 0));
+	CheckArena(&arena, sets, NSETS);
+	CSetArena_Free(&arena);
+	CHECK(CSetArena_BuildFromPairs(&arena, 5, rows, cols, 0, 1));
+	CHECK(arena.Count == 5 && arena.nValues == 0 && CSetArena_View(&arena, 4).Usage == 0);
+	CSetArena_Free(&arena);
+	free(rows);
+	free(cols);
+
+	i = 0;
+	while (i < NSETS) {
+		free(sets[i].Data);
+		i++;
+	}
+	unlink(Path);
+	return Test_Report("test_arena");
+}
@@ -0,0 +1,151 @@
+// Behavior tests for CSet_IntersectionBatch against CSet_Intersection run
+// pair by pair, with counts, results or both, on any number of threads.
+
+#include "CSet.c"
+#include "testing.h"
+
+#define NSETS  8
+#define NPAIRS 150
+
+static CSet         Sets[NSETS];
+static CSetOperands Pairs[NPAIRS];
+
+static void MakeOperands(void) {
+	const int32_t ends[2] = { INT32_MIN, INT32_MAX };
+	Test_MakeSet(&Sets[0], NULL, 0, 1);
+	Test_MakeSet(&Sets[1], ends, 2, 0);
+	Test_RandomSet(&Sets[2], 100, UINT32_MAX, INT32_MIN);
+	CSet_Insert(&Sets[2], INT32_MIN);
+	Test_RandomSet(&Sets[3], 5000, 10000, 0);
+	Test_RandomSet(&Sets[4], 50000, 100000, 0);
+	Test_RandomSet(&Sets[5], 30, 10000, 0);
+	Test_RandomSet(&Sets[6], 20000, 30000, -10000);
+	Test_RandomSet(&Sets[7], 3, 10, 0);
+	CSet_Insert(&Sets[7], INT32_MAX);
+	uint32_t i = 0;
+	while (i < NPAIRS) {
+		Pairs[i].A = &Sets[Test_Random() % NSETS];
+		Pairs[i].B = &Sets[Test_Random() % NSETS];
+		i++;
+	}
+	//The same set on both sides
+	Pairs[0].A = &Sets[4];
+	Pairs[0].B = &Sets[4];
+}
+
+// Runs the batch and checks every requested count and result.
+static void RunBatch(uint32_t n, bool WantCounts, bool WantResults, uint32_t nThreads) {
+	static uint32_t counts[NPAIRS];
+	static CSet results[NPAIRS];
+	uint32_t i = 0;
+	while (i < n) {
+		counts[i] = UINT32_MAX;
+		CSet_Init(&results[i], 0);
+		i++;
+	}
+	CHECK(CSet_IntersectionBatch(Pairs, n, WantCounts ? counts : NULL, WantResults ? results : NULL,
+	                             nThreads));
+	CSet expect;
+	CSet_Init(&expect, 0);
+	i = 0;
+	while (i < n) {
+		CHECK(CSet_Intersection(&expect, Pairs[i].A, Pairs[i].B));
+		if (WantCounts) {
+			CHECK(counts[i] == expect.Usage);
+		}
+		else {
+			CHECK(counts[i] == UINT32_MAX);
+		}
+		if (WantResults) {
+			CHECK(CSet_Equals(&results[i], &expect) && Test_IsProper(&results[i]));
+		}
+		else {
+			CHECK(results[i].Usage == 0);
+		}
+		free(results[i].Data);
+		i++;
+	}
+	free(expect.Data);
+}
+
+static void TestBatches(void) {
+	//An empty batch succeeds and touches nothing
+	CHECK(CSet_IntersectionBatch(Pairs, 0, NULL, NULL, 1));
+	RunBatch(0, true, true, 0);
+	const uint32_t threads[4] = { 1, 2, 5, 0 };
+	uint32_t t = 0;
+	while (t < 4) {
+		RunBatch(1, true, true, threads[t]);
+		RunBatch(7, true, false, threads[t]);
+		RunBatch(NPAIRS, false, true, threads[t]);
+		RunBatch(NPAIRS, true, true, threads[t]);
+		t++;
+	}
+}
+
+// Two threads run batches over the same operands at once; both get the
+// right counts and leave the operands unchanged.
+static uint32_t Counts[2][NPAIRS];
+static uint32_t Errors;
+
+static void* Batcher(void* Arg) {
+	uint32_t* counts = Counts[(uintptr_t)Arg];
+	uint32_t round = 0;
+	while (round < 20) {
+		if (!CSet_IntersectionBatch(Pairs, NPAIRS, counts, NULL, 3)) {
+			__atomic_add_fetch(&Errors, 1, __ATOMIC_RELAXED);
+		}
+		round++;
+	}
+	return NULL;
+}
+
+static void TestConcurrent(void) {
+	CSet before[NSETS];
+	uint32_t i = 0;
+	while (i < NSETS) {
+		CSet_Init(&before[i], 0);
+		CSet_Copy(&before[i], &Sets[i]);
+		i++;
+	}
+	pthread_t threads[2];
+	uintptr_t k = 0;
+	while (k < 2) {
+		pthread_create(&threads[k], NULL, Batcher, (void*)k);
+		k++;
+	}
+	k = 0;
+	while (k < 2) {
+		pthread_join(threads[k], NULL);
+		k++;
+	}
+	CHECK(Errors == 0);
+	CSet expect;
+	CSet_Init(&expect, 0);
+	i = 0;
+	while (i < NPAIRS) {
+		CHECK(CSet_Intersection(&expect, Pairs[i].A, Pairs[i].B));
+		CHECK(Counts[0][i] == expect.Usage && Counts[1][i] == expect.Usage);
+		i++;
+	}
+	free(expect.Data);
+	i = 0;
+	while (i < NSETS) {
+		CHECK(CSet_Equals(&before[i], &Sets[i]) && Test_IsProper(&Sets[i]));
+		free(before[i].Data);
+		i++;
+	}
+}
+
+int main(void) {
+	Test_Seed = 12345;
+	MakeOperands();
+	TestBatches();
+	TestConcurrent();
+	uint32_t i = 0;
+	while (i < NSETS) {
+		free(Sets[i].Data);
+		i++;
+	}
+	return Test_Report("test_batch");
+}
@@ -0,0 +1,403 @@
+// Behavior tests for CSetCancel and the operations that poll it: a fired
+// token stops them with *Result unchanged, or a built arena empty, and
+// reports why.
+
+#include "CSet.c"
+#include "testing.h"
+
+// Waits until at least Micros microseconds have passed.
+static void Pause(uint64_t Micros) {
+	uint64_t start = CSet_Micros();
+	while (CSet_Micros() - start < Micros) {
+		sched_yield();
+	}
+}
+
+static void TestToken(void) {
+	CSetCancel token;
+	CHECK(CSetCancel_Status(NULL) == CSET_OK);
+	CSetCancel_Init(&token, 0);
+	CHECK(CSetCancel_Status(&token) == CSET_OK);
+	CSetCancel_Cancel(&token);
+	CHECK(CSetCancel_Status(&token) == CSET_CANCELLED);
+	CSetCancel_Cancel(&token);
+	CHECK(CSetCancel_Status(&token) == CSET_CANCELLED);
+
+	CSetCancel_Init(&token, 1000);
+	CHECK(CSetCancel_Status(&token) == CSET_OK);
+	Pause(2000);
+	CHECK(CSetCancel_Status(&token) == CSET_EXPIRED);
+	//Cancellation is reported ahead of expiry
+	CSetCancel_Cancel(&token);
+	CHECK(CSetCancel_Status(&token) == CSET_CANCELLED);
+	//A long deadline does not fire
+	CSetCancel_Init(&token, (uint64_t)3600 * 1000000u);
+	CHECK(CSetCancel_Status(&token) == CSET_OK);
+}
+
+static void TestTOccurrence(void) {
+	//Values across the whole int32_t range take the merge path
+	CSet sets[3];
+	const CSet* ptrs[3];
+	uint32_t s = 0;
+	while (s < 3) {
+		Test_RandomSet(&sets[s], 60000, UINT32_MAX, INT32_MIN);
+		CSet_Insert(&sets[s], INT32_MIN);
+		CSet_Insert(&sets[s], INT32_MAX);
+		ptrs[s] = &sets[s];
+		s++;
+	}
+	CSet expect, result, before;
+	CSet_Init(&expect, 0);
+	CHECK(CSet_TOccurrence(&expect, ptrs, 3, 2, 1));
+	CHECK(expect.Usage >= 2);
+	const int32_t keep[2] = { -5, 5 };
+	Test_MakeSet(&result, keep, 2, 1);
+	Test_MakeSet(&before, keep, 2, 1);
+
+	CSetCancel token;
+	uint32_t threads = 1;
+	while (threads <= 4) {
+		CSetCancel_Init(&token, 0);
+		CSetCancel_Cancel(&token);
+		CHECK(CSet_TOccurrenceCancellable(&result, ptrs, 3, 2, threads, &token) == CSET_CANCELLED);
+		CHECK(CSet_Equals(&result, &before) && Test_IsProper(&result));
+		CSetCancel_Init(&token, 1);
+		Pause(10);
+		CHECK(CSet_TOccurrenceCancellable(&result, ptrs, 3, 2, threads, &token) == CSET_EXPIRED);
+		CHECK(CSet_Equals(&result, &before));
+		//A token that does not fire changes nothing
+		CSetCancel_Init(&token, 0);
+		CHECK(CSet_TOccurrenceCancellable(&result, ptrs, 3, 2, threads, &token) == CSET_OK);
+		CHECK(CSet_Equals(&result, &expect) && Test_IsProper(&result));
+		CHECK(CSet_Copy(&result, &before));
+		CHECK(CSet_TOccurrenceCancellable(&result, ptrs, 3, 2, threads, NULL) == CSET_OK);
+		CHECK(CSet_Equals(&result, &expect));
+		CHECK(CSet_Copy(&result, &before));
+		threads *= 2;
+	}
+	//The counting path polls too
+	CSet dense[2];
+	const CSet* dptrs[2];
+	Test_RandomSet(&dense[0], 50000, 60000, -30000);
+	Test_RandomSet(&dense[1], 50000, 60000, -30000);
+	dptrs[0] = &dense[0];
+	dptrs[1] = &dense[1];
+	CSetCancel_Init(&token, 0);
+	CSetCancel_Cancel(&token);
+	CHECK(CSet_TOccurrenceCancellable(&result, dptrs, 2, 1, 1, &token) == CSET_CANCELLED);
+	CHECK(CSet_Equals(&result, &before));
+	//T of 0 is refused; T past N gives the empty set
+	CHECK(CSet_TOccurrenceCancellable(&result, ptrs, 3, 0, 1, NULL) == CSET_FAILED);
+	CHECK(CSet_Equals(&result, &before));
+	CHECK(CSet_TOccurrenceCancellable(&result, ptrs, 3, 4, 1, NULL) == CSET_OK);
+	CHECK(result.Usage == 0 && Test_IsProper(&result));
+
+	s = 0;
+	while (s < 3) {
+		free(sets[s].Data);
+		s++;
+	}
+	free(dense[0].Data);
+	free(dense[1].Data);
+	free(expect.Data);
+	free(result.Data);
+	free(before.Data);
+}
+
+static void TestJobs(void) {
+	CSet a, b, expect, result, before;
+	Test_RandomSet(&a, 100000, 200000, 0);
+	Test_RandomSet(&b, 100000, 200000, 0);
+	CSet_Init(&expect, 0);
+	CHECK(CSet_SymDifference(&expect, &a, &b));
+	const int32_t keep[3] = { INT32_MIN, 0, INT32_MAX };
+	Test_MakeSet(&result, keep, 3, 0);
+	Test_MakeSet(&before, keep, 3, 0);
+
+	//A stopped job keeps its progress and can be resumed
+	CSetCancel token;
+	CSetCancel_Init(&token, 0);
+	CSetJob job;
+	CHECK(CSetJob_Init(&job, CSETJOB_SYMDIFFERENCE, &result, &a, &b));
+	CHECK(!CSetJob_Step(&job, 10000, 0));
+	CSetCancel_Cancel(&token);
+	CHECK(CSetJob_Run(&job, &token) == CSET_CANCELLED);
+	CHECK(job.Processed == 10000);
+	CHECK(CSet_Equals(&result, &before));
+	CSetCancel_Init(&token, 1);
+	Pause(10);
+	CHECK(CSetJob_Run(&job, &token) == CSET_EXPIRED);
+	CHECK(CSet_Equals(&result, &before));
+	CHECK(CSetJob_Run(&job, NULL) == CSET_OK);
+	CHECK(CSet_Equals(&result, &expect) && Test_IsProper(&result));
+	CHECK(CSetJob_Run(&job, &token) == CSET_OK);
+	CHECK(CSet_Copy(&result, &before));
+
+	//One-shot runs leave Result alone unless they complete
+	CSetCancel_Init(&token, 0);
+	CSetCancel_Cancel(&token);
+	uint32_t op = 0;
+	while (op < 3) {
+		CHECK(CSet_RunCancellable((CSetJobOp)op, &result, &a, &b, &token) == CSET_CANCELLED);
+		CHECK(CSet_Equals(&result, &before));
+		op++;
+	}
+	CHECK(CSet_RunCancellable(CSETJOB_SYMDIFFERENCE, &result, &a, &b, NULL) == CSET_OK);
+	CHECK(CSet_Equals(&result, &expect));
+	CSetCancel_Init(&token, 0);
+	CHECK(CSet_RunCancellable(CSETJOB_COPY, &result, &a, NULL, &token) == CSET_OK);
+	CHECK(CSet_Equals(&result, &a));
+	//Result may be an operand
+	CHECK(CSet_RunCancellable(CSETJOB_INTERSECTION, &a, &a, &a, NULL) == CSET_OK);
+	CHECK(CSet_Equals(&a, &result) && Test_IsProper(&a));
+	free(a.Data);
+	free(b.Data);
+	free(expect.Data);
+	free(result.Data);
+	free(before.Data);
+}
+
+// A token cancelled from another thread stops a running operation, which
+// either completed first or left its destination unchanged.
+static CSetCancel Token;
+
+static void* Canceller(void* Arg) {
+	(void)Arg;
+	Pause(200);
+	CSetCancel_Cancel(&Token);
+	return NULL;
+}
+
+static void TestConcurrent(void) {
+	CSet a, b, expect, result;
+	Test_RandomSet(&a, 400000, 800000, 0);
+	Test_RandomSet(&b, 400000, 800000, 0);
+	CSet_Init(&expect, 0);
+	CHECK(CSet_SymDifference(&expect, &a, &b));
+	uint32_t cancelled = 0;
+	uint32_t round = 0;
+	//The race goes either way, so keep going until a cancellation lands
+	while (round < 20 || (cancelled == 0 && round < 1000)) {
+		CSet_Init(&result, 0);
+		CSetCancel_Init(&Token, 0);
+		pthread_t thread;
+		pthread_create(&thread, NULL, Canceller, NULL);
+		CSetStatus status = CSet_RunCancellable(CSETJOB_SYMDIFFERENCE, &result, &a, &b, &Token);
+		pthread_join(thread, NULL);
+		if (status == CSET_CANCELLED) {
+			CHECK(result.Usage == 0 && Test_IsProper(&result));
+			cancelled++;
+		}
+		else {
+			CHECK(status == CSET_OK && CSet_Equals(&result, &expect));
+		}
+		free(result.Data);
+		round++;
+	}
+	CHECK(cancelled > 0);
+	free(a.Data);
+	free(b.Data);
+	free(expect.Data);
+}
+
+// Returns true if two arenas hold the same sets.
+static bool SameArena(const CSetArena* const pX, const CSetArena* const pY) {
+	if (pX->Count != pY->Count || pX->nValues != pY->nValues) return false;
+	if (memcmp(pX->Offsets, pY->Offsets, ((size_t)pX->Count + 1) * sizeof(uint64_t)) != 0) return false;
+	return pX->nValues == 0 || memcmp(pX->Values, pY->Values, (size_t)pX->nValues * sizeof(int32_t)) == 0;
+}
+
+// Returns true if a stopped build left an empty arena.
+static bool IsEmptyArena(const CSetArena* const pArena) {
+	return pArena->Count == 0 && pArena->nValues == 0 && pArena->Offsets[0] == 0;
+}
+
+#define ROWS  40000
+#define PAIRS 800000
+
+static void TestArena(void) {
+	//Rows of 0 to 40 values, with the extremes among them
+	CSet* sets = (CSet*)malloc(ROWS * sizeof(CSet));
+	const CSet** ptrs = (const CSet**)malloc(ROWS * sizeof(CSet*));
+	uint32_t* rows = (uint32_t*)malloc(PAIRS * sizeof(uint32_t));
+	int32_t* cols = (int32_t*)malloc(PAIRS * sizeof(int32_t));
+	uint32_t i = 0;
+	while (i < ROWS) {
+		Test_RandomSet(&sets[i], Test_Random() % 41, 100000, -50000);
+		if (i % 7 == 0) CSet_Insert(&sets[i], INT32_MIN);
+		if (i % 11 == 0) CSet_Insert(&sets[i], INT32_MAX);
+		ptrs[i] = &sets[i];
+		i++;
+	}
+	i = 0;
+	while (i < PAIRS) {
+		rows[i] = Test_Random() % ROWS;
+		cols[i] = (int32_t)(Test_Random() % 1000) - 500;
+		i++;
+	}
+	CSetArena expect, expectPairs, arena;
+	CHECK(CSetArena_Build(&expect, ptrs, ROWS, 1));
+	CHECK(CSetArena_BuildFromPairs(&expectPairs, ROWS, rows, cols, PAIRS, 1));
+
+	CSetCancel token;
+	uint32_t threads = 1;
+	while (threads <= 4) {
+		CSetCancel_Init(&token, 0);
+		CSetCancel_Cancel(&token);
+		CHECK(CSetArena_BuildCancellable(&arena, ptrs, ROWS, threads, &token) == CSET_CANCELLED);
+		CHECK(IsEmptyArena(&arena));
+		CSetArena_Free(&arena);
+		CHECK(CSetArena_BuildFromPairsCancellable(&arena, ROWS, rows, cols, PAIRS, threads, &token) ==
+		      CSET_CANCELLED);
+		CHECK(IsEmptyArena(&arena));
+		CSetArena_Free(&arena);
+		CSetCancel_Init(&token, 1);
+		Pause(10);
+		CHECK(CSetArena_BuildCancellable(&arena, ptrs, ROWS, threads, &token) == CSET_EXPIRED);
+		CHECK(IsEmptyArena(&arena));
+		CSetArena_Free(&arena);
+		CHECK(CSetArena_BuildFromPairsCancellable(&arena, ROWS, rows, cols, PAIRS, threads, &token) ==
+		      CSET_EXPIRED);
+		CHECK(IsEmptyArena(&arena));
+		CSetArena_Free(&arena);
+		//A token that does not fire changes nothing
+		CSetCancel_Init(&token, 0);
+		CHECK(CSetArena_BuildCancellable(&arena, ptrs, ROWS, threads, &token) == CSET_OK);
+		CHECK(SameArena(&arena, &expect));
+		CSetArena_Free(&arena);
+		CHECK(CSetArena_BuildFromPairsCancellable(&arena, ROWS, rows, cols, PAIRS, threads, &token) ==
+		      CSET_OK);
+		CHECK(SameArena(&arena, &expectPairs));
+		CSetArena_Free(&arena);
+		threads *= 2;
+	}
+	//No sets at all
+	CSetCancel_Init(&token, 0);
+	CHECK(CSetArena_BuildCancellable(&arena, ptrs, 0, 2, &token) == CSET_OK && arena.Count == 0);
+	CSetArena_Free(&arena);
+
+	//Cancelled from another thread part way through
+	uint32_t cancelled = 0;
+	uint32_t round = 0;
+	while (round < 10 || (cancelled == 0 && round < 1000)) {
+		CSetCancel_Init(&Token, 0);
+		pthread_t thread;
+		pthread_create(&thread, NULL, Canceller, NULL);
+		CSetStatus status = (round % 2 == 0)
+		                    ? CSetArena_BuildFromPairsCancellable(&arena, ROWS, rows, cols, PAIRS, 2, &Token)
+		                    : CSetArena_BuildCancellable(&arena, ptrs, ROWS, 2, &Token);
+		pthread_join(thread, NULL);
+		if (status == CSET_CANCELLED) {
+			CHECK(IsEmptyArena(&arena));
+			cancelled++;
+		}
+		else {
+			CHECK(status == CSET_OK && SameArena(&arena, (round % 2 == 0) ? &expectPairs : &expect));
+		}
+		CSetArena_Free(&arena);
+		round++;
+	}
+	CHECK(cancelled > 0);
+
+	CSetArena_Free(&expect);
+	CSetArena_Free(&expectPairs);
+	i = 0;
+	while (i < ROWS) {
+		free(sets[i].Data);
+		i++;
+	}
+	free(sets);
+	free(ptrs);
+	free(rows);
+	free(cols);
+}
+
+static void TestJoin(void) {
+	//Small A sets over a narrow range, so many are contained in the B sets
+	const uint32_t nA = 20000;
+	const uint32_t nB = 4000;
+	CSet* sets = (CSet*)malloc((nA + nB) * sizeof(CSet));
+	const CSet** ptrs = (const CSet**)malloc((nA + nB) * sizeof(CSet*));
+	uint32_t i = 0;
+	while (i < nA + nB) {
+		if (i < nA) {
+			Test_RandomSet(&sets[i], Test_Random() % 4, 64, -32);
+		}
+		else {
+			Test_RandomSet(&sets[i], 40, 64, -32);
+		}
+		if (i % 13 == 0) CSet_Insert(&sets[i], INT32_MAX);
+		ptrs[i] = &sets[i];
+		i++;
+	}
+	CSetPair* expect;
+	uint64_t nExpect;
+	CHECK(CSet_ContainmentJoin(ptrs, nA, ptrs + nA, nB, &expect, &nExpect, 1));
+	CHECK(nExpect > 0);
+
+	CSetCancel token;
+	CSetPair* pairs;
+	uint64_t count;
+	uint32_t threads = 1;
+	while (threads <= 4) {
+		CSetCancel_Init(&token, 0);
+		CSetCancel_Cancel(&token);
+		CHECK(CSet_ContainmentJoinCancellable(ptrs, nA, ptrs + nA, nB, &pairs, &count, threads, &token) ==
+		      CSET_CANCELLED);
+		CHECK(pairs == NULL && count == 0);
+		CSetCancel_Init(&token, 1);
+		Pause(10);
+		CHECK(CSet_ContainmentJoinCancellable(ptrs, nA, ptrs + nA, nB, &pairs, &count, threads, &token) ==
+		      CSET_EXPIRED);
+		CHECK(pairs == NULL && count == 0);
+		CSetCancel_Init(&token, 0);
+		CHECK(CSet_ContainmentJoinCancellable(ptrs, nA, ptrs + nA, nB, &pairs, &count, threads, &token) ==
+		      CSET_OK);
+		CHECK(count == nExpect && memcmp(pairs, expect, (size_t)count * sizeof(CSetPair)) == 0);
+		free(pairs);
+		threads *= 2;
+	}
+
+	//Cancelled from another thread part way through
+	uint32_t cancelled = 0;
+	uint32_t round = 0;
+	while (round < 10 || (cancelled == 0 && round < 1000)) {
+		CSetCancel_Init(&Token, 0);
+		pthread_t thread;
+		pthread_create(&thread, NULL, Canceller, NULL);
+		CSetStatus status =
+		    CSet_ContainmentJoinCancellable(ptrs, nA, ptrs + nA, nB, &pairs, &count, 2, &Token);
+		pthread_join(thread, NULL);
+		if (status == CSET_CANCELLED) {
+			CHECK(pairs == NULL && count == 0);
+			cancelled++;
+		}
+		else {
+			CHECK(status == CSET_OK && count == nExpect);
+			CHECK(memcmp(pairs, expect, (size_t)count * sizeof(CSetPair)) == 0);
+			free(pairs);
+		}
+		round++;
+	}
+	CHECK(cancelled > 0);
+
+	free(expect);
+	i = 0;
+	while (i < nA + nB) {
+		free(sets[i].Data);
+		i++;
+	}
+	free(sets);
+	free(ptrs);
+}
+
+int main(void) {
+	TestToken();
+	TestTOccurrence();
+	TestJobs();
+	TestConcurrent();
+	TestArena();
+	TestJoin();
+	return Test_Report("test_cancel");
+}
@@ -0,0 +1,98 @@
+// Behavior tests for CSet_ContainmentJoin().
+
+#include "CSet.c"
+#include "testing.h"
+
+// Checks the join of As and Bs against Test_IsSubset() on every pair.
+static void CheckJoin(const CSet* const* As, uint32_t nA, const CSet* const* Bs, uint32_t nB,
+                      uint32_t nThreads) {
+	CSetPair* pairs = (CSetPair*)1;
+	uint64_t count = 1;
+	CHECK(CSet_ContainmentJoin(As, nA, Bs, nB, &pairs, &count, nThreads));
+	CHECK((count == 0) == (pairs == NULL));
+	uint64_t k = 0;
+	uint32_t a = 0;
+	while (a < nA) {
+		uint32_t b = 0;
+		while (b < nB) {
+			if (Test_IsSubset(As[a], Bs[b])) {
+				CHECK(k < count && pairs[k].A == a && pairs[k].B == b);
+				k++;
+			}
+			b++;
+		}
+		a++;
+	}
+	CHECK(k == count);
+	free(pairs);
+}
+
+static void TestEdges(void) {
+	CSet empty, ends, mid;
+	CSet_Init(&empty, 0);
+	int32_t values[3] = { INT32_MIN, 0, INT32_MAX };
+	Test_MakeSet(&ends, values, 3, 0);
+	Test_MakeSet(&mid, values + 1, 1, 2);
+	const CSet* sets[3] = { &empty, &ends, &mid };
+	CSetPair* pairs;
+	uint64_t count;
+	CHECK(CSet_ContainmentJoin(sets, 0, sets, 3, &pairs, &count, 1));
+	CHECK(pairs == NULL && count == 0);
+	CHECK(CSet_ContainmentJoin(sets, 3, sets, 0, &pairs, &count, 1));
+	CHECK(pairs == NULL && count == 0);
+	//The empty set is a subset of everything, including itself
+	CheckJoin(sets, 3, sets, 3, 1);
+	CheckJoin(sets, 3, sets, 3, 3);
+	free(ends.Data);
+	free(mid.Data);
+}
+
+// Long posting lists, so the gallop runs many strides: every B holds a
+// common core, and the A sets pick values from it plus a few rare ones.
+static void TestRandom(uint32_t nA, uint32_t nB, uint32_t Range, uint32_t nThreads) {
+	CSet* as = (CSet*)malloc(nA * sizeof(CSet));
+	CSet* bs = (CSet*)malloc(nB * sizeof(CSet));
+	const CSet** pa = (const CSet**)malloc(nA * sizeof(CSet*));
+	const CSet** pb = (const CSet**)malloc(nB * sizeof(CSet*));
+	uint32_t i = 0;
+	while (i < nB) {
+		Test_RandomSet(&bs[i], Range / 2 + Test_Random() % Range, Range, INT32_MAX - (int64_t)Range + 1);
+		pb[i] = &bs[i];
+		i++;
+	}
+	i = 0;
+	while (i < nA) {
+		Test_RandomSet(&as[i], Test_Random() % 4, Range, INT32_MAX - (int64_t)Range + 1);
+		pa[i] = &as[i];
+		i++;
+	}
+	CheckJoin(pa, nA, pb, nB, nThreads);
+	//Aliased collections: each set against the whole collection
+	CheckJoin(pb, nB, pb, nB, nThreads);
+	i = 0;
+	while (i < nA) {
+		free(as[i].Data);
+		i++;
+	}
+	i = 0;
+	while (i < nB) {
+		free(bs[i].Data);
+		i++;
+	}
+	free(as);
+	free(bs);
+	free(pa);
+	free(pb);
+}
+
+int main(void) {
+	TestEdges();
+	uint32_t round = 0;
+	while (round < 20) {
+		TestRandom(50, 80, 16, 1);
+		TestRandom(40, 60, 64, 4);
+		round++;
+	}
+	TestRandom(400, 2000, 24, 0);
+	return Test_Report("test_containment");
+}
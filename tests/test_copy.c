@@ -0,0 +1,206 @@
+// Behavior tests for CSet_Copy, CSet_CopyParallel and the streaming
+// (cache-bypassing) paths that large copies, unions and splits take.
+
+#include "CSet.c"
+#include "testing.h"
+
+// Makes a set of the N values Base, Base + Step, ... with Slack FILLER
+// cells after them.
+static void MakeRun(CSet* const pSet, uint32_t N, int64_t Base, uint32_t Step, uint32_t Slack) {
+	CSet_Init(pSet, N + Slack);
+	uint32_t i = 0;
+	while (i < N) {
+		pSet->Data[i] = (int32_t)(Base + (int64_t)i * Step);
+		i++;
+	}
+	pSet->Usage = N;
+}
+
+// Returns true if *pCopy is an exact copy of *pSource, tail included.
+static bool SameCells(const CSet* const pCopy, const CSet* const pSource) {
+	if (pCopy->Usage != pSource->Usage || pCopy->Capacity != pSource->Capacity) return false;
+	if (pCopy->Capacity > 0 && pCopy->Data == pSource->Data) return false;
+	return Test_IsProper(pCopy) && CSet_Equals(pCopy, pSource);
+}
+
+static void TestCopy(void) {
+	//Empty sets, with and without cells, and the extreme values
+	const int32_t ends[2] = { INT32_MIN, INT32_MAX };
+	CSet sources[4];
+	Test_MakeSet(&sources[0], NULL, 0, 0);
+	Test_MakeSet(&sources[1], NULL, 0, 3);
+	Test_MakeSet(&sources[2], ends, 2, 0);
+	Test_MakeSet(&sources[3], ends, 2, 5);
+	uint32_t s = 0;
+	while (s < 4) {
+		CSet copy;
+		Test_RandomSet(&copy, 20, 100, 0);
+		CHECK(CSet_Copy(&copy, &sources[s]));
+		CHECK(SameCells(&copy, &sources[s]));
+		CHECK(CSet_CopyParallel(&copy, &sources[s], 4));
+		CHECK(SameCells(&copy, &sources[s]));
+		free(copy.Data);
+		s++;
+	}
+	//Copying a set onto itself changes nothing
+	const int32_t* data = sources[3].Data;
+	CHECK(CSet_Copy(&sources[3], &sources[3]) && sources[3].Data == data);
+	CHECK(CSet_CopyParallel(&sources[3], &sources[3], 2) && sources[3].Data == data);
+	CHECK(Test_Holds(&sources[3], ends, 2) && sources[3].Capacity == 7);
+	s = 0;
+	while (s < 4) {
+		free(sources[s].Data);
+		s++;
+	}
+
+	//Sizes around the streaming threshold, with odd lengths so the vector
+	//loops leave a scalar tail, and long FILLER tails streamed on their own
+	const uint32_t usages[5] = { CSET_STREAM_MIN - 1, CSET_STREAM_MIN, CSET_STREAM_MIN + 3, 5, 0 };
+	const uint32_t slacks[5] = { 1, 2, 7, CSET_STREAM_MIN + 1, CSET_STREAM_MIN * 2 };
+	uint32_t u = 0;
+	while (u < 5) {
+		CSet source, copy;
+		MakeRun(&source, usages[u], INT32_MIN, 3, slacks[u]);
+		CSet_Init(&copy, 0);
+		CHECK(CSet_Copy(&copy, &source));
+		CHECK(SameCells(&copy, &source));
+		free(copy.Data);
+		free(source.Data);
+		u++;
+	}
+}
+
+static void TestCopyParallel(void) {
+	//Large enough to be split across every thread count tried; Usage ends
+	//inside a slice, on a slice edge, at 0 and at Capacity - 1
+	const uint32_t capacity = 8 * CSET_STREAM_MIN + 13;
+	const uint32_t usages[5] = { 3 * CSET_STREAM_MIN + 5, 4 * CSET_STREAM_MIN, 0, capacity - 1, 17 };
+	const uint32_t threads[5] = { 1, 2, 3, 7, 0 };
+	uint32_t u = 0;
+	while (u < 5) {
+		CSet source;
+		MakeRun(&source, usages[u], -(int64_t)usages[u], 2, capacity - usages[u]);
+		uint32_t t = 0;
+		while (t < 5) {
+			CSet copy;
+			Test_RandomSet(&copy, 10, 100, 0);
+			CHECK(CSet_CopyParallel(&copy, &source, threads[t]));
+			CHECK(SameCells(&copy, &source));
+			free(copy.Data);
+			t++;
+		}
+		free(source.Data);
+		u++;
+	}
+}
+
+// Checks *pResult against the union of *pA and *pB, value by value.
+static bool IsUnion(const CSet* const pResult, const CSet* const pA, const CSet* const pB) {
+	if (!Test_IsProper(pResult) || pResult->Capacity != pA->Capacity + pB->Capacity) return false;
+	uint32_t i = 0;
+	while (i < pResult->Usage) {
+		int32_t v = pResult->Data[i];
+		if (!CSet_Contains(pA, v) && !CSet_Contains(pB, v)) return false;
+		i++;
+	}
+	const CSet* sides[2] = { pA, pB };
+	uint32_t s = 0;
+	while (s < 2) {
+		i = 0;
+		while (i < sides[s]->Usage) {
+			if (!CSet_Contains(pResult, sides[s]->Data[i])) return false;
+			i++;
+		}
+		s++;
+	}
+	return true;
+}
+
+static void TestStreamingOps(void) {
+	//Range-disjoint halves, the first of odd length, so the second is
+	//written to a destination that is not 16-byte aligned
+	CSet low, high, result;
+	MakeRun(&low, CSET_STREAM_MIN + 1, INT32_MIN, 5, 2);
+	MakeRun(&high, CSET_STREAM_MIN + 6, 0, 7, 0);
+	CSet_Insert(&high, INT32_MAX);
+	CSet_Init(&result, 0);
+	CHECK(CSet_Union(&result, &low, &high));
+	CHECK(IsUnion(&result, &low, &high));
+	CHECK(CSet_Union(&result, &high, &low));
+	CHECK(IsUnion(&result, &low, &high));
+	CHECK(CSet_Concat(&result, &low, &high));
+	CHECK(result.Usage == low.Usage + high.Usage && Test_IsProper(&result));
+	CHECK(CSet_SymDifference(&result, &high, &low));
+	CHECK(IsUnion(&result, &low, &high));
+
+	//Overlapping sets take the staged merge writer
+	CSet a, b;
+	MakeRun(&a, CSET_STREAM_MIN, -1000000, 3, 1);
+	MakeRun(&b, CSET_STREAM_MIN + 77, -1000001, 2, 0);
+	CHECK(CSet_Union(&result, &a, &b));
+	CHECK(IsUnion(&result, &a, &b));
+	//The result may be an operand
+	CHECK(CSet_Union(&a, &a, &b));
+	CHECK(CSet_Equals(&a, &result) && Test_IsProper(&a));
+
+	//Splitting a large set streams both halves
+	CSet lo, hi;
+	CSet_Init(&lo, 0);
+	CSet_Init(&hi, 0);
+	CHECK(CSet_Split(&result, 1, &lo, &hi));
+	CHECK(Test_IsProper(&lo) && Test_IsProper(&hi));
+	CHECK(lo.Usage + hi.Usage == result.Usage && lo.Usage > CSET_STREAM_MIN);
+	CHECK(CSet_Concat(&lo, &lo, &hi));
+	CHECK(CSet_Equals(&lo, &result));
+	free(low.Data);
+	free(high.Data);
+	free(result.Data);
+	free(a.Data);
+	free(b.Data);
+	free(lo.Data);
+	free(hi.Data);
+}
+
+// Several threads copy the same source at once, in parallel themselves.
+static CSet     Source;
+static uint32_t Errors;
+
+static void* Copier(void* Arg) {
+	uint32_t nThreads = 1 + (uint32_t)(uintptr_t)Arg;
+	uint32_t round = 0;
+	while (round < 3) {
+		CSet copy;
+		CSet_Init(&copy, 0);
+		if (!CSet_CopyParallel(&copy, &Source, nThreads) || !SameCells(&copy, &Source)) {
+			__atomic_add_fetch(&Errors, 1, __ATOMIC_RELAXED);
+		}
+		free(copy.Data);
+		round++;
+	}
+	return NULL;
+}
+
+static void TestConcurrent(void) {
+	MakeRun(&Source, 2 * CSET_STREAM_MIN + 9, 1, 11, 4 * CSET_STREAM_MIN);
+	pthread_t threads[3];
+	uintptr_t i = 0;
+	while (i < 3) {
+		pthread_create(&threads[i], NULL, Copier, (void*)i);
+		i++;
+	}
+	i = 0;
+	while (i < 3) {
+		pthread_join(threads[i], NULL);
+		i++;
+	}
+	CHECK(Errors == 0);
+	free(Source.Data);
+}
+
+int main(void) {
+	TestCopy();
+	TestCopyParallel();
+	TestStreamingOps();
+	TestConcurrent();
+	return Test_Report("test_copy");
+}
@@ -0,0 +1,123 @@
+// Behavior tests for CDeltaSet.
+
+#include "CSet.c"
+#include "testing.h"
+
+// Values are -3000, -2995, ..., 11995 and the two extremes, one per slot.
+#define RANGE  3000
+#define SCALE  5
+#define OFFSET (-RANGE)
+#define SLOTS  (RANGE + 2)
+
+// Checks every view of *pDelta against the plain set *pMirror.
+static void CheckDelta(const CDeltaSet* const pDelta, const CSet* const pMirror) {
+	CHECK(CDeltaSet_Usage(pDelta) == pMirror->Usage);
+	CDeltaCursor cur;
+	CDeltaCursor_Init(&cur, pDelta);
+	uint32_t i = 0;
+	int32_t v;
+	bool same = true;
+	while (CDeltaCursor_Next(&cur, &v)) {
+		same = same && i < pMirror->Usage && pMirror->Data[i] == v;
+		i++;
+	}
+	CHECK(same && i == pMirror->Usage);
+	CHECK(!CDeltaCursor_Next(&cur, &v));
+	CSet out;
+	CSet_Init(&out, 3);
+	CHECK(CDeltaSet_Materialize(pDelta, &out));
+	CHECK(Test_IsProper(&out) && CSet_Equals(&out, pMirror));
+	CHECK(out.Capacity == pMirror->Usage + 1);
+	free(out.Data);
+	uint32_t slot = 0;
+	while (slot < SLOTS) {
+		int32_t value = Test_EdgeValue(slot, RANGE, SCALE, OFFSET);
+		same = same && CDeltaSet_Contains(pDelta, value) == CSet_Contains(pMirror, value);
+		slot += 7;
+	}
+	same = same && CDeltaSet_Contains(pDelta, INT32_MIN) == CSet_Contains(pMirror, INT32_MIN);
+	same = same && CDeltaSet_Contains(pDelta, INT32_MAX) == CSet_Contains(pMirror, INT32_MAX);
+	CHECK(same);
+}
+
+static void TestEmptyBase(void) {
+	CSet base, mirror;
+	CSet_Init(&base, 0);
+	CSet_Init(&mirror, 0);
+	CDeltaSet delta;
+	CHECK(CDeltaSet_Init(&delta, &base));
+	CheckDelta(&delta, &mirror);
+	CHECK(!CDeltaSet_Remove(&delta, 0));
+	CHECK(CDeltaSet_Insert(&delta, INT32_MIN));
+	CHECK(!CDeltaSet_Insert(&delta, INT32_MIN));
+	CHECK(CDeltaSet_Insert(&delta, INT32_MAX));
+	CSet_Insert(&mirror, INT32_MIN);
+	CSet_Insert(&mirror, INT32_MAX);
+	CheckDelta(&delta, &mirror);
+	CHECK(CDeltaSet_Rebase(&delta));
+	CHECK(delta.OwnsBase && delta.Added.Usage == 0);
+	CheckDelta(&delta, &mirror);
+	CHECK(CDeltaSet_Remove(&delta, INT32_MIN));
+	CSet_Remove(&mirror, INT32_MIN);
+	CheckDelta(&delta, &mirror);
+	CDeltaSet_Free(&delta);
+	free(mirror.Data);
+}
+
+// Random edits drive the differences past the rebase threshold many times.
+static void TestRandom(void) {
+	int32_t values[SLOTS];
+	uint32_t n = 0;
+	uint32_t slot = 0;
+	while (slot < SLOTS) {
+		if (Test_Random() % 2) values[n++] = Test_EdgeValue(slot, RANGE, SCALE, OFFSET);
+		slot++;
+	}
+	CSet base, mirror;
+	Test_MakeSet(&base, values, n, 0);
+	Test_MakeSet(&mirror, values, n, 0);
+	CDeltaSet delta;
+	CHECK(CDeltaSet_Init(&delta, &base));
+	bool rebased = false;
+	uint32_t k = 0;
+	while (k < 20000) {
+		int32_t v = Test_EdgeValue(Test_Random() % SLOTS, RANGE, SCALE, OFFSET);
+		if (Test_Random() % 2) {
+			CHECK(CDeltaSet_Insert(&delta, v) == !CSet_Contains(&mirror, v));
+			CSet_Insert(&mirror, v);
+		}
+		else {
+			CHECK(CDeltaSet_Remove(&delta, v) == CSet_Contains(&mirror, v));
+			CSet_Remove(&mirror, v);
+		}
+		rebased = rebased || delta.OwnsBase;
+		if (k % 1000 == 0) CheckDelta(&delta, &mirror);
+		k++;
+	}
+	CHECK(rebased);
+	CheckDelta(&delta, &mirror);
+	CDeltaSet_Free(&delta);
+
+	//Encode the mirror against the original base, and against itself
+	CHECK(CDeltaSet_Encode(&delta, &base, &mirror));
+	CHECK(delta.OwnsBase || delta.Base == &base);
+	CheckDelta(&delta, &mirror);
+	CDeltaSet_Free(&delta);
+	CHECK(CDeltaSet_Encode(&delta, &mirror, &mirror));
+	CHECK(delta.Added.Usage == 0 && delta.Removed.Usage == 0);
+	CheckDelta(&delta, &mirror);
+	CDeltaSet_Free(&delta);
+	CSet empty;
+	CSet_Init(&empty, 0);
+	CHECK(CDeltaSet_Encode(&delta, &base, &empty));
+	CheckDelta(&delta, &empty);
+	CDeltaSet_Free(&delta);
+	free(base.Data);
+	free(mirror.Data);
+}
+
+int main(void) {
+	TestEmptyBase();
+	TestRandom();
+	return Test_Report("test_delta");
+}
@@ -0,0 +1,102 @@
+// Behavior tests for CSet_Diff() and CSetDiffCursor.
+
+#include "CSet.c"
+#include "testing.h"
+
+static void RandomSet(CSet* const pSet) {
+	uint32_t kind = Test_Random() % 3;
+	if (kind == 0) {
+		Test_RandomSet(pSet, Test_Random() % 300, 400, -200);
+	}
+	else if (kind == 1) {
+		Test_RandomSet(pSet, Test_Random() % 300, UINT32_MAX, INT32_MIN);
+	}
+	else {
+		int32_t ends[4] = { INT32_MIN, INT32_MIN + 1, INT32_MAX - 1, INT32_MAX };
+		Test_MakeSet(pSet, ends + Test_Random() % 2, 1 + Test_Random() % 3, 1);
+	}
+}
+
+// Checks *pAdded and *pRemoved against CSet_Contains() on both versions,
+// and against the cursor.
+static void CheckDiff(const CSet* const pOld, const CSet* const pNew, const CSet* const pAdded,
+                      const CSet* const pRemoved) {
+	CHECK(Test_IsProper(pAdded) && Test_IsProper(pRemoved));
+	bool same = true;
+	uint32_t i = 0;
+	while (i < pAdded->Usage) {
+		same = same && CSet_Contains(pNew, pAdded->Data[i]) && !CSet_Contains(pOld, pAdded->Data[i]);
+		i++;
+	}
+	i = 0;
+	while (i < pRemoved->Usage) {
+		same = same && CSet_Contains(pOld, pRemoved->Data[i]) && !CSet_Contains(pNew, pRemoved->Data[i]);
+		i++;
+	}
+	//Every value of either version is accounted for
+	CSet both;
+	CSet_Init(&both, 0);
+	CSet_Intersection(&both, pOld, pNew);
+	same = same && both.Usage + pRemoved->Usage == pOld->Usage && both.Usage + pAdded->Usage == pNew->Usage;
+	free(both.Data);
+	CHECK(same);
+
+	CSetDiffCursor cur;
+	CSetDiffCursor_Init(&cur, pOld, pNew);
+	uint32_t a = 0, r = 0;
+	int32_t v;
+	bool side;
+	int64_t last = INT64_MIN;
+	while (CSetDiffCursor_Next(&cur, &v, &side)) {
+		same = same && v > last;
+		last = v;
+		if (side) {
+			same = same && a < pAdded->Usage && pAdded->Data[a++] == v;
+		}
+		else {
+			same = same && r < pRemoved->Usage && pRemoved->Data[r++] == v;
+		}
+	}
+	CHECK(same && a == pAdded->Usage && r == pRemoved->Usage);
+}
+
+int main(void) {
+	uint32_t round = 0;
+	while (round < 1000) {
+		CSet old, now, added, removed;
+		RandomSet(&old);
+		RandomSet(&now);
+		CSet_Init(&added, 2);
+		CSet_Init(&removed, 0);
+		CHECK(CSet_Diff(&old, &now, &added, &removed));
+		CheckDiff(&old, &now, &added, &removed);
+		CHECK(added.Capacity == now.Usage + 1 && removed.Capacity == old.Usage + 1);
+
+		//Replaying the diff on the old version gives the new one
+		CSet replay;
+		Test_MakeSet(&replay, old.Data, old.Usage, 0);
+		CHECK(CSet_ApplyDelta(&replay, added.Data, added.Usage, removed.Data, removed.Usage, NULL, NULL));
+		CHECK(CSet_Equals(&replay, &now));
+		free(replay.Data);
+
+		//Outputs aliasing the inputs
+		CSet oldCopy, nowCopy;
+		Test_MakeSet(&oldCopy, old.Data, old.Usage, 0);
+		Test_MakeSet(&nowCopy, now.Data, now.Usage, 0);
+		CHECK(CSet_Diff(&oldCopy, &nowCopy, &oldCopy, &nowCopy));
+		CHECK(CSet_Equals(&oldCopy, &added) && CSet_Equals(&nowCopy, &removed));
+		free(oldCopy.Data);
+		free(nowCopy.Data);
+
+		//A version against itself has no differences
+		CHECK(CSet_Diff(&old, &old, &added, &removed));
+		CHECK(added.Usage == 0 && removed.Usage == 0);
+		CheckDiff(&old, &old, &added, &removed);
+		free(old.Data);
+		free(now.Data);
+		free(added.Data);
+		free(removed.Data);
+		round++;
+	}
+	return Test_Report("test_diff");
+}
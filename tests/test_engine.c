@@ -0,0 +1,222 @@
+// Behavior tests for CSetEngine: every operation against its synchronous
+// counterpart, batching of many small requests, and several threads
+// submitting while another collects.
+
+#include "CSet.c"
+#include "testing.h"
+
+// Checks a completed request against the synchronous operation it stands for.
+static bool Matches(const CSetRequest* const pReq) {
+	if (!pReq->Ok) return false;
+	if (pReq->Op == CSETASYNC_CONTAINS) {
+		uint32_t i = 0;
+		while (i < pReq->nValues) {
+			if (pReq->Found[i] != CSet_Contains(pReq->A, pReq->Values[i])) return false;
+			i++;
+		}
+		return true;
+	}
+	CSet expect;
+	CSet_Init(&expect, 0);
+	bool ok;
+	if (pReq->Op == CSETASYNC_INTERSECTION) {
+		ok = CSet_Intersection(&expect, pReq->A, pReq->B);
+	}
+	else if (pReq->Op == CSETASYNC_SYMDIFFERENCE) {
+		ok = CSet_SymDifference(&expect, pReq->A, pReq->B);
+	}
+	else {
+		ok = CSet_Copy(&expect, pReq->A);
+	}
+	ok = ok && CSet_Equals(&expect, pReq->Result) && Test_IsProper(pReq->Result);
+	free(expect.Data);
+	return ok;
+}
+
+#define NSETS 6
+#define NREQS 300
+
+static void TestOperations(uint32_t nThreads) {
+	CSet sets[NSETS];
+	const int32_t ends[2] = { INT32_MIN, INT32_MAX };
+	Test_MakeSet(&sets[0], NULL, 0, 1);
+	Test_MakeSet(&sets[1], ends, 2, 0);
+	Test_RandomSet(&sets[2], 50, UINT32_MAX, INT32_MIN);
+	Test_RandomSet(&sets[3], 3000, 6000, -3000);
+	Test_RandomSet(&sets[4], 40000, 80000, -40000);
+	Test_RandomSet(&sets[5], 10, 20, 0);
+	CSet_Insert(&sets[5], INT32_MAX);
+
+	CSetEngine engine;
+	CHECK(CSetEngine_Init(&engine, nThreads));
+	CHECK(engine.nThreads > 0);
+	CHECK(CSetEngine_Poll(&engine) == NULL);
+	CHECK(CSetEngine_Wait(&engine) == NULL);
+
+	static CSetRequest reqs[NREQS];
+	static CSet results[NREQS];
+	static bool found[NREQS][16];
+	int32_t values[16] = { INT32_MIN, INT32_MAX, 0, 1, -1, 5, 7, -2999, 2999, 100,
+	                       -100, 39999, -40000, 12, 13, 14 };
+	uint32_t i = 0;
+	while (i < NREQS) {
+		CSet_Init(&results[i], 0);
+		reqs[i].Op = (CSetAsyncOp)(i % 4);
+		reqs[i].A = &sets[i % NSETS];
+		reqs[i].B = &sets[(i / NSETS) % NSETS];
+		reqs[i].Result = &results[i];
+		reqs[i].Values = values;
+		reqs[i].nValues = 1 + i % 16;
+		reqs[i].Found = found[i];
+		reqs[i].Tag = (void*)(uintptr_t)(i + 1);
+		reqs[i].Ok = false;
+		CHECK(CSetEngine_Submit(&engine, &reqs[i]));
+		i++;
+	}
+	//Every request comes back exactly once, with its tag untouched
+	static bool seen[NREQS];
+	memset(seen, 0, sizeof(seen));
+	uint32_t n = 0;
+	CSetRequest* pReq = CSetEngine_Wait(&engine);
+	while (pReq != NULL) {
+		uint32_t k = (uint32_t)(pReq - reqs);
+		CHECK(k < NREQS && !seen[k] && pReq->Tag == (void*)(uintptr_t)(k + 1));
+		seen[k] = true;
+		CHECK(Matches(pReq));
+		n++;
+		pReq = CSetEngine_Wait(&engine);
+	}
+	CHECK(n == NREQS);
+	CHECK(CSetEngine_Poll(&engine) == NULL);
+
+	//A result may alias its operand
+	CSet own;
+	Test_RandomSet(&own, 500, 1000, 0);
+	CSet expect;
+	CSet_Init(&expect, 0);
+	CSet_Intersection(&expect, &own, &sets[3]);
+	CSetRequest alias;
+	alias.Op = CSETASYNC_INTERSECTION;
+	alias.Result = &own;
+	alias.A = &own;
+	alias.B = &sets[3];
+	CHECK(CSetEngine_Submit(&engine, &alias));
+	CHECK(CSetEngine_Wait(&engine) == &alias && alias.Ok);
+	CHECK(CSet_Equals(&own, &expect) && Test_IsProper(&own));
+	CSetEngine_Free(&engine);
+
+	i = 0;
+	while (i < NREQS) {
+		free(results[i].Data);
+		i++;
+	}
+	i = 0;
+	while (i < NSETS) {
+		free(sets[i].Data);
+		i++;
+	}
+	free(own.Data);
+	free(expect.Data);
+}
+
+// Requests still queued when the engine is freed are run first.
+static void TestFreeDrains(void) {
+	CSet a, b;
+	Test_RandomSet(&a, 20000, 40000, 0);
+	Test_RandomSet(&b, 20000, 40000, 0);
+	CSetEngine engine;
+	CHECK(CSetEngine_Init(&engine, 1));
+	static CSetRequest reqs[32];
+	static CSet results[32];
+	uint32_t i = 0;
+	while (i < 32) {
+		CSet_Init(&results[i], 0);
+		reqs[i].Op = CSETASYNC_SYMDIFFERENCE;
+		reqs[i].A = &a;
+		reqs[i].B = &b;
+		reqs[i].Result = &results[i];
+		reqs[i].Ok = false;
+		CHECK(CSetEngine_Submit(&engine, &reqs[i]));
+		i++;
+	}
+	CSetEngine_Free(&engine);
+	i = 0;
+	while (i < 32) {
+		CHECK(reqs[i].Ok && CSet_Equals(&results[i], &results[0]));
+		i++;
+	}
+	i = 0;
+	while (i < 32) {
+		free(results[i].Data);
+		i++;
+	}
+	free(a.Data);
+	free(b.Data);
+}
+
+// Submitters share the engine with a collector that polls.
+#define SUBMITTERS 4
+#define PER_THREAD 500
+
+static CSetEngine Engine;
+static CSet       Operand;
+static uint32_t   Errors;
+static const int32_t Probes[4] = { INT32_MIN, 0, 999, INT32_MAX };
+
+static void* Submitter(void* Arg) {
+	CSetRequest* reqs = (CSetRequest*)Arg;
+	uint32_t i = 0;
+	while (i < PER_THREAD) {
+		reqs[i].Op = CSETASYNC_CONTAINS;
+		reqs[i].A = &Operand;
+		reqs[i].Values = Probes;
+		reqs[i].nValues = 4;
+		reqs[i].Found = (bool*)malloc(4 * sizeof(bool));
+		if (!CSetEngine_Submit(&Engine, &reqs[i])) {
+			__atomic_add_fetch(&Errors, 1, __ATOMIC_RELAXED);
+		}
+		i++;
+	}
+	return NULL;
+}
+
+static void TestConcurrent(void) {
+	Test_RandomSet(&Operand, 1000, 2000, 0);
+	CHECK(CSetEngine_Init(&Engine, 3));
+	static CSetRequest reqs[SUBMITTERS][PER_THREAD];
+	pthread_t threads[SUBMITTERS];
+	uint32_t i = 0;
+	while (i < SUBMITTERS) {
+		pthread_create(&threads[i], NULL, Submitter, reqs[i]);
+		i++;
+	}
+	uint32_t collected = 0;
+	while (collected < SUBMITTERS * PER_THREAD) {
+		CSetRequest* pReq = CSetEngine_Poll(&Engine);
+		if (pReq == NULL) {
+			sched_yield();
+			continue;
+		}
+		CHECK(Matches(pReq));
+		free(pReq->Found);
+		collected++;
+	}
+	i = 0;
+	while (i < SUBMITTERS) {
+		pthread_join(threads[i], NULL);
+		i++;
+	}
+	CHECK(Errors == 0);
+	CHECK(CSetEngine_Poll(&Engine) == NULL && CSetEngine_Wait(&Engine) == NULL);
+	CSetEngine_Free(&Engine);
+	free(Operand.Data);
+}
+
+int main(void) {
+	TestOperations(0);
+	TestOperations(1);
+	TestOperations(4);
+	TestFreeDrains();
+	TestConcurrent();
+	return Test_Report("test_engine");
+}
@@ -0,0 +1,168 @@
+// Behavior tests for the change feed, including a concurrent producer and
+// consumer.
+
+#include "CSet.c"
+#include "testing.h"
+
+// Applies the feed to *pReplica, copying *pSet when a resync is needed.
+// Returns whether a resync happened.
+static bool Catchup(CSetFeed* const pFeed, const CSet* const pSet, CSet* const pReplica) {
+	bool resync = false;
+	CHECK(CSetFeed_Apply(pFeed, pReplica, &resync));
+	if (resync) {
+		CHECK(CSet_Copy(pReplica, pSet));
+		CSetFeed_Resynced(pFeed);
+	}
+	return resync;
+}
+
+static void TestSequential(void) {
+	CSet set, replica;
+	CSet_Init(&set, 0);
+	CSet_Init(&replica, 0);
+	CSetFeed feed;
+	CHECK(CSetFeed_Init(&feed, 64));
+	CHECK(CSet_AttachFeed(&set, &feed));
+	CHECK(!Catchup(&feed, &set, &replica));
+
+	//Inserts, removes and a delta, including the extreme values
+	CSetFeedRecord recs[8];
+	CHECK(CSet_Insert(&set, INT32_MIN));
+	CHECK(CSet_Insert(&set, INT32_MAX));
+	CHECK(!CSet_Insert(&set, INT32_MAX));
+	CHECK(CSetFeed_Poll(&feed, recs, 8) == 2);
+	CHECK(recs[0].Op == CSETFEED_INSERT && recs[0].Value == INT32_MIN && recs[0].Generation == 0);
+	CHECK(recs[1].Value == INT32_MAX && recs[1].Generation == 1);
+	CHECK(CSetFeed_Poll(&feed, recs, 8) == 0);
+	//Polled records are gone, so the replica has to be copied
+	CHECK(Catchup(&feed, &set, &replica));
+	CHECK(CSet_Equals(&replica, &set));
+
+	int32_t ins[3] = { 5, 6, 7 };
+	int32_t rem[2] = { INT32_MIN, 6 };
+	CHECK(CSet_ApplyDelta(&set, ins, 3, rem, 2, NULL, NULL));
+	CHECK(CSet_Remove(&set, INT32_MAX));
+	CHECK(!Catchup(&feed, &set, &replica));
+	CHECK(CSet_Equals(&replica, &set));
+
+	//Whole-set replacement forces a resync
+	CSet other;
+	Test_RandomSet(&other, 50, 1000, 0);
+	CHECK(CSet_Copy(&set, &other));
+	CHECK(CSet_Insert(&set, -1));
+	CHECK(Catchup(&feed, &set, &replica));
+	CHECK(CSet_Equals(&replica, &set));
+
+	//Overflowing the ring drops records and forces a resync
+	int32_t v = 0;
+	while (v < 100) {
+		CSet_Insert(&set, v * 13);
+		v++;
+	}
+	CHECK(Catchup(&feed, &set, &replica));
+	CHECK(CSet_Equals(&replica, &set));
+	CHECK(CSet_Remove(&set, 13));
+	CHECK(!Catchup(&feed, &set, &replica));
+	CHECK(CSet_Equals(&replica, &set));
+
+	//Detached sets record nothing
+	CHECK(CSet_DetachFeed(&set));
+	CHECK(!CSet_DetachFeed(&set));
+	CSet_Insert(&set, 999999);
+	CHECK(CSetFeed_Poll(&feed, recs, 8) == 0);
+	CSetFeed_Free(&feed);
+	free(set.Data);
+	free(replica.Data);
+	free(other.Data);
+}
+
+static void TestLimit(void) {
+	static CSet sets[CSET_MAX_FEEDS + 1];
+	static CSetFeed feeds[CSET_MAX_FEEDS + 1];
+	uint32_t i = 0;
+	while (i <= CSET_MAX_FEEDS) {
+		CSet_Init(&sets[i], 0);
+		CSetFeed_Init(&feeds[i], 16);
+		CHECK(CSet_AttachFeed(&sets[i], &feeds[i]) == (i < CSET_MAX_FEEDS));
+		i++;
+	}
+	CHECK(CSet_DetachFeed(&sets[3]));
+	CHECK(CSet_AttachFeed(&sets[CSET_MAX_FEEDS], &feeds[CSET_MAX_FEEDS]));
+	CSet_Insert(&sets[CSET_MAX_FEEDS], 1);
+	CSet_Insert(&sets[3], 1);
+	CSetFeedRecord rec;
+	CHECK(CSetFeed_Poll(&feeds[CSET_MAX_FEEDS], &rec, 1) == 1 && rec.Value == 1);
+	CHECK(CSetFeed_Poll(&feeds[3], &rec, 1) == 0);
+	i = 0;
+	while (i <= CSET_MAX_FEEDS) {
+		CSet_DetachFeed(&sets[i]);
+		CSetFeed_Free(&feeds[i]);
+		free(sets[i].Data);
+		i++;
+	}
+	CHECK(CSet_FeedSlots == 0);
+}
+
+// The producer changes the set under Lock, which the consumer also takes
+// to copy the set when it has to resync; replaying never takes it.
+static CSet Tracked;
+static CSetFeed Feed;
+static pthread_mutex_t Lock = PTHREAD_MUTEX_INITIALIZER;
+static uint32_t Finished;
+
+static void* Producer(void* Arg) {
+	(void)Arg;
+	uint32_t seed = 99;
+	uint32_t k = 0;
+	while (k < 200000) {
+		seed = seed * 1103515245u + 12345u;
+		int32_t v = (int32_t)((seed >> 8) % 5000) - 2500;
+		pthread_mutex_lock(&Lock);
+		if (seed & 1) {
+			CSet_Insert(&Tracked, v);
+		}
+		else {
+			CSet_Remove(&Tracked, v);
+		}
+		pthread_mutex_unlock(&Lock);
+		k++;
+	}
+	__atomic_store_n(&Finished, 1, __ATOMIC_RELEASE);
+	return NULL;
+}
+
+static void TestConcurrent(void) {
+	CSet replica;
+	CSet_Init(&Tracked, 0);
+	CSet_Init(&replica, 0);
+	CHECK(CSetFeed_Init(&Feed, 1024));
+	CHECK(CSet_AttachFeed(&Tracked, &Feed));
+	pthread_t producer;
+	pthread_create(&producer, NULL, Producer, NULL);
+	uint32_t applied = 0;
+	while (!__atomic_load_n(&Finished, __ATOMIC_ACQUIRE)) {
+		bool resync = false;
+		CHECK(CSetFeed_Apply(&Feed, &replica, &resync));
+		if (resync) {
+			pthread_mutex_lock(&Lock);
+			CHECK(CSet_Copy(&replica, &Tracked));
+			CSetFeed_Resynced(&Feed);
+			pthread_mutex_unlock(&Lock);
+		}
+		applied++;
+	}
+	pthread_join(producer, NULL);
+	Catchup(&Feed, &Tracked, &replica);
+	CHECK(CSet_Equals(&replica, &Tracked) && applied > 0);
+	CSet_DetachFeed(&Tracked);
+	CSetFeed_Free(&Feed);
+	free(Tracked.Data);
+	free(replica.Data);
+}
+
+int main(void) {
+	TestSequential();
+	TestLimit();
+	TestConcurrent();
+	return Test_Report("test_feed");
+}
@@ -0,0 +1,158 @@
+// Behavior tests for CSet_Hash() and the interning table.
+
+#include "CSet.c"
+#include "testing.h"
+
+#define NPOOL   24
+#define THREADS 8
+
+static CSetInternTable Table;
+static CSet Pool[NPOOL];
+
+static void TestBasics(void) {
+	int32_t values[4] = { INT32_MIN, -1, 0, INT32_MAX };
+	CSet a, b, c, empty, wide;
+	Test_MakeSet(&a, values, 4, 0);
+	Test_MakeSet(&b, values, 4, 5);
+	Test_MakeSet(&c, values, 3, 0);
+	CSet_Init(&empty, 0);
+	CSet_Init(&wide, 9);
+	CHECK(CSet_Hash(&a) == CSet_Hash(&b));
+	CHECK(CSet_Hash(&a) != CSet_Hash(&c));
+	CHECK(CSet_Hash(&empty) == CSet_Hash(&wide));
+
+	CHECK(CSetInternTable_Init(&Table));
+	const CSet* pa = CSet_Intern(&Table, &a);
+	const CSet* pb = CSet_Intern(&Table, &b);
+	const CSet* pc = CSet_Intern(&Table, &c);
+	const CSet* pe = CSet_Intern(&Table, &empty);
+	const CSet* pw = CSet_Intern(&Table, &wide);
+	CHECK(pa != NULL && pa == pb && pa != pc);
+	CHECK(pe != NULL && pe == pw && pe != pa);
+	CHECK(Test_Holds(pa, values, 4) && pa->Capacity == 4);
+	CHECK(pe->Usage == 0 && pe->Capacity == 0);
+	CHECK(Table.Count == 3);
+
+	//The copy lives until its last reference goes
+	CSet_Release(&Table, pa);
+	CHECK(Table.Count == 3 && Test_Holds(pb, values, 4));
+	CSet_Release(&Table, pb);
+	CHECK(Table.Count == 2);
+	CSet_Release(&Table, pc);
+	CSet_Release(&Table, pe);
+	CSet_Release(&Table, pw);
+	CHECK(Table.Count == 0);
+
+	//Interning a shared copy returns the copy itself
+	pa = CSet_Intern(&Table, &a);
+	CHECK(CSet_Intern(&Table, pa) == pa);
+	CSet_Release(&Table, pa);
+	CSet_Release(&Table, pa);
+	CSetInternTable_Free(&Table);
+	free(a.Data);
+	free(b.Data);
+	free(c.Data);
+	free(wide.Data);
+}
+
+// Enough distinct sets that the table grows several times.
+static void TestGrowth(void) {
+	CHECK(CSetInternTable_Init(&Table));
+	const CSet** handles = (const CSet**)malloc(2000 * sizeof(CSet*));
+	uint32_t i = 0;
+	while (i < 2000) {
+		int32_t values[2] = { (int32_t)i, INT32_MAX };
+		CSet s;
+		Test_MakeSet(&s, values, 2, i % 3);
+		handles[i] = CSet_Intern(&Table, &s);
+		CHECK(handles[i] != NULL && CSet_Equals(handles[i], &s));
+		free(s.Data);
+		i++;
+	}
+	CHECK(Table.Count == 2000 && Table.nBuckets >= 1000);
+	i = 0;
+	while (i < 2000) {
+		int32_t values[2] = { (int32_t)i, INT32_MAX };
+		CSet s;
+		Test_MakeSet(&s, values, 2, 0);
+		const CSet* again = CSet_Intern(&Table, &s);
+		CHECK(again == handles[i]);
+		CSet_Release(&Table, again);
+		CSet_Release(&Table, handles[i]);
+		free(s.Data);
+		i++;
+	}
+	CHECK(Table.Count == 0);
+	free(handles);
+	CSetInternTable_Free(&Table);
+}
+
+// Threads intern and release sets from a shared pool; equal contents must
+// always come back as the same handle while any reference is held.
+static void* Interner(void* Arg) {
+	uint32_t seed = (uint32_t)(uintptr_t)Arg;
+	uint32_t* errors = (uint32_t*)calloc(1, sizeof(uint32_t));
+	const CSet* held[NPOOL] = { NULL };
+	uint32_t k = 0;
+	while (k < 20000) {
+		seed = seed * 1103515245u + 12345u;
+		uint32_t i = (seed >> 16) % NPOOL;
+		if (held[i] == NULL) {
+			held[i] = CSet_Intern(&Table, &Pool[i]);
+			if (held[i] == NULL || !CSet_Equals(held[i], &Pool[i])) (*errors)++;
+		}
+		else {
+			const CSet* again = CSet_Intern(&Table, &Pool[i]);
+			if (again != held[i]) (*errors)++;
+			CSet_Release(&Table, again);
+			CSet_Release(&Table, held[i]);
+			held[i] = NULL;
+		}
+		k++;
+	}
+	uint32_t i = 0;
+	while (i < NPOOL) {
+		if (held[i] != NULL) CSet_Release(&Table, held[i]);
+		i++;
+	}
+	return errors;
+}
+
+static void TestConcurrent(void) {
+	uint32_t i = 0;
+	while (i < NPOOL) {
+		//Pairs of pool entries have equal contents and different capacities
+		int32_t values[3] = { (int32_t)(i / 2), INT32_MIN, (int32_t)(i / 2) * 7 };
+		Test_MakeSet(&Pool[i], values, 3, i % 2);
+		i++;
+	}
+	CHECK(CSetInternTable_Init(&Table));
+	pthread_t threads[THREADS];
+	uint32_t t = 0;
+	while (t < THREADS) {
+		pthread_create(&threads[t], NULL, Interner, (void*)(uintptr_t)(t + 1));
+		t++;
+	}
+	t = 0;
+	while (t < THREADS) {
+		void* errors;
+		pthread_join(threads[t], &errors);
+		CHECK(*(uint32_t*)errors == 0);
+		free(errors);
+		t++;
+	}
+	CHECK(Table.Count == 0);
+	CSetInternTable_Free(&Table);
+	i = 0;
+	while (i < NPOOL) {
+		free(Pool[i].Data);
+		i++;
+	}
+}
+
+int main(void) {
+	TestBasics();
+	TestGrowth();
+	TestConcurrent();
+	return Test_Report("test_intern");
+}
@@ -0,0 +1,151 @@
+// Behavior tests for CSetJob: each operation run a slice at a time must
+// leave *Result untouched until it completes, then match the operation
+// run in one go.
+
+#include "CSet.c"
+#include "testing.h"
+
+// Sets *pExpect to Op applied to *pA and *pB in one go.
+static void Expected(CSetJobOp Op, CSet* const pExpect, const CSet* const pA, const CSet* const pB) {
+	if (Op == CSETJOB_INTERSECTION) {
+		CHECK(CSet_Intersection(pExpect, pA, pB));
+	}
+	else if (Op == CSETJOB_SYMDIFFERENCE) {
+		CHECK(CSet_SymDifference(pExpect, pA, pB));
+	}
+	else {
+		CHECK(CSet_Copy(pExpect, pA));
+	}
+}
+
+// Runs Op in slices of Elements, checking *pResult stays as it was until
+// the job completes.
+static void RunSliced(CSetJobOp Op, const CSet* const pA, const CSet* const pB, uint32_t Elements) {
+	CSet expect, result;
+	CSet_Init(&expect, 0);
+	Expected(Op, &expect, pA, pB);
+	const int32_t before[3] = { INT32_MIN, 4, INT32_MAX };
+	Test_MakeSet(&result, before, 3, 2);
+	const int32_t* data = result.Data;
+
+	CSetJob job;
+	CHECK(CSetJob_Init(&job, Op, &result, pA, pB));
+	uint64_t processed = 0;
+	uint32_t slices = 0;
+	while (!CSetJob_Step(&job, Elements, 0)) {
+		CHECK(result.Data == data && Test_Holds(&result, before, 3));
+		CHECK(job.Processed - processed == Elements);
+		processed = job.Processed;
+		slices++;
+	}
+	CHECK(Elements == 0 || job.Processed - processed <= Elements);
+	CHECK(CSet_Equals(&result, &expect) && Test_IsProper(&result));
+	CHECK(result.Capacity == expect.Capacity);
+	//A completed job has nothing left to step or discard
+	CHECK(CSetJob_Step(&job, Elements, 0));
+	CSetJob_Abort(&job);
+	CHECK(CSet_Equals(&result, &expect));
+	//A copy handles each cell once: every member, then the padding
+	if (Op == CSETJOB_COPY && Elements == 1) {
+		CHECK(slices + 1 >= pA->Capacity);
+	}
+	free(expect.Data);
+	free(result.Data);
+}
+
+static void TestOperations(void) {
+	CSet sets[6];
+	const int32_t ends[2] = { INT32_MIN, INT32_MAX };
+	Test_MakeSet(&sets[0], NULL, 0, 1);
+	Test_MakeSet(&sets[1], ends, 2, 0);
+	Test_RandomSet(&sets[2], 300, UINT32_MAX, INT32_MIN);
+	Test_RandomSet(&sets[3], 3000, 6000, -3000);
+	Test_RandomSet(&sets[4], 5000, 6000, -3000);
+	CSet_Init(&sets[5], 0);
+	CSet_Insert(&sets[5], INT32_MIN);
+	CSet_Insert(&sets[5], 0);
+	const uint32_t slices[4] = { 1, 7, CSETJOB_CHUNK, 0 };
+	uint32_t op = 0;
+	while (op < 3) {
+		uint32_t x = 0;
+		while (x < 6) {
+			uint32_t y = 0;
+			while (y < 6) {
+				uint32_t s = 0;
+				while (s < 4) {
+					//Single-element slices on the big sets take too long
+					if (slices[s] != 1 || sets[x].Usage + sets[y].Usage < 1000) {
+						RunSliced((CSetJobOp)op, &sets[x], &sets[y], slices[s]);
+					}
+					s++;
+				}
+				y++;
+			}
+			x++;
+		}
+		op++;
+	}
+	uint32_t i = 0;
+	while (i < 6) {
+		free(sets[i].Data);
+		i++;
+	}
+}
+
+static void TestAbortAndAlias(void) {
+	CSet a, b, result, expect;
+	Test_RandomSet(&a, 20000, 40000, 0);
+	Test_RandomSet(&b, 20000, 40000, 0);
+	Test_RandomSet(&result, 10, 100, 0);
+	CSet_Init(&expect, 0);
+	CSet keep;
+	CSet_Init(&keep, 0);
+	CSet_Copy(&keep, &result);
+
+	//Aborting part way leaves Result alone and frees the partial output
+	CSetJob job;
+	CHECK(CSetJob_Init(&job, CSETJOB_SYMDIFFERENCE, &result, &a, &b));
+	CHECK(!CSetJob_Step(&job, 5000, 0));
+	CHECK(job.Processed == 5000);
+	CSetJob_Abort(&job);
+	CHECK(CSet_Equals(&result, &keep) && Test_IsProper(&result));
+	//Aborting before any step is fine too
+	CHECK(CSetJob_Init(&job, CSETJOB_COPY, &result, &a, NULL));
+	CSetJob_Abort(&job);
+	CHECK(CSet_Equals(&result, &keep));
+
+	//Result may be an operand, since it is replaced only at the end
+	Expected(CSETJOB_INTERSECTION, &expect, &a, &b);
+	CHECK(CSetJob_Init(&job, CSETJOB_INTERSECTION, &a, &a, &b));
+	while (!CSetJob_Step(&job, 333, 0)) {
+	}
+	CHECK(CSet_Equals(&a, &expect) && Test_IsProper(&a));
+	Expected(CSETJOB_SYMDIFFERENCE, &expect, &b, &b);
+	CHECK(CSetJob_Init(&job, CSETJOB_SYMDIFFERENCE, &b, &b, &b));
+	while (!CSetJob_Step(&job, 333, 0)) {
+	}
+	CHECK(b.Usage == 0 && CSet_Equals(&b, &expect) && Test_IsProper(&b));
+
+	//A time limit alone still makes progress every slice
+	free(a.Data);
+	Test_RandomSet(&a, 200000, 400000, 0);
+	Expected(CSETJOB_COPY, &expect, &a, NULL);
+	CHECK(CSetJob_Init(&job, CSETJOB_COPY, &result, &a, NULL));
+	uint64_t processed = 0;
+	while (!CSetJob_Step(&job, 0, 1)) {
+		CHECK(job.Processed > processed);
+		processed = job.Processed;
+	}
+	CHECK(CSet_Equals(&result, &expect));
+	free(a.Data);
+	free(b.Data);
+	free(result.Data);
+	free(expect.Data);
+	free(keep.Data);
+}
+
+int main(void) {
+	TestOperations();
+	TestAbortAndAlias();
+	return Test_Report("test_job");
+}
@@ -0,0 +1,158 @@
+// Behavior tests for CMultiSet.
+
+#include "CSet.c"
+#include "testing.h"
+
+#define RANGE 64
+
+// Checks that *pSet is proper and that its multiplicities match Expect[].
+static void CheckMulti(const CMultiSet* const pSet, const uint32_t* Expect) {
+	bool proper = pSet->Usage <= pSet->Capacity;
+	uint32_t i = 0;
+	while (proper && i < pSet->Usage) {
+		proper = pSet->Count[i] > 0 && (i == 0 || pSet->Data[i - 1] < pSet->Data[i]);
+		i++;
+	}
+	while (proper && i < pSet->Capacity) {
+		proper = pSet->Data[i] == INT32_MIN && pSet->Count[i] == 0;
+		i++;
+	}
+	CHECK(proper);
+	int32_t v = 0;
+	while (v < RANGE) {
+		CHECK(CMultiSet_Count(pSet, v) == Expect[v]);
+		v++;
+	}
+}
+
+static void TestEmpty(void) {
+	CMultiSet a, b, c;
+	CMultiSet_Init(&a, 0);
+	CMultiSet_Init(&b, 4);
+	CMultiSet_Init(&c, 0);
+	CHECK(a.Data == NULL && a.Count == NULL && a.Capacity == 0);
+	CHECK(CMultiSet_Count(&a, 0) == 0);
+	CHECK(CMultiSet_Decrement(&a, 0, 1) == 0);
+	CHECK(!CMultiSet_Increment(&a, 0, 0));
+
+	CHECK(CMultiSet_Union(&c, &a, &b, CMULTISET_SUM));
+	CHECK(c.Usage == 0);
+	CHECK(CMultiSet_Intersection(&c, &a, &b));
+	CHECK(c.Usage == 0);
+	CHECK(CMultiSet_Difference(&c, &b, &a));
+	CHECK(c.Usage == 0);
+
+	CSet s;
+	CSet_Init(&s, 2);
+	CHECK(CMultiSet_Support(&s, &a));
+	CHECK(s.Usage == 0);
+	free(s.Data);
+	CMultiSet_Free(&a);
+	CMultiSet_Free(&b);
+	CMultiSet_Free(&c);
+}
+
+static void TestExtremes(void) {
+	CMultiSet a;
+	CMultiSet_Init(&a, 1);
+	CHECK(CMultiSet_Increment(&a, INT32_MAX, 2));
+	CHECK(CMultiSet_Increment(&a, INT32_MIN, 3));
+	CHECK(CMultiSet_Increment(&a, 0, UINT32_MAX));
+	CHECK(CMultiSet_Increment(&a, 0, 5));
+	CHECK(a.Usage == 3 && a.Data[0] == INT32_MIN && a.Data[2] == INT32_MAX);
+	CHECK(CMultiSet_Count(&a, INT32_MIN) == 3);
+	CHECK(CMultiSet_Count(&a, INT32_MAX) == 2);
+	CHECK(CMultiSet_Count(&a, 0) == UINT32_MAX);
+
+	CMultiSet sum;
+	CMultiSet_Init(&sum, 0);
+	CHECK(CMultiSet_Union(&sum, &a, &a, CMULTISET_SUM));
+	CHECK(CMultiSet_Count(&sum, 0) == UINT32_MAX);
+	CHECK(CMultiSet_Count(&sum, INT32_MIN) == 6);
+
+	CHECK(CMultiSet_Decrement(&a, INT32_MIN, 3) == 0);
+	CHECK(CMultiSet_Count(&a, INT32_MIN) == 0);
+	CHECK(a.Usage == 2 && a.Data[0] == 0);
+	CHECK(a.Data[2] == INT32_MIN && a.Count[2] == 0);
+	CHECK(CMultiSet_Decrement(&a, INT32_MAX, 1) == 1);
+	CMultiSet_Free(&a);
+	CMultiSet_Free(&sum);
+}
+
+// Random sequences of updates and every binary operation, against arrays of
+// counts, including results that alias an operand.
+static void TestRandom(void) {
+	uint32_t round = 0;
+	while (round < 200) {
+		CMultiSet a, b, c;
+		uint32_t ra[RANGE] = { 0 }, rb[RANGE] = { 0 }, rc[RANGE];
+		CMultiSet_Init(&a, 0);
+		CMultiSet_Init(&b, 3);
+		CMultiSet_Init(&c, 0);
+		uint32_t k = 0;
+		while (k < 100) {
+			int32_t v = Test_Random() % RANGE;
+			uint32_t n = Test_Random() % 3 + 1;
+			if (Test_Random() % 3) {
+				CMultiSet_Increment(&a, v, n);
+				ra[v] += n;
+			}
+			else {
+				CHECK(CMultiSet_Decrement(&a, v, n) == (ra[v] > n ? ra[v] - n : 0));
+				ra[v] = ra[v] > n ? ra[v] - n : 0;
+			}
+			v = Test_Random() % RANGE;
+			CMultiSet_Increment(&b, v, n);
+			rb[v] += n;
+			k++;
+		}
+		CheckMulti(&a, ra);
+		CheckMulti(&b, rb);
+
+		int32_t v = 0;
+		CHECK(CMultiSet_Union(&c, &a, &b, CMULTISET_MAX));
+		while (v < RANGE) { rc[v] = ra[v] > rb[v] ? ra[v] : rb[v]; v++; }
+		CheckMulti(&c, rc);
+		CHECK(CMultiSet_Union(&c, &a, &b, CMULTISET_SUM));
+		v = 0;
+		while (v < RANGE) { rc[v] = ra[v] + rb[v]; v++; }
+		CheckMulti(&c, rc);
+		CHECK(CMultiSet_Intersection(&c, &a, &b));
+		v = 0;
+		while (v < RANGE) { rc[v] = ra[v] < rb[v] ? ra[v] : rb[v]; v++; }
+		CheckMulti(&c, rc);
+		CHECK(CMultiSet_Difference(&c, &a, &b));
+		v = 0;
+		while (v < RANGE) { rc[v] = ra[v] > rb[v] ? ra[v] - rb[v] : 0; v++; }
+		CheckMulti(&c, rc);
+
+		//Results aliasing an operand
+		CHECK(CMultiSet_Difference(&a, &a, &b));
+		CheckMulti(&a, rc);
+		CHECK(CMultiSet_Union(&b, &b, &b, CMULTISET_SUM));
+		v = 0;
+		while (v < RANGE) { rb[v] *= 2; v++; }
+		CheckMulti(&b, rb);
+		CHECK(CMultiSet_Intersection(&b, &a, &b));
+		v = 0;
+		while (v < RANGE) { rc[v] = rc[v] < rb[v] ? rc[v] : rb[v]; v++; }
+		CheckMulti(&b, rc);
+
+		CSet s;
+		CSet_Init(&s, 1);
+		CHECK(CMultiSet_Support(&s, &b));
+		CHECK(Test_IsProper(&s) && s.Usage == b.Usage);
+		free(s.Data);
+		CMultiSet_Free(&a);
+		CMultiSet_Free(&b);
+		CMultiSet_Free(&c);
+		round++;
+	}
+}
+
+int main(void) {
+	TestEmpty();
+	TestExtremes();
+	TestRandom();
+	return Test_Report("test_multiset");
+}
@@ -0,0 +1,112 @@
+// Behavior tests for CSetRIndex.
+
+#include "CSet.c"
+#include "testing.h"
+
+#define NSETS 40
+
+// Members draw from -1000, -989, ..., 1189 and the two extremes.
+#define RANGE  200
+#define SCALE  11
+#define OFFSET (-1000)
+
+// Checks every lookup against the member sets, whose ids are Ids[].
+static void CheckIndex(const CSetRIndex* const pIndex, const CSet* Sets, const int32_t* Ids, uint32_t N) {
+	CHECK(pIndex->Usage <= pIndex->Capacity);
+	uint32_t slot = 0;
+	while (slot < RANGE + 2) {
+		int32_t v = Test_EdgeValue(slot, RANGE, SCALE, OFFSET);
+		CSet expect;
+		CSet_Init(&expect, 0);
+		uint32_t s = 0;
+		while (s < N) {
+			if (CSet_Contains(&Sets[s], v)) CSet_Insert(&expect, Ids[s]);
+			s++;
+		}
+		const CSet* list = CSetRIndex_Lookup(pIndex, v);
+		if (expect.Usage == 0) {
+			CHECK(list == NULL);
+		}
+		else {
+			CHECK(list != NULL && Test_IsProper(list) && Test_Holds(list, expect.Data, expect.Usage));
+		}
+		free(expect.Data);
+		slot++;
+	}
+	CHECK(CSetRIndex_Lookup(pIndex, 2) == NULL);
+}
+
+static void TestEmpty(void) {
+	CSetRIndex index;
+	CSetRIndex_Init(&index);
+	CHECK(CSetRIndex_Lookup(&index, 0) == NULL);
+	CHECK(CSetRIndex_Build(&index, NULL, 0));
+	CHECK(index.Usage == 0 && CSetRIndex_Lookup(&index, INT32_MIN) == NULL);
+	CSetRIndex_Free(&index);
+	CSet empty;
+	CSet_Init(&empty, 0);
+	const CSet* sets[2] = { &empty, &empty };
+	CHECK(CSetRIndex_Build(&index, sets, 2));
+	CHECK(index.Usage == 0);
+	CHECK(CSetRIndex_Update(&index, 0, &empty, &empty));
+	CHECK(index.Usage == 0);
+	CSetRIndex_Free(&index);
+}
+
+static void TestRandom(void) {
+	CSet sets[NSETS];
+	const CSet* ptrs[NSETS];
+	int32_t ids[NSETS];
+	uint32_t s = 0;
+	while (s < NSETS) {
+		Test_RandomSetWithEdges(&sets[s], 39, RANGE, SCALE, OFFSET, Test_Random() % 2);
+		ptrs[s] = &sets[s];
+		ids[s] = (int32_t)s;
+		s++;
+	}
+	CSetRIndex index;
+	CHECK(CSetRIndex_Build(&index, ptrs, NSETS));
+	CheckIndex(&index, sets, ids, NSETS);
+
+	//Replace, empty and refill members; the last one moves to id INT32_MAX
+	CSet empty;
+	CSet_Init(&empty, 0);
+	CHECK(CSetRIndex_Update(&index, NSETS - 1, &sets[NSETS - 1], &empty));
+	CHECK(CSetRIndex_Update(&index, INT32_MAX, &empty, &sets[NSETS - 1]));
+	ids[NSETS - 1] = INT32_MAX;
+	CheckIndex(&index, sets, ids, NSETS);
+	uint32_t round = 0;
+	while (round < 400) {
+		s = Test_Random() % NSETS;
+		CSet next;
+		if (Test_Random() % 4 == 0) {
+			CSet_Init(&next, 0);
+		}
+		else {
+			Test_RandomSetWithEdges(&next, 39, RANGE, SCALE, OFFSET, Test_Random() % 2);
+		}
+		CHECK(CSetRIndex_Update(&index, ids[s], &sets[s], &next));
+		free(sets[s].Data);
+		sets[s] = next;
+		if (round % 20 == 0) CheckIndex(&index, sets, ids, NSETS);
+		round++;
+	}
+	CheckIndex(&index, sets, ids, NSETS);
+
+	//Emptying every member empties the index
+	s = 0;
+	while (s < NSETS) {
+		CHECK(CSetRIndex_Update(&index, ids[s], &sets[s], &empty));
+		free(sets[s].Data);
+		sets[s] = empty;
+		s++;
+	}
+	CHECK(index.Usage == 0);
+	CSetRIndex_Free(&index);
+}
+
+int main(void) {
+	TestEmpty();
+	TestRandom();
+	return Test_Report("test_rindex");
+}
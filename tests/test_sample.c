@@ -0,0 +1,144 @@
+// Behavior tests for the random sampling functions.
+
+#include "CSet.c"
+#include "testing.h"
+
+// Determines whether every member of *pSub is a member of *pSet.
+static bool Within(const CSet* const pSub, const CSet* const pSet) {
+	uint32_t i = 0;
+	while (i < pSub->Usage) {
+		if (!CSet_Contains(pSet, pSub->Data[i])) return false;
+		i++;
+	}
+	return true;
+}
+
+static void TestSample(void) {
+	uint64_t rng = 1;
+	CSet set, sample, empty;
+	int32_t values[10] = { INT32_MIN, -5, -1, 0, 1, 2, 3, 100, INT32_MAX - 1, INT32_MAX };
+	Test_MakeSet(&set, values, 10, 2);
+	CSet_Init(&sample, 0);
+	CSet_Init(&empty, 0);
+
+	CHECK(CSet_Sample(&sample, &empty, 5, &rng));
+	CHECK(sample.Usage == 0 && Test_IsProper(&sample));
+	CHECK(CSet_Sample(&sample, &set, 0, &rng));
+	CHECK(sample.Usage == 0 && Test_IsProper(&sample));
+	CHECK(CSet_Sample(&sample, &set, 50, &rng));
+	CHECK(Test_Holds(&sample, values, 10) && sample.Capacity == 10);
+
+	//Each member should be drawn in 3 of every 10 samples
+	uint32_t hits[10] = { 0 };
+	uint32_t trial = 0;
+	while (trial < 30000) {
+		CHECK(CSet_Sample(&sample, &set, 3, &rng));
+		CHECK(sample.Usage == 3 && sample.Capacity == 3 && Test_IsProper(&sample));
+		uint32_t i = 0;
+		while (i < 3) {
+			hits[CSet_LowerBound(values, 0, 10, sample.Data[i])]++;
+			i++;
+		}
+		trial++;
+	}
+	uint32_t i = 0;
+	while (i < 10) {
+		CHECK(hits[i] > 8500 && hits[i] < 9500);
+		i++;
+	}
+
+	//A large sample exercises a large position table
+	CSet big;
+	Test_RandomSet(&big, 1000000, UINT32_MAX, INT32_MIN);
+	CHECK(CSet_Sample(&sample, &big, big.Usage / 2, &rng));
+	CHECK(sample.Usage == big.Usage / 2 && Test_IsProper(&sample) && Within(&sample, &big));
+	CHECK(CSet_Sample(&sample, &big, big.Usage - 1, &rng));
+	CHECK(sample.Usage == big.Usage - 1 && Test_IsProper(&sample) && Within(&sample, &big));
+	free(big.Data);
+	free(sample.Data);
+	free(set.Data);
+}
+
+static void TestSampler(void) {
+	uint64_t rng = 7;
+	CSet a, b, empty;
+	int32_t av[2] = { INT32_MIN, INT32_MAX };
+	int32_t bv[6] = { 1, 2, 3, 4, 5, 6 };
+	Test_MakeSet(&a, av, 2, 0);
+	Test_MakeSet(&b, bv, 6, 1);
+	CSet_Init(&empty, 0);
+	int32_t v = 0;
+	CHECK(!CSet_RandomElement(&empty, &rng, &v));
+	CHECK(CSet_RandomElement(&a, &rng, &v) && (v == INT32_MIN || v == INT32_MAX));
+
+	CSetSampler sampler;
+	const CSet* sets[3] = { &a, &empty, &b };
+	CHECK(!CSetSampler_Init(&sampler, sets + 1, 1, NULL));
+	CSetSampler_Free(&sampler);
+
+	//Weighted by size: a is drawn 2 times in 8
+	CHECK(CSetSampler_Init(&sampler, sets, 3, NULL));
+	uint32_t count[3] = { 0 };
+	uint32_t k = 0;
+	while (k < 80000) {
+		uint32_t s;
+		CSetSampler_Draw(&sampler, &rng, &s, &v);
+		count[s]++;
+		CHECK(CSet_Contains(sets[s], v));
+		k++;
+	}
+	CHECK(count[1] == 0 && count[0] > 19000 && count[0] < 21000);
+	CSetSampler_Free(&sampler);
+
+	//Explicit weights: an empty set is never drawn whatever its weight
+	double weights[3] = { 3.0, 100.0, 1.0 };
+	CHECK(CSetSampler_Init(&sampler, sets, 3, weights));
+	count[0] = count[1] = count[2] = 0;
+	k = 0;
+	while (k < 80000) {
+		uint32_t s;
+		CSetSampler_Draw(&sampler, &rng, &s, &v);
+		count[s]++;
+		k++;
+	}
+	CHECK(count[1] == 0 && count[0] > 59000 && count[0] < 61000);
+	CSetSampler_Free(&sampler);
+	free(a.Data);
+	free(b.Data);
+}
+
+static void TestIntersection(void) {
+	uint64_t rng = 3;
+	CSet a, b, both, sample;
+	CSet_Init(&sample, 0);
+	uint32_t round = 0;
+	while (round < 100) {
+		//Overlaps from none to nearly all, so both the rejection and the
+		//merge paths run
+		uint32_t range = 1000 + Test_Random() % 100000;
+		Test_RandomSet(&a, Test_Random() % 2000, range, INT32_MAX - (int64_t)range + 1);
+		Test_RandomSet(&b, Test_Random() % 2000, range, INT32_MAX - (int64_t)range + 1);
+		CSet_Init(&both, 0);
+		CSet_Intersection(&both, &a, &b);
+		int32_t v;
+		bool drawn = CSet_RandomIntersectionElement(&a, &b, &rng, &v);
+		CHECK(drawn == (both.Usage > 0));
+		CHECK(!drawn || CSet_Contains(&both, v));
+		uint32_t K = Test_Random() % 50;
+		CHECK(CSet_SampleIntersection(&sample, &a, &b, K, &rng));
+		CHECK(sample.Usage == (K < both.Usage ? K : both.Usage));
+		CHECK(sample.Capacity == K && Test_IsProper(&sample) && Within(&sample, &both));
+		free(a.Data);
+		free(b.Data);
+		free(both.Data);
+		round++;
+	}
+	free(sample.Data);
+}
+
+int main(void) {
+	TestSample();
+	TestSampler();
+	TestIntersection();
+	return Test_Report("test_sample");
+}
@@ -0,0 +1,146 @@
+// Behavior tests for CSet_ContainsWith and CSet_ChooseSearchMode: both
+// search modes must agree with CSet_Contains on any data, and the hybrid
+// mode is chosen only for sets spread about evenly.
+
+#include "CSet.c"
+#include "testing.h"
+
+// Checks both modes against CSet_Contains on every member, the values
+// next to them, the gaps and the extremes.
+static void CheckModes(const CSet* const pSet) {
+	const int32_t extremes[4] = { INT32_MIN, INT32_MIN + 1, INT32_MAX - 1, INT32_MAX };
+	uint32_t e = 0;
+	while (e < 4) {
+		bool expect = CSet_Contains(pSet, extremes[e]);
+		CHECK(CSet_ContainsWith(pSet, extremes[e], CSET_SEARCH_BINARY) == expect);
+		CHECK(CSet_ContainsWith(pSet, extremes[e], CSET_SEARCH_HYBRID) == expect);
+		e++;
+	}
+	uint32_t i = 0;
+	while (i < pSet->Usage) {
+		int32_t v = pSet->Data[i];
+		CHECK(CSet_ContainsWith(pSet, v, CSET_SEARCH_HYBRID));
+		CHECK(CSet_ContainsWith(pSet, v, CSET_SEARCH_BINARY));
+		if (v > INT32_MIN) {
+			CHECK(CSet_ContainsWith(pSet, v - 1, CSET_SEARCH_HYBRID) == CSet_Contains(pSet, v - 1));
+		}
+		if (v < INT32_MAX) {
+			CHECK(CSet_ContainsWith(pSet, v + 1, CSET_SEARCH_HYBRID) == CSet_Contains(pSet, v + 1));
+		}
+		i++;
+	}
+	uint32_t k = 0;
+	while (k < 2000) {
+		int32_t v = (int32_t)Test_Random();
+		CHECK(CSet_ContainsWith(pSet, v, CSET_SEARCH_HYBRID) == CSet_Contains(pSet, v));
+		k++;
+	}
+}
+
+// Makes a set of N values Base, Base + Step, ...
+static void MakeRun(CSet* const pSet, uint32_t N, int64_t Base, uint32_t Step) {
+	CSet_Init(pSet, N + 1);
+	uint32_t i = 0;
+	while (i < N) {
+		pSet->Data[i] = (int32_t)(Base + (int64_t)i * Step);
+		i++;
+	}
+	pSet->Usage = N;
+}
+
+static void TestEvenlySpread(void) {
+	CSet set;
+	//Consecutive values, an even stride, and random values over the whole
+	//int32_t range with both extremes
+	MakeRun(&set, 50000, -25000, 1);
+	CHECK(CSet_ChooseSearchMode(&set) == CSET_SEARCH_HYBRID);
+	CheckModes(&set);
+	free(set.Data);
+	MakeRun(&set, 40000, INT32_MIN, 107000);
+	CHECK(CSet_ChooseSearchMode(&set) == CSET_SEARCH_HYBRID);
+	CheckModes(&set);
+	free(set.Data);
+	Test_RandomSet(&set, 30000, UINT32_MAX, INT32_MIN);
+	CSet_Insert(&set, INT32_MIN);
+	CSet_Insert(&set, INT32_MAX);
+	CHECK(CSet_ChooseSearchMode(&set) == CSET_SEARCH_HYBRID);
+	CheckModes(&set);
+	free(set.Data);
+}
+
+static void TestSkewed(void) {
+	//Dense values with one far outlier at each end: interpolation would
+	//badly mispredict, so bisection is chosen, and hybrid is still correct
+	CSet set;
+	MakeRun(&set, 20000, 0, 1);
+	CSet_Insert(&set, INT32_MIN);
+	CSet_Insert(&set, INT32_MAX);
+	CHECK(CSet_ChooseSearchMode(&set) == CSET_SEARCH_BINARY);
+	CheckModes(&set);
+	free(set.Data);
+
+	//Values growing geometrically
+	CSet_Init(&set, 1);
+	int64_t v = 1;
+	while (v < INT32_MAX) {
+		CSet_Insert(&set, (int32_t)v);
+		CSet_Insert(&set, (int32_t)-v);
+		v = v * 9 / 8 + 1;
+	}
+	CHECK(set.Usage > CSET_HYBRID_MIN);
+	CHECK(CSet_ChooseSearchMode(&set) == CSET_SEARCH_BINARY);
+	CheckModes(&set);
+	free(set.Data);
+
+	//Two tight clusters far apart
+	CSet_Init(&set, 1);
+	int32_t i = 0;
+	while (i < 5000) {
+		CSet_Insert(&set, INT32_MIN + i);
+		CSet_Insert(&set, INT32_MAX - i);
+		i++;
+	}
+	CHECK(CSet_ChooseSearchMode(&set) == CSET_SEARCH_BINARY);
+	CheckModes(&set);
+	free(set.Data);
+}
+
+static void TestSmall(void) {
+	//Sets too small to be worth interpolating are searched as by Contains
+	CSet set;
+	Test_MakeSet(&set, NULL, 0, 0);
+	CHECK(CSet_ChooseSearchMode(&set) == CSET_SEARCH_BINARY);
+	CHECK(!CSet_ContainsWith(&set, INT32_MIN, CSET_SEARCH_HYBRID));
+	CHECK(!CSet_ContainsWith(&set, 0, CSET_SEARCH_BINARY));
+	Test_MakeSet(&set, NULL, 0, 3);
+	CHECK(!CSet_ContainsWith(&set, INT32_MIN, CSET_SEARCH_HYBRID));
+	free(set.Data);
+	uint32_t n = 1;
+	while (n <= 64) {
+		MakeRun(&set, n, -7, 3);
+		if (n <= CSET_HYBRID_MIN) {
+			CHECK(CSet_ChooseSearchMode(&set) == CSET_SEARCH_BINARY);
+		}
+		CheckModes(&set);
+		free(set.Data);
+		n++;
+	}
+	//With the scan path off, short ranges are still finished by bisection
+	CSet_SetSmallThresholds(0, 0);
+	n = 1;
+	while (n <= 64) {
+		MakeRun(&set, n, INT32_MAX - 64, 1);
+		CheckModes(&set);
+		free(set.Data);
+		n++;
+	}
+	CSet_SetSmallThresholds(32, 16);
+}
+
+int main(void) {
+	Test_Seed = 4242;
+	TestEvenlySpread();
+	TestSkewed();
+	TestSmall();
+	return Test_Report("test_search");
+}
@@ -0,0 +1,149 @@
+// Behavior tests for CSeqSet, including one writer racing several readers
+// across growth of the set.
+
+#include "CSet.c"
+#include "testing.h"
+
+static void TestSequential(void) {
+	CSeqSet seq;
+	CHECK(CSeqSet_Init(&seq, 0));
+	int32_t out[8];
+	CHECK(!CSeqSet_Contains(&seq, 0));
+	CHECK(CSeqSet_Range(&seq, INT32_MIN, INT32_MAX, out, 8) == 0);
+	CHECK(!CSeqSet_Remove(&seq, 0));
+
+	CHECK(CSeqSet_Insert(&seq, INT32_MAX));
+	CHECK(CSeqSet_Insert(&seq, INT32_MIN));
+	CHECK(!CSeqSet_Insert(&seq, INT32_MIN));
+	CHECK(CSeqSet_Insert(&seq, 0));
+	CHECK(CSeqSet_Contains(&seq, INT32_MIN) && CSeqSet_Contains(&seq, INT32_MAX));
+	CHECK(!CSeqSet_Contains(&seq, 1));
+	CHECK(CSeqSet_Range(&seq, INT32_MIN, INT32_MAX, out, 8) == 3);
+	CHECK(out[0] == INT32_MIN && out[1] == 0 && out[2] == INT32_MAX);
+	CHECK(CSeqSet_Range(&seq, INT32_MIN, INT32_MAX, out, 2) == 2 && out[1] == 0);
+	CHECK(CSeqSet_Range(&seq, 1, INT32_MAX - 1, out, 8) == 0);
+	CHECK(CSeqSet_Range(&seq, 5, 4, out, 8) == 0);
+	CHECK(Test_IsProper(&seq.Set));
+
+	CHECK(CSeqSet_Remove(&seq, INT32_MIN));
+	CHECK(!CSeqSet_Remove(&seq, INT32_MIN));
+	CHECK(CSeqSet_Remove(&seq, INT32_MAX));
+	CHECK(!CSeqSet_Contains(&seq, INT32_MAX));
+	CHECK(CSeqSet_Range(&seq, INT32_MIN, INT32_MAX, out, 8) == 1 && out[0] == 0);
+
+	//Growth retires buffers until Free, and keeps the set proper
+	int32_t v = 1000;
+	while (v > 0) {
+		CHECK(CSeqSet_Insert(&seq, v));
+		v -= 3;
+	}
+	CHECK(seq.nRetired > 0);
+	CHECK(seq.Set.Usage == 335 && Test_IsProper(&seq.Set));
+	CHECK(CSeqSet_Range(&seq, 990, 1000, out, 8) == 4 && out[0] == 991 && out[3] == 1000);
+	CSeqSet_Free(&seq);
+	CHECK(seq.Set.Data == NULL && seq.Retired == NULL && seq.nRetired == 0);
+}
+
+// The writer toggles even values, keeping multiples of 1024 present
+// throughout; readers check those are always seen, odd values never are,
+// and every range they read is ascending and in bounds.
+#define RANGE    8192
+#define READERS  3
+#define WRITES   100000
+
+static CSeqSet  Seq;
+static CSet     Mirror;
+static uint32_t Done;
+static uint32_t Errors;
+
+static void* Writer(void* Arg) {
+	(void)Arg;
+	uint32_t seed = 7;
+	uint32_t k = 0;
+	while (k < WRITES) {
+		seed = seed * 1103515245u + 12345u;
+		int32_t v = (int32_t)((seed >> 8) % RANGE) & ~1;
+		if (v % 1024 != 0) {
+			if (seed & 0x10000) {
+				if (CSeqSet_Insert(&Seq, v) != CSet_Insert(&Mirror, v)) {
+					__atomic_add_fetch(&Errors, 1, __ATOMIC_RELAXED);
+				}
+			}
+			else if (CSeqSet_Remove(&Seq, v) != CSet_Remove(&Mirror, v)) {
+				__atomic_add_fetch(&Errors, 1, __ATOMIC_RELAXED);
+			}
+		}
+		k++;
+	}
+	return NULL;
+}
+
+static void* Reader(void* Arg) {
+	uint32_t seed = 11 + (uint32_t)(uintptr_t)Arg;
+	int32_t out[64];
+	while (!__atomic_load_n(&Done, __ATOMIC_ACQUIRE)) {
+		seed = seed * 1103515245u + 12345u;
+		int32_t v = (int32_t)((seed >> 8) % RANGE);
+		bool found = CSeqSet_Contains(&Seq, v);
+		if ((v % 1024 == 0 && !found) || ((v & 1) && found)) {
+			__atomic_add_fetch(&Errors, 1, __ATOMIC_RELAXED);
+		}
+		uint32_t n = CSeqSet_Range(&Seq, v, v + 256, out, 64);
+		uint32_t i = 0;
+		while (i < n) {
+			if (out[i] < v || out[i] > v + 256 || (out[i] & 1) || (i > 0 && out[i - 1] >= out[i])) {
+				__atomic_add_fetch(&Errors, 1, __ATOMIC_RELAXED);
+			}
+			i++;
+		}
+		//Every multiple of 1024 in range must show up unless Max cut it off
+		if (n < 64 && v % 1024 != 0 && v / 1024 != (v + 256) / 1024) {
+			int32_t m = (v / 1024 + 1) * 1024;
+			bool seen = false;
+			i = 0;
+			while (i < n) {
+				seen |= (out[i] == m);
+				i++;
+			}
+			if (m < RANGE && !seen) __atomic_add_fetch(&Errors, 1, __ATOMIC_RELAXED);
+		}
+	}
+	return NULL;
+}
+
+static void TestConcurrent(void) {
+	CHECK(CSeqSet_Init(&Seq, 2));
+	CSet_Init(&Mirror, 0);
+	int32_t v = 0;
+	while (v < RANGE) {
+		CHECK(CSeqSet_Insert(&Seq, v));
+		CSet_Insert(&Mirror, v);
+		v += 1024;
+	}
+	pthread_t writer;
+	pthread_t readers[READERS];
+	uintptr_t i = 0;
+	while (i < READERS) {
+		pthread_create(&readers[i], NULL, Reader, (void*)i);
+		i++;
+	}
+	pthread_create(&writer, NULL, Writer, NULL);
+	pthread_join(writer, NULL);
+	__atomic_store_n(&Done, 1, __ATOMIC_RELEASE);
+	i = 0;
+	while (i < READERS) {
+		pthread_join(readers[i], NULL);
+		i++;
+	}
+	CHECK(Errors == 0);
+	CHECK(CSet_Equals(&Seq.Set, &Mirror) && Test_IsProper(&Seq.Set));
+	CHECK(Seq.nRetired > 0);
+	CSeqSet_Free(&Seq);
+	free(Mirror.Data);
+}
+
+int main(void) {
+	TestSequential();
+	TestConcurrent();
+	return Test_Report("test_seqset");
+}
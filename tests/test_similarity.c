@@ -0,0 +1,100 @@
+// Behavior tests for CSetSimIndex_TopK().
+
+#include "CSet.c"
+#include "testing.h"
+
+#define NSETS 500
+
+// Sets draw from -20 ... 19 and the two extremes, so they overlap often.
+#define RANGE  40
+#define SCALE  1
+#define OFFSET (-RANGE / 2)
+
+struct Ranked {
+
+	double   Score;
+	uint32_t Id;
+};
+
+static int CompareRanked(const void* pX, const void* pY) {
+	const struct Ranked* x = (const struct Ranked*)pX;
+	const struct Ranked* y = (const struct Ranked*)pY;
+	if (x->Score != y->Score) return (x->Score < y->Score) ? 1 : -1;
+	return (x->Id > y->Id) - (x->Id < y->Id);
+}
+
+// Ranks every set that shares a value with the query, by a full scan.
+static uint32_t Expected(const CSet* Sets, const CSet* const pQuery, CSetSimilarity Measure,
+                         struct Ranked* Out) {
+	uint32_t n = 0;
+	uint32_t s = 0;
+	while (s < NSETS) {
+		CSet both;
+		CSet_Init(&both, 0);
+		CSet_Intersection(&both, &Sets[s], pQuery);
+		if (both.Usage > 0) {
+			Out[n].Score = CSet_SimScore(Measure, both.Usage, pQuery->Usage, Sets[s].Usage);
+			Out[n].Id = s;
+			n++;
+		}
+		free(both.Data);
+		s++;
+	}
+	qsort(Out, n, sizeof(struct Ranked), CompareRanked);
+	return n;
+}
+
+int main(void) {
+	static CSet sets[NSETS];
+	static const CSet* ptrs[NSETS];
+	static struct Ranked expect[NSETS];
+	uint32_t ids[NSETS];
+	double scores[NSETS];
+	uint32_t s = 0;
+	while (s < NSETS) {
+		Test_RandomSetWithEdges(&sets[s], 8, RANGE, SCALE, OFFSET, 0);
+		ptrs[s] = &sets[s];
+		s++;
+	}
+	CSetSimIndex empty;
+	CHECK(CSetSimIndex_Build(&empty, ptrs, 0, 2));
+	CHECK(CSetSimIndex_TopK(&empty, &sets[0], 5, CSET_OVERLAP, ids, scores) == 0);
+	CSetSimIndex_Free(&empty);
+
+	uint32_t parts[3] = { 1, 3, 0 };
+	uint32_t p = 0;
+	while (p < 3) {
+		CSetSimIndex index;
+		CHECK(CSetSimIndex_Build(&index, ptrs, NSETS, parts[p]));
+		uint32_t round = 0;
+		while (round < 300) {
+			CSet query;
+			Test_RandomSetWithEdges(&query, round % 3 == 0 ? 3 : 30, RANGE, SCALE, OFFSET, 0);
+			CSetSimilarity measure = (round % 2) ? CSET_JACCARD : CSET_OVERLAP;
+			uint32_t K = 1 + Test_Random() % 30;
+			uint32_t n = Expected(sets, &query, measure, expect);
+			uint32_t r = CSetSimIndex_TopK(&index, &query, K, measure, ids, scores);
+			CHECK(r == (K < n ? K : n));
+			//Ties are broken by index, so the answer is unique
+			uint32_t i = 0;
+			while (i < r) {
+				CHECK(ids[i] == expect[i].Id && scores[i] == expect[i].Score);
+				i++;
+			}
+			CHECK(CSetSimIndex_TopK(&index, &query, 0, measure, ids, scores) == 0);
+			free(query.Data);
+			round++;
+		}
+		CSet none;
+		CSet_Init(&none, 0);
+		CHECK(CSetSimIndex_TopK(&index, &none, 5, CSET_JACCARD, ids, scores) == 0);
+		CSetSimIndex_Free(&index);
+		p++;
+	}
+	s = 0;
+	while (s < NSETS) {
+		free(sets[s].Data);
+		s++;
+	}
+	return Test_Report("test_similarity");
+}
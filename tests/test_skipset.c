@@ -0,0 +1,186 @@
+// Behavior tests for CSkipSet, including a stress test in which many
+// threads insert, remove and look up at once, both on values only they
+// change and on values all of them fight over.
+
+#include "CSet.c"
+#include "testing.h"
+
+static void TestSequential(void) {
+	CSkipSet skip;
+	CHECK(CSkipSet_Init(&skip));
+	CSet snap;
+	CSet_Init(&snap, 0);
+	CHECK(!CSkipSet_Contains(&skip, 0));
+	CHECK(!CSkipSet_Remove(&skip, 0));
+	CHECK(CSkipSet_Snapshot(&skip, &snap));
+	CHECK(snap.Usage == 0 && Test_IsProper(&snap));
+
+	CHECK(CSkipSet_Insert(&skip, INT32_MAX));
+	CHECK(CSkipSet_Insert(&skip, INT32_MIN));
+	CHECK(!CSkipSet_Insert(&skip, INT32_MAX));
+	CHECK(CSkipSet_Contains(&skip, INT32_MIN) && CSkipSet_Contains(&skip, INT32_MAX));
+	CHECK(!CSkipSet_Contains(&skip, 0));
+	CHECK(CSkipSet_Snapshot(&skip, &snap));
+	const int32_t ends[2] = { INT32_MIN, INT32_MAX };
+	CHECK(Test_Holds(&snap, ends, 2));
+	CHECK(CSkipSet_Remove(&skip, INT32_MIN));
+	CHECK(!CSkipSet_Remove(&skip, INT32_MIN));
+	CHECK(!CSkipSet_Contains(&skip, INT32_MIN));
+	//A removed value can come back
+	CHECK(CSkipSet_Insert(&skip, INT32_MIN));
+	CHECK(CSkipSet_Contains(&skip, INT32_MIN));
+
+	//Random changes against a CSet
+	CSet mirror;
+	CSet_Init(&mirror, 0);
+	CSet_Insert(&mirror, INT32_MIN);
+	CSet_Insert(&mirror, INT32_MAX);
+	Test_Seed = 5;
+	uint32_t k = 0;
+	while (k < 20000) {
+		int32_t v = (int32_t)(Test_Random() % 3000) - 1500;
+		if (Test_Random() & 1) {
+			CHECK(CSkipSet_Insert(&skip, v) == CSet_Insert(&mirror, v));
+		}
+		else {
+			CHECK(CSkipSet_Remove(&skip, v) == CSet_Remove(&mirror, v));
+		}
+		k++;
+	}
+	int32_t v = -1600;
+	while (v < 1600) {
+		CHECK(CSkipSet_Contains(&skip, v) == CSet_Contains(&mirror, v));
+		v++;
+	}
+	CHECK(CSkipSet_Snapshot(&skip, &snap));
+	CHECK(CSet_Equals(&snap, &mirror) && Test_IsProper(&snap));
+	CSkipSet_Free(&skip);
+	CHECK(skip.Head == NULL && skip.Chunks == NULL);
+	free(snap.Data);
+	free(mirror.Data);
+}
+
+// Each thread owns the values congruent to its number modulo THREADS,
+// below OWNED, and checks them against its own mirror; all threads also
+// insert and remove the SHARED values above OWNED, counting the calls
+// that succeeded, and a snapshot thread copies the set throughout.
+#define THREADS 8
+#define OWNED   (THREADS * 512)
+#define SHARED  64
+#define STEPS   40000
+
+static CSkipSet Skip;
+static uint32_t Done;
+static uint32_t Errors;
+static int64_t  Balance[SHARED];   // successful inserts less removes
+
+static void* Worker(void* Arg) {
+	uint32_t id = (uint32_t)(uintptr_t)Arg;
+	uint32_t seed = 17 + id;
+	CSet mirror;
+	CSet_Init(&mirror, 0);
+	uint32_t k = 0;
+	while (k < STEPS) {
+		seed ^= seed << 13;
+		seed ^= seed >> 17;
+		seed ^= seed << 5;
+		uint32_t pick = seed % 8;
+		if (pick < 3) {
+			//An owned value: the results must match the mirror exactly
+			int32_t v = (int32_t)(((seed >> 8) % (OWNED / THREADS)) * THREADS + id);
+			bool same;
+			if (pick == 0) {
+				same = (CSkipSet_Insert(&Skip, v) == CSet_Insert(&mirror, v));
+			}
+			else if (pick == 1) {
+				same = (CSkipSet_Remove(&Skip, v) == CSet_Remove(&mirror, v));
+			}
+			else {
+				same = (CSkipSet_Contains(&Skip, v) == CSet_Contains(&mirror, v));
+			}
+			if (!same) __atomic_add_fetch(&Errors, 1, __ATOMIC_RELAXED);
+		}
+		else {
+			uint32_t s = (seed >> 8) % SHARED;
+			int32_t v = OWNED + (int32_t)s;
+			if (pick < 5) {
+				if (CSkipSet_Insert(&Skip, v)) __atomic_add_fetch(&Balance[s], 1, __ATOMIC_RELAXED);
+			}
+			else if (pick < 7) {
+				if (CSkipSet_Remove(&Skip, v)) __atomic_sub_fetch(&Balance[s], 1, __ATOMIC_RELAXED);
+			}
+			else {
+				CSkipSet_Contains(&Skip, v);
+			}
+		}
+		k++;
+	}
+	//What this thread owns is left exactly as its mirror says
+	int32_t v = (int32_t)id;
+	while (v < OWNED) {
+		if (CSkipSet_Contains(&Skip, v) != CSet_Contains(&mirror, v)) {
+			__atomic_add_fetch(&Errors, 1, __ATOMIC_RELAXED);
+		}
+		v += THREADS;
+	}
+	free(mirror.Data);
+	return NULL;
+}
+
+static void* Snapshotter(void* Arg) {
+	(void)Arg;
+	CSet snap;
+	CSet_Init(&snap, 0);
+	while (!__atomic_load_n(&Done, __ATOMIC_ACQUIRE)) {
+		if (!CSkipSet_Snapshot(&Skip, &snap) || !Test_IsProper(&snap)) {
+			__atomic_add_fetch(&Errors, 1, __ATOMIC_RELAXED);
+		}
+	}
+	free(snap.Data);
+	return NULL;
+}
+
+static void TestConcurrent(void) {
+	CHECK(CSkipSet_Init(&Skip));
+	pthread_t workers[THREADS];
+	pthread_t snapshotter;
+	pthread_create(&snapshotter, NULL, Snapshotter, NULL);
+	uintptr_t i = 0;
+	while (i < THREADS) {
+		pthread_create(&workers[i], NULL, Worker, (void*)i);
+		i++;
+	}
+	i = 0;
+	while (i < THREADS) {
+		pthread_join(workers[i], NULL);
+		i++;
+	}
+	__atomic_store_n(&Done, 1, __ATOMIC_RELEASE);
+	pthread_join(snapshotter, NULL);
+	CHECK(Errors == 0);
+
+	//Inserts and removes of each shared value alternate, so their
+	//successes differ by the value's final membership
+	uint32_t s = 0;
+	while (s < SHARED) {
+		bool member = CSkipSet_Contains(&Skip, OWNED + (int32_t)s);
+		CHECK(Balance[s] == (member ? 1 : 0));
+		s++;
+	}
+	CSet snap;
+	CSet_Init(&snap, 0);
+	CHECK(CSkipSet_Snapshot(&Skip, &snap) && Test_IsProper(&snap));
+	uint32_t n = 0;
+	while (n < snap.Usage) {
+		CHECK(CSkipSet_Contains(&Skip, snap.Data[n]));
+		n++;
+	}
+	free(snap.Data);
+	CSkipSet_Free(&Skip);
+}
+
+int main(void) {
+	TestSequential();
+	TestConcurrent();
+	return Test_Report("test_skipset");
+}
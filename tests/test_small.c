@@ -0,0 +1,168 @@
+// Behavior tests for the small-set paths of CSet_Contains,
+// CSet_Intersection and CSet_isSubsetOf: each must agree with a plain
+// reference whatever limits CSet_SetSmallThresholds() or CSet_Calibrate()
+// choose, including sets that hold INT32_MIN, which is also the FILLER.
+
+#include "CSet.c"
+#include "testing.h"
+
+static bool RefContains(const CSet* const pSet, int32_t Value) {
+	uint32_t i = 0;
+	while (i < pSet->Usage) {
+		if (pSet->Data[i] == Value) return true;
+		i++;
+	}
+	return false;
+}
+
+static bool RefSubset(const CSet* const pA, const CSet* const pB) {
+	uint32_t i = 0;
+	while (i < pA->Usage) {
+		if (!RefContains(pB, pA->Data[i])) return false;
+		i++;
+	}
+	return true;
+}
+
+// Builds sets of 0 to 40 values, drawn from a narrow range so they overlap
+// and nest often, some holding the extreme values and some with slack.
+#define NSETS 60
+
+static CSet Sets[NSETS];
+
+static void MakeOperands(void) {
+	Test_Seed = 777;
+	uint32_t s = 0;
+	while (s < NSETS) {
+		uint32_t n = s % 41;
+		int32_t values[44];
+		uint32_t i = 0;
+		while (i < n) {
+			values[i] = (int32_t)(Test_Random() % 48) - 24;
+			i++;
+		}
+		if (s % 3 == 0) values[n++] = INT32_MIN;
+		if (s % 5 == 0) values[n++] = INT32_MAX;
+		Test_MakeSet(&Sets[s], values, n, s % 4);
+		s++;
+	}
+	//A superset of set 30 that differs from it only at the ends
+	CSet_Copy(&Sets[NSETS - 1], &Sets[30]);
+	CSet_Insert(&Sets[NSETS - 1], INT32_MIN);
+	CSet_Insert(&Sets[NSETS - 1], INT32_MAX);
+}
+
+static void CheckAll(void) {
+	uint32_t x = 0;
+	while (x < NSETS) {
+		const CSet* pA = &Sets[x];
+		int32_t v = -26;
+		while (v <= 26) {
+			CHECK(CSet_Contains(pA, v) == RefContains(pA, v));
+			v++;
+		}
+		CHECK(CSet_Contains(pA, INT32_MIN) == RefContains(pA, INT32_MIN));
+		CHECK(CSet_Contains(pA, INT32_MAX) == RefContains(pA, INT32_MAX));
+		uint32_t y = 0;
+		while (y < NSETS) {
+			const CSet* pB = &Sets[y];
+			CHECK(CSet_isSubsetOf(pA, pB) == RefSubset(pA, pB));
+			CSet result;
+			CSet_Init(&result, 0);
+			CHECK(CSet_Intersection(&result, pA, pB));
+			CHECK(Test_IsProper(&result));
+			CHECK(result.Capacity == (pA->Capacity < pB->Capacity ? pA->Capacity : pB->Capacity));
+			uint32_t count = 0;
+			uint32_t i = 0;
+			while (i < pA->Usage) {
+				count += RefContains(pB, pA->Data[i]);
+				i++;
+			}
+			CHECK(result.Usage == count && RefSubset(&result, pA) && RefSubset(&result, pB));
+			free(result.Data);
+			y++;
+		}
+		x++;
+	}
+	//Results aliasing an operand
+	CSet a;
+	CSet_Init(&a, 0);
+	CSet_Copy(&a, &Sets[NSETS - 1]);
+	CHECK(CSet_Intersection(&a, &a, &Sets[30]));
+	CHECK(CSet_Equals(&a, &Sets[30]) && Test_IsProper(&a));
+	CHECK(CSet_Intersection(&a, &Sets[12], &a));
+	CHECK(Test_IsProper(&a) && RefSubset(&a, &Sets[12]) && RefSubset(&a, &Sets[30]));
+	free(a.Data);
+}
+
+static void TestEdges(void) {
+	//An empty set with spare cells, which hold INT32_MIN, has no members
+	CSet empty, none, minOnly;
+	Test_MakeSet(&empty, NULL, 0, 4);
+	Test_MakeSet(&none, NULL, 0, 0);
+	const int32_t min[1] = { INT32_MIN };
+	Test_MakeSet(&minOnly, min, 1, 3);
+	CHECK(!CSet_Contains(&empty, INT32_MIN));
+	CHECK(!CSet_Contains(&none, INT32_MIN));
+	CHECK(CSet_Contains(&minOnly, INT32_MIN));
+	CHECK(!CSet_isSubsetOf(&minOnly, &empty));
+	CHECK(CSet_isSubsetOf(&empty, &minOnly) && CSet_isSubsetOf(&none, &empty));
+	CHECK(CSet_isSubsetOf(&empty, &none) && CSet_isSubsetOf(&none, &none));
+	CSet result;
+	CSet_Init(&result, 0);
+	CHECK(CSet_Intersection(&result, &minOnly, &empty));
+	CHECK(result.Usage == 0 && result.Capacity == 4 && Test_IsProper(&result));
+	//A capacity of 0 gives a result with no cells at all
+	CHECK(CSet_Intersection(&result, &none, &minOnly));
+	CHECK(result.Usage == 0 && result.Capacity == 0 && Test_IsProper(&result));
+	CHECK(CSet_Intersection(&result, &none, &none));
+	CHECK(result.Usage == 0 && Test_IsProper(&result));
+	free(result.Data);
+	free(empty.Data);
+	free(minOnly.Data);
+
+	//A small set against a large one takes the merge, which must agree
+	CSet big, small;
+	Test_RandomSet(&big, 2000, 4000, -2000);
+	int32_t picks[8];
+	uint32_t i = 0;
+	while (i < 8) {
+		picks[i] = big.Data[i * 250];
+		i++;
+	}
+	Test_MakeSet(&small, picks, 8, 0);
+	CHECK(CSet_isSubsetOf(&small, &big) && !CSet_isSubsetOf(&big, &small));
+	CSet_Insert(&small, 5000);
+	CHECK(!CSet_isSubsetOf(&small, &big));
+	free(big.Data);
+	free(small.Data);
+}
+
+int main(void) {
+	MakeOperands();
+	//The default limits, both paths off, tiny limits, and limits that send
+	//every set down the small paths
+	CheckAll();
+	TestEdges();
+	CSet_SetSmallThresholds(0, 0);
+	CheckAll();
+	TestEdges();
+	CSet_SetSmallThresholds(1, 1);
+	CheckAll();
+	CSet_SetSmallThresholds(256, 256);
+	CheckAll();
+	TestEdges();
+	//Measured limits stay within the sizes tried
+	CSet_Calibrate();
+	CHECK(CSet_ScanMax <= CSET_CALIBRATE_MAX && CSet_PairsMax <= CSET_CALIBRATE_MAX);
+	CHECK(CSet_ScanMax == 0 || CSet_ScanMax >= 4);
+	CheckAll();
+	TestEdges();
+	CSet_SetSmallThresholds(32, 16);
+	uint32_t s = 0;
+	while (s < NSETS) {
+		free(Sets[s].Data);
+		s++;
+	}
+	return Test_Report("test_small");
+}
@@ -0,0 +1,213 @@
+// Behavior tests for CSetStore and its transactions, including concurrent
+// readers checking that each commit is seen whole.
+
+#include "CSet.c"
+#include "testing.h"
+
+static void TestSequential(void) {
+	CSetStore store;
+	CHECK(CSetStore_Init(&store, 3));
+	CSetReader reader;
+	CSetStore_ReadBegin(&store, &reader);
+	CHECK(CSetStore_Version(&reader) == 1);
+	uint32_t i = 0;
+	while (i < 3) {
+		CHECK(CSetStore_Get(&reader, i)->Usage == 0 && Test_IsProper(CSetStore_Get(&reader, i)));
+		i++;
+	}
+	CSetStore_ReadEnd(&store, &reader);
+
+	//An empty transaction still publishes a version
+	CSetTxn txn;
+	CHECK(CSetTxn_Begin(&store, &txn));
+	CHECK(CSetTxn_Commit(&txn));
+	CSetStore_ReadBegin(&store, &reader);
+	CHECK(CSetStore_Version(&reader) == 2 && CSetStore_Get(&reader, 0)->Usage == 0);
+	CSetStore_ReadEnd(&store, &reader);
+
+	//Extreme values, duplicates and the last change per value winning
+	CHECK(CSetTxn_Begin(&store, &txn));
+	CHECK(CSetTxn_Insert(&txn, 0, INT32_MAX));
+	CHECK(CSetTxn_Insert(&txn, 0, INT32_MIN));
+	CHECK(CSetTxn_Insert(&txn, 0, INT32_MIN));
+	CHECK(CSetTxn_Insert(&txn, 1, 7));
+	CHECK(CSetTxn_Remove(&txn, 1, 7));
+	CHECK(CSetTxn_Remove(&txn, 2, 8));
+	CHECK(CSetTxn_Insert(&txn, 2, 8));
+	CHECK(CSetTxn_Remove(&txn, 2, 9));
+	CHECK(CSetTxn_Commit(&txn));
+	CSetStore_ReadBegin(&store, &reader);
+	const int32_t s0[2] = { INT32_MIN, INT32_MAX };
+	const int32_t s2[1] = { 8 };
+	CHECK(CSetStore_Version(&reader) == 3);
+	CHECK(Test_Holds(CSetStore_Get(&reader, 0), s0, 2));
+	CHECK(Test_Holds(CSetStore_Get(&reader, 1), NULL, 0));
+	CHECK(Test_Holds(CSetStore_Get(&reader, 2), s2, 1));
+	CHECK(Test_IsProper(CSetStore_Get(&reader, 0)));
+
+	CSetStore_ReadEnd(&store, &reader);
+	CHECK(CSetTxn_Begin(&store, &txn));
+	CHECK(CSetTxn_Move(&txn, 0, 1, INT32_MAX));
+	CHECK(CSetTxn_Commit(&txn));
+	CSetStore_ReadBegin(&store, &reader);
+	const int32_t m0[1] = { INT32_MIN };
+	const int32_t m1[1] = { INT32_MAX };
+	CHECK(CSetStore_Version(&reader) == 4);
+	CHECK(Test_Holds(CSetStore_Get(&reader, 0), m0, 1));
+	CHECK(Test_Holds(CSetStore_Get(&reader, 1), m1, 1));
+	CHECK(Test_Holds(CSetStore_Get(&reader, 2), s2, 1));
+	CSetStore_ReadEnd(&store, &reader);
+
+	//Aborted transactions change nothing
+	CHECK(CSetTxn_Begin(&store, &txn));
+	CHECK(CSetTxn_Insert(&txn, 2, 100));
+	CHECK(CSetTxn_Remove(&txn, 0, INT32_MIN));
+	CSetTxn_Abort(&txn);
+	CSetStore_ReadBegin(&store, &reader);
+	CHECK(CSetStore_Version(&reader) == 4);
+	CHECK(Test_Holds(CSetStore_Get(&reader, 0), m0, 1));
+	CHECK(Test_Holds(CSetStore_Get(&reader, 2), s2, 1));
+	CSetStore_ReadEnd(&store, &reader);
+
+	//A large transaction grows its entry list; one of its values is 8
+	CHECK(CSetTxn_Begin(&store, &txn));
+	int32_t v = 0;
+	while (v < 5000) {
+		CHECK(CSetTxn_Insert(&txn, 2, v * 3 - 7000));
+		v++;
+	}
+	CHECK(CSetTxn_Commit(&txn));
+	CSetStore_ReadBegin(&store, &reader);
+	CHECK(CSetStore_Get(&reader, 2)->Usage == 5000 && Test_IsProper(CSetStore_Get(&reader, 2)));
+	CHECK(CSet_Contains(CSetStore_Get(&reader, 2), 8) && CSet_Contains(CSetStore_Get(&reader, 2), -7000));
+	CSetStore_ReadEnd(&store, &reader);
+	CSetStore_Free(&store);
+}
+
+// Writers move tokens between sets, so every version holds each of the
+// Tokens in exactly one set; readers check that on every version they see.
+#define SETS     4
+#define TOKENS   64
+#define WRITERS  2
+#define READERS  3
+#define COMMITS  200
+
+static CSetStore Store;
+static uint32_t  Done;
+static uint32_t  Errors;
+
+static void* Writer(void* Arg) {
+	uint32_t seed = 1 + (uint32_t)(uintptr_t)Arg;
+	uint32_t k = 0;
+	while (k < COMMITS) {
+		CSetTxn txn;
+		if (!CSetTxn_Begin(&Store, &txn)) {
+			__atomic_add_fetch(&Errors, 1, __ATOMIC_RELAXED);
+			break;
+		}
+		//Move a few tokens, removing each from every other set so that
+		//the commit is right whatever the version it lands on
+		uint32_t n = 0;
+		while (n < 3) {
+			seed = seed * 1103515245u + 12345u;
+			int32_t token = (int32_t)((seed >> 8) % TOKENS);
+			uint32_t to = (seed >> 20) % SETS;
+			uint32_t s = 0;
+			while (s < SETS) {
+				if (s != to) CSetTxn_Remove(&txn, s, token);
+				s++;
+			}
+			CSetTxn_Insert(&txn, to, token);
+			n++;
+		}
+		if (!CSetTxn_Commit(&txn)) {
+			__atomic_add_fetch(&Errors, 1, __ATOMIC_RELAXED);
+		}
+		k++;
+	}
+	return NULL;
+}
+
+static void* Reader(void* Arg) {
+	(void)Arg;
+	uint64_t last = 0;
+	while (!__atomic_load_n(&Done, __ATOMIC_ACQUIRE)) {
+		CSetReader reader;
+		CSetStore_ReadBegin(&Store, &reader);
+		uint64_t version = CSetStore_Version(&reader);
+		uint32_t total = 0;
+		uint32_t s = 0;
+		while (s < SETS) {
+			const CSet* pSet = CSetStore_Get(&reader, s);
+			if (!Test_IsProper(pSet)) __atomic_add_fetch(&Errors, 1, __ATOMIC_RELAXED);
+			total += pSet->Usage;
+			s++;
+		}
+		int32_t token = 0;
+		while (token < TOKENS) {
+			uint32_t holders = 0;
+			s = 0;
+			while (s < SETS) {
+				holders += CSet_Contains(CSetStore_Get(&reader, s), token);
+				s++;
+			}
+			if (holders != 1) __atomic_add_fetch(&Errors, 1, __ATOMIC_RELAXED);
+			token++;
+		}
+		CSetStore_ReadEnd(&Store, &reader);
+		if (total != TOKENS || version < last) {
+			__atomic_add_fetch(&Errors, 1, __ATOMIC_RELAXED);
+		}
+		last = version;
+	}
+	return NULL;
+}
+
+static void TestConcurrent(void) {
+	CHECK(CSetStore_Init(&Store, SETS));
+	CSetTxn txn;
+	CHECK(CSetTxn_Begin(&Store, &txn));
+	int32_t token = 0;
+	while (token < TOKENS) {
+		CHECK(CSetTxn_Insert(&txn, (uint32_t)token % SETS, token));
+		token++;
+	}
+	CHECK(CSetTxn_Commit(&txn));
+
+	pthread_t writers[WRITERS];
+	pthread_t readers[READERS];
+	uintptr_t i = 0;
+	while (i < READERS) {
+		pthread_create(&readers[i], NULL, Reader, NULL);
+		i++;
+	}
+	i = 0;
+	while (i < WRITERS) {
+		pthread_create(&writers[i], NULL, Writer, (void*)i);
+		i++;
+	}
+	i = 0;
+	while (i < WRITERS) {
+		pthread_join(writers[i], NULL);
+		i++;
+	}
+	__atomic_store_n(&Done, 1, __ATOMIC_RELEASE);
+	i = 0;
+	while (i < READERS) {
+		pthread_join(readers[i], NULL);
+		i++;
+	}
+	CHECK(Errors == 0);
+
+	CSetReader reader;
+	CSetStore_ReadBegin(&Store, &reader);
+	CHECK(CSetStore_Version(&reader) == 2 + WRITERS * COMMITS);
+	CSetStore_ReadEnd(&Store, &reader);
+	CSetStore_Free(&Store);
+}
+
+int main(void) {
+	TestSequential();
+	TestConcurrent();
+	return Test_Report("test_store");
+}
@@ -0,0 +1,238 @@
+// Behavior tests for CSetSubIndex, including concurrent matching.
+
+#define _POSIX_C_SOURCE 200809L
+#include "stdlib.h"
+
+// Every block CSet.c asks for is counted here, so a test can check how
+// much memory one call touches.
+static size_t Allocated = 0;
+
+static void* CountedMalloc(size_t Size) {
+	Allocated += Size;
+	return malloc(Size);
+}
+
+static void* CountedCalloc(size_t N, size_t Size) {
+	Allocated += N * Size;
+	return calloc(N, Size);
+}
+
+static void* CountedRealloc(void* p, size_t Size) {
+	Allocated += Size;
+	return realloc(p, Size);
+}
+
+#define malloc(Size)    CountedMalloc(Size)
+#define calloc(N, Size) CountedCalloc(N, Size)
+#define realloc(p, Size) CountedRealloc(p, Size)
+
+#include "CSet.c"
+#include "testing.h"
+
+#define NSUBS   300
+#define THREADS 8
+
+// Subscriptions and events draw from 0, 3, ..., 177 and the two extremes.
+#define RANGE   60
+#define SCALE   3
+#define OFFSET  0
+
+static CSetSubIndex Index;
+static CSet Subs[NSUBS];
+static bool Live[NSUBS];
+
+// Builds the expected matches for *pEvent by testing every subscription.
+static void Expected(CSet* const pExpect, const CSet* const pEvent) {
+	CSet_Init(pExpect, NSUBS + 1);
+	uint32_t id = 0;
+	while (id < NSUBS) {
+		if (Live[id] && Test_IsSubset(&Subs[id], pEvent)) {
+			pExpect->Data[pExpect->Usage++] = (int32_t)id;
+		}
+		id++;
+	}
+}
+
+static void CheckMatch(const CSet* const pEvent) {
+	CSet matches, expect;
+	CSet_Init(&matches, 0);
+	Expected(&expect, pEvent);
+	CHECK(CSetSubIndex_Match(&Index, pEvent, &matches));
+	CHECK(Test_IsProper(&matches) && Test_Holds(&matches, expect.Data, expect.Usage));
+	free(matches.Data);
+	free(expect.Data);
+}
+
+// Each matcher thread runs its own stream of queries against the shared
+// index and counts the answers that differ from a scan.
+struct MatchTask {
+
+	uint32_t Seed;
+	uint32_t Errors;
+};
+
+static void* Matcher(void* Arg) {
+	struct MatchTask* pTask = (struct MatchTask*)Arg;
+	uint32_t q = 0;
+	while (q < 300) {
+		int32_t values[RANGE + 2];
+		uint32_t n = 0;
+		uint32_t slot = 0;
+		while (slot < RANGE + 2) {
+			pTask->Seed = pTask->Seed * 1103515245u + 12345u;
+			if ((pTask->Seed >> 16) % 4 != 0) {
+				values[n++] = Test_EdgeValue(slot, RANGE, SCALE, OFFSET);
+			}
+			slot++;
+		}
+		CSet event, matches, expect;
+		Test_MakeSet(&event, values, n, 0);
+		CSet_Init(&matches, 0);
+		Expected(&expect, &event);
+		if (!CSetSubIndex_Match(&Index, &event, &matches) ||
+		    !Test_Holds(&matches, expect.Data, expect.Usage)) {
+			pTask->Errors++;
+		}
+		free(event.Data);
+		free(matches.Data);
+		free(expect.Data);
+		q++;
+	}
+	return NULL;
+}
+
+// A match reads only the id lists of the event's values: on an index of
+// many subscriptions, an event sharing no value with them allocates next
+// to nothing, and one sharing some values allocates in proportion to
+// their lists.
+static void TestLargeIndex(void) {
+	//Subscription id is { id % 1000, 1000 + id / 1000 }, so each value
+	//below 1000 is in 100 subscriptions and each value above in 1000
+	const uint32_t subs = 100000;
+	CSetSubIndex index;
+	CHECK(CSetSubIndex_Init(&index));
+	uint32_t id = 0;
+	bool ok = true;
+	while (id < subs) {
+		int32_t values[2] = { (int32_t)(id % 1000), (int32_t)(1000 + id / 1000) };
+		CSet sub;
+		uint32_t got;
+		Test_MakeSet(&sub, values, 2, 0);
+		ok = ok && CSetSubIndex_Add(&index, &sub, &got) && got == id;
+		free(sub.Data);
+		id++;
+	}
+	CSet none;
+	uint32_t emptyId;
+	CSet_Init(&none, 0);
+	ok = ok && CSetSubIndex_Add(&index, &none, &emptyId);
+	free(none.Data);
+	CHECK(ok);
+
+	const int32_t disjoint[3] = { -5, 1000000, INT32_MAX };
+	CSet event, matches;
+	Test_MakeSet(&event, disjoint, 3, 0);
+	CSet_Init(&matches, 0);
+	Allocated = 0;
+	CHECK(CSetSubIndex_Match(&index, &event, &matches));
+	CHECK(Allocated < 256);
+	CHECK(matches.Usage == 1 && matches.Data[0] == (int32_t)emptyId);
+	free(event.Data);
+
+	//1100 ids are read, and the counters for them take far less than one
+	//byte per subscription
+	const int32_t some[3] = { 5, 1003, 1000000 };
+	Test_MakeSet(&event, some, 3, 0);
+	Allocated = 0;
+	CHECK(CSetSubIndex_Match(&index, &event, &matches));
+	CHECK(Allocated < 64 * 1024 && Allocated < subs);
+	const int32_t expect[2] = { 3005, (int32_t)emptyId };
+	CHECK(Test_Holds(&matches, expect, 2) && Test_IsProper(&matches));
+	free(event.Data);
+	free(matches.Data);
+	CSetSubIndex_Free(&index);
+}
+
+int main(void) {
+	TestLargeIndex();
+	CHECK(CSetSubIndex_Init(&Index));
+	CSet event;
+	CSet_Init(&event, 0);
+	CheckMatch(&event);
+
+	//Subscriptions, including empty ones, added in id order
+	uint32_t id = 0;
+	while (id < NSUBS) {
+		uint32_t got = UINT32_MAX;
+		Test_RandomSetWithEdges(&Subs[id], 4, RANGE, SCALE, OFFSET, 0);
+		CHECK(CSetSubIndex_Add(&Index, &Subs[id], &got));
+		CHECK(got == id);
+		Live[id] = true;
+		id++;
+	}
+	uint32_t round = 0;
+	while (round < 200) {
+		Test_RandomSetWithEdges(&event, RANGE + 2, RANGE, SCALE, OFFSET, 0);
+		CheckMatch(&event);
+		free(event.Data);
+		round++;
+	}
+
+	//Removed ids stop matching and are handed out again
+	CHECK(!CSetSubIndex_Remove(&Index, NSUBS));
+	id = 0;
+	while (id < NSUBS) {
+		if (id % 3 == 0) {
+			CHECK(CSetSubIndex_Remove(&Index, id));
+			CHECK(!CSetSubIndex_Remove(&Index, id));
+			Live[id] = false;
+			free(Subs[id].Data);
+		}
+		id++;
+	}
+	id = 0;
+	while (id < NSUBS / 6) {
+		CSet sub;
+		uint32_t got = UINT32_MAX;
+		Test_RandomSetWithEdges(&sub, 3, RANGE, SCALE, OFFSET, 0);
+		CHECK(CSetSubIndex_Add(&Index, &sub, &got));
+		CHECK(got == 3 * id);
+		if (got < NSUBS && !Live[got]) {
+			Subs[got] = sub;
+			Live[got] = true;
+		}
+		id++;
+	}
+	round = 0;
+	while (round < 200) {
+		Test_RandomSetWithEdges(&event, RANGE + 2, RANGE, SCALE, OFFSET, 0);
+		CheckMatch(&event);
+		free(event.Data);
+		round++;
+	}
+
+	//Concurrent matching against the same index
+	pthread_t threads[THREADS];
+	struct MatchTask tasks[THREADS];
+	uint32_t t = 0;
+	while (t < THREADS) {
+		tasks[t].Seed = t + 1;
+		tasks[t].Errors = 0;
+		pthread_create(&threads[t], NULL, Matcher, &tasks[t]);
+		t++;
+	}
+	t = 0;
+	while (t < THREADS) {
+		pthread_join(threads[t], NULL);
+		CHECK(tasks[t].Errors == 0);
+		t++;
+	}
+
+	id = 0;
+	while (id < NSUBS) {
+		if (Live[id]) free(Subs[id].Data);
+		id++;
+	}
+	CSetSubIndex_Free(&Index);
+	return Test_Report("test_subindex");
+}
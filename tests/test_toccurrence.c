@@ -0,0 +1,104 @@
+// Behavior tests for CSet_TOccurrence().
+
+#include "CSet.c"
+#include "testing.h"
+
+#define MAXSETS 12
+
+// Builds the expected answer by sorting every member of every set together
+// and keeping the values whose run is at least T long.
+static void Expected(CSet* const pExpect, const CSet* Sets, uint32_t N, uint32_t T) {
+	uint64_t total = 0;
+	uint32_t s = 0;
+	while (s < N) {
+		total += Sets[s].Usage;
+		s++;
+	}
+	int32_t* all = (int32_t*)malloc((total + 1) * sizeof(int32_t));
+	uint64_t n = 0;
+	s = 0;
+	while (s < N) {
+		if (Sets[s].Usage > 0) memcpy(all + n, Sets[s].Data, Sets[s].Usage * sizeof(int32_t));
+		n += Sets[s].Usage;
+		s++;
+	}
+	qsort(all, n, sizeof(int32_t), Test_Compare);
+	uint64_t out = 0;
+	uint64_t i = 0;
+	while (i < n) {
+		uint64_t j = i;
+		while (j < n && all[j] == all[i]) j++;
+		if (j - i >= T) all[out++] = all[i];
+		i = j;
+	}
+	Test_MakeSet(pExpect, all, (uint32_t)out, 0);
+	free(all);
+}
+
+static void RunCase(uint32_t N, uint32_t Size, uint32_t Range, int64_t Base, uint32_t nThreads) {
+	CSet sets[MAXSETS];
+	const CSet* ptrs[MAXSETS];
+	uint32_t s = 0;
+	while (s < N) {
+		Test_RandomSet(&sets[s], Test_Random() % (Size + 1), Range, Base);
+		ptrs[s] = &sets[s];
+		s++;
+	}
+	uint32_t T = 1;
+	while (T <= N + 1) {
+		CSet result, expect;
+		CSet_Init(&result, 0);
+		Expected(&expect, sets, N, T);
+		CHECK(CSet_TOccurrence(&result, ptrs, N, T, nThreads));
+		CHECK(Test_IsProper(&result));
+		CHECK(Test_Holds(&result, expect.Data, expect.Usage));
+		free(result.Data);
+		free(expect.Data);
+		T++;
+	}
+	s = 0;
+	while (s < N) {
+		free(sets[s].Data);
+		s++;
+	}
+}
+
+static void TestEdges(void) {
+	CSet result, empty, ends;
+	CSet_Init(&result, 4);
+	CSet_Insert(&result, 7);
+	CSet_Init(&empty, 0);
+	const CSet* none[1] = { &empty };
+	CHECK(!CSet_TOccurrence(&result, none, 1, 0, 1));
+	CHECK(result.Usage == 1);
+	CHECK(CSet_TOccurrence(&result, none, 0, 1, 1));
+	CHECK(result.Usage == 0 && Test_IsProper(&result));
+	CHECK(CSet_TOccurrence(&result, none, 1, 1, 1));
+	CHECK(result.Usage == 0 && Test_IsProper(&result));
+
+	int32_t values[3] = { INT32_MIN, 0, INT32_MAX };
+	Test_MakeSet(&ends, values, 3, 1);
+	const CSet* twice[3] = { &ends, &empty, &ends };
+	CHECK(CSet_TOccurrence(&result, twice, 3, 2, 4));
+	CHECK(Test_Holds(&result, values, 3));
+	CHECK(CSet_TOccurrence(&result, twice, 3, 3, 4));
+	CHECK(result.Usage == 0);
+	free(result.Data);
+	free(ends.Data);
+}
+
+int main(void) {
+	TestEdges();
+	uint32_t round = 0;
+	while (round < 60) {
+		uint32_t n = 1 + Test_Random() % MAXSETS;
+		RunCase(n, 200, 400, -200, 1);
+		RunCase(n, 200, UINT32_MAX, INT32_MIN, 1);
+		round++;
+	}
+	//Large enough to be split across threads
+	RunCase(8, 40000, 200000, INT32_MAX - 199999, 4);
+	RunCase(8, 40000, UINT32_MAX, INT32_MIN, 0);
+	RunCase(3, 100000, 100000, INT32_MIN, 3);
+	return Test_Report("test_toccurrence");
+}
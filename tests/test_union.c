@@ -0,0 +1,181 @@
+// Behavior tests for CSet_Union, CSet_Split, CSet_Concat and the
+// range-disjoint path of CSet_SymDifference, including results that alias
+// an operand.
+
+#include "CSet.c"
+#include "testing.h"
+
+// Sets *pExpect to the union of *pA and *pB, or to their symmetric
+// difference if Sym, one value at a time.
+static void Reference(CSet* const pExpect, const CSet* const pA, const CSet* const pB, bool Sym) {
+	CSet_Init(pExpect, 1);
+	const CSet* sides[2] = { pA, pB };
+	uint32_t s = 0;
+	while (s < 2) {
+		uint32_t i = 0;
+		while (i < sides[s]->Usage) {
+			int32_t v = sides[s]->Data[i];
+			if (!Sym || CSet_Contains(pA, v) != CSet_Contains(pB, v)) {
+				CSet_Insert(pExpect, v);
+			}
+			i++;
+		}
+		s++;
+	}
+}
+
+#define NSETS 9
+
+static CSet Sets[NSETS];
+
+static void MakeOperands(void) {
+	const int32_t ends[2] = { INT32_MIN, INT32_MAX };
+	const int32_t low[3] = { INT32_MIN, -7, -1 };
+	const int32_t high[3] = { 0, 9, INT32_MAX };
+	Test_MakeSet(&Sets[0], NULL, 0, 1);
+	Test_MakeSet(&Sets[1], NULL, 0, 0);
+	Test_MakeSet(&Sets[2], ends, 2, 0);
+	Test_MakeSet(&Sets[3], low, 3, 2);
+	Test_MakeSet(&Sets[4], high, 3, 0);
+	//Range-disjoint from each other, and overlapping the full-range set
+	Test_RandomSet(&Sets[5], 3000, 10000, -20000);
+	Test_RandomSet(&Sets[6], 3000, 10000, -5000);
+	Test_RandomSet(&Sets[7], 3000, 10000, 10000);
+	Test_RandomSet(&Sets[8], 100, UINT32_MAX, INT32_MIN);
+}
+
+static void TestUnionAndSym(void) {
+	uint32_t x = 0;
+	while (x < NSETS) {
+		uint32_t y = 0;
+		while (y < NSETS) {
+			const CSet* pA = &Sets[x];
+			const CSet* pB = &Sets[y];
+			CSet expect, result;
+			Reference(&expect, pA, pB, false);
+			CSet_Init(&result, 0);
+			CHECK(CSet_Union(&result, pA, pB));
+			CHECK(CSet_Equals(&result, &expect) && Test_IsProper(&result));
+			CHECK(result.Capacity == pA->Capacity + pB->Capacity);
+			free(expect.Data);
+
+			Reference(&expect, pA, pB, true);
+			CHECK(CSet_SymDifference(&result, pA, pB));
+			CHECK(CSet_Equals(&result, &expect) && Test_IsProper(&result));
+			CHECK(result.Capacity == pA->Capacity + pB->Capacity);
+
+			//Results aliasing either operand
+			CSet a;
+			CSet_Init(&a, 0);
+			CSet_Copy(&a, pA);
+			CHECK(CSet_SymDifference(&a, &a, pB));
+			CHECK(CSet_Equals(&a, &expect) && Test_IsProper(&a));
+			free(expect.Data);
+			Reference(&expect, pA, pB, false);
+			CSet_Copy(&a, pB);
+			CHECK(CSet_Union(&a, pA, &a));
+			CHECK(CSet_Equals(&a, &expect) && Test_IsProper(&a));
+			free(expect.Data);
+			free(a.Data);
+			free(result.Data);
+			y++;
+		}
+		x++;
+	}
+	//A set with itself
+	CSet a;
+	CSet_Init(&a, 0);
+	CSet_Copy(&a, &Sets[5]);
+	CHECK(CSet_Union(&a, &a, &a));
+	CHECK(CSet_Equals(&a, &Sets[5]) && Test_IsProper(&a));
+	CHECK(CSet_SymDifference(&a, &a, &a));
+	CHECK(a.Usage == 0 && Test_IsProper(&a));
+	free(a.Data);
+}
+
+static void TestSplit(void) {
+	const int32_t pivots[7] = { INT32_MIN, INT32_MIN + 1, -1, 0, 5000, INT32_MAX, -20000 };
+	uint32_t x = 0;
+	while (x < NSETS) {
+		uint32_t p = 0;
+		while (p < 7) {
+			CSet low, high, joined;
+			CSet_Init(&low, 0);
+			CSet_Init(&high, 0);
+			CSet_Init(&joined, 0);
+			CHECK(CSet_Split(&Sets[x], pivots[p], &low, &high));
+			CHECK(Test_IsProper(&low) && Test_IsProper(&high));
+			CHECK(low.Capacity == low.Usage + 1 && high.Capacity == high.Usage + 1);
+			CHECK(low.Usage == 0 || low.Data[low.Usage - 1] < pivots[p]);
+			CHECK(high.Usage == 0 || high.Data[0] >= pivots[p]);
+			CHECK(low.Usage + high.Usage == Sets[x].Usage);
+			//Concat puts the halves back together, and refuses them the
+			//other way round unless one is empty
+			CHECK(CSet_Concat(&joined, &low, &high));
+			CHECK(CSet_Equals(&joined, &Sets[x]) && Test_IsProper(&joined));
+			CHECK(joined.Capacity == Sets[x].Usage + 1);
+			bool swapped = CSet_Concat(&joined, &high, &low);
+			CHECK(swapped == (low.Usage == 0 || high.Usage == 0));
+			CHECK(CSet_Equals(&joined, &Sets[x]));
+			free(low.Data);
+			free(high.Data);
+			free(joined.Data);
+			p++;
+		}
+		x++;
+	}
+	//The set split may be one of the halves
+	CSet a, other;
+	CSet_Init(&a, 0);
+	CSet_Init(&other, 0);
+	CSet_Copy(&a, &Sets[6]);
+	CHECK(CSet_Split(&a, 0, &a, &other));
+	CHECK(Test_IsProper(&a) && Test_IsProper(&other));
+	CHECK(a.Usage + other.Usage == Sets[6].Usage);
+	CHECK(a.Usage == 0 || a.Data[a.Usage - 1] < 0);
+	CSet_Copy(&a, &Sets[6]);
+	CHECK(CSet_Split(&a, 0, &other, &a));
+	CHECK(a.Usage == 0 || a.Data[0] >= 0);
+	CHECK(other.Usage + a.Usage == Sets[6].Usage);
+
+	//Concat aliasing its operands
+	CSet b;
+	CSet_Init(&b, 0);
+	CSet_Copy(&b, &Sets[7]);
+	CSet_Copy(&a, &Sets[5]);
+	CSet expect;
+	Reference(&expect, &Sets[5], &Sets[7], false);
+	CHECK(CSet_Concat(&a, &a, &b));
+	CHECK(CSet_Equals(&a, &expect) && Test_IsProper(&a));
+	CSet_Copy(&a, &Sets[5]);
+	CHECK(CSet_Concat(&b, &a, &b));
+	CHECK(CSet_Equals(&b, &expect));
+	//Overlapping ranges leave the result unchanged
+	CHECK(!CSet_Concat(&b, &Sets[6], &Sets[8]));
+	CHECK(!CSet_Concat(&b, &Sets[2], &Sets[2]));
+	CHECK(CSet_Equals(&b, &expect));
+	//Values meeting at the boundary count as overlapping
+	const int32_t one[1] = { 7 };
+	CSet c;
+	Test_MakeSet(&c, one, 1, 1);
+	CHECK(!CSet_Concat(&b, &c, &c));
+	CHECK(CSet_Concat(&b, &Sets[0], &Sets[1]));
+	CHECK(b.Usage == 0 && Test_IsProper(&b));
+	free(a.Data);
+	free(b.Data);
+	free(c.Data);
+	free(other.Data);
+	free(expect.Data);
+}
+
+int main(void) {
+	MakeOperands();
+	TestUnionAndSym();
+	TestSplit();
+	uint32_t i = 0;
+	while (i < NSETS) {
+		free(Sets[i].Data);
+		i++;
+	}
+	return Test_Report("test_union");
+}
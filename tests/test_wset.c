@@ -0,0 +1,159 @@
+// Behavior tests for CWSet and CWSet_TopK().
+
+#include "CSet.c"
+#include "testing.h"
+
+static void TestBasics(void) {
+	CWSet a, b, c;
+	CWSet_Init(&a, 0);
+	CWSet_Init(&b, 2);
+	CWSet_Init(&c, 0);
+	double w = -1.0;
+	CHECK(!CWSet_Weight(&a, 0, &w));
+	CHECK(!CWSet_Insert(&a, 1, -1.0));
+	CHECK(CWSet_Intersection(&c, &a, &b, CWSET_SUM));
+	CHECK(c.Usage == 0);
+
+	CHECK(CWSet_Insert(&a, INT32_MAX, 1.0));
+	CHECK(CWSet_Insert(&a, INT32_MIN, 2.0));
+	CHECK(CWSet_Insert(&a, 0, 3.0));
+	CHECK(CWSet_Insert(&a, 0, 4.0));
+	CHECK(a.Usage == 3 && a.Data[0] == INT32_MIN && a.Data[2] == INT32_MAX);
+	CHECK(CWSet_Weight(&a, 0, &w) && w == 4.0);
+	CHECK(CWSet_Seal(&a));
+	CHECK(a.BlockMax != NULL && a.MaxWeight == 4.0);
+	CHECK(CWSet_Insert(&a, 5, 0.5));
+	CHECK(a.BlockMax == NULL);
+
+	CWSet_Insert(&b, INT32_MIN, 1.0);
+	CWSet_Insert(&b, 5, 2.0);
+	CHECK(CWSet_Intersection(&c, &a, &b, CWSET_SUM));
+	CHECK(c.Usage == 2 && c.Data[0] == INT32_MIN && c.Weight[0] == 3.0 && c.Weight[1] == 2.5);
+	CHECK(CWSet_Intersection(&a, &a, &b, CWSET_MAX));
+	CHECK(a.Usage == 2 && a.Weight[0] == 2.0 && a.Weight[1] == 2.0);
+	CWSet_Free(&a);
+	CWSet_Free(&b);
+	CWSet_Free(&c);
+}
+
+// A block ending at INT32_MAX used to make the block skip wrap to INT32_MIN
+// and spin forever.
+static void TestTopKInt32Max(void) {
+	CWSet a, b;
+	CWSet_Init(&a, 0);
+	CWSet_Init(&b, 0);
+	CWSet_Insert(&a, 0, 11.0);
+	int32_t v = 1;
+	while (v < 64) {
+		CWSet_Insert(&a, v, 0.5);
+		v++;
+	}
+	CWSet_Insert(&a, 1000, 0.5);
+	CWSet_Insert(&a, INT32_MAX, 0.5);
+	CWSet_Insert(&b, 50, 1.0);
+	CWSet_Insert(&b, INT32_MAX, 1.0);
+	const CWSet* sets[2] = { &a, &b };
+	int32_t values[3];
+	double scores[3];
+	CHECK(CWSet_TopK(sets, 2, 1, values, scores) == 1);
+	CHECK(values[0] == 0 && scores[0] == 11.0);
+	CWSet_Seal(&a);
+	CWSet_Seal(&b);
+	CHECK(CWSet_TopK(sets, 2, 3, values, scores) == 3);
+	CHECK(values[0] == 0 && scores[0] == 11.0);
+	CHECK(scores[1] == 1.5 && scores[2] == 1.5);
+	CHECK((values[1] == 50 && values[2] == INT32_MAX) || (values[1] == INT32_MAX && values[2] == 50));
+	CWSet_Free(&a);
+	CWSet_Free(&b);
+}
+
+#define NSETS 4
+#define RANGE 512
+
+// Compares CWSet_TopK() with a brute-force ranking; weights are multiples
+// of 1/4 so every sum is exact.
+static void TestTopKRandom(void) {
+	static const int32_t Edge[4] = { INT32_MIN, INT32_MIN + 1, INT32_MAX - 1, INT32_MAX };
+	uint32_t round = 0;
+	while (round < 300) {
+		CWSet sets[NSETS];
+		const CWSet* ptrs[NSETS];
+		double total[RANGE + 4] = { 0.0 };
+		uint32_t n = 1 + Test_Random() % NSETS;
+		uint32_t s = 0;
+		while (s < n) {
+			CWSet_Init(&sets[s], 0);
+			uint32_t m = Test_Random() % 300;
+			uint32_t k = 0;
+			while (k < m) {
+				uint32_t slot = Test_Random() % (RANGE + 4);
+				int32_t v = (slot < RANGE) ? (int32_t)slot * 3 - 700 : Edge[slot - RANGE];
+				double w = (Test_Random() % 40) * 0.25;
+				double old = 0.0;
+				CWSet_Weight(&sets[s], v, &old);
+				CWSet_Insert(&sets[s], v, w);
+				total[slot] += w - old;
+				k++;
+			}
+			if (Test_Random() % 2) CWSet_Seal(&sets[s]);
+			ptrs[s] = &sets[s];
+			s++;
+		}
+		//Brute force: count members and collect totals in descending order
+		double expect[RANGE + 4];
+		uint32_t members = 0;
+		uint32_t slot = 0;
+		while (slot < RANGE + 4) {
+			int32_t v = (slot < RANGE) ? (int32_t)slot * 3 - 700 : Edge[slot - RANGE];
+			bool member = false;
+			s = 0;
+			while (s < n) {
+				double w;
+				member = CWSet_Weight(&sets[s], v, &w) || member;
+				s++;
+			}
+			if (member) {
+				uint32_t j = members++;
+				while (j > 0 && expect[j - 1] < total[slot]) {
+					expect[j] = expect[j - 1];
+					j--;
+				}
+				expect[j] = total[slot];
+			}
+			slot++;
+		}
+		uint32_t K = 1 + Test_Random() % 20;
+		int32_t values[20];
+		double scores[20];
+		uint32_t r = CWSet_TopK(ptrs, n, K, values, scores);
+		CHECK(r == (K < members ? K : members));
+		uint32_t i = 0;
+		while (i < r) {
+			CHECK(scores[i] == expect[i]);
+			double sum = 0.0;
+			s = 0;
+			while (s < n) {
+				double w = 0.0;
+				CWSet_Weight(&sets[s], values[i], &w);
+				sum += w;
+				s++;
+			}
+			CHECK(sum == scores[i]);
+			CHECK(i == 0 || values[i] != values[i - 1]);
+			i++;
+		}
+		s = 0;
+		while (s < n) {
+			CWSet_Free(&sets[s]);
+			s++;
+		}
+		round++;
+	}
+}
+
+int main(void) {
+	TestBasics();
+	TestTopKInt32Max();
+	TestTopKRandom();
+	return Test_Report("test_wset");
+}
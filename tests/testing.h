@@ -0,0 +1,174 @@
+#ifndef TESTING_H
+#define TESTING_H
+
+// Minimal checking support for the behavior tests in this directory.
+//
+// Each test program #includes CSet.c directly, since most of the extended
+// API (CMultiSet, CWSet, CSetStore, ...) is not declared in the grader's
+// CSet.h.  A test calls CHECK() for every expectation and returns
+// Test_Report() from main(); the runner treats a nonzero exit as failure.
+
+#include "stdio.h"
+#include "stdlib.h"
+#include "stdint.h"
+#include "stdbool.h"
+#include "string.h"
+
+static uint32_t Test_Checks = 0;
+static uint32_t Test_Failures = 0;
+
+// Records one expectation; on failure prints its location and text.
+#define CHECK(cond) \
+	do { \
+		Test_Checks++; \
+		if (!(cond)) { \
+			Test_Failures++; \
+			fprintf(stderr, "%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #cond); \
+		} \
+	} while (0)
+
+/**
+ * Prints the pass/fail summary for a test program.
+ *
+ * Returns:
+ *    0 if every CHECK held, 1 otherwise
+ */
+static inline int Test_Report(const char* Name) {
+	printf("%-24s %u checks, %u failed\n", Name, Test_Checks, Test_Failures);
+	return Test_Failures == 0 ? 0 : 1;
+}
+
+static inline int Test_Compare(const void* pA, const void* pB) {
+	int32_t a = *(const int32_t*)pA;
+	int32_t b = *(const int32_t*)pB;
+	return (a > b) - (a < b);
+}
+
+/**
+ * Builds a proper CSet holding the N given values (which need not be sorted
+ * or distinct) with Slack spare FILLER cells above Usage.
+ */
+static inline void Test_MakeSet(CSet* const pSet, const int32_t* Values, uint32_t N, uint32_t Slack) {
+	pSet->Capacity = 0;
+	pSet->Usage = 0;
+	pSet->Data = NULL;
+	if (N + Slack == 0) return;
+	int32_t* data = (int32_t*)malloc((N + Slack) * sizeof(int32_t));
+	if (N > 0) memcpy(data, Values, N * sizeof(int32_t));
+	qsort(data, N, sizeof(int32_t), Test_Compare);
+	uint32_t usage = 0;
+	uint32_t i = 0;
+	while (i < N) {
+		if (usage == 0 || data[usage - 1] != data[i]) data[usage++] = data[i];
+		i++;
+	}
+	pSet->Capacity = usage + Slack;
+	pSet->Usage = usage;
+	if (pSet->Capacity == 0) {
+		free(data);
+		return;
+	}
+	i = usage;
+	while (i < pSet->Capacity) {
+		data[i] = INT32_MIN;
+		i++;
+	}
+	pSet->Data = data;
+}
+
+/**
+ * Determines whether *pSet is proper: ascending values below Usage,
+ * FILLER above it, and no storage when Capacity is 0.
+ */
+static inline bool Test_IsProper(const CSet* const pSet) {
+	if (pSet->Usage > pSet->Capacity) return false;
+	if (pSet->Capacity == 0) return pSet->Usage == 0 && pSet->Data == NULL;
+	uint32_t i = 1;
+	while (i < pSet->Usage) {
+		if (pSet->Data[i - 1] >= pSet->Data[i]) return false;
+		i++;
+	}
+	i = pSet->Usage;
+	while (i < pSet->Capacity) {
+		if (pSet->Data[i] != INT32_MIN) return false;
+		i++;
+	}
+	return true;
+}
+
+/**
+ * Determines whether *pSet holds exactly the N ascending values in Values.
+ */
+static inline bool Test_Holds(const CSet* const pSet, const int32_t* Values, uint32_t N) {
+	if (pSet->Usage != N) return false;
+	return N == 0 || memcmp(pSet->Data, Values, N * sizeof(int32_t)) == 0;
+}
+
+/**
+ * Determines whether every member of *pA is a member of *pB, by walking
+ * both sets, as a reference for the operations under test.
+ */
+static inline bool Test_IsSubset(const CSet* const pA, const CSet* const pB) {
+	uint32_t j = 0;
+	uint32_t i = 0;
+	while (i < pA->Usage) {
+		while (j < pB->Usage && pB->Data[j] < pA->Data[i]) j++;
+		if (j == pB->Usage || pB->Data[j] != pA->Data[i]) return false;
+		i++;
+	}
+	return true;
+}
+
+// xorshift32; deterministic so failures reproduce.
+static uint32_t Test_Seed = 2463534242u;
+
+static inline uint32_t Test_Random(void) {
+	Test_Seed ^= Test_Seed << 13;
+	Test_Seed ^= Test_Seed >> 17;
+	Test_Seed ^= Test_Seed << 5;
+	return Test_Seed;
+}
+
+/**
+ * Builds a proper set of up to N random values from [Base, Base + Range),
+ * with up to two spare cells.
+ */
+static inline void Test_RandomSet(CSet* const pSet, uint32_t N, uint32_t Range, int64_t Base) {
+	int32_t* values = (int32_t*)malloc((N + 1) * sizeof(int32_t));
+	uint32_t i = 0;
+	while (i < N) {
+		values[i] = (int32_t)(Base + (int64_t)(Test_Random() % Range));
+		i++;
+	}
+	Test_MakeSet(pSet, values, N, Test_Random() % 3);
+	free(values);
+}
+
+/**
+ * Maps Slot in [0, Range + 2) to a test value: Slot * Scale + Offset below
+ * Range, then INT32_MIN and INT32_MAX, so the extremes turn up as often as
+ * any other value.
+ */
+static inline int32_t Test_EdgeValue(uint32_t Slot, uint32_t Range, int32_t Scale, int32_t Offset) {
+	if (Slot < Range) return (int32_t)((int64_t)Slot * Scale + Offset);
+	return (Slot == Range) ? INT32_MIN : INT32_MAX;
+}
+
+/**
+ * Builds a proper set of up to MaxSize values drawn by Test_EdgeValue()
+ * from its Range + 2 slots, with Slack spare cells.
+ */
+static inline void Test_RandomSetWithEdges(CSet* const pSet, uint32_t MaxSize, uint32_t Range,
+                                           int32_t Scale, int32_t Offset, uint32_t Slack) {
+	int32_t* values = (int32_t*)malloc((MaxSize + 1) * sizeof(int32_t));
+	uint32_t n = Test_Random() % (MaxSize + 1);
+	uint32_t i = 0;
+	while (i < n) {
+		values[i] = Test_EdgeValue(Test_Random() % (Range + 2), Range, Scale, Offset);
+		i++;
+	}
+	Test_MakeSet(pSet, values, n, Slack);
+	free(values);
+}
+
+#endif